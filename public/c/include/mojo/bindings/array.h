@@ -113,13 +113,24 @@ MojomValidationResult MojomArray_Validate(
     uint32_t in_num_handles,
     struct MojomValidationContext* inout_context);
 
+// Validates only the header of |in_array|: that it fits within
+// |in_array_size| bytes and is large enough for its elements (and, for
+// fixed-size arrays, has the expected number of elements). Used by
+// MojomArray_Validate() before validating the elements.
+MojomValidationResult MojomArray_ValidateHeader(
+    const struct MojomTypeDescriptorArray* in_type_desc,
+    const struct MojomArrayHeader* in_array,
+    uint32_t in_array_size);
+
 // Creates a new copy of |in_array| using |buffer| to allocate space.
 // Recursively creates new copies of any references from |in_array|, and updates
 // the references to point to the new copies. This operation is useful if you
 // want to linearize |in_array| using the buffer backed by |buffer|. If there is
 // insufficient space in the buffer or has unknown-typed data, this function
 // returns false and the supplied buffer may be partially used. Otherwise,
-// |out_array| is set to the new copy of the struct.
+// |out_array| is set to the new copy of the struct. If |buffer| is the buffer
+// of a |MojomArena|, the copy only fails if memory can't be allocated, but it
+// is not linear (see |MojomArena|).
 // |buffer|: A mojom buffer used to allocate space for the new array.
 // |in_type_desc|: Describes the pointer and handle fields of the mojom array.
 // |in_array|: The unencoded mojom array to be copied.
@@ -11,6 +11,8 @@
 
 MOJO_BEGIN_EXTERN_C
 
+struct MojomArena;
+
 // |MojomBuffer| is used to track a buffer state for mojom serialization. The
 // user must initialize this struct themselves. See the fields for details.
 struct MojomBuffer {
@@ -20,12 +22,83 @@ struct MojomBuffer {
   // Must be initialized to 0. MojomBuffer_Allocate() will update it as it
   // consumes |buf|.
   uint32_t num_bytes_used;
+  // Should be NULL (the default when the fields above are initialized with a
+  // brace initializer), unless this is the |buffer| of a |MojomArena|, in
+  // which case it points to that arena; see below.
+  struct MojomArena* arena;
 };
 
 // Allocates |num_bytes| (rounded up to 8 bytes) from |buf|. Returns NULL if
-// there isn't enough space left to allocate.
+// there isn't enough space left to allocate. If |buf| belongs to an arena, a
+// new chunk is taken from the arena instead of failing.
 void* MojomBuffer_Allocate(struct MojomBuffer* buf, uint32_t num_bytes);
 
+// The size of the first chunk an arena allocates, and the largest size it
+// grows chunks to (larger allocations still get a chunk of their own).
+#define MOJOM_ARENA_MIN_CHUNK_SIZE ((uint32_t)4096)
+#define MOJOM_ARENA_MAX_CHUNK_SIZE ((uint32_t)(256 * 1024))
+
+// A chunk of memory owned by a |MojomArena|. It is followed (at the next
+// 8-byte boundary) by |size| bytes.
+struct MojomArenaChunk {
+  struct MojomArenaChunk* next;
+  uint32_t size;
+};
+
+// |MojomArena| is a growable allocator made of a list of chunks. Since its
+// |buffer| is an ordinary |MojomBuffer|, it can be passed to any of the
+// *_DeepCopy() and *_New() functions, which then never fail for lack of space
+// (only if malloc() fails), so that a received message can be copied and
+// retained without computing its size first.
+//
+// Each allocation is contiguous, but consecutive allocations may be in
+// different chunks. Objects built in an arena therefore can't be encoded in
+// place into a message; they have to be copied into a single |MojomBuffer|
+// first.
+//
+// Chunks are kept when the arena is reset, so a long-lived arena that is
+// reset after each message doesn't call malloc() once it has grown to the
+// size of the largest message. All chunks are freed at once by
+// MojomArena_Destroy(); individual allocations are never freed.
+struct MojomArena {
+  // Allocations are made from |buffer|, which describes the unused part of
+  // the current chunk. Pass |&arena->buffer| to functions taking a
+  // |MojomBuffer|; don't copy it.
+  struct MojomBuffer buffer;
+  // The memory passed to MojomArena_Init(), if any. It is used before any
+  // chunk, and isn't freed by the arena.
+  char* initial_buf;
+  uint32_t initial_buf_size;
+  // The size of the next chunk to malloc().
+  uint32_t next_chunk_size;
+  // All the chunks, in the order they are used, and the one |buffer| is
+  // currently in (NULL while allocating from |initial_buf|).
+  struct MojomArenaChunk* chunks;
+  struct MojomArenaChunk* current_chunk;
+};
+
+// Initializes |arena|. |initial_buf| (which may be NULL) holds
+// |initial_buf_size| bytes that are used before any memory is malloc()ed; it
+// must be 8-byte aligned, and outlive the arena.
+void MojomArena_Init(struct MojomArena* arena,
+                     void* initial_buf,
+                     uint32_t initial_buf_size);
+
+// Allocates |num_bytes| (rounded up to 8 bytes) of contiguous memory from
+// |arena|. Returns NULL only if a new chunk was needed and malloc() failed.
+void* MojomArena_Allocate(struct MojomArena* arena, uint32_t num_bytes);
+
+// Makes all the memory in |arena| available for reuse, invalidating every
+// allocation made from it. Chunks are kept, rather than freed.
+void MojomArena_Reset(struct MojomArena* arena);
+
+// Frees all the chunks of |arena|. The arena must be initialized again
+// before it is reused.
+void MojomArena_Destroy(struct MojomArena* arena);
+
+// Returns the total number of bytes in the chunks |arena| has allocated.
+uint64_t MojomArena_GetNumBytesReserved(const struct MojomArena* arena);
+
 // |MojomHandleBuffer| is used to track handle offsets during serialization.
 // Handles are moved into the |handles| array, and are referred to by index
 // into the array. The user must initialize this struct themselves. See the
@@ -158,6 +158,40 @@ extern const struct MojomTypeDescriptorArray g_mojom_string_type_description;
 // them here.
 bool MojomType_IsPointer(enum MojomTypeDescriptorType type);
 
+// Encodes |pointer| into an offset relative to itself. The pointee must be
+// within |max_offset| bytes of |pointer|.
+void MojomType_EncodePointer(union MojomPointer* pointer, uint32_t max_offset);
+
+// Decodes the offset in |pointer| back into a pointer.
+void MojomType_DecodePointer(union MojomPointer* pointer);
+
+// Encodes |handle| by moving it into |handles_buffer| and replacing it with its
+// index there. An invalid handle is encoded as index "-1", and is only allowed
+// if |nullable|.
+void MojomType_EncodeHandle(bool nullable, MojoHandle* handle,
+                            struct MojomHandleBuffer* handles_buffer);
+
+// Decodes |handle|, which is an index into |inout_handles| (or the encoded
+// invalid handle), by moving the handle out of |inout_handles|.
+void MojomType_DecodeHandle(MojoHandle* handle,
+                            MojoHandle inout_handles[],
+                            uint32_t in_num_handles);
+
+// Validates that the offset (|pointer->offset|) points to a new memory region,
+// i.e. one that hasn't been referenced yet. If so, moves the expected offset
+// (for the next pointer) forward.
+MojomValidationResult MojomType_ValidatePointer(
+    const union MojomPointer* pointer,
+    size_t max_offset,
+    bool is_nullable,
+    struct MojomValidationContext* inout_context);
+
+// Validates an encoded handle index against |num_handles|, and makes sure
+// handles are referenced in increasing order.
+MojomValidationResult MojomType_ValidateHandle(
+    MojoHandle encoded_handle, uint32_t num_handles, bool is_nullable,
+    struct MojomValidationContext* inout_context);
+
 // This helper function, depending on |type|, calls the appropriate
 // *_ComputeSerializedSize(|type_desc|, |data|).
 size_t MojomType_DispatchComputeSerializedSize(
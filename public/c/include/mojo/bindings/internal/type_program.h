@@ -0,0 +1,131 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file contains a compiled form of mojom type descriptors. The
+// MojomType_Dispatch*() functions walk a type descriptor recursively: every
+// pointer is a function call, and every element goes through a switch on its
+// |MojomTypeDescriptorType| as well as a linear scan of the containing
+// descriptor. For deeply nested types or large arrays of references this
+// dominates the cost of serialization.
+//
+// A |MojomTypeProgram| flattens a struct, array or union type descriptor into
+// a table of ops, one per field that holds a pointer, union or handle (plain
+// old data fields are dropped). Ops refer directly to the program of the type
+// they point to, so the programs for all the types reachable from a struct
+// form a graph that is compiled once (typically at startup) and can then be
+// interpreted by a single iterative loop using an explicit stack instead of
+// recursion.
+//
+// The MojomTypeProgram_*() functions below are drop-in replacements for the
+// corresponding MojomStruct_*() functions, and produce identical results.
+
+#ifndef MOJO_PUBLIC_C_INCLUDE_MOJO_BINDINGS_INTERNAL_TYPE_PROGRAM_H_
+#define MOJO_PUBLIC_C_INCLUDE_MOJO_BINDINGS_INTERNAL_TYPE_PROGRAM_H_
+
+#include <mojo/bindings/buffer.h>
+#include <mojo/bindings/internal/type_descriptor.h>
+#include <mojo/bindings/internal/util.h>
+#include <mojo/bindings/struct.h>
+#include <mojo/bindings/validation.h>
+#include <mojo/macros.h>
+#include <mojo/system/handle.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+MOJO_BEGIN_EXTERN_C
+
+// The maximum nesting depth of structs and arrays handled by the iterative
+// interpreter. Anything nested deeper than this falls back to the recursive
+// MojomType_Dispatch*() functions.
+#define MOJOM_TYPE_PROGRAM_MAX_DEPTH 32
+
+// Describes a single pointer, union or handle slot of a compiled type.
+struct MojomTypeProgramOp {
+  // The type of the slot; see |MojomTypeDescriptorType|.
+  enum MojomTypeDescriptorType type;
+  // Byte offset of the slot from the start of the enclosing object. For struct
+  // fields, this includes the struct header. For array elements, this is 0 and
+  // the element index is accounted for separately.
+  uint32_t offset;
+  // For struct fields, the minimum struct version the field is present in. For
+  // union fields, the union tag. 0 for array elements.
+  uint32_t key;
+  bool nullable;
+  // The program describing the referenced (or inline union) type, or NULL for
+  // handles, interfaces and plain old data.
+  const struct MojomTypeProgram* target;
+};
+
+// A compiled struct, map, array or union type descriptor.
+struct MojomTypeProgram {
+  // One of MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR, *_MAP_PTR, *_ARRAY_PTR or
+  // *_UNION.
+  enum MojomTypeDescriptorType type;
+  // The type descriptor this program was compiled from.
+  const void* type_desc;
+  // For arrays, the byte size of an element. 0 otherwise.
+  uint32_t elem_size;
+  // |ops| is an array of |num_ops| entries. For structs, they are in the same
+  // order as the type descriptor's entries. Arrays of non-POD types have a
+  // single op describing every element, and arrays of POD types have none.
+  uint32_t num_ops;
+  const struct MojomTypeProgramOp* ops;
+  // Whether this is a struct or array that is at most two levels deep: every
+  // op is either a handle, or a struct or array pointer whose target only
+  // contains handles. Shallow types are visited in a single loop without
+  // using the interpreter's stack, which avoids a push and pop per element for
+  // the common case of arrays of small structs.
+  bool is_shallow;
+  // Programs compiled together are chained in the order they were compiled.
+  struct MojomTypeProgram* next;
+};
+
+// Compiles |in_type_desc| and every type reachable from it into programs
+// allocated out of |inout_buffer|, which must be 8-byte aligned and must
+// outlive the returned program. Each type descriptor is compiled only once,
+// so recursive types are supported. Returns NULL if |inout_buffer| is too
+// small.
+const struct MojomTypeProgram* MojomTypeProgram_CompileStruct(
+    const struct MojomTypeDescriptorStruct* in_type_desc,
+    struct MojomBuffer* inout_buffer);
+
+// Like MojomStruct_ComputeSerializedSize(), but driven by |in_program|, which
+// must have been compiled from the struct's type descriptor.
+size_t MojomTypeProgram_ComputeSerializedSize(
+    const struct MojomTypeProgram* in_program,
+    const struct MojomStructHeader* in_struct);
+
+// Like MojomStruct_EncodePointersAndHandles().
+void MojomTypeProgram_EncodePointersAndHandles(
+    const struct MojomTypeProgram* in_program,
+    struct MojomStructHeader* inout_struct,
+    uint32_t in_struct_size,
+    struct MojomHandleBuffer* inout_handles_buffer);
+
+// Like MojomStruct_DecodePointersAndHandles().
+void MojomTypeProgram_DecodePointersAndHandles(
+    const struct MojomTypeProgram* in_program,
+    struct MojomStructHeader* inout_struct,
+    uint32_t in_struct_size,
+    MojoHandle* inout_handles,
+    uint32_t in_num_handles);
+
+// Like MojomStruct_Validate().
+MojomValidationResult MojomTypeProgram_Validate(
+    const struct MojomTypeProgram* in_program,
+    const struct MojomStructHeader* in_struct,
+    uint32_t in_struct_size,
+    uint32_t in_num_handles,
+    struct MojomValidationContext* inout_context);
+
+// Like MojomStruct_DeepCopy().
+bool MojomTypeProgram_DeepCopy(struct MojomBuffer* buffer,
+                               const struct MojomTypeProgram* in_program,
+                               const struct MojomStructHeader* in_struct,
+                               struct MojomStructHeader** out_struct);
+
+MOJO_END_EXTERN_C
+
+#endif  // MOJO_PUBLIC_C_INCLUDE_MOJO_BINDINGS_INTERNAL_TYPE_PROGRAM_H_
@@ -68,6 +68,20 @@ void MojomStruct_DecodePointersAndHandles(
     MojoHandle* inout_handles,
     uint32_t in_num_handles);
 
+// Like MojomStruct_DecodePointersAndHandles(), but decodes a copy of
+// |in_struct| made in |arena| instead of decoding it in place, so that a
+// received message can be retained after the buffer it was read into is
+// reused. Since the encoded struct is already linear, it is copied with a
+// single allocation and no sizing pass. Returns the decoded copy, or NULL if
+// |arena| couldn't allocate it (in which case no handles are moved).
+struct MojomStructHeader* MojomStruct_DecodeIntoArena(
+    const struct MojomTypeDescriptorStruct* in_type_desc,
+    const struct MojomStructHeader* in_struct,
+    uint32_t in_struct_size,
+    MojoHandle* inout_handles,
+    uint32_t in_num_handles,
+    struct MojomArena* arena);
+
 // Validates the mojom struct described by the |in_struct| buffer. Any
 // references from the struct are also recursively validated, and are expected
 // to be in the same buffer backing |in_struct|.
@@ -87,13 +101,23 @@ MojomValidationResult MojomStruct_Validate(
     uint32_t in_num_handles,
     struct MojomValidationContext* inout_context);
 
+// Validates only the header of |in_struct|: that it fits within
+// |in_struct_size| bytes, is aligned, and has a size consistent with its
+// version. Used by MojomStruct_Validate() before validating the fields.
+MojomValidationResult MojomStruct_ValidateHeader(
+    const struct MojomTypeDescriptorStruct* in_type_desc,
+    const struct MojomStructHeader* in_struct,
+    uint32_t in_struct_size);
+
 // Creates a new copy of |in_struct| using |buffer| to allocate space.
 // Recursively creates new copies of any references from |in_struct|, and
 // updates the references to point to the new copies. This operation is useful
 // if you want to linearize |in_struct| using the buffer backed by |buffer|. If
 // there is insufficient space in the buffer or has unknown-typed data, this
 // function returns false and the supplied buffer may be partially used.
-// Otherwise, |out_struct| is set to the new copy of the struct.
+// Otherwise, |out_struct| is set to the new copy of the struct. If |buffer| is
+// the buffer of a |MojomArena|, the copy only fails if memory can't be
+// allocated, but it is not linear (see |MojomArena|).
 // |buffer|: A mojom buffer used to allocate space for the new struct.
 // |in_type_desc|: Describes the pointer and handle fields of the mojom struct.
 // |in_struct|: The unencoded mojom struct to be copied.
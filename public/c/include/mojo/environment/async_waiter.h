@@ -68,4 +68,41 @@ struct MojoAsyncWaiter {
   void (*CancelWait)(MojoAsyncWaitID wait_id);
 };
 
+// Functions for persistently watching (and cancelling watches on) a handle.
+// These are the "level-triggered" counterpart of |MojoAsyncWaiter|: a single
+// watch may deliver any number of notifications, so that a consumer that is
+// repeatedly notified about the same handle (e.g., each time more messages
+// arrive on a message pipe) need not re-register after every notification.
+//
+// The thread-safety requirements are the same as for |MojoAsyncWaiter| (with
+// |AsyncWatch()| and |CancelWatch()| in place of |AsyncWait()| and
+// |CancelWait()|).
+struct MojoAsyncWatcher {
+  // Arranges for |callback| to be called on the current thread, with result
+  // |MOJO_RESULT_OK|, at some future time when |handle| satisfies |signals|,
+  // and again each subsequent time (e.g., each run loop iteration) that it
+  // still satisfies |signals|, until the watch is cancelled. If it becomes
+  // known that |handle| will never satisfy |signals| (with the same behavior as
+  // |MojoWait()|), |callback| is called once more with the error result and the
+  // watch ends (the returned |MojoAsyncWaitID| becomes invalid).
+  //
+  // As with |MojoAsyncWaiter::AsyncWait()|, |callback| will not be called in
+  // the nested context of |AsyncWatch()|, and |handle| must not be closed or
+  // transferred while the watch is active.
+  MojoAsyncWaitID (*AsyncWatch)(MojoHandle handle,
+                                MojoHandleSignals signals,
+                                MojoAsyncWaitCallback callback,
+                                void* closure);
+
+  // Cancels an active watch (specified by |watch_id|) started by
+  // |AsyncWatch()|. This may only be called from the same thread on which the
+  // corresponding |AsyncWatch()| was called (including from within its
+  // callback), and may not be called after the watch has ended due to an
+  // error.
+  //
+  // Once this has been called, |callback| will not be called again and it is
+  // immediately safe to close or transfer the watched handle.
+  void (*CancelWatch)(MojoAsyncWaitID watch_id);
+};
+
 #endif  // MOJO_PUBLIC_C_INCLUDE_MOJO_ENVIRONMENT_ASYNC_WAITER_H_
@@ -67,12 +67,15 @@ MOJO_STATIC_ASSERT(sizeof(struct MojoDataPipeProducerOptions) == 8,
 // and |MojoBeginWriteData()|.
 //   |MOJO_WRITE_DATA_FLAG_NONE| - No flags; default mode.
 //   |MOJO_WRITE_DATA_FLAG_ALL_OR_NONE| - Write either all the elements
-//       requested or none of them.
+//       requested or none of them. For use with |MojoWriteData()| only.
+//   |MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES| - Offer at most the requested number
+//       of bytes of buffer. For use with |MojoBeginWriteData()| only.
 
 typedef uint32_t MojoWriteDataFlags;
 
 #define MOJO_WRITE_DATA_FLAG_NONE ((MojoWriteDataFlags)0)
 #define MOJO_WRITE_DATA_FLAG_ALL_OR_NONE ((MojoWriteDataFlags)1 << 0)
+#define MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES ((MojoWriteDataFlags)1 << 1)
 
 // |MojoDataPipeConsumerOptions|: Used to specify data pipe consumer options (to
 // |MojoSetDataPipeConsumerOptions()| and from
@@ -112,6 +115,8 @@ MOJO_STATIC_ASSERT(sizeof(struct MojoDataPipeConsumerOptions) == 8,
 //   |MOJO_READ_DATA_FLAG_PEEK| - Read elements without removing them. For use
 //       with |MojoReadData()| only. Mutually exclusive with
 //       |MOJO_READ_DATA_FLAG_DISCARD| and |MOJO_READ_DATA_FLAG_QUERY|.
+//   |MOJO_READ_DATA_FLAG_MAX_NUM_BYTES| - Offer at most the requested number
+//       of bytes of data. For use with |MojoBeginReadData()| only.
 
 typedef uint32_t MojoReadDataFlags;
 
@@ -120,6 +125,27 @@ typedef uint32_t MojoReadDataFlags;
 #define MOJO_READ_DATA_FLAG_DISCARD ((MojoReadDataFlags)1 << 1)
 #define MOJO_READ_DATA_FLAG_QUERY ((MojoReadDataFlags)1 << 2)
 #define MOJO_READ_DATA_FLAG_PEEK ((MojoReadDataFlags)1 << 3)
+#define MOJO_READ_DATA_FLAG_MAX_NUM_BYTES ((MojoReadDataFlags)1 << 4)
+
+// |MojoWriteDataSegment|: Used to specify one contiguous part of the data to
+// |MojoWriteDataV()|.
+//   |const void* bytes|: The part's data; may be null if |num_bytes| is zero.
+//   |uint32_t num_bytes|: The size of the part, in bytes.
+
+struct MojoWriteDataSegment {
+  const void* bytes;
+  uint32_t num_bytes;
+};
+
+// |MojoReadDataSegment|: Used to specify one contiguous part of the buffer to
+// |MojoReadDataV()|.
+//   |void* bytes|: The part of the buffer; may be null if |num_bytes| is zero.
+//   |uint32_t num_bytes|: The size of the part, in bytes.
+
+struct MojoReadDataSegment {
+  void* bytes;
+  uint32_t num_bytes;
+};
 
 MOJO_BEGIN_EXTERN_C
 
@@ -243,6 +269,7 @@ MojoResult MojoGetDataPipeProducerOptions(
 //   |MOJO_RESULT_SHOULD_WAIT| if no data can currently be written (and the
 //       consumer is still open) and |flags| does *not* have
 //       |MOJO_WRITE_DATA_FLAG_ALL_OR_NONE| set.
+//   |MOJO_RESULT_UNIMPLEMENTED| if an unsupported flag was set in |flags|.
 //
 // TODO(vtl): Should there be a way of querying how much data can be written?
 MojoResult MojoWriteData(MojoHandle data_pipe_producer_handle,  // In.
@@ -250,11 +277,35 @@ MojoResult MojoWriteData(MojoHandle data_pipe_producer_handle,  // In.
                          uint32_t* MOJO_RESTRICT num_bytes,     // In/out.
                          MojoWriteDataFlags flags);             // In.
 
+// |MojoWriteDataV()|: Like |MojoWriteData()|, except that the data to be
+// written is the concatenation of the |num_segments| segments specified by
+// |segments| (in order), so that data in several parts needn't first be copied
+// into one contiguous buffer. The total size of the segments (which need not
+// individually be multiples of the data pipe's element size) takes the place of
+// the input value of |*num_bytes|; on success, |*num_bytes| is set to the
+// amount actually written, which comes from the segments in order. If there are
+// no segments, |segments| may be null, in which case |num_segments| must be
+// zero.
+//
+// Returns the same values as |MojoWriteData()|; in particular,
+// |MOJO_RESULT_INVALID_ARGUMENT| if the total size of the segments does not fit
+// in a |uint32_t|.
+MojoResult MojoWriteDataV(
+    MojoHandle data_pipe_producer_handle,         // In.
+    const struct MojoWriteDataSegment* segments,  // Optional in.
+    uint32_t num_segments,                        // In.
+    uint32_t* num_bytes,                          // Out.
+    MojoWriteDataFlags flags);                    // In.
+
 // |MojoBeginWriteData()|: Begins a two-phase write to the data pipe producer
 // given by |data_pipe_producer_handle| (which must have the
 // |MOJO_HANDLE_RIGHT_WRITE| right). On success, |*buffer| will be a pointer to
-// which the caller can write |*buffer_num_bytes| bytes of data. There are
-// currently no flags allowed, so |flags| should be |MOJO_WRITE_DATA_FLAG_NONE|.
+// which the caller can write |*buffer_num_bytes| bytes of data.
+//
+// If |flags| has |MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES| set, at most the input
+// value of |*buffer_num_bytes| (which must be a nonzero multiple of the data
+// pipe's element size) bytes will be offered; otherwise, its input value is
+// ignored. No other flags are allowed.
 //
 // During a two-phase write, |data_pipe_producer_handle| is *not* writable.
 // E.g., if another thread tries to write to it, it will get |MOJO_RESULT_BUSY|;
@@ -278,8 +329,10 @@ MojoResult MojoWriteData(MojoHandle data_pipe_producer_handle,  // In.
 // Returns:
 //   |MOJO_RESULT_OK| on success.
 //   |MOJO_RESULT_INVALID_ARGUMENT| if some argument was invalid (e.g.,
-//       |data_pipe_producer_handle| is not a handle to a data pipe producer or
-//       flags has |MOJO_WRITE_DATA_FLAG_ALL_OR_NONE| set).
+//       |data_pipe_producer_handle| is not a handle to a data pipe producer,
+//       flags has |MOJO_WRITE_DATA_FLAG_ALL_OR_NONE| set, or flags has
+//       |MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES| set and |*buffer_num_bytes| is
+//       invalid).
 //   |MOJO_RESULT_PERMISSION_DENIED| if |data_pipe_producer_handle| does not
 //       have the |MOJO_HANDLE_RIGHT_WRITE| right.
 //   |MOJO_RESULT_FAILED_PRECONDITION| if the data pipe consumer handle has been
@@ -291,10 +344,11 @@ MojoResult MojoWriteData(MojoHandle data_pipe_producer_handle,  // In.
 //       has been called, but not yet the matching |MojoEndWriteData()|).
 //   |MOJO_RESULT_SHOULD_WAIT| if no data can currently be written (and the
 //       consumer is still open).
-MojoResult MojoBeginWriteData(MojoHandle data_pipe_producer_handle,      // In.
-                              void** MOJO_RESTRICT buffer,               // Out.
-                              uint32_t* MOJO_RESTRICT buffer_num_bytes,  // Out.
-                              MojoWriteDataFlags flags);                 // In.
+MojoResult MojoBeginWriteData(
+    MojoHandle data_pipe_producer_handle,      // In.
+    void** MOJO_RESTRICT buffer,               // Out.
+    uint32_t* MOJO_RESTRICT buffer_num_bytes,  // In/out.
+    MojoWriteDataFlags flags);                 // In.
 
 // |MojoEndWriteData()|: Ends a two-phase write to the data pipe producer given
 // by |data_pipe_producer_handle| (which must have the |MOJO_HANDLE_RIGHT_WRITE|
@@ -429,16 +483,41 @@ MojoResult MojoGetDataPipeConsumerOptions(
 //   |MOJO_RESULT_SHOULD_WAIT| if there is no data to be read or discarded (and
 //       the producer is still open) and |flags| does *not* have
 //       |MOJO_READ_DATA_FLAG_ALL_OR_NONE| set.
+//   |MOJO_RESULT_UNIMPLEMENTED| if an unsupported flag was set in |flags|.
 MojoResult MojoReadData(MojoHandle data_pipe_consumer_handle,  // In.
                         void* MOJO_RESTRICT elements,          // Out.
                         uint32_t* MOJO_RESTRICT num_bytes,     // In/out.
                         MojoReadDataFlags flags);              // In.
 
+// |MojoReadDataV()|: Like |MojoReadData()|, except that the data is read into
+// the |num_segments| segments specified by |segments| (filling each in turn),
+// so that it needn't be read into one contiguous buffer and then copied. The
+// total size of the segments (which need not individually be multiples of the
+// data pipe's element size) takes the place of the input value of
+// |*num_bytes|; on success, |*num_bytes| is set to the amount actually read.
+// |MOJO_READ_DATA_FLAG_DISCARD| and |MOJO_READ_DATA_FLAG_QUERY| are not allowed
+// (use |MojoReadData()| instead). If there are no segments, |segments| may be
+// null, in which case |num_segments| must be zero.
+//
+// Returns the same values as |MojoReadData()|; in particular,
+// |MOJO_RESULT_INVALID_ARGUMENT| if the total size of the segments does not fit
+// in a |uint32_t|.
+MojoResult MojoReadDataV(
+    MojoHandle data_pipe_consumer_handle,        // In.
+    const struct MojoReadDataSegment* segments,  // Optional in.
+    uint32_t num_segments,                       // In.
+    uint32_t* num_bytes,                         // Out.
+    MojoReadDataFlags flags);                    // In.
+
 // |MojoBeginReadData()|: Begins a two-phase read from the data pipe consumer
 // given by |data_pipe_consumer_handle| (which must have the
 // |MOJO_HANDLE_RIGHT_READ| right). On success, |*buffer| will be a pointer from
-// which the caller can read |*buffer_num_bytes| bytes of data. There are
-// currently no valid flags, so |flags| must be |MOJO_READ_DATA_FLAG_NONE|.
+// which the caller can read |*buffer_num_bytes| bytes of data.
+//
+// If |flags| has |MOJO_READ_DATA_FLAG_MAX_NUM_BYTES| set, at most the input
+// value of |*buffer_num_bytes| (which must be a nonzero multiple of the data
+// pipe's element size) bytes will be offered; otherwise, its input value is
+// ignored. No other flags are allowed.
 //
 // During a two-phase read, |data_pipe_consumer_handle| is *not* readable.
 // E.g., if another thread tries to read from it, it will get
@@ -462,7 +541,9 @@ MojoResult MojoReadData(MojoHandle data_pipe_consumer_handle,  // In.
 //   |MOJO_RESULT_OK| on success.
 //   |MOJO_RESULT_INVALID_ARGUMENT| if some argument was invalid (e.g.,
 //       |data_pipe_consumer_handle| is not a handle to a data pipe consumer,
-//       or |flags| has invalid flags set).
+//       |flags| has invalid flags set, or |flags| has
+//       |MOJO_READ_DATA_FLAG_MAX_NUM_BYTES| set and |*buffer_num_bytes| is
+//       invalid).
 //   |MOJO_RESULT_PERMISSION_DENIED| if |data_pipe_consumer_handle| does not
 //       have the |MOJO_HANDLE_RIGHT_READ| right.
 //   |MOJO_RESULT_FAILED_PRECONDITION| if the data pipe producer handle has been
@@ -474,10 +555,11 @@ MojoResult MojoReadData(MojoHandle data_pipe_consumer_handle,  // In.
 //       has been called, but not yet the matching |MojoEndReadData()|).
 //   |MOJO_RESULT_SHOULD_WAIT| if no data can currently be read (and the
 //       producer is still open).
-MojoResult MojoBeginReadData(MojoHandle data_pipe_consumer_handle,      // In.
-                             const void** MOJO_RESTRICT buffer,         // Out.
-                             uint32_t* MOJO_RESTRICT buffer_num_bytes,  // Out.
-                             MojoReadDataFlags flags);                  // In.
+MojoResult MojoBeginReadData(
+    MojoHandle data_pipe_consumer_handle,      // In.
+    const void** MOJO_RESTRICT buffer,         // Out.
+    uint32_t* MOJO_RESTRICT buffer_num_bytes,  // In/out.
+    MojoReadDataFlags flags);                  // In.
 
 // |MojoEndReadData()|: Ends a two-phase read from the data pipe consumer given
 // by |data_pipe_consumer_handle| (which must have the |MOJO_HANDLE_RIGHT_READ|
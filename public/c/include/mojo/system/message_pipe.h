@@ -54,6 +54,16 @@ typedef uint32_t MojoReadMessageFlags;
 #define MOJO_READ_MESSAGE_FLAG_NONE ((MojoReadMessageFlags)0)
 #define MOJO_READ_MESSAGE_FLAG_MAY_DISCARD ((MojoReadMessageFlags)1 << 0)
 
+// |MojoMessageSegment|: Used to specify one contiguous part of the data of a
+// message to |MojoWriteMessageV()|.
+//   |const void* bytes|: The part's data; may be null if |num_bytes| is zero.
+//   |uint32_t num_bytes|: The size of the part, in bytes.
+
+struct MojoMessageSegment {
+  const void* bytes;
+  uint32_t num_bytes;
+};
+
 MOJO_BEGIN_EXTERN_C
 
 // |MojoCreateMessagePipe()|: Creates a message pipe, which is a bidirectional
@@ -107,6 +117,10 @@ MojoResult MojoCreateMessagePipe(
 //   |MOJO_RESULT_RESOURCE_EXHAUSTED| if some system limit has been reached, or
 //       the number of handles to send is too large (TODO(vtl): reconsider the
 //       latter case).
+//   |MOJO_RESULT_OUT_OF_RANGE| if |num_bytes| is larger than the largest
+//       message that the message pipe can carry. (Unlike
+//       |MOJO_RESULT_RESOURCE_EXHAUSTED|, retrying the same write will never
+//       succeed.)
 //   |MOJO_RESULT_FAILED_PRECONDITION| if the other endpoint has been closed.
 //       Note that closing an endpoint is not necessarily synchronous (e.g.,
 //       across processes), so this function may succeed even if the other
@@ -135,6 +149,24 @@ MojoResult MojoWriteMessage(MojoHandle message_pipe_handle,  // In.
                             uint32_t num_handles,            // In.
                             MojoWriteMessageFlags flags);    // In.
 
+// |MojoWriteMessageV()|: Like |MojoWriteMessage()|, except that the message
+// data is the concatenation of the |num_segments| segments specified by
+// |segments| (in order), which avoids having to first copy the message's parts
+// into one contiguous buffer. If there are no segments, |segments| may be null,
+// in which case |num_segments| must be zero. Segments may be empty. Any segment
+// memory may be reused once this returns.
+//
+// Returns the same values as |MojoWriteMessage()|; in particular,
+// |MOJO_RESULT_INVALID_ARGUMENT| if the total size of the segments does not fit
+// in a |uint32_t|.
+MojoResult MojoWriteMessageV(
+    MojoHandle message_pipe_handle,             // In.
+    const struct MojoMessageSegment* segments,  // Optional in.
+    uint32_t num_segments,                      // In.
+    const MojoHandle* handles,                  // Optional in.
+    uint32_t num_handles,                       // In.
+    MojoWriteMessageFlags flags);               // In.
+
 // |MojoReadMessage()|: Reads the next message from the message pipe endpoint
 // given by |message_pipe_handle| (which must have the |MOJO_HANDLE_RIGHT_READ|
 // right) or indicates the size of the message if it cannot fit in the provided
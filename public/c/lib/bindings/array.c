@@ -149,7 +149,7 @@ static uint64_t bits_to_bytes(uint64_t bits) {
   return (bits + 7) / 8;
 }
 
-static MojomValidationResult validate_array_header(
+MojomValidationResult MojomArray_ValidateHeader(
     const struct MojomTypeDescriptorArray* in_type_desc,
     const struct MojomArrayHeader* in_array,
     uint32_t in_buf_size) {
@@ -187,7 +187,7 @@ MojomValidationResult MojomArray_Validate(
   assert(in_array);
 
   MojomValidationResult result =
-      validate_array_header(in_type_desc, in_array, in_array_size);
+      MojomArray_ValidateHeader(in_type_desc, in_array, in_array_size);
   if (result != MOJOM_VALIDATION_ERROR_NONE)
     return result;
 
@@ -6,16 +6,130 @@
 
 #include <assert.h>
 #include <mojo/bindings/internal/util.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdlib.h>
+
+// The offset of a chunk's data from the start of the chunk.
+#define CHUNK_DATA_OFFSET \
+  ((uint32_t)MOJOM_INTERNAL_ROUND_TO_8(sizeof(struct MojomArenaChunk)))
+
+// Points |arena|'s buffer at the start of |chunk|.
+static void use_chunk(struct MojomArena* arena,
+                      struct MojomArenaChunk* chunk) {
+  arena->current_chunk = chunk;
+  arena->buffer.buf = (char*)chunk + CHUNK_DATA_OFFSET;
+  arena->buffer.buf_size = chunk->size;
+  arena->buffer.num_bytes_used = 0;
+}
+
+// Moves |arena|'s buffer to a chunk with room for at least |num_bytes|: the
+// chunk after the current one if it is large enough (i.e., after a reset), or
+// else a new one. Returns false if malloc() fails.
+static bool next_chunk(struct MojomArena* arena, uint64_t num_bytes) {
+  struct MojomArenaChunk** next = arena->current_chunk
+                                      ? &arena->current_chunk->next
+                                      : &arena->chunks;
+  if (*next == NULL || (*next)->size < num_bytes) {
+    uint64_t size = arena->next_chunk_size;
+    if (size < num_bytes)
+      size = num_bytes;
+    if (size > UINT32_MAX - CHUNK_DATA_OFFSET)
+      return false;
+
+    struct MojomArenaChunk* chunk = malloc(CHUNK_DATA_OFFSET + size);
+    if (chunk == NULL)
+      return false;
+    chunk->size = (uint32_t)size;
+    // Any chunk that was too small is kept for later.
+    chunk->next = *next;
+    *next = chunk;
+
+    if (arena->next_chunk_size < MOJOM_ARENA_MAX_CHUNK_SIZE)
+      arena->next_chunk_size *= 2;
+  }
+  use_chunk(arena, *next);
+  return true;
+}
 
 void* MojomBuffer_Allocate(struct MojomBuffer* buf, uint32_t num_bytes) {
   assert(buf);
 
-  const uint32_t bytes_used = buf->num_bytes_used;
+  uint32_t bytes_used = buf->num_bytes_used;
   const uint64_t size = MOJOM_INTERNAL_ROUND_TO_8((uint64_t)num_bytes);
-  if (bytes_used + size > buf->buf_size)
-    return NULL;
+  if (bytes_used + size > buf->buf_size) {
+    if (buf->arena == NULL)
+      return NULL;
+    // A copy of an arena's buffer would allocate the same memory twice.
+    assert(buf == &buf->arena->buffer);
+    if (!next_chunk(buf->arena, size))
+      return NULL;
+    bytes_used = 0;
+  }
 
   buf->num_bytes_used += size;
   return buf->buf + bytes_used;
 }
+
+void MojomArena_Init(struct MojomArena* arena,
+                     void* initial_buf,
+                     uint32_t initial_buf_size) {
+  assert(arena);
+  assert(initial_buf != NULL || initial_buf_size == 0);
+  assert(((uintptr_t)initial_buf & 7) == 0);
+
+  arena->buffer.buf = initial_buf;
+  arena->buffer.buf_size = initial_buf_size;
+  arena->buffer.num_bytes_used = 0;
+  arena->buffer.arena = arena;
+  arena->initial_buf = initial_buf;
+  arena->initial_buf_size = initial_buf_size;
+  arena->next_chunk_size = MOJOM_ARENA_MIN_CHUNK_SIZE;
+  arena->chunks = NULL;
+  arena->current_chunk = NULL;
+}
+
+void* MojomArena_Allocate(struct MojomArena* arena, uint32_t num_bytes) {
+  assert(arena);
+  return MojomBuffer_Allocate(&arena->buffer, num_bytes);
+}
+
+void MojomArena_Reset(struct MojomArena* arena) {
+  assert(arena);
+
+  if (arena->initial_buf_size == 0 && arena->chunks != NULL) {
+    use_chunk(arena, arena->chunks);
+    return;
+  }
+  arena->current_chunk = NULL;
+  arena->buffer.buf = arena->initial_buf;
+  arena->buffer.buf_size = arena->initial_buf_size;
+  arena->buffer.num_bytes_used = 0;
+}
+
+void MojomArena_Destroy(struct MojomArena* arena) {
+  assert(arena);
+
+  struct MojomArenaChunk* chunk = arena->chunks;
+  while (chunk != NULL) {
+    struct MojomArenaChunk* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  arena->chunks = NULL;
+  arena->current_chunk = NULL;
+  arena->buffer.buf = NULL;
+  arena->buffer.buf_size = 0;
+  arena->buffer.num_bytes_used = 0;
+}
+
+uint64_t MojomArena_GetNumBytesReserved(const struct MojomArena* arena) {
+  assert(arena);
+
+  uint64_t num_bytes = 0;
+  for (const struct MojomArenaChunk* chunk = arena->chunks; chunk != NULL;
+       chunk = chunk->next) {
+    num_bytes += chunk->size;
+  }
+  return num_bytes;
+}
@@ -96,6 +96,26 @@ void MojomStruct_DecodePointersAndHandles(
   }
 }
 
+struct MojomStructHeader* MojomStruct_DecodeIntoArena(
+    const struct MojomTypeDescriptorStruct* in_type_desc,
+    const struct MojomStructHeader* in_struct,
+    uint32_t in_struct_size,
+    MojoHandle* inout_handles,
+    uint32_t in_num_handles,
+    struct MojomArena* arena) {
+  assert(in_struct);
+  assert(arena);
+
+  struct MojomStructHeader* copy = MojomArena_Allocate(arena, in_struct_size);
+  if (copy == NULL)
+    return NULL;
+
+  memcpy(copy, in_struct, in_struct_size);
+  MojomStruct_DecodePointersAndHandles(in_type_desc, copy, in_struct_size,
+                                       inout_handles, in_num_handles);
+  return copy;
+}
+
 static bool is_valid_size_for_version(
     const struct MojomStructHeader* in_struct,
     const struct MojomTypeDescriptorStructVersion versions[],
@@ -113,16 +133,13 @@ static bool is_valid_size_for_version(
   }
 }
 
-MojomValidationResult MojomStruct_Validate(
+MojomValidationResult MojomStruct_ValidateHeader(
     const struct MojomTypeDescriptorStruct* in_type_desc,
     const struct MojomStructHeader* in_struct,
-    uint32_t in_struct_size,
-    uint32_t in_num_handles,
-    struct MojomValidationContext* inout_context) {
+    uint32_t in_struct_size) {
   assert(in_type_desc);
   assert(in_struct);
 
-  // Struct header validation.
   if (in_struct_size < sizeof(struct MojomStructHeader))
     return MOJOM_VALIDATION_ILLEGAL_MEMORY_RANGE;
 
@@ -137,6 +154,23 @@ MojomValidationResult MojomStruct_Validate(
   if ((in_struct->num_bytes & 7) != 0)
     return MOJOM_VALIDATION_MISALIGNED_OBJECT;
 
+  return MOJOM_VALIDATION_ERROR_NONE;
+}
+
+MojomValidationResult MojomStruct_Validate(
+    const struct MojomTypeDescriptorStruct* in_type_desc,
+    const struct MojomStructHeader* in_struct,
+    uint32_t in_struct_size,
+    uint32_t in_num_handles,
+    struct MojomValidationContext* inout_context) {
+  assert(in_type_desc);
+  assert(in_struct);
+
+  MojomValidationResult result =
+      MojomStruct_ValidateHeader(in_type_desc, in_struct, in_struct_size);
+  if (result != MOJOM_VALIDATION_ERROR_NONE)
+    return result;
+
   // From here on out, all pointers need to point past the end of this struct.
   inout_context->next_pointer = (char*)in_struct + in_struct->num_bytes;
 
@@ -149,7 +183,7 @@ MojomValidationResult MojomStruct_Validate(
 
     void* elem_data = ((char*)in_struct + sizeof(struct MojomStructHeader) +
                        entry->offset);
-    MojomValidationResult result = MojomType_DispatchValidate(
+    result = MojomType_DispatchValidate(
         entry->elem_type,
         entry->elem_descriptor,
         entry->nullable,
@@ -66,8 +66,7 @@ size_t MojomType_DispatchComputeSerializedSize(
       // NULL, OR by setting the union's |size| to 0.
       if (!nullable || (udata && udata->size != 0)) {
         return size + MojomUnion_ComputeSerializedSize(
-            (const struct MojomTypeDescriptorUnion*)type_desc,
-            (const struct MojomUnionLayout*)data);
+            (const struct MojomTypeDescriptorUnion*)type_desc, udata);
       }
       break;
     }
@@ -81,7 +80,7 @@ size_t MojomType_DispatchComputeSerializedSize(
   return size;
 }
 
-static void encode_pointer(union MojomPointer* pointer, uint32_t max_offset) {
+void MojomType_EncodePointer(union MojomPointer* pointer, uint32_t max_offset) {
   if (pointer->ptr == NULL) {
     pointer->offset = 0;
   } else {
@@ -91,7 +90,7 @@ static void encode_pointer(union MojomPointer* pointer, uint32_t max_offset) {
   }
 }
 
-static void decode_pointer(union MojomPointer* pointer) {
+void MojomType_DecodePointer(union MojomPointer* pointer) {
   if (pointer->offset == 0) {
     pointer->ptr = NULL;
   } else {
@@ -99,8 +98,8 @@ static void decode_pointer(union MojomPointer* pointer) {
   }
 }
 
-static void encode_handle(bool nullable, MojoHandle* handle,
-                          struct MojomHandleBuffer* handles_buffer) {
+void MojomType_EncodeHandle(bool nullable, MojoHandle* handle,
+                            struct MojomHandleBuffer* handles_buffer) {
   assert(handle);
   assert(handles_buffer);
   assert(handles_buffer->handles);
@@ -117,9 +116,9 @@ static void encode_handle(bool nullable, MojoHandle* handle,
   }
 }
 
-// *handle is an index into inout_handles, or is encoded NULL.
-static void decode_handle(MojoHandle* handle,
-                          MojoHandle inout_handles[], uint32_t in_num_handles) {
+void MojomType_DecodeHandle(MojoHandle* handle,
+                            MojoHandle inout_handles[],
+                            uint32_t in_num_handles) {
   assert(handle);
   assert(inout_handles);
 
@@ -148,7 +147,7 @@ void MojomType_DispatchEncodePointersAndHandles(
     case MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR: {
       struct MojomStructHeader* inout_struct =
           ((union MojomPointer*)inout_buf)->ptr;
-      encode_pointer(inout_buf, in_buf_size);
+      MojomType_EncodePointer(inout_buf, in_buf_size);
       if (!in_nullable || inout_struct != NULL)
         MojomStruct_EncodePointersAndHandles(
             (const struct MojomTypeDescriptorStruct*)in_type_desc,
@@ -160,7 +159,7 @@ void MojomType_DispatchEncodePointersAndHandles(
     case MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR: {
       struct MojomArrayHeader* inout_array =
                 ((union MojomPointer*)inout_buf)->ptr;
-      encode_pointer(inout_buf, in_buf_size);
+      MojomType_EncodePointer(inout_buf, in_buf_size);
       if (!in_nullable || inout_array != NULL)
         MojomArray_EncodePointersAndHandles(
             (const struct MojomTypeDescriptorArray*)in_type_desc,
@@ -171,24 +170,26 @@ void MojomType_DispatchEncodePointersAndHandles(
     }
     case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION_PTR:
       union_buf = ((union MojomPointer*)inout_buf)->ptr;
-      encode_pointer(inout_buf, in_buf_size);
+      MojomType_EncodePointer(inout_buf, in_buf_size);
       // Fall through
     case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION: {
       struct MojomUnionLayout* u_data = union_buf;
       if (!in_nullable || (u_data != NULL && u_data->size != 0))
         MojomUnion_EncodePointersAndHandles(
             (const struct MojomTypeDescriptorUnion*)in_type_desc,
-            inout_buf,
-            in_buf_size,
+            u_data,
+            in_buf_size - ((char*)u_data - (char*)inout_buf),
             inout_handles_buffer);
       break;
     }
     case MOJOM_TYPE_DESCRIPTOR_TYPE_HANDLE:
-      encode_handle(in_nullable, (MojoHandle*)inout_buf, inout_handles_buffer);
+      MojomType_EncodeHandle(in_nullable, (MojoHandle*)inout_buf,
+                             inout_handles_buffer);
       break;
     case MOJOM_TYPE_DESCRIPTOR_TYPE_INTERFACE: {
       struct MojomInterfaceData* interface = inout_buf;
-      encode_handle(in_nullable, &interface->handle, inout_handles_buffer);
+      MojomType_EncodeHandle(in_nullable, &interface->handle,
+                             inout_handles_buffer);
       break;
     }
     case MOJOM_TYPE_DESCRIPTOR_TYPE_POD:
@@ -212,7 +213,7 @@ void MojomType_DispatchDecodePointersAndHandles(
   switch (in_elem_type) {
     case MOJOM_TYPE_DESCRIPTOR_TYPE_MAP_PTR:
     case MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR: {
-      decode_pointer(inout_buf);
+      MojomType_DecodePointer(inout_buf);
       struct MojomStructHeader* inout_struct =
           ((union MojomPointer*)inout_buf)->ptr;
       assert(inout_struct == NULL ||
@@ -227,7 +228,7 @@ void MojomType_DispatchDecodePointersAndHandles(
       break;
     }
     case MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR: {
-      decode_pointer(inout_buf);
+      MojomType_DecodePointer(inout_buf);
       struct MojomArrayHeader* inout_array =
                 ((union MojomPointer*)inout_buf)->ptr;
       assert(inout_array == NULL ||
@@ -242,7 +243,7 @@ void MojomType_DispatchDecodePointersAndHandles(
       break;
     }
     case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION_PTR:
-      decode_pointer(inout_buf);
+      MojomType_DecodePointer(inout_buf);
       union_buf = ((union MojomPointer*)inout_buf)->ptr;
       assert(union_buf == NULL ||
              (char*)union_buf < ((char*)inout_buf) + in_buf_size);
@@ -252,20 +253,20 @@ void MojomType_DispatchDecodePointersAndHandles(
       if (!in_nullable || (u_data != NULL && u_data->size != 0))
         MojomUnion_DecodePointersAndHandles(
             (const struct MojomTypeDescriptorUnion*)in_type_desc,
-            inout_buf,
-            in_buf_size,
+            u_data,
+            in_buf_size - ((char*)u_data - (char*)inout_buf),
             inout_handles,
             in_num_handles);
       break;
     }
     case MOJOM_TYPE_DESCRIPTOR_TYPE_HANDLE:
-      decode_handle((MojoHandle*)inout_buf, inout_handles,
-                    in_num_handles);
+      MojomType_DecodeHandle((MojoHandle*)inout_buf, inout_handles,
+                             in_num_handles);
       break;
     case MOJOM_TYPE_DESCRIPTOR_TYPE_INTERFACE: {
       struct MojomInterfaceData* interface = inout_buf;
-      decode_handle(&interface->handle, inout_handles,
-                    in_num_handles);
+      MojomType_DecodeHandle(&interface->handle, inout_handles,
+                             in_num_handles);
       break;
     }
     case MOJOM_TYPE_DESCRIPTOR_TYPE_POD:
@@ -275,10 +276,7 @@ void MojomType_DispatchDecodePointersAndHandles(
   }
 }
 
-// Validates that the offset (|pointer->offset|) points to a new memory region,
-// i.e. one that hasn't been referenced yet. If so, moves the expected offset
-// (for the next pointer) forward.
-static MojomValidationResult validate_pointer(
+MojomValidationResult MojomType_ValidatePointer(
     const union MojomPointer* pointer,
     size_t max_offset,
     bool is_nullable,
@@ -305,7 +303,7 @@ static MojomValidationResult validate_pointer(
   return MOJOM_VALIDATION_ERROR_NONE;
 }
 
-static MojomValidationResult validate_handle(
+MojomValidationResult MojomType_ValidateHandle(
     MojoHandle encoded_handle, uint32_t num_handles, bool is_nullable,
     struct MojomValidationContext* inout_context) {
   if (!is_nullable && encoded_handle == kEncodedHandleInvalid)
@@ -334,7 +332,8 @@ MojomValidationResult MojomType_DispatchValidate(
     case MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR: {
       union MojomPointer* pointer = (union MojomPointer*)in_buf;
       MojomValidationResult result =
-          validate_pointer(pointer, in_buf_size, in_nullable, inout_context);
+          MojomType_ValidatePointer(pointer, in_buf_size, in_nullable,
+                                    inout_context);
       if (result != MOJOM_VALIDATION_ERROR_NONE || pointer->offset == 0)
         return result;
 
@@ -356,7 +355,8 @@ MojomValidationResult MojomType_DispatchValidate(
     case MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR: {
       union MojomPointer* pointer = (union MojomPointer*)in_buf;
       MojomValidationResult result =
-          validate_pointer(pointer, in_buf_size, in_nullable, inout_context);
+          MojomType_ValidatePointer(pointer, in_buf_size, in_nullable,
+                                    inout_context);
       if (result != MOJOM_VALIDATION_ERROR_NONE || pointer->offset == 0)
         return result;
 
@@ -368,7 +368,8 @@ MojomValidationResult MojomType_DispatchValidate(
     case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION_PTR: {
       union MojomPointer* pointer = (union MojomPointer*)in_buf;
       MojomValidationResult result =
-          validate_pointer(pointer, in_buf_size, in_nullable, inout_context);
+          MojomType_ValidatePointer(pointer, in_buf_size, in_nullable,
+                                    inout_context);
       if (result != MOJOM_VALIDATION_ERROR_NONE || pointer->offset == 0)
         return result;
 
@@ -390,11 +391,13 @@ MojomValidationResult MojomType_DispatchValidate(
           union_data, in_buf_size - ((char*)union_data - (char*)in_buf),
           in_num_handles, inout_context);
     case MOJOM_TYPE_DESCRIPTOR_TYPE_HANDLE:
-      return validate_handle(*(const MojoHandle*)in_buf, in_num_handles,
-                             in_nullable, inout_context);
+      return MojomType_ValidateHandle(*(const MojoHandle*)in_buf,
+                                      in_num_handles, in_nullable,
+                                      inout_context);
     case MOJOM_TYPE_DESCRIPTOR_TYPE_INTERFACE:
-      return validate_handle(((const struct MojomInterfaceData*)in_buf)->handle,
-                             in_num_handles, in_nullable, inout_context);
+      return MojomType_ValidateHandle(
+          ((const struct MojomInterfaceData*)in_buf)->handle, in_num_handles,
+          in_nullable, inout_context);
     case MOJOM_TYPE_DESCRIPTOR_TYPE_POD:
       break;
   }
@@ -0,0 +1,1144 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <mojo/bindings/internal/type_program.h>
+
+#include <assert.h>
+#include <mojo/bindings/array.h>
+#include <mojo/bindings/interface.h>
+#include <mojo/bindings/map.h>
+#include <mojo/bindings/union.h>
+#include <stddef.h>
+#include <string.h>
+
+#define UNION_TAG_UNKNOWN ((uint32_t)0xFFFFFFFF)
+
+// Compilation -----------------------------------------------------------------
+
+// Returns the byte size of an array element of type |type|.
+static uint32_t array_elem_size(enum MojomTypeDescriptorType type) {
+  switch (type) {
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR:
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_MAP_PTR:
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR:
+      return sizeof(union MojomPointer);
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION:
+      return sizeof(struct MojomUnionLayout);
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_HANDLE:
+      return sizeof(MojoHandle);
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_INTERFACE:
+      return sizeof(struct MojomInterfaceData);
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION_PTR:
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_POD:
+      // This is a type that isn't supported in (or has no ops in) an array.
+      assert(0);
+      break;
+  }
+  return 0;
+}
+
+// Finds the program for |type_desc| in the list starting at |first|, or
+// appends a new, not yet compiled, program for it to the list (which ends at
+// |*inout_last|). The new program is compiled when the list is walked in
+// MojomTypeProgram_CompileStruct(). On success, |*out_program| is set to the
+// program, or to NULL if |elem_type| doesn't refer to a type with a program.
+static bool find_or_add_program(struct MojomBuffer* buffer,
+                                struct MojomTypeProgram* first,
+                                struct MojomTypeProgram** inout_last,
+                                enum MojomTypeDescriptorType elem_type,
+                                const void* type_desc,
+                                const struct MojomTypeProgram** out_program) {
+  enum MojomTypeDescriptorType program_type = elem_type;
+  switch (elem_type) {
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR:
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_MAP_PTR:
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR:
+      break;
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION_PTR:
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION:
+      program_type = MOJOM_TYPE_DESCRIPTOR_TYPE_UNION;
+      break;
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_HANDLE:
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_INTERFACE:
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_POD:
+      *out_program = NULL;
+      return true;
+  }
+  assert(type_desc);
+
+  for (struct MojomTypeProgram* program = first; program != NULL;
+       program = program->next) {
+    if (program->type_desc == type_desc && program->type == program_type) {
+      *out_program = program;
+      return true;
+    }
+  }
+
+  struct MojomTypeProgram* program =
+      MojomBuffer_Allocate(buffer, sizeof(struct MojomTypeProgram));
+  if (program == NULL)
+    return false;
+
+  program->type = program_type;
+  program->type_desc = type_desc;
+  program->elem_size = 0;
+  program->num_ops = 0;
+  program->ops = NULL;
+  program->is_shallow = false;
+  program->next = NULL;
+
+  (*inout_last)->next = program;
+  *inout_last = program;
+  *out_program = program;
+  return true;
+}
+
+// Fills in the ops of |program| from its type descriptor.
+static bool compile_program(struct MojomBuffer* buffer,
+                            struct MojomTypeProgram* first,
+                            struct MojomTypeProgram** inout_last,
+                            struct MojomTypeProgram* program) {
+  uint32_t num_ops = 0;
+  switch (program->type) {
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR:
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_MAP_PTR:
+      num_ops = ((const struct MojomTypeDescriptorStruct*)program->type_desc)
+                    ->num_entries;
+      break;
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR: {
+      const struct MojomTypeDescriptorArray* desc = program->type_desc;
+      if (desc->elem_type != MOJOM_TYPE_DESCRIPTOR_TYPE_POD) {
+        num_ops = 1;
+        program->elem_size = array_elem_size(desc->elem_type);
+      }
+      break;
+    }
+    case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION:
+      num_ops = ((const struct MojomTypeDescriptorUnion*)program->type_desc)
+                    ->num_entries;
+      break;
+    default:
+      assert(0);
+      return false;
+  }
+
+  if (num_ops == 0)
+    return true;
+
+  struct MojomTypeProgramOp* ops = MojomBuffer_Allocate(
+      buffer, num_ops * (uint32_t)sizeof(struct MojomTypeProgramOp));
+  if (ops == NULL)
+    return false;
+
+  for (uint32_t i = 0; i < num_ops; i++) {
+    struct MojomTypeProgramOp* op = &ops[i];
+    const void* elem_desc = NULL;
+    switch (program->type) {
+      case MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR:
+      case MOJOM_TYPE_DESCRIPTOR_TYPE_MAP_PTR: {
+        const struct MojomTypeDescriptorStructEntry* entry =
+            &((const struct MojomTypeDescriptorStruct*)program->type_desc)
+                 ->entries[i];
+        op->type = entry->elem_type;
+        op->offset = sizeof(struct MojomStructHeader) + entry->offset;
+        op->key = entry->min_version;
+        op->nullable = entry->nullable;
+        elem_desc = entry->elem_descriptor;
+        break;
+      }
+      case MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR: {
+        const struct MojomTypeDescriptorArray* desc = program->type_desc;
+        op->type = desc->elem_type;
+        op->offset = 0;
+        op->key = 0;
+        op->nullable = desc->nullable;
+        elem_desc = desc->elem_descriptor;
+        break;
+      }
+      default: {
+        const struct MojomTypeDescriptorUnionEntry* entry =
+            &((const struct MojomTypeDescriptorUnion*)program->type_desc)
+                 ->entries[i];
+        op->type = entry->elem_type;
+        op->offset = offsetof(struct MojomUnionLayout, data);
+        op->key = entry->tag;
+        op->nullable = entry->nullable;
+        elem_desc = entry->elem_descriptor;
+        break;
+      }
+    }
+    if (!find_or_add_program(buffer, first, inout_last, op->type, elem_desc,
+                             &op->target)) {
+      return false;
+    }
+  }
+
+  program->num_ops = num_ops;
+  program->ops = ops;
+  return true;
+}
+
+static bool has_references(const struct MojomTypeProgram* program) {
+  for (uint32_t i = 0; i < program->num_ops; i++) {
+    if (program->ops[i].target != NULL)
+      return true;
+  }
+  return false;
+}
+
+// See |MojomTypeProgram::is_shallow|. Maps are excluded since their keys and
+// values need to be validated together.
+static bool is_shallow(const struct MojomTypeProgram* program) {
+  if (program->type != MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR &&
+      program->type != MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR) {
+    return false;
+  }
+  for (uint32_t i = 0; i < program->num_ops; i++) {
+    const struct MojomTypeProgramOp* op = &program->ops[i];
+    if (op->target == NULL)
+      continue;
+    if (op->type != MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR &&
+        op->type != MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR) {
+      return false;
+    }
+    if (has_references(op->target))
+      return false;
+  }
+  return true;
+}
+
+const struct MojomTypeProgram* MojomTypeProgram_CompileStruct(
+    const struct MojomTypeDescriptorStruct* in_type_desc,
+    struct MojomBuffer* inout_buffer) {
+  assert(in_type_desc);
+  assert(inout_buffer);
+
+  struct MojomTypeProgram* root =
+      MojomBuffer_Allocate(inout_buffer, sizeof(struct MojomTypeProgram));
+  if (root == NULL)
+    return NULL;
+
+  root->type = MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR;
+  root->type_desc = in_type_desc;
+  root->elem_size = 0;
+  root->num_ops = 0;
+  root->ops = NULL;
+  root->is_shallow = false;
+  root->next = NULL;
+
+  // Compiling a program may append programs for the types it refers to, so
+  // this walks the whole type graph breadth-first without recursing.
+  struct MojomTypeProgram* last = root;
+  for (struct MojomTypeProgram* program = root; program != NULL;
+       program = program->next) {
+    if (!compile_program(inout_buffer, root, &last, program))
+      return NULL;
+  }
+
+  // Whether a program is shallow depends on the ops of the programs it refers
+  // to, so this can only be determined once they have all been compiled.
+  for (struct MojomTypeProgram* program = root; program != NULL;
+       program = program->next) {
+    program->is_shallow = is_shallow(program);
+  }
+
+  return root;
+}
+
+// Interpretation --------------------------------------------------------------
+
+// A struct, or the elements of an array, being visited by the interpreter.
+struct MojomTypeProgramFrame {
+  const struct MojomTypeProgram* program;
+  // The next op of |program| to visit.
+  const struct MojomTypeProgramOp* op;
+  // The start of the struct, or of the first array element.
+  char* data;
+  // For MojomTypeProgram_DeepCopy(), the start of the copy of |data|.
+  char* out_data;
+  // The byte offset of the array element being visited from |data|.
+  size_t elem_offset;
+  // The struct's version; ops with a greater |key| are skipped. 0 for arrays.
+  uint32_t version;
+  // The number of array elements left to visit, including the current one.
+  // Structs are treated as an array of 1 element.
+  uint32_t num_elements_left;
+};
+
+struct MojomTypeProgramStack {
+  struct MojomTypeProgramFrame frames[MOJOM_TYPE_PROGRAM_MAX_DEPTH];
+  size_t depth;
+};
+
+// Sets |*out_data| and |*out_version| to the start and version of the objects
+// described by |program| in the struct or array |pointee|, and returns their
+// number: a struct is a single object, and an array's elements follow its
+// header.
+static uint32_t get_objects(const struct MojomTypeProgram* program,
+                            const void* pointee,
+                            char** out_data,
+                            uint32_t* out_version) {
+  if (program->type == MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR) {
+    const struct MojomArrayHeader* array = pointee;
+    *out_data = (char*)array + sizeof(struct MojomArrayHeader);
+    *out_version = 0;
+    return array->num_elements;
+  }
+  *out_data = (char*)pointee;
+  *out_version = ((const struct MojomStructHeader*)pointee)->version;
+  return 1;
+}
+
+// Pushes a frame visiting the struct or array |pointee| (and |out_pointee|,
+// its copy, if not NULL) described by |program|. Shallow programs are visited
+// directly by the *_shallow() functions below instead.
+static void push_frame(struct MojomTypeProgramStack* stack,
+                       const struct MojomTypeProgram* program,
+                       const void* pointee,
+                       void* out_pointee) {
+  assert(stack->depth < MOJOM_TYPE_PROGRAM_MAX_DEPTH);
+  assert(!program->is_shallow);
+  struct MojomTypeProgramFrame* frame = &stack->frames[stack->depth];
+  frame->num_elements_left =
+      get_objects(program, pointee, &frame->data, &frame->version);
+  if (program->num_ops == 0 || frame->num_elements_left == 0)
+    return;
+
+  frame->program = program;
+  frame->op = program->ops;
+  frame->out_data =
+      out_pointee ? (char*)out_pointee + (frame->data - (char*)pointee) : NULL;
+  frame->elem_offset = 0;
+  stack->depth++;
+}
+
+// Returns the next op to visit in |frame|, and sets |*out_offset| to the byte
+// offset of its slot from |frame->data|. Returns NULL once |frame| is done.
+static const struct MojomTypeProgramOp* next_op(
+    struct MojomTypeProgramFrame* frame,
+    size_t* out_offset) {
+  const struct MojomTypeProgram* program = frame->program;
+  const struct MojomTypeProgramOp* ops_end = program->ops + program->num_ops;
+  for (;;) {
+    if (frame->op == ops_end) {
+      if (--frame->num_elements_left == 0)
+        return NULL;
+      frame->op = program->ops;
+      frame->elem_offset += program->elem_size;
+    }
+    const struct MojomTypeProgramOp* op = frame->op++;
+    if (frame->version < op->key)
+      continue;
+    *out_offset = frame->elem_offset + op->offset;
+    return op;
+  }
+}
+
+// Returns the size of the struct or array |pointee|, which is of type |type|.
+static uint32_t pointee_num_bytes(enum MojomTypeDescriptorType type,
+                                  const void* pointee) {
+  if (type == MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR)
+    return ((const struct MojomArrayHeader*)pointee)->num_bytes;
+  return ((const struct MojomStructHeader*)pointee)->num_bytes;
+}
+
+// Like MojomType_EncodePointer() and MojomType_DecodePointer(), but return the
+// pointee. These are on the interpreter's hottest path, so they are kept here
+// where they can be inlined.
+static void* encode_pointer(char* slot, const char* buf_end) {
+  union MojomPointer* pointer = (union MojomPointer*)slot;
+  void* ptr = pointer->ptr;
+  if (ptr == NULL) {
+    pointer->offset = 0;
+  } else {
+    assert((char*)ptr > slot && (char*)ptr < buf_end);
+    pointer->offset = (char*)ptr - slot;
+  }
+  return ptr;
+}
+
+static void* decode_pointer(char* slot) {
+  union MojomPointer* pointer = (union MojomPointer*)slot;
+  pointer->ptr = pointer->offset == 0 ? NULL : slot + pointer->offset;
+  return pointer->ptr;
+}
+
+// See type_descriptor.c.
+static const MojoHandle kEncodedHandleInvalid = (MojoHandle)-1;
+
+// Like MojomType_ValidatePointer() and MojomType_ValidateHandle(). These are
+// called once per pointer and handle visited, so they are also kept here where
+// they can be inlined.
+static MojomValidationResult validate_offset(
+    const union MojomPointer* pointer,
+    size_t max_offset,
+    bool is_nullable,
+    struct MojomValidationContext* inout_context) {
+  uint64_t offset = pointer->offset;
+  if (offset == 0) {
+    return is_nullable ? MOJOM_VALIDATION_ERROR_NONE
+                       : MOJOM_VALIDATION_UNEXPECTED_NULL_POINTER;
+  }
+  if (offset > max_offset || offset > UINT32_MAX)
+    return MOJOM_VALIDATION_ILLEGAL_POINTER;
+  if ((char*)pointer + offset < inout_context->next_pointer)
+    return MOJOM_VALIDATION_ILLEGAL_MEMORY_RANGE;
+  inout_context->next_pointer = (char*)pointer + offset;
+  if ((offset & 7) != 0)
+    return MOJOM_VALIDATION_MISALIGNED_OBJECT;
+  return MOJOM_VALIDATION_ERROR_NONE;
+}
+
+static MojomValidationResult validate_handle(
+    MojoHandle encoded_handle,
+    uint32_t num_handles,
+    bool is_nullable,
+    struct MojomValidationContext* inout_context) {
+  if (encoded_handle == kEncodedHandleInvalid) {
+    return is_nullable ? MOJOM_VALIDATION_ERROR_NONE
+                       : MOJOM_VALIDATION_UNEXPECTED_INVALID_HANDLE;
+  }
+  if (encoded_handle >= num_handles ||
+      encoded_handle < inout_context->next_handle_index)
+    return MOJOM_VALIDATION_ILLEGAL_HANDLE;
+  inout_context->next_handle_index = encoded_handle + 1;
+  return MOJOM_VALIDATION_ERROR_NONE;
+}
+
+// Validates the struct or array pointer described by |op| in |slot|, and the
+// header of its pointee, which is returned in |*out_pointee| (NULL if the
+// pointer is null).
+static MojomValidationResult validate_pointer(
+    const struct MojomTypeProgramOp* op,
+    const char* slot,
+    const char* buf_end,
+    struct MojomValidationContext* inout_context,
+    const void** out_pointee) {
+  const union MojomPointer* pointer = (const union MojomPointer*)slot;
+  *out_pointee = NULL;
+  MojomValidationResult result =
+      validate_offset(pointer, buf_end - slot, op->nullable, inout_context);
+  if (result != MOJOM_VALIDATION_ERROR_NONE || pointer->offset == 0)
+    return result;
+
+  const char* pointee = slot + pointer->offset;
+  uint32_t max_size = (uint32_t)(buf_end - pointee);
+  if (op->type == MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR) {
+    result = MojomArray_ValidateHeader(
+        op->target->type_desc, (const struct MojomArrayHeader*)pointee,
+        max_size);
+  } else {
+    result = MojomStruct_ValidateHeader(
+        op->target->type_desc, (const struct MojomStructHeader*)pointee,
+        max_size);
+  }
+  if (result != MOJOM_VALIDATION_ERROR_NONE)
+    return result;
+
+  inout_context->next_pointer =
+      (char*)pointee + pointee_num_bytes(op->type, pointee);
+  *out_pointee = pointee;
+  return MOJOM_VALIDATION_ERROR_NONE;
+}
+
+// Copies the struct or array of type |type| that |in_slot| points to, and
+// points |out_slot| at the copy. Returns false if |buffer| is too small.
+static bool copy_pointer(struct MojomBuffer* buffer,
+                         enum MojomTypeDescriptorType type,
+                         const char* in_slot,
+                         char* out_slot) {
+  const void* pointee = ((const union MojomPointer*)in_slot)->ptr;
+  void* out_pointee = NULL;
+  if (pointee != NULL) {
+    uint32_t num_bytes = pointee_num_bytes(type, pointee);
+    out_pointee = MojomBuffer_Allocate(buffer, num_bytes);
+    if (out_pointee == NULL)
+      return false;
+    memcpy(out_pointee, pointee, num_bytes);
+  }
+  ((union MojomPointer*)out_slot)->ptr = out_pointee;
+  return true;
+}
+
+// The following functions visit the struct or array |pointee| described by
+// the shallow |program| with a pair of plain loops, without using the
+// interpreter's stack. The targets of |program|'s ops contain nothing but
+// handles, and are visited by the *_handles() functions.
+
+static void encode_handles(const struct MojomTypeProgram* program,
+                           void* pointee,
+                           struct MojomHandleBuffer* inout_handles_buffer) {
+  char* data;
+  uint32_t version;
+  uint32_t count = get_objects(program, pointee, &data, &version);
+  for (uint32_t i = 0; i < count; i++, data += program->elem_size) {
+    for (uint32_t j = 0; j < program->num_ops; j++) {
+      const struct MojomTypeProgramOp* op = &program->ops[j];
+      if (version < op->key)
+        continue;
+      // The handle is the first field of a |struct MojomInterfaceData|.
+      MojomType_EncodeHandle(op->nullable, (MojoHandle*)(data + op->offset),
+                             inout_handles_buffer);
+    }
+  }
+}
+
+static void encode_shallow(const struct MojomTypeProgram* program,
+                           void* pointee,
+                           const char* buf_end,
+                           struct MojomHandleBuffer* inout_handles_buffer) {
+  char* data;
+  uint32_t version;
+  uint32_t count = get_objects(program, pointee, &data, &version);
+  for (uint32_t i = 0; i < count; i++, data += program->elem_size) {
+    for (uint32_t j = 0; j < program->num_ops; j++) {
+      const struct MojomTypeProgramOp* op = &program->ops[j];
+      if (version < op->key)
+        continue;
+      char* slot = data + op->offset;
+      if (op->target == NULL) {
+        MojomType_EncodeHandle(op->nullable, (MojoHandle*)slot,
+                               inout_handles_buffer);
+        continue;
+      }
+      void* p = encode_pointer(slot, buf_end);
+      if (p != NULL)
+        encode_handles(op->target, p, inout_handles_buffer);
+    }
+  }
+}
+
+static void decode_handles(const struct MojomTypeProgram* program,
+                           void* pointee,
+                           MojoHandle* inout_handles,
+                           uint32_t in_num_handles) {
+  char* data;
+  uint32_t version;
+  uint32_t count = get_objects(program, pointee, &data, &version);
+  for (uint32_t i = 0; i < count; i++, data += program->elem_size) {
+    for (uint32_t j = 0; j < program->num_ops; j++) {
+      const struct MojomTypeProgramOp* op = &program->ops[j];
+      if (version < op->key)
+        continue;
+      MojomType_DecodeHandle((MojoHandle*)(data + op->offset), inout_handles,
+                             in_num_handles);
+    }
+  }
+}
+
+static void decode_shallow(const struct MojomTypeProgram* program,
+                           void* pointee,
+                           const char* buf_end,
+                           MojoHandle* inout_handles,
+                           uint32_t in_num_handles) {
+  char* data;
+  uint32_t version;
+  uint32_t count = get_objects(program, pointee, &data, &version);
+  for (uint32_t i = 0; i < count; i++, data += program->elem_size) {
+    for (uint32_t j = 0; j < program->num_ops; j++) {
+      const struct MojomTypeProgramOp* op = &program->ops[j];
+      if (version < op->key)
+        continue;
+      char* slot = data + op->offset;
+      if (op->target == NULL) {
+        MojomType_DecodeHandle((MojoHandle*)slot, inout_handles,
+                               in_num_handles);
+        continue;
+      }
+      void* p = decode_pointer(slot);
+      assert(p == NULL || (char*)p < buf_end);
+      if (p != NULL)
+        decode_handles(op->target, p, inout_handles, in_num_handles);
+    }
+  }
+}
+
+static MojomValidationResult validate_handles(
+    const struct MojomTypeProgram* program,
+    const void* pointee,
+    uint32_t in_num_handles,
+    struct MojomValidationContext* inout_context) {
+  char* data;
+  uint32_t version;
+  uint32_t count = get_objects(program, pointee, &data, &version);
+  for (uint32_t i = 0; i < count; i++, data += program->elem_size) {
+    for (uint32_t j = 0; j < program->num_ops; j++) {
+      const struct MojomTypeProgramOp* op = &program->ops[j];
+      if (version < op->key)
+        continue;
+      MojomValidationResult result =
+          validate_handle(*(const MojoHandle*)(data + op->offset),
+                          in_num_handles, op->nullable, inout_context);
+      if (result != MOJOM_VALIDATION_ERROR_NONE)
+        return result;
+    }
+  }
+  return MOJOM_VALIDATION_ERROR_NONE;
+}
+
+static MojomValidationResult validate_shallow(
+    const struct MojomTypeProgram* program,
+    const void* pointee,
+    const char* buf_end,
+    uint32_t in_num_handles,
+    struct MojomValidationContext* inout_context) {
+  char* data;
+  uint32_t version;
+  uint32_t count = get_objects(program, pointee, &data, &version);
+  for (uint32_t i = 0; i < count; i++, data += program->elem_size) {
+    for (uint32_t j = 0; j < program->num_ops; j++) {
+      const struct MojomTypeProgramOp* op = &program->ops[j];
+      if (version < op->key)
+        continue;
+      const char* slot = data + op->offset;
+      MojomValidationResult result;
+      if (op->target == NULL) {
+        result = validate_handle(*(const MojoHandle*)slot, in_num_handles,
+                                 op->nullable, inout_context);
+      } else {
+        const void* p;
+        result = validate_pointer(op, slot, buf_end, inout_context, &p);
+        if (result == MOJOM_VALIDATION_ERROR_NONE && p != NULL) {
+          result = validate_handles(op->target, p, in_num_handles,
+                                    inout_context);
+        }
+      }
+      if (result != MOJOM_VALIDATION_ERROR_NONE)
+        return result;
+    }
+  }
+  return MOJOM_VALIDATION_ERROR_NONE;
+}
+
+static size_t compute_size_shallow(const struct MojomTypeProgram* program,
+                                   const void* pointee) {
+  char* data;
+  uint32_t version;
+  uint32_t count = get_objects(program, pointee, &data, &version);
+  size_t size = 0;
+  for (uint32_t i = 0; i < count; i++, data += program->elem_size) {
+    for (uint32_t j = 0; j < program->num_ops; j++) {
+      const struct MojomTypeProgramOp* op = &program->ops[j];
+      if (version < op->key || op->target == NULL)
+        continue;
+      const void* p = ((const union MojomPointer*)(data + op->offset))->ptr;
+      if (p != NULL)
+        size += pointee_num_bytes(op->type, p);
+    }
+  }
+  return size;
+}
+
+// Handles are copied along with the rest of their struct or array, so only
+// the references of |pointee| need to be copied into |out_pointee|.
+static bool copy_shallow(struct MojomBuffer* buffer,
+                         const struct MojomTypeProgram* program,
+                         const void* pointee,
+                         void* out_pointee) {
+  char* data;
+  uint32_t version;
+  uint32_t count = get_objects(program, pointee, &data, &version);
+  char* out_data = (char*)out_pointee + (data - (const char*)pointee);
+  for (uint32_t i = 0; i < count; i++, data += program->elem_size,
+                out_data += program->elem_size) {
+    for (uint32_t j = 0; j < program->num_ops; j++) {
+      const struct MojomTypeProgramOp* op = &program->ops[j];
+      if (version < op->key || op->target == NULL)
+        continue;
+      if (!copy_pointer(buffer, op->type, data + op->offset,
+                        out_data + op->offset)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Returns the op of the active field of |layout|, or NULL if it is unknown.
+static const struct MojomTypeProgramOp* union_op(
+    const struct MojomTypeProgram* program,
+    const struct MojomUnionLayout* layout) {
+  for (uint32_t i = 0; i < program->num_ops; i++) {
+    if (program->ops[i].key == layout->tag)
+      return &program->ops[i];
+  }
+  return NULL;
+}
+
+size_t MojomTypeProgram_ComputeSerializedSize(
+    const struct MojomTypeProgram* in_program,
+    const struct MojomStructHeader* in_struct) {
+  assert(in_program);
+  assert(in_struct);
+
+  size_t size = in_struct->num_bytes;
+  if (in_program->is_shallow)
+    return size + compute_size_shallow(in_program, in_struct);
+
+  struct MojomTypeProgramStack stack;
+  stack.depth = 0;
+  push_frame(&stack, in_program, in_struct, NULL);
+
+  while (stack.depth > 0) {
+    struct MojomTypeProgramFrame* frame = &stack.frames[stack.depth - 1];
+    size_t offset;
+    const struct MojomTypeProgramOp* op = next_op(frame, &offset);
+    if (op == NULL) {
+      stack.depth--;
+      continue;
+    }
+    char* slot = frame->data + offset;
+
+    if (stack.depth == MOJOM_TYPE_PROGRAM_MAX_DEPTH && op->target) {
+      size += MojomType_DispatchComputeSerializedSize(
+          op->type, op->target->type_desc, op->nullable, slot);
+      continue;
+    }
+
+    while (op != NULL) {
+      const struct MojomTypeProgramOp* next = NULL;
+      struct MojomUnionLayout* layout = (struct MojomUnionLayout*)slot;
+      switch (op->type) {
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR:
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_MAP_PTR:
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR: {
+          const void* p = ((union MojomPointer*)slot)->ptr;
+          if (p == NULL)
+            break;
+          size += pointee_num_bytes(op->type, p);
+          if (op->target->is_shallow)
+            size += compute_size_shallow(op->target, p);
+          else
+            push_frame(&stack, op->target, p, NULL);
+          break;
+        }
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION_PTR:
+          layout = ((union MojomPointer*)slot)->ptr;
+          if (layout == NULL)
+            break;
+          size += sizeof(struct MojomUnionLayout);
+          // Fall through.
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION:
+          if (op->nullable && layout->size == 0)
+            break;
+          next = union_op(op->target, layout);
+          slot = (char*)&layout->data;
+          break;
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_HANDLE:
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_INTERFACE:
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_POD:
+          break;
+      }
+      op = next;
+    }
+  }
+
+  return size;
+}
+
+void MojomTypeProgram_EncodePointersAndHandles(
+    const struct MojomTypeProgram* in_program,
+    struct MojomStructHeader* inout_struct,
+    uint32_t in_struct_size,
+    struct MojomHandleBuffer* inout_handles_buffer) {
+  assert(in_program);
+  assert(inout_struct);
+  assert(in_struct_size >= sizeof(struct MojomStructHeader));
+
+  char* buf_end = (char*)inout_struct + in_struct_size;
+  if (in_program->is_shallow) {
+    encode_shallow(in_program, inout_struct, buf_end, inout_handles_buffer);
+    return;
+  }
+
+  struct MojomTypeProgramStack stack;
+  stack.depth = 0;
+  push_frame(&stack, in_program, inout_struct, NULL);
+
+  while (stack.depth > 0) {
+    struct MojomTypeProgramFrame* frame = &stack.frames[stack.depth - 1];
+    size_t offset;
+    const struct MojomTypeProgramOp* op = next_op(frame, &offset);
+    if (op == NULL) {
+      stack.depth--;
+      continue;
+    }
+    char* slot = frame->data + offset;
+    assert(slot < buf_end);
+
+    if (stack.depth == MOJOM_TYPE_PROGRAM_MAX_DEPTH && op->target) {
+      MojomType_DispatchEncodePointersAndHandles(
+          op->type, op->target->type_desc, op->nullable, slot,
+          (uint32_t)(buf_end - slot), inout_handles_buffer);
+      continue;
+    }
+
+    while (op != NULL) {
+      const struct MojomTypeProgramOp* next = NULL;
+      struct MojomUnionLayout* layout = (struct MojomUnionLayout*)slot;
+      switch (op->type) {
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR:
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_MAP_PTR:
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR: {
+          void* p = encode_pointer(slot, buf_end);
+          if (p == NULL)
+            break;
+          if (op->target->is_shallow)
+            encode_shallow(op->target, p, buf_end, inout_handles_buffer);
+          else
+            push_frame(&stack, op->target, p, NULL);
+          break;
+        }
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION_PTR:
+          layout = encode_pointer(slot, buf_end);
+          if (layout == NULL)
+            break;
+          // Fall through.
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION:
+          if (op->nullable && layout->size == 0)
+            break;
+          next = union_op(op->target, layout);
+          slot = (char*)&layout->data;
+          break;
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_HANDLE:
+          MojomType_EncodeHandle(op->nullable, (MojoHandle*)slot,
+                                 inout_handles_buffer);
+          break;
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_INTERFACE:
+          MojomType_EncodeHandle(op->nullable,
+                                 &((struct MojomInterfaceData*)slot)->handle,
+                                 inout_handles_buffer);
+          break;
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_POD:
+          break;
+      }
+      op = next;
+    }
+  }
+}
+
+void MojomTypeProgram_DecodePointersAndHandles(
+    const struct MojomTypeProgram* in_program,
+    struct MojomStructHeader* inout_struct,
+    uint32_t in_struct_size,
+    MojoHandle* inout_handles,
+    uint32_t in_num_handles) {
+  assert(in_program);
+  assert(inout_struct);
+  assert(inout_handles != NULL || in_num_handles == 0);
+
+  char* buf_end = (char*)inout_struct + in_struct_size;
+  if (in_program->is_shallow) {
+    decode_shallow(in_program, inout_struct, buf_end, inout_handles,
+                   in_num_handles);
+    return;
+  }
+
+  struct MojomTypeProgramStack stack;
+  stack.depth = 0;
+  push_frame(&stack, in_program, inout_struct, NULL);
+
+  while (stack.depth > 0) {
+    struct MojomTypeProgramFrame* frame = &stack.frames[stack.depth - 1];
+    size_t offset;
+    const struct MojomTypeProgramOp* op = next_op(frame, &offset);
+    if (op == NULL) {
+      stack.depth--;
+      continue;
+    }
+    char* slot = frame->data + offset;
+    assert(slot < buf_end);
+
+    if (stack.depth == MOJOM_TYPE_PROGRAM_MAX_DEPTH && op->target) {
+      MojomType_DispatchDecodePointersAndHandles(
+          op->type, op->target->type_desc, op->nullable, slot,
+          (uint32_t)(buf_end - slot), inout_handles, in_num_handles);
+      continue;
+    }
+
+    while (op != NULL) {
+      const struct MojomTypeProgramOp* next = NULL;
+      struct MojomUnionLayout* layout = (struct MojomUnionLayout*)slot;
+      switch (op->type) {
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR:
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_MAP_PTR:
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR: {
+          void* p = decode_pointer(slot);
+          assert(p == NULL || (char*)p < buf_end);
+          if (p == NULL)
+            break;
+          if (op->target->is_shallow) {
+            decode_shallow(op->target, p, buf_end, inout_handles,
+                           in_num_handles);
+          } else {
+            push_frame(&stack, op->target, p, NULL);
+          }
+          break;
+        }
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION_PTR:
+          layout = decode_pointer(slot);
+          assert(layout == NULL || (char*)layout < buf_end);
+          if (layout == NULL)
+            break;
+          // Fall through.
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION:
+          if (op->nullable && layout->size == 0)
+            break;
+          next = union_op(op->target, layout);
+          slot = (char*)&layout->data;
+          break;
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_HANDLE:
+          MojomType_DecodeHandle((MojoHandle*)slot, inout_handles,
+                                 in_num_handles);
+          break;
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_INTERFACE:
+          MojomType_DecodeHandle(&((struct MojomInterfaceData*)slot)->handle,
+                                 inout_handles, in_num_handles);
+          break;
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_POD:
+          break;
+      }
+      op = next;
+    }
+  }
+}
+
+MojomValidationResult MojomTypeProgram_Validate(
+    const struct MojomTypeProgram* in_program,
+    const struct MojomStructHeader* in_struct,
+    uint32_t in_struct_size,
+    uint32_t in_num_handles,
+    struct MojomValidationContext* inout_context) {
+  assert(in_program);
+  assert(in_struct);
+
+  MojomValidationResult result = MojomStruct_ValidateHeader(
+      in_program->type_desc, in_struct, in_struct_size);
+  if (result != MOJOM_VALIDATION_ERROR_NONE)
+    return result;
+
+  // From here on out, all pointers need to point past the end of this struct.
+  inout_context->next_pointer = (char*)in_struct + in_struct->num_bytes;
+
+  char* buf_end = (char*)in_struct + in_struct_size;
+  if (in_program->is_shallow) {
+    return validate_shallow(in_program, in_struct, buf_end, in_num_handles,
+                            inout_context);
+  }
+
+  struct MojomTypeProgramStack stack;
+  stack.depth = 0;
+  push_frame(&stack, in_program, in_struct, NULL);
+
+  while (stack.depth > 0) {
+    struct MojomTypeProgramFrame* frame = &stack.frames[stack.depth - 1];
+    size_t offset;
+    const struct MojomTypeProgramOp* op = next_op(frame, &offset);
+    if (op == NULL) {
+      // A map's keys and values can only be compared once both arrays have
+      // been validated.
+      if (frame->program->type == MOJOM_TYPE_DESCRIPTOR_TYPE_MAP_PTR) {
+        result = MojomMap_Validate(
+            frame->program->type_desc,
+            (const struct MojomStructHeader*)frame->data,
+            (uint32_t)(buf_end - frame->data), in_num_handles, inout_context);
+        if (result != MOJOM_VALIDATION_ERROR_NONE)
+          return result;
+      }
+      stack.depth--;
+      continue;
+    }
+    char* slot = frame->data + offset;
+
+    if (stack.depth == MOJOM_TYPE_PROGRAM_MAX_DEPTH && op->target) {
+      result = MojomType_DispatchValidate(
+          op->type, op->target->type_desc, op->nullable, slot,
+          (uint32_t)(buf_end - slot), in_num_handles, inout_context);
+      if (result != MOJOM_VALIDATION_ERROR_NONE)
+        return result;
+      continue;
+    }
+
+    while (op != NULL) {
+      const struct MojomTypeProgramOp* next = NULL;
+      const union MojomPointer* pointer = (const union MojomPointer*)slot;
+      struct MojomUnionLayout* layout = (struct MojomUnionLayout*)slot;
+      switch (op->type) {
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR:
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_MAP_PTR:
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR: {
+          const void* p;
+          result = validate_pointer(op, slot, buf_end, inout_context, &p);
+          if (result != MOJOM_VALIDATION_ERROR_NONE)
+            return result;
+          if (p == NULL)
+            break;
+          if (op->target->is_shallow) {
+            result = validate_shallow(op->target, p, buf_end, in_num_handles,
+                                      inout_context);
+            if (result != MOJOM_VALIDATION_ERROR_NONE)
+              return result;
+          } else {
+            push_frame(&stack, op->target, p, NULL);
+          }
+          break;
+        }
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION_PTR:
+          result = validate_offset(pointer, buf_end - slot, op->nullable,
+                                   inout_context);
+          if (result != MOJOM_VALIDATION_ERROR_NONE)
+            return result;
+          if (pointer->offset == 0)
+            break;
+
+          // Since this union is a pointer, we update |next_pointer| to be past
+          // the union data.
+          inout_context->next_pointer += sizeof(struct MojomUnionLayout);
+          layout = (struct MojomUnionLayout*)(slot + pointer->offset);
+          // Fall through.
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION:
+          if (layout->size == 0) {
+            if (!op->nullable)
+              return MOJOM_VALIDATION_UNEXPECTED_NULL_UNION;
+            break;
+          }
+
+          next = union_op(op->target, layout);
+          if (next == NULL || next->type == MOJOM_TYPE_DESCRIPTOR_TYPE_POD) {
+            next = NULL;
+            break;
+          }
+          if (!op->nullable && layout->size != sizeof(struct MojomUnionLayout))
+            return MOJOM_VALIDATION_UNEXPECTED_NULL_UNION;
+          slot = (char*)&layout->data;
+          break;
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_HANDLE:
+          result = validate_handle(*(const MojoHandle*)slot, in_num_handles,
+                                   op->nullable, inout_context);
+          if (result != MOJOM_VALIDATION_ERROR_NONE)
+            return result;
+          break;
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_INTERFACE:
+          result = validate_handle(
+              ((const struct MojomInterfaceData*)slot)->handle, in_num_handles,
+              op->nullable, inout_context);
+          if (result != MOJOM_VALIDATION_ERROR_NONE)
+            return result;
+          break;
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_POD:
+          break;
+      }
+      op = next;
+    }
+  }
+
+  return MOJOM_VALIDATION_ERROR_NONE;
+}
+
+bool MojomTypeProgram_DeepCopy(struct MojomBuffer* buffer,
+                               const struct MojomTypeProgram* in_program,
+                               const struct MojomStructHeader* in_struct,
+                               struct MojomStructHeader** out_struct) {
+  assert(in_program);
+  assert(in_struct);
+  assert(out_struct);
+
+  *out_struct = MojomBuffer_Allocate(buffer, in_struct->num_bytes);
+  if (*out_struct == NULL)
+    return false;
+
+  memcpy(*out_struct, in_struct, in_struct->num_bytes);
+
+  if (in_program->is_shallow)
+    return copy_shallow(buffer, in_program, in_struct, *out_struct);
+
+  struct MojomTypeProgramStack stack;
+  stack.depth = 0;
+  push_frame(&stack, in_program, in_struct, *out_struct);
+
+  while (stack.depth > 0) {
+    struct MojomTypeProgramFrame* frame = &stack.frames[stack.depth - 1];
+    size_t offset;
+    const struct MojomTypeProgramOp* op = next_op(frame, &offset);
+    if (op == NULL) {
+      stack.depth--;
+      continue;
+    }
+    char* in_slot = frame->data + offset;
+    char* out_slot = frame->out_data + offset;
+
+    if (stack.depth == MOJOM_TYPE_PROGRAM_MAX_DEPTH && op->target) {
+      if (!MojomType_DispatchDeepCopy(buffer, op->type, op->target->type_desc,
+                                      in_slot, out_slot)) {
+        return false;
+      }
+      continue;
+    }
+
+    while (op != NULL) {
+      const struct MojomTypeProgramOp* next = NULL;
+      struct MojomUnionLayout* in_layout = (struct MojomUnionLayout*)in_slot;
+      struct MojomUnionLayout* out_layout = (struct MojomUnionLayout*)out_slot;
+      switch (op->type) {
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR:
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_MAP_PTR:
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR: {
+          if (!copy_pointer(buffer, op->type, in_slot, out_slot))
+            return false;
+          const void* p = ((union MojomPointer*)in_slot)->ptr;
+          void* out_p = ((union MojomPointer*)out_slot)->ptr;
+          if (p == NULL)
+            break;
+          if (op->target->is_shallow) {
+            if (!copy_shallow(buffer, op->target, p, out_p))
+              return false;
+          } else {
+            push_frame(&stack, op->target, p, out_p);
+          }
+          break;
+        }
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION_PTR:
+          in_layout = ((union MojomPointer*)in_slot)->ptr;
+          if (in_layout == NULL) {
+            ((union MojomPointer*)out_slot)->ptr = NULL;
+            break;
+          }
+          out_layout =
+              MojomBuffer_Allocate(buffer, sizeof(struct MojomUnionLayout));
+          if (out_layout == NULL)
+            return false;
+          ((union MojomPointer*)out_slot)->ptr = out_layout;
+          // Fall through.
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_UNION:
+          memcpy(out_layout, in_layout, sizeof(struct MojomUnionLayout));
+          // Unions with size 0 are null.
+          if (in_layout->size == 0)
+            break;
+
+          next = union_op(op->target, in_layout);
+          if (next == NULL) {
+            // If it's the UNKNOWN tag, it's not a failure. If it's an
+            // unrecognized tag, we don't know how to copy it.
+            const struct MojomTypeDescriptorUnion* desc =
+                op->target->type_desc;
+            if (in_layout->tag >= desc->num_fields &&
+                in_layout->tag != UNION_TAG_UNKNOWN) {
+              return false;
+            }
+            break;
+          }
+          in_slot = (char*)&in_layout->data;
+          out_slot = (char*)&out_layout->data;
+          break;
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_HANDLE:
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_INTERFACE:
+        case MOJOM_TYPE_DESCRIPTOR_TYPE_POD:
+          break;
+      }
+      op = next;
+    }
+  }
+
+  return true;
+}
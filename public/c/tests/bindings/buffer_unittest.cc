@@ -5,6 +5,7 @@
 #include <mojo/bindings/buffer.h>
 
 #include <stdint.h>
+#include <string.h>
 
 #include "third_party/gtest/include/gtest/gtest.h"
 
@@ -49,4 +50,76 @@ TEST(MojomBufferTest, Failure) {
   EXPECT_EQ(NULL, MojomBuffer_Allocate(&mbuf, 1));
 }
 
+TEST(MojomArenaTest, UsesInitialBufferFirst) {
+  alignas(8) char buffer[64];
+  struct MojomArena arena;
+  MojomArena_Init(&arena, buffer, sizeof(buffer));
+
+  EXPECT_EQ(buffer, MojomArena_Allocate(&arena, 6));
+  EXPECT_EQ(buffer + 8, MojomBuffer_Allocate(&arena.buffer, 56));
+  EXPECT_EQ(0u, MojomArena_GetNumBytesReserved(&arena));
+
+  // The initial buffer is full, so this comes from a new chunk.
+  char* p = static_cast<char*>(MojomBuffer_Allocate(&arena.buffer, 8));
+  ASSERT_TRUE(p);
+  EXPECT_TRUE(p < buffer || p >= buffer + sizeof(buffer));
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(p) % 8);
+  EXPECT_EQ(MOJOM_ARENA_MIN_CHUNK_SIZE, MojomArena_GetNumBytesReserved(&arena));
+
+  MojomArena_Destroy(&arena);
+}
+
+TEST(MojomArenaTest, Grows) {
+  struct MojomArena arena;
+  MojomArena_Init(&arena, NULL, 0);
+
+  // Every allocation is contiguous and writable, even once chunks fill up.
+  const uint32_t kSize = 1000;
+  for (uint32_t i = 0; i < 100; i++) {
+    char* p = static_cast<char*>(MojomArena_Allocate(&arena, kSize));
+    ASSERT_TRUE(p);
+    memset(p, static_cast<int>(i), kSize);
+  }
+  uint64_t reserved = MojomArena_GetNumBytesReserved(&arena);
+  EXPECT_GE(reserved, 100u * kSize);
+  // Chunks double in size, so there are only a few of them.
+  size_t num_chunks = 0;
+  for (struct MojomArenaChunk* chunk = arena.chunks; chunk;
+       chunk = chunk->next) {
+    EXPECT_LE(chunk->size, MOJOM_ARENA_MAX_CHUNK_SIZE);
+    num_chunks++;
+  }
+  EXPECT_LE(num_chunks, 6u);
+
+  // Allocations larger than a chunk get a chunk of their own.
+  const uint32_t kLarge = MOJOM_ARENA_MAX_CHUNK_SIZE * 2;
+  char* large = static_cast<char*>(MojomArena_Allocate(&arena, kLarge));
+  ASSERT_TRUE(large);
+  memset(large, 1, kLarge);
+  EXPECT_EQ(reserved + kLarge, MojomArena_GetNumBytesReserved(&arena));
+
+  MojomArena_Destroy(&arena);
+  EXPECT_EQ(0u, MojomArena_GetNumBytesReserved(&arena));
+}
+
+TEST(MojomArenaTest, ResetReusesChunks) {
+  struct MojomArena arena;
+  MojomArena_Init(&arena, NULL, 0);
+
+  void* first = MojomArena_Allocate(&arena, 8);
+  for (uint32_t i = 0; i < 10; i++)
+    ASSERT_TRUE(MojomArena_Allocate(&arena, 3000));
+  uint64_t reserved = MojomArena_GetNumBytesReserved(&arena);
+
+  // The same sequence of allocations after a reset doesn't allocate any more
+  // chunks, and starts over at the first one.
+  MojomArena_Reset(&arena);
+  EXPECT_EQ(first, MojomArena_Allocate(&arena, 8));
+  for (uint32_t i = 0; i < 10; i++)
+    ASSERT_TRUE(MojomArena_Allocate(&arena, 3000));
+  EXPECT_EQ(reserved, MojomArena_GetNumBytesReserved(&arena));
+
+  MojomArena_Destroy(&arena);
+}
+
 }  // namespace
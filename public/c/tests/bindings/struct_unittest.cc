@@ -107,6 +107,65 @@ TEST(StructSerializationTest, StructOfStructs) {
   }
 }
 
+// Describes mojo_test_RectPair, so that it can be used with the MojomStruct_*()
+// functions directly.
+struct MojomTypeDescriptorStructVersion kRectVersions[] = {
+    {0, sizeof(struct mojo_test_Rect)}};
+const struct MojomTypeDescriptorStruct kRectDesc = {1, kRectVersions, 0,
+                                                    NULL};
+struct MojomTypeDescriptorStructVersion kRectPairVersions[] = {
+    {0, sizeof(struct mojo_test_RectPair)}};
+const struct MojomTypeDescriptorStructEntry kRectPairEntries[] = {
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR, &kRectDesc, 0, 0, false},
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR, &kRectDesc, 8, 0, false},
+};
+const struct MojomTypeDescriptorStruct kRectPairDesc = {
+    1, kRectPairVersions, MOJO_ARRAYSIZE(kRectPairEntries), kRectPairEntries};
+
+// A deep copy into an arena doesn't need to know the struct's size upfront,
+// and a received (encoded) struct can be decoded into an arena to retain it.
+TEST(StructSerializationTest, Arena) {
+  char buffer_bytes[1000] = {0};
+  struct MojomBuffer buf = {buffer_bytes, sizeof(buffer_bytes), 0};
+  struct mojo_test_RectPair* pair = static_cast<struct mojo_test_RectPair*>(
+      MojomBuffer_Allocate(&buf, sizeof(struct mojo_test_RectPair)));
+  *pair = mojo_test_RectPair{
+      {sizeof(struct mojo_test_RectPair), 0},
+      {MakeRect(&buf)},  // first
+      {MakeRect(&buf)},  // second
+  };
+  pair->first.ptr->x = 1;
+  pair->second.ptr->height = 2;
+
+  // An initial buffer that is too small to hold the copy.
+  alignas(8) char initial_bytes[32];
+  struct MojomArena arena;
+  MojomArena_Init(&arena, initial_bytes, sizeof(initial_bytes));
+
+  struct mojo_test_RectPair* copy =
+      mojo_test_RectPair_DeepCopy(&arena.buffer, pair);
+  ASSERT_TRUE(copy);
+  EXPECT_NE(pair->first.ptr, copy->first.ptr);
+  EXPECT_EQ(1, copy->first.ptr->x);
+  EXPECT_EQ(2, copy->second.ptr->height);
+
+  mojo_test_RectPair_EncodePointersAndHandles(pair, buf.num_bytes_used, NULL);
+  struct mojo_test_RectPair* decoded =
+      reinterpret_cast<struct mojo_test_RectPair*>(MojomStruct_DecodeIntoArena(
+          &kRectPairDesc, reinterpret_cast<struct MojomStructHeader*>(pair),
+          buf.num_bytes_used, NULL, 0, &arena));
+  ASSERT_TRUE(decoded);
+  // The original stays encoded.
+  EXPECT_EQ(BYTES_LEFT_AFTER_FIELD(struct mojo_test_RectPair, first),
+            pair->first.offset);
+  EXPECT_EQ(reinterpret_cast<char*>(decoded) + sizeof(*decoded),
+            reinterpret_cast<char*>(decoded->first.ptr));
+  EXPECT_EQ(1, decoded->first.ptr->x);
+  EXPECT_EQ(2, decoded->second.ptr->height);
+
+  MojomArena_Destroy(&arena);
+}
+
 // Tests a struct that has:
 //  - nullable string which isn't null.
 //  - nullable array of rects, which isn't null.
@@ -0,0 +1,219 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares the recursive MojomType_Dispatch*() functions (via MojomStruct_*())
+// with the compiled MojomTypeProgram_*() interpreter on a struct holding a
+// large nested array.
+
+#include <mojo/bindings/internal/type_program.h>
+
+#include <mojo/bindings/array.h>
+#include <mojo/bindings/internal/type_descriptor.h>
+#include <mojo/bindings/struct.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <vector>
+
+#include "mojo/public/c/tests/system/perftest_utils.h"
+#include "third_party/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// struct Leaf { int32 x; handle? h; };
+struct Leaf {
+  struct MojomStructHeader header;
+  int32_t x;
+  MojoHandle h;
+};
+
+// struct Root { array<array<Leaf>> rows; };
+struct Root {
+  struct MojomStructHeader header;
+  union MojomPointer rows;
+};
+
+struct MojomTypeDescriptorStructVersion kLeafVersions[] = {
+    {0, sizeof(Leaf)}};
+const struct MojomTypeDescriptorStructEntry kLeafEntries[] = {
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_HANDLE, nullptr,
+     offsetof(Leaf, h) - sizeof(struct MojomStructHeader), 0, true},
+};
+const struct MojomTypeDescriptorStruct kLeafDesc = {1, kLeafVersions, 1,
+                                                    kLeafEntries};
+const struct MojomTypeDescriptorArray kLeafArrayDesc = {
+    MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR, &kLeafDesc, 0, 64, false};
+const struct MojomTypeDescriptorArray kRowsDesc = {
+    MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR, &kLeafArrayDesc, 0, 64, false};
+
+struct MojomTypeDescriptorStructVersion kRootVersions[] = {
+    {0, sizeof(Root)}};
+const struct MojomTypeDescriptorStructEntry kRootEntries[] = {
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR, &kRowsDesc, 0, 0, false},
+};
+const struct MojomTypeDescriptorStruct kRootDesc = {1, kRootVersions, 1,
+                                                    kRootEntries};
+
+const uint32_t kNumRows = 64;
+const uint32_t kNumColumns = 64;
+
+class TypeProgramPerftest : public testing::Test {
+ public:
+  TypeProgramPerftest()
+      : message_bytes_(sizeof(Root) +
+                       (sizeof(struct MojomArrayHeader) +
+                        kNumRows * sizeof(union MojomPointer)) +
+                       kNumRows * (sizeof(struct MojomArrayHeader) +
+                                   kNumColumns * sizeof(union MojomPointer)) +
+                       kNumRows * kNumColumns * sizeof(Leaf)),
+        copy_bytes_(message_bytes_.size()),
+        program_(nullptr),
+        root_(nullptr) {}
+
+  void SetUp() override {
+    struct MojomBuffer program_buf = {program_bytes_, sizeof(program_bytes_),
+                                      0};
+    program_ = MojomTypeProgram_CompileStruct(&kRootDesc, &program_buf);
+    ASSERT_TRUE(program_);
+
+    struct MojomBuffer buf = {message_bytes_.data(),
+                              static_cast<uint32_t>(message_bytes_.size()), 0};
+    root_ = static_cast<Root*>(MojomBuffer_Allocate(&buf, sizeof(Root)));
+    root_->header = {sizeof(Root), 0};
+    struct MojomArrayHeader* rows =
+        MojomArray_New(&buf, kNumRows, sizeof(union MojomPointer));
+    root_->rows.ptr = rows;
+    for (uint32_t i = 0; i < kNumRows; i++) {
+      struct MojomArrayHeader* row =
+          MojomArray_New(&buf, kNumColumns, sizeof(union MojomPointer));
+      MOJOM_ARRAY_INDEX(rows, union MojomPointer, i)->ptr = row;
+      for (uint32_t j = 0; j < kNumColumns; j++) {
+        Leaf* leaf =
+            static_cast<Leaf*>(MojomBuffer_Allocate(&buf, sizeof(Leaf)));
+        *leaf = Leaf{{sizeof(Leaf), 0}, static_cast<int32_t>(j),
+                     MOJO_HANDLE_INVALID};
+        MOJOM_ARRAY_INDEX(row, union MojomPointer, j)->ptr = leaf;
+      }
+    }
+    ASSERT_EQ(message_bytes_.size(), buf.num_bytes_used);
+  }
+
+ protected:
+  struct MojomStructHeader* root() { return &root_->header; }
+  uint32_t message_size() const {
+    return static_cast<uint32_t>(message_bytes_.size());
+  }
+
+  // Runs |encode| and |decode| on the message in place.
+  template <typename EncodeFn, typename DecodeFn>
+  void EncodeDecode(EncodeFn encode, DecodeFn decode) {
+    MojoHandle handles[1];
+    struct MojomHandleBuffer handle_buf = {handles, 1, 0};
+    encode(root(), message_size(), &handle_buf);
+    decode(root(), message_size(), handles, 0);
+  }
+
+  // Returns an encoded copy of the message.
+  struct MojomStructHeader* EncodedCopy() {
+    struct MojomBuffer buf = {copy_bytes_.data(),
+                              static_cast<uint32_t>(copy_bytes_.size()), 0};
+    struct MojomStructHeader* copy = nullptr;
+    EXPECT_TRUE(MojomStruct_DeepCopy(&buf, &kRootDesc, root(), &copy));
+    MojoHandle handles[1];
+    struct MojomHandleBuffer handle_buf = {handles, 1, 0};
+    MojomStruct_EncodePointersAndHandles(&kRootDesc, copy, message_size(),
+                                         &handle_buf);
+    return copy;
+  }
+
+  std::vector<char> message_bytes_;
+  std::vector<char> copy_bytes_;
+  const struct MojomTypeProgram* program_;
+
+ private:
+  alignas(8) char program_bytes_[1024];
+  Root* root_;
+};
+
+TEST_F(TypeProgramPerftest, ComputeSerializedSize) {
+  mojo::test::IterateAndReportPerf(
+      "TypeProgram_ComputeSerializedSize", "Dispatch", [this]() {
+        EXPECT_EQ(message_size(),
+                  MojomStruct_ComputeSerializedSize(&kRootDesc, root()));
+      });
+  mojo::test::IterateAndReportPerf(
+      "TypeProgram_ComputeSerializedSize", "Program", [this]() {
+        EXPECT_EQ(message_size(),
+                  MojomTypeProgram_ComputeSerializedSize(program_, root()));
+      });
+}
+
+TEST_F(TypeProgramPerftest, EncodeDecode) {
+  mojo::test::IterateAndReportPerf(
+      "TypeProgram_EncodeDecode", "Dispatch", [this]() {
+        EncodeDecode(
+            [](struct MojomStructHeader* s, uint32_t size,
+               struct MojomHandleBuffer* handle_buf) {
+              MojomStruct_EncodePointersAndHandles(&kRootDesc, s, size,
+                                                   handle_buf);
+            },
+            [](struct MojomStructHeader* s, uint32_t size, MojoHandle* handles,
+               uint32_t num_handles) {
+              MojomStruct_DecodePointersAndHandles(&kRootDesc, s, size,
+                                                   handles, num_handles);
+            });
+      });
+  mojo::test::IterateAndReportPerf(
+      "TypeProgram_EncodeDecode", "Program", [this]() {
+        const struct MojomTypeProgram* program = program_;
+        EncodeDecode(
+            [program](struct MojomStructHeader* s, uint32_t size,
+                      struct MojomHandleBuffer* handle_buf) {
+              MojomTypeProgram_EncodePointersAndHandles(program, s, size,
+                                                        handle_buf);
+            },
+            [program](struct MojomStructHeader* s, uint32_t size,
+                      MojoHandle* handles, uint32_t num_handles) {
+              MojomTypeProgram_DecodePointersAndHandles(program, s, size,
+                                                        handles, num_handles);
+            });
+      });
+}
+
+TEST_F(TypeProgramPerftest, Validate) {
+  struct MojomStructHeader* encoded = EncodedCopy();
+  mojo::test::IterateAndReportPerf(
+      "TypeProgram_Validate", "Dispatch", [this, encoded]() {
+        struct MojomValidationContext context = {0, nullptr};
+        EXPECT_EQ(MOJOM_VALIDATION_ERROR_NONE,
+                  MojomStruct_Validate(&kRootDesc, encoded, message_size(), 0,
+                                       &context));
+      });
+  mojo::test::IterateAndReportPerf(
+      "TypeProgram_Validate", "Program", [this, encoded]() {
+        struct MojomValidationContext context = {0, nullptr};
+        EXPECT_EQ(MOJOM_VALIDATION_ERROR_NONE,
+                  MojomTypeProgram_Validate(program_, encoded, message_size(),
+                                            0, &context));
+      });
+}
+
+TEST_F(TypeProgramPerftest, DeepCopy) {
+  mojo::test::IterateAndReportPerf("TypeProgram_DeepCopy", "Dispatch",
+                                   [this]() {
+    struct MojomBuffer buf = {copy_bytes_.data(),
+                              static_cast<uint32_t>(copy_bytes_.size()), 0};
+    struct MojomStructHeader* copy = nullptr;
+    EXPECT_TRUE(MojomStruct_DeepCopy(&buf, &kRootDesc, root(), &copy));
+  });
+  mojo::test::IterateAndReportPerf("TypeProgram_DeepCopy", "Program",
+                                   [this]() {
+    struct MojomBuffer buf = {copy_bytes_.data(),
+                              static_cast<uint32_t>(copy_bytes_.size()), 0};
+    struct MojomStructHeader* copy = nullptr;
+    EXPECT_TRUE(MojomTypeProgram_DeepCopy(&buf, program_, root(), &copy));
+  });
+}
+
+}  // namespace
@@ -0,0 +1,569 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <mojo/bindings/internal/type_program.h>
+
+#include <mojo/bindings/array.h>
+#include <mojo/bindings/internal/type_descriptor.h>
+#include <mojo/bindings/struct.h>
+#include <mojo/bindings/union.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "mojo/public/cpp/system/macros.h"
+#include "third_party/gtest/include/gtest/gtest.h"
+
+// The type descriptors below are written by hand (instead of using generated
+// bindings) so that they exercise every kind of op: handles, nested and
+// recursive structs, arrays of structs/unions/handles, maps, inline unions and
+// unions pointing to unions.
+namespace {
+
+struct Leaf {
+  struct MojomStructHeader header;
+  int32_t x;
+  MojoHandle h;
+};
+
+struct Map {
+  struct MojomStructHeader header;
+  union MojomPointer keys;
+  union MojomPointer values;
+};
+
+struct Outer {
+  struct MojomStructHeader header;
+  union MojomPointer leaf;
+  union MojomPointer leaves;
+  struct MojomUnionLayout u;
+  union MojomPointer map;
+  union MojomPointer next;
+  union MojomPointer handles;
+  union MojomPointer unions;
+  // Only present in version 1.
+  union MojomPointer v1_leaf;
+};
+
+#define FIELD_OFFSET(type, field) \
+  (offsetof(type, field) - sizeof(struct MojomStructHeader))
+
+struct MojomTypeDescriptorStructVersion kLeafVersions[] = {
+    {0, sizeof(Leaf)}};
+const struct MojomTypeDescriptorStructEntry kLeafEntries[] = {
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_HANDLE, nullptr, FIELD_OFFSET(Leaf, h), 0,
+     true},
+};
+const struct MojomTypeDescriptorStruct kLeafDesc = {1, kLeafVersions, 1,
+                                                    kLeafEntries};
+
+const struct MojomTypeDescriptorArray kLeafArrayDesc = {
+    MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR, &kLeafDesc, 0, 64, true};
+const struct MojomTypeDescriptorArray kInt32ArrayDesc = {
+    MOJOM_TYPE_DESCRIPTOR_TYPE_POD, nullptr, 0, 32, false};
+const struct MojomTypeDescriptorArray kHandleArrayDesc = {
+    MOJOM_TYPE_DESCRIPTOR_TYPE_HANDLE, nullptr, 0, 32, true};
+const struct MojomTypeDescriptorArray kStringArrayDesc = {
+    MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR, &g_mojom_string_type_description, 0,
+    64, false};
+
+extern const struct MojomTypeDescriptorUnion kUnionDesc;
+const struct MojomTypeDescriptorUnionEntry kUnionEntries[] = {
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_POD, nullptr, 0, false},
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR, &kLeafDesc, 1, false},
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR, &kInt32ArrayDesc, 2, false},
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_UNION_PTR, &kUnionDesc, 3, true},
+};
+const struct MojomTypeDescriptorUnion kUnionDesc = {4, 4, kUnionEntries};
+
+const struct MojomTypeDescriptorArray kUnionArrayDesc = {
+    MOJOM_TYPE_DESCRIPTOR_TYPE_UNION, &kUnionDesc, 0, 128, true};
+
+struct MojomTypeDescriptorStructVersion kMapVersions[] = {{0, sizeof(Map)}};
+const struct MojomTypeDescriptorStructEntry kMapEntries[] = {
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR, &kStringArrayDesc,
+     FIELD_OFFSET(Map, keys), 0, false},
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR, &kLeafArrayDesc,
+     FIELD_OFFSET(Map, values), 0, false},
+};
+const struct MojomTypeDescriptorStruct kMapDesc = {1, kMapVersions, 2,
+                                                   kMapEntries};
+
+extern const struct MojomTypeDescriptorStruct kOuterDesc;
+struct MojomTypeDescriptorStructVersion kOuterVersions[] = {
+    {0, offsetof(Outer, v1_leaf)}, {1, sizeof(Outer)}};
+const struct MojomTypeDescriptorStructEntry kOuterEntries[] = {
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR, &kLeafDesc,
+     FIELD_OFFSET(Outer, leaf), 0, true},
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR, &kLeafArrayDesc,
+     FIELD_OFFSET(Outer, leaves), 0, true},
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_UNION, &kUnionDesc, FIELD_OFFSET(Outer, u), 0,
+     true},
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_MAP_PTR, &kMapDesc, FIELD_OFFSET(Outer, map),
+     0, true},
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR, &kOuterDesc,
+     FIELD_OFFSET(Outer, next), 0, true},
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR, &kHandleArrayDesc,
+     FIELD_OFFSET(Outer, handles), 0, true},
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR, &kUnionArrayDesc,
+     FIELD_OFFSET(Outer, unions), 0, true},
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR, &kLeafDesc,
+     FIELD_OFFSET(Outer, v1_leaf), 1, true},
+};
+const struct MojomTypeDescriptorStruct kOuterDesc = {2, kOuterVersions, 8,
+                                                     kOuterEntries};
+
+// A struct that is compiled to a shallow program.
+struct Shallow {
+  struct MojomStructHeader header;
+  union MojomPointer leaf;
+  union MojomPointer name;
+  union MojomPointer handles;
+  MojoHandle h;
+  uint32_t pad;
+};
+
+struct MojomTypeDescriptorStructVersion kShallowVersions[] = {
+    {0, sizeof(Shallow)}};
+const struct MojomTypeDescriptorStructEntry kShallowEntries[] = {
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR, &kLeafDesc,
+     FIELD_OFFSET(Shallow, leaf), 0, false},
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR, &g_mojom_string_type_description,
+     FIELD_OFFSET(Shallow, name), 0, false},
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_ARRAY_PTR, &kHandleArrayDesc,
+     FIELD_OFFSET(Shallow, handles), 0, true},
+    {MOJOM_TYPE_DESCRIPTOR_TYPE_HANDLE, nullptr, FIELD_OFFSET(Shallow, h), 0,
+     false},
+};
+const struct MojomTypeDescriptorStruct kShallowDesc = {1, kShallowVersions, 4,
+                                                       kShallowEntries};
+
+template <typename T>
+T* Allocate(struct MojomBuffer* buf) {
+  T* t = static_cast<T*>(MojomBuffer_Allocate(buf, sizeof(T)));
+  memset(t, 0, sizeof(T));
+  t->header.num_bytes = sizeof(T);
+  return t;
+}
+
+Leaf* NewLeaf(struct MojomBuffer* buf, int32_t x, MojoHandle h) {
+  Leaf* leaf = Allocate<Leaf>(buf);
+  leaf->x = x;
+  leaf->h = h;
+  return leaf;
+}
+
+Outer* NewOuter(struct MojomBuffer* buf) {
+  Outer* outer = static_cast<Outer*>(
+      MojomBuffer_Allocate(buf, offsetof(Outer, v1_leaf)));
+  memset(outer, 0, offsetof(Outer, v1_leaf));
+  outer->header.num_bytes = offsetof(Outer, v1_leaf);
+  return outer;
+}
+
+struct MojomArrayHeader* NewLeafArray(struct MojomBuffer* buf,
+                                      uint32_t num_leaves,
+                                      MojoHandle first_handle) {
+  struct MojomArrayHeader* arr =
+      MojomArray_New(buf, num_leaves, sizeof(union MojomPointer));
+  for (uint32_t i = 0; i < num_leaves; i++) {
+    MOJOM_ARRAY_INDEX(arr, union MojomPointer, i)->ptr = NewLeaf(
+        buf, i, first_handle ? first_handle + i : MOJO_HANDLE_INVALID);
+  }
+  return arr;
+}
+
+struct MojomArrayHeader* NewInt32Array(struct MojomBuffer* buf,
+                                       uint32_t num_elements) {
+  struct MojomArrayHeader* arr =
+      MojomArray_New(buf, num_elements, sizeof(int32_t));
+  for (uint32_t i = 0; i < num_elements; i++)
+    *MOJOM_ARRAY_INDEX(arr, int32_t, i) = i;
+  return arr;
+}
+
+// Builds an |Outer| that uses every field, with handles numbered from 100.
+Outer* MakeOuter(struct MojomBuffer* buf) {
+  Outer* outer = Allocate<Outer>(buf);
+  outer->header.version = 1;
+
+  outer->leaf.ptr = NewLeaf(buf, 1, 100);
+  outer->leaves.ptr = NewLeafArray(buf, 3, 0);
+  MOJOM_ARRAY_INDEX((struct MojomArrayHeader*)outer->leaves.ptr,
+                    union MojomPointer, 1)->ptr = nullptr;
+
+  // |u| points to another union, which holds a struct.
+  struct MojomUnionLayout* inner = static_cast<struct MojomUnionLayout*>(
+      MojomBuffer_Allocate(buf, sizeof(struct MojomUnionLayout)));
+  inner->size = sizeof(struct MojomUnionLayout);
+  inner->tag = 1;
+  inner->data.pointer.ptr = NewLeaf(buf, 2, 101);
+  outer->u.size = sizeof(struct MojomUnionLayout);
+  outer->u.tag = 3;
+  outer->u.data.pointer.ptr = inner;
+
+  Map* map = Allocate<Map>(buf);
+  struct MojomArrayHeader* keys =
+      MojomArray_New(buf, 2, sizeof(union MojomPointer));
+  for (uint32_t i = 0; i < 2; i++) {
+    struct MojomArrayHeader* key = MojomArray_New(buf, 3, 1);
+    memcpy(MOJOM_ARRAY_INDEX(key, char, 0), i ? "two" : "one", 3);
+    MOJOM_ARRAY_INDEX(keys, union MojomPointer, i)->ptr = key;
+  }
+  map->keys.ptr = keys;
+  map->values.ptr = NewLeafArray(buf, 2, 102);
+  outer->map.ptr = map;
+
+  Outer* next = NewOuter(buf);
+  next->u.size = sizeof(struct MojomUnionLayout);
+  next->u.tag = 2;
+  next->u.data.pointer.ptr = NewInt32Array(buf, 5);
+  outer->next.ptr = next;
+
+  struct MojomArrayHeader* handles =
+      MojomArray_New(buf, 3, sizeof(MojoHandle));
+  *MOJOM_ARRAY_INDEX(handles, MojoHandle, 0) = 104;
+  *MOJOM_ARRAY_INDEX(handles, MojoHandle, 1) = MOJO_HANDLE_INVALID;
+  *MOJOM_ARRAY_INDEX(handles, MojoHandle, 2) = 105;
+  outer->handles.ptr = handles;
+
+  struct MojomArrayHeader* unions =
+      MojomArray_New(buf, 3, sizeof(struct MojomUnionLayout));
+  struct MojomUnionLayout* u0 =
+      MOJOM_ARRAY_INDEX(unions, struct MojomUnionLayout, 0);
+  u0->size = sizeof(struct MojomUnionLayout);
+  u0->tag = 0;
+  u0->data.force_size_ = 7;
+  // Element 1 is a null union.
+  struct MojomUnionLayout* u2 =
+      MOJOM_ARRAY_INDEX(unions, struct MojomUnionLayout, 2);
+  u2->size = sizeof(struct MojomUnionLayout);
+  u2->tag = 2;
+  u2->data.pointer.ptr = NewInt32Array(buf, 3);
+  outer->unions.ptr = unions;
+
+  outer->v1_leaf.ptr = NewLeaf(buf, 3, 106);
+  return outer;
+}
+
+const uint32_t kNumHandles = 7;
+
+// Owns the compiled program for |kOuterDesc|.
+class TypeProgramTest : public testing::Test {
+ public:
+  TypeProgramTest() : program_(nullptr) {}
+
+  void SetUp() override {
+    struct MojomBuffer buf = {program_bytes_, sizeof(program_bytes_), 0};
+    program_ = MojomTypeProgram_CompileStruct(&kOuterDesc, &buf);
+    ASSERT_TRUE(program_);
+  }
+
+ protected:
+  // Deep copies |in_struct| into |buf| using the recursive dispatch, to get a
+  // linear copy of it.
+  Outer* Linearize(Outer* in_struct, struct MojomBuffer* buf) {
+    struct MojomStructHeader* out = nullptr;
+    EXPECT_TRUE(
+        MojomStruct_DeepCopy(buf, &kOuterDesc, &in_struct->header, &out));
+    return reinterpret_cast<Outer*>(out);
+  }
+
+  const struct MojomTypeProgram* program_;
+
+ private:
+  alignas(8) char program_bytes_[4096];
+};
+
+TEST_F(TypeProgramTest, Compile) {
+  // Outer, Leaf, array<Leaf>, U, Map, array<handle>, array<U>, array<int32>,
+  // array<string> and string; |next| reuses Outer's program.
+  size_t num_programs = 0;
+  for (const struct MojomTypeProgram* p = program_; p; p = p->next)
+    num_programs++;
+  EXPECT_EQ(10u, num_programs);
+
+  EXPECT_EQ(MOJOM_TYPE_DESCRIPTOR_TYPE_STRUCT_PTR, program_->type);
+  EXPECT_EQ(8u, program_->num_ops);
+  EXPECT_EQ(program_, program_->ops[4].target);
+  EXPECT_EQ(MOJOM_TYPE_DESCRIPTOR_TYPE_MAP_PTR, program_->ops[3].target->type);
+  EXPECT_EQ(offsetof(Outer, v1_leaf), program_->ops[7].offset);
+  EXPECT_EQ(1u, program_->ops[7].key);
+
+  // Leaf, array<Leaf> and array<string> only lead to handles or POD, so are
+  // visited without the interpreter's stack. Structs with unions and maps
+  // aren't.
+  EXPECT_TRUE(program_->ops[0].target->is_shallow);
+  EXPECT_TRUE(program_->ops[1].target->is_shallow);
+  EXPECT_TRUE(program_->ops[3].target->ops[0].target->is_shallow);
+  EXPECT_FALSE(program_->is_shallow);
+  EXPECT_FALSE(program_->ops[3].target->is_shallow);
+
+  // Arrays of POD have no ops.
+  const struct MojomTypeProgram* int_array =
+      program_->ops[2].target->ops[2].target;
+  EXPECT_EQ(&kInt32ArrayDesc, int_array->type_desc);
+  EXPECT_EQ(0u, int_array->num_ops);
+
+  // Too small a buffer fails.
+  char bytes[64];
+  struct MojomBuffer small_buf = {bytes, sizeof(bytes), 0};
+  EXPECT_FALSE(MojomTypeProgram_CompileStruct(&kOuterDesc, &small_buf));
+}
+
+TEST_F(TypeProgramTest, MatchesDispatch) {
+  alignas(8) char bytes[4096] = {0};
+  struct MojomBuffer buf = {bytes, sizeof(bytes), 0};
+  Outer* outer = MakeOuter(&buf);
+
+  EXPECT_EQ(MojomStruct_ComputeSerializedSize(&kOuterDesc, &outer->header),
+            MojomTypeProgram_ComputeSerializedSize(program_, &outer->header));
+
+  // Deep copies are identical.
+  alignas(8) char bytes1[4096] = {0};
+  alignas(8) char bytes2[4096] = {0};
+  struct MojomBuffer buf1 = {bytes1, sizeof(bytes1), 0};
+  struct MojomBuffer buf2 = {bytes2, sizeof(bytes2), 0};
+  Outer* copy1 = Linearize(outer, &buf1);
+  struct MojomStructHeader* copy2 = nullptr;
+  ASSERT_TRUE(
+      MojomTypeProgram_DeepCopy(&buf2, program_, &outer->header, &copy2));
+  ASSERT_EQ(buf1.num_bytes_used, buf2.num_bytes_used);
+  EXPECT_EQ(buf1.num_bytes_used,
+            MojomTypeProgram_ComputeSerializedSize(program_, copy2));
+
+  // Encoding yields the same bytes and handles.
+  MojoHandle handles1[kNumHandles];
+  MojoHandle handles2[kNumHandles];
+  struct MojomHandleBuffer handle_buf1 = {handles1, kNumHandles, 0};
+  struct MojomHandleBuffer handle_buf2 = {handles2, kNumHandles, 0};
+  MojomStruct_EncodePointersAndHandles(&kOuterDesc, &copy1->header,
+                                       buf1.num_bytes_used, &handle_buf1);
+  MojomTypeProgram_EncodePointersAndHandles(program_, copy2,
+                                            buf2.num_bytes_used, &handle_buf2);
+  EXPECT_EQ(kNumHandles, handle_buf1.num_handles_used);
+  ASSERT_EQ(handle_buf1.num_handles_used, handle_buf2.num_handles_used);
+  EXPECT_EQ(0, memcmp(handles1, handles2, sizeof(handles1)));
+  EXPECT_EQ(0, memcmp(bytes1, bytes2, buf1.num_bytes_used));
+
+  // Both accept the encoded message.
+  struct MojomValidationContext context1 = {0, nullptr};
+  struct MojomValidationContext context2 = {0, nullptr};
+  EXPECT_EQ(MOJOM_VALIDATION_ERROR_NONE,
+            MojomStruct_Validate(&kOuterDesc, &copy1->header,
+                                 buf1.num_bytes_used, kNumHandles, &context1));
+  EXPECT_EQ(MOJOM_VALIDATION_ERROR_NONE,
+            MojomTypeProgram_Validate(program_, copy2, buf2.num_bytes_used,
+                                      kNumHandles, &context2));
+  EXPECT_EQ(context1.next_handle_index, context2.next_handle_index);
+  EXPECT_EQ(context1.next_pointer - bytes1, context2.next_pointer - bytes2);
+
+  // Decoding restores the original (unencoded) message.
+  MojomStruct_DecodePointersAndHandles(&kOuterDesc, &copy1->header,
+                                       buf1.num_bytes_used, handles1,
+                                       kNumHandles);
+  MojomTypeProgram_DecodePointersAndHandles(program_, copy2,
+                                            buf2.num_bytes_used, handles2,
+                                            kNumHandles);
+  EXPECT_EQ(0, memcmp(handles1, handles2, sizeof(handles1)));
+  handle_buf1.num_handles_used = 0;
+  handle_buf2.num_handles_used = 0;
+  MojomStruct_EncodePointersAndHandles(&kOuterDesc, &copy1->header,
+                                       buf1.num_bytes_used, &handle_buf1);
+  MojomStruct_EncodePointersAndHandles(&kOuterDesc, copy2,
+                                       buf2.num_bytes_used, &handle_buf2);
+  EXPECT_EQ(0, memcmp(bytes1, bytes2, buf1.num_bytes_used));
+}
+
+TEST_F(TypeProgramTest, ValidationErrors) {
+  alignas(8) char bytes[4096] = {0};
+  struct MojomBuffer buf = {bytes, sizeof(bytes), 0};
+  Outer* outer = MakeOuter(&buf);
+
+  alignas(8) char encoded[4096];
+  struct MojomBuffer encoded_buf = {encoded, sizeof(encoded), 0};
+  Outer* copy = Linearize(outer, &encoded_buf);
+  MojoHandle handles[kNumHandles];
+  struct MojomHandleBuffer handle_buf = {handles, kNumHandles, 0};
+  MojomStruct_EncodePointersAndHandles(&kOuterDesc, &copy->header,
+                                       encoded_buf.num_bytes_used, &handle_buf);
+  const uint32_t size = encoded_buf.num_bytes_used;
+
+  // Each corruption is applied to a fresh copy of |encoded|.
+  struct {
+    void (*corrupt)(Outer* outer);
+    MojomValidationResult expected;
+  } cases[] = {
+      {[](Outer* o) { o->leaf.offset = 1u << 20; },
+       MOJOM_VALIDATION_ILLEGAL_POINTER},
+      {[](Outer* o) { o->leaf.offset += 4; },
+       MOJOM_VALIDATION_MISALIGNED_OBJECT},
+      {[](Outer* o) {
+         reinterpret_cast<Leaf*>((char*)&o->leaf + o->leaf.offset)->h = 99;
+       },
+       MOJOM_VALIDATION_ILLEGAL_HANDLE},
+      {[](Outer* o) { o->header.num_bytes = offsetof(Outer, v1_leaf); },
+       MOJOM_VALIDATION_UNEXPECTED_STRUCT_HEADER},
+      {[](Outer* o) {
+         Map* map = reinterpret_cast<Map*>((char*)&o->map + o->map.offset);
+         reinterpret_cast<struct MojomArrayHeader*>(
+             (char*)&map->values + map->values.offset)->num_elements = 1;
+       },
+       MOJOM_VALIDATION_DIFFERENT_SIZED_ARRAYS_IN_MAP},
+      {[](Outer* o) {
+         struct MojomUnionLayout* inner =
+             reinterpret_cast<struct MojomUnionLayout*>(
+                 (char*)&o->u.data + o->u.data.pointer.offset);
+         inner->data.pointer.offset = 0;
+       },
+       MOJOM_VALIDATION_UNEXPECTED_NULL_POINTER},
+      {[](Outer* o) {
+         Outer* next = reinterpret_cast<Outer*>((char*)&o->next +
+                                                o->next.offset);
+         next->u.size = 8;
+       },
+       MOJOM_VALIDATION_ERROR_NONE},
+  };
+
+  for (size_t i = 0; i < MOJO_ARRAYSIZE(cases); i++) {
+    alignas(8) char bytes1[4096];
+    alignas(8) char bytes2[4096];
+    memcpy(bytes1, encoded, size);
+    memcpy(bytes2, encoded, size);
+    cases[i].corrupt(reinterpret_cast<Outer*>(bytes1));
+    cases[i].corrupt(reinterpret_cast<Outer*>(bytes2));
+
+    struct MojomValidationContext context1 = {0, nullptr};
+    struct MojomValidationContext context2 = {0, nullptr};
+    MojomValidationResult expected = MojomStruct_Validate(
+        &kOuterDesc, reinterpret_cast<struct MojomStructHeader*>(bytes1), size,
+        kNumHandles, &context1);
+    EXPECT_EQ(cases[i].expected, expected) << i;
+    EXPECT_EQ(expected,
+              MojomTypeProgram_Validate(
+                  program_, reinterpret_cast<struct MojomStructHeader*>(bytes2),
+                  size, kNumHandles, &context2))
+        << i;
+  }
+}
+
+// Structs that only lead to handles are visited without the interpreter's
+// stack.
+TEST_F(TypeProgramTest, Shallow) {
+  alignas(8) char program_bytes[512];
+  struct MojomBuffer program_buf = {program_bytes, sizeof(program_bytes), 0};
+  const struct MojomTypeProgram* program =
+      MojomTypeProgram_CompileStruct(&kShallowDesc, &program_buf);
+  ASSERT_TRUE(program);
+  EXPECT_TRUE(program->is_shallow);
+
+  alignas(8) char bytes[1024] = {0};
+  struct MojomBuffer buf = {bytes, sizeof(bytes), 0};
+  Shallow* shallow = Allocate<Shallow>(&buf);
+  shallow->leaf.ptr = NewLeaf(&buf, 1, 200);
+  struct MojomArrayHeader* name = MojomArray_New(&buf, 4, 1);
+  memcpy(MOJOM_ARRAY_INDEX(name, char, 0), "name", 4);
+  shallow->name.ptr = name;
+  struct MojomArrayHeader* handles =
+      MojomArray_New(&buf, 2, sizeof(MojoHandle));
+  *MOJOM_ARRAY_INDEX(handles, MojoHandle, 0) = MOJO_HANDLE_INVALID;
+  *MOJOM_ARRAY_INDEX(handles, MojoHandle, 1) = 210;
+  shallow->handles.ptr = handles;
+  shallow->h = 211;
+
+  EXPECT_EQ(MojomStruct_ComputeSerializedSize(&kShallowDesc, &shallow->header),
+            MojomTypeProgram_ComputeSerializedSize(program, &shallow->header));
+
+  alignas(8) char bytes1[sizeof(bytes)] = {0};
+  alignas(8) char bytes2[sizeof(bytes)] = {0};
+  struct MojomBuffer buf1 = {bytes1, sizeof(bytes1), 0};
+  struct MojomBuffer buf2 = {bytes2, sizeof(bytes2), 0};
+  struct MojomStructHeader* copy1 = nullptr;
+  struct MojomStructHeader* copy2 = nullptr;
+  ASSERT_TRUE(
+      MojomStruct_DeepCopy(&buf1, &kShallowDesc, &shallow->header, &copy1));
+  ASSERT_TRUE(
+      MojomTypeProgram_DeepCopy(&buf2, program, &shallow->header, &copy2));
+  ASSERT_EQ(buf1.num_bytes_used, buf2.num_bytes_used);
+
+  MojoHandle handles1[8];
+  MojoHandle handles2[8];
+  struct MojomHandleBuffer handle_buf1 = {handles1, 8, 0};
+  struct MojomHandleBuffer handle_buf2 = {handles2, 8, 0};
+  MojomStruct_EncodePointersAndHandles(&kShallowDesc, copy1,
+                                       buf1.num_bytes_used, &handle_buf1);
+  MojomTypeProgram_EncodePointersAndHandles(program, copy2,
+                                            buf2.num_bytes_used, &handle_buf2);
+  ASSERT_EQ(handle_buf1.num_handles_used, handle_buf2.num_handles_used);
+  EXPECT_EQ(0, memcmp(handles1, handles2,
+                      handle_buf1.num_handles_used * sizeof(MojoHandle)));
+  EXPECT_EQ(0, memcmp(bytes1, bytes2, buf1.num_bytes_used));
+
+  struct MojomValidationContext context = {0, nullptr};
+  EXPECT_EQ(MOJOM_VALIDATION_ERROR_NONE,
+            MojomTypeProgram_Validate(program, copy2, buf2.num_bytes_used,
+                                      handle_buf2.num_handles_used, &context));
+  EXPECT_EQ(bytes2 + buf2.num_bytes_used, context.next_pointer);
+  context = {0, nullptr};
+  EXPECT_EQ(MOJOM_VALIDATION_ILLEGAL_HANDLE,
+            MojomTypeProgram_Validate(program, copy2, buf2.num_bytes_used, 1,
+                                      &context));
+
+  MojomTypeProgram_DecodePointersAndHandles(program, copy2,
+                                            buf2.num_bytes_used, handles2,
+                                            handle_buf2.num_handles_used);
+  EXPECT_EQ(MojomStruct_ComputeSerializedSize(&kShallowDesc, &shallow->header),
+            MojomTypeProgram_ComputeSerializedSize(program, copy2));
+  EXPECT_EQ(211u, reinterpret_cast<Shallow*>(copy2)->h);
+}
+
+// Structs nested deeper than MOJOM_TYPE_PROGRAM_MAX_DEPTH are handed off to the
+// recursive dispatch.
+TEST_F(TypeProgramTest, DeepNesting) {
+  const size_t kDepth = MOJOM_TYPE_PROGRAM_MAX_DEPTH * 2;
+  alignas(8) char bytes[kDepth * (sizeof(Outer) + 32)] = {0};
+  struct MojomBuffer buf = {bytes, sizeof(bytes), 0};
+  Outer* head = NewOuter(&buf);
+  Outer* tail = head;
+  for (size_t i = 1; i < kDepth; i++) {
+    Outer* next = NewOuter(&buf);
+    next->leaf.ptr = NewLeaf(&buf, i, MOJO_HANDLE_INVALID);
+    tail->next.ptr = next;
+    tail = next;
+  }
+
+  EXPECT_EQ(MojomStruct_ComputeSerializedSize(&kOuterDesc, &head->header),
+            MojomTypeProgram_ComputeSerializedSize(program_, &head->header));
+
+  alignas(8) char bytes1[sizeof(bytes)] = {0};
+  alignas(8) char bytes2[sizeof(bytes)] = {0};
+  struct MojomBuffer buf1 = {bytes1, sizeof(bytes1), 0};
+  struct MojomBuffer buf2 = {bytes2, sizeof(bytes2), 0};
+  Outer* copy1 = Linearize(head, &buf1);
+  struct MojomStructHeader* copy2 = nullptr;
+  ASSERT_TRUE(
+      MojomTypeProgram_DeepCopy(&buf2, program_, &head->header, &copy2));
+  ASSERT_EQ(buf1.num_bytes_used, buf2.num_bytes_used);
+
+  // None of the handles are valid, but the handle buffer must exist.
+  MojoHandle handles[1];
+  struct MojomHandleBuffer handle_buf = {handles, 1, 0};
+  MojomStruct_EncodePointersAndHandles(&kOuterDesc, &copy1->header,
+                                       buf1.num_bytes_used, &handle_buf);
+  MojomTypeProgram_EncodePointersAndHandles(program_, copy2,
+                                            buf2.num_bytes_used, &handle_buf);
+  EXPECT_EQ(0u, handle_buf.num_handles_used);
+  EXPECT_EQ(0, memcmp(bytes1, bytes2, buf1.num_bytes_used));
+
+  struct MojomValidationContext context = {0, nullptr};
+  EXPECT_EQ(MOJOM_VALIDATION_ERROR_NONE,
+            MojomTypeProgram_Validate(program_, copy2, buf2.num_bytes_used, 0,
+                                      &context));
+
+  MojomTypeProgram_DecodePointersAndHandles(program_, copy2,
+                                            buf2.num_bytes_used, handles, 0);
+  EXPECT_EQ(MojomStruct_ComputeSerializedSize(&kOuterDesc, &head->header),
+            MojomTypeProgram_ComputeSerializedSize(program_, copy2));
+}
+
+}  // namespace
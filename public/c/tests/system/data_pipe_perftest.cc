@@ -0,0 +1,358 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This tests the performance of data pipes via the C API.
+
+#include <mojo/system/data_pipe.h>
+
+#include <assert.h>
+#include <mojo/macros.h>
+#include <mojo/result.h>
+#include <mojo/system/handle.h>
+#include <mojo/system/wait.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <thread>
+#include <vector>
+
+#include "mojo/public/c/tests/system/perftest_utils.h"
+#include "third_party/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Each iteration writes and then reads (in some way) this many bytes, through a
+// data pipe with four times this capacity.
+constexpr uint32_t kChunkNumBytes = 4096u;
+constexpr char kSubTestName[] = "4096bytes";
+
+void CreateDataPipe(MojoHandle* hp, MojoHandle* hc) {
+  const MojoCreateDataPipeOptions options = {
+      static_cast<uint32_t>(
+          sizeof(MojoCreateDataPipeOptions)),   // |struct_size|.
+      MOJO_CREATE_DATA_PIPE_OPTIONS_FLAG_NONE,  // |flags|.
+      1u,                                       // |element_num_bytes|.
+      4u * kChunkNumBytes                       // |capacity_num_bytes|.
+  };
+  MojoResult result = MojoCreateDataPipe(&options, hp, hc);
+  MOJO_ALLOW_UNUSED_LOCAL(result);
+  assert(result == MOJO_RESULT_OK);
+}
+
+void ClosePair(MojoHandle h0, MojoHandle h1) {
+  MojoResult result = MojoClose(h0);
+  MOJO_ALLOW_UNUSED_LOCAL(result);
+  assert(result == MOJO_RESULT_OK);
+  result = MojoClose(h1);
+  assert(result == MOJO_RESULT_OK);
+}
+
+void WriteChunk(MojoHandle hp, const char* buffer, MojoWriteDataFlags flags) {
+  uint32_t num_bytes = kChunkNumBytes;
+  MojoResult result = MojoWriteData(hp, buffer, &num_bytes, flags);
+  MOJO_ALLOW_UNUSED_LOCAL(result);
+  assert(result == MOJO_RESULT_OK);
+  assert(num_bytes == kChunkNumBytes);
+}
+
+void ReadChunk(MojoHandle hc, char* buffer, MojoReadDataFlags flags) {
+  uint32_t num_bytes = kChunkNumBytes;
+  MojoResult result = MojoReadData(hc, buffer, &num_bytes, flags);
+  MOJO_ALLOW_UNUSED_LOCAL(result);
+  assert(result == MOJO_RESULT_OK);
+  assert(num_bytes == kChunkNumBytes);
+}
+
+TEST(DataPipePerftest, WriteAndRead) {
+  MojoHandle hp;
+  MojoHandle hc;
+  CreateDataPipe(&hp, &hc);
+  char buffer[kChunkNumBytes] = {};
+  mojo::test::IterateAndReportPerf(
+      "DataPipe_WriteAndRead", kSubTestName, [hp, hc, &buffer]() {
+        WriteChunk(hp, buffer, MOJO_WRITE_DATA_FLAG_NONE);
+        ReadChunk(hc, buffer, MOJO_READ_DATA_FLAG_NONE);
+      });
+  mojo::test::IterateAndReportPerf(
+      "DataPipe_WriteAndReadAllOrNone", kSubTestName, [hp, hc, &buffer]() {
+        WriteChunk(hp, buffer, MOJO_WRITE_DATA_FLAG_ALL_OR_NONE);
+        ReadChunk(hc, buffer, MOJO_READ_DATA_FLAG_ALL_OR_NONE);
+      });
+  ClosePair(hp, hc);
+}
+
+TEST(DataPipePerftest, WriteQueryAndRead) {
+  MojoHandle hp;
+  MojoHandle hc;
+  CreateDataPipe(&hp, &hc);
+  char buffer[kChunkNumBytes] = {};
+  mojo::test::IterateAndReportPerf(
+      "DataPipe_WriteQueryAndRead", kSubTestName, [hp, hc, &buffer]() {
+        WriteChunk(hp, buffer, MOJO_WRITE_DATA_FLAG_NONE);
+        uint32_t num_bytes = 0u;
+        MojoResult result =
+            MojoReadData(hc, nullptr, &num_bytes, MOJO_READ_DATA_FLAG_QUERY);
+        MOJO_ALLOW_UNUSED_LOCAL(result);
+        assert(result == MOJO_RESULT_OK);
+        assert(num_bytes == kChunkNumBytes);
+        ReadChunk(hc, buffer, MOJO_READ_DATA_FLAG_NONE);
+      });
+  ClosePair(hp, hc);
+}
+
+TEST(DataPipePerftest, WritePeekAndDiscard) {
+  MojoHandle hp;
+  MojoHandle hc;
+  CreateDataPipe(&hp, &hc);
+  char buffer[kChunkNumBytes] = {};
+  // This is how a consumer might parse a header before deciding what to do with
+  // the rest.
+  mojo::test::IterateAndReportPerf(
+      "DataPipe_WritePeekAndDiscard", kSubTestName, [hp, hc, &buffer]() {
+        WriteChunk(hp, buffer, MOJO_WRITE_DATA_FLAG_NONE);
+        uint32_t num_bytes = 16u;
+        MojoResult result =
+            MojoReadData(hc, buffer, &num_bytes, MOJO_READ_DATA_FLAG_PEEK);
+        MOJO_ALLOW_UNUSED_LOCAL(result);
+        assert(result == MOJO_RESULT_OK);
+        ReadChunk(hc, nullptr, MOJO_READ_DATA_FLAG_DISCARD);
+      });
+  ClosePair(hp, hc);
+}
+
+TEST(DataPipePerftest, TwoPhaseWriteAndRead) {
+  MojoHandle hp;
+  MojoHandle hc;
+  CreateDataPipe(&hp, &hc);
+  char buffer[kChunkNumBytes] = {};
+  MojoWriteDataFlags write_flags = MOJO_WRITE_DATA_FLAG_NONE;
+  MojoReadDataFlags read_flags = MOJO_READ_DATA_FLAG_NONE;
+  // Each iteration moves |kChunkNumBytes| bytes, in (at most) two two-phase
+  // writes and reads.
+  auto single_iteration = [hp, hc, &buffer, &write_flags, &read_flags]() {
+    for (uint32_t num_bytes_written = 0u; num_bytes_written < kChunkNumBytes;) {
+      void* write_pointer = nullptr;
+      uint32_t num_bytes = kChunkNumBytes - num_bytes_written;
+      MojoResult result =
+          MojoBeginWriteData(hp, &write_pointer, &num_bytes, write_flags);
+      MOJO_ALLOW_UNUSED_LOCAL(result);
+      assert(result == MOJO_RESULT_OK);
+      if (num_bytes > kChunkNumBytes - num_bytes_written)
+        num_bytes = kChunkNumBytes - num_bytes_written;
+      memcpy(write_pointer, buffer, num_bytes);
+      result = MojoEndWriteData(hp, num_bytes);
+      assert(result == MOJO_RESULT_OK);
+      num_bytes_written += num_bytes;
+    }
+    for (uint32_t num_bytes_read = 0u; num_bytes_read < kChunkNumBytes;) {
+      const void* read_pointer = nullptr;
+      uint32_t num_bytes = kChunkNumBytes - num_bytes_read;
+      MojoResult result =
+          MojoBeginReadData(hc, &read_pointer, &num_bytes, read_flags);
+      MOJO_ALLOW_UNUSED_LOCAL(result);
+      assert(result == MOJO_RESULT_OK);
+      if (num_bytes > kChunkNumBytes - num_bytes_read)
+        num_bytes = kChunkNumBytes - num_bytes_read;
+      memcpy(buffer, read_pointer, num_bytes);
+      result = MojoEndReadData(hc, num_bytes);
+      assert(result == MOJO_RESULT_OK);
+      num_bytes_read += num_bytes;
+    }
+  };
+  mojo::test::IterateAndReportPerf("DataPipe_TwoPhaseWriteAndRead",
+                                   kSubTestName, single_iteration);
+  write_flags = MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES;
+  read_flags = MOJO_READ_DATA_FLAG_MAX_NUM_BYTES;
+  mojo::test::IterateAndReportPerf("DataPipe_TwoPhaseWriteAndReadMaxNumBytes",
+                                   kSubTestName, single_iteration);
+  ClosePair(hp, hc);
+}
+
+// Throughput, for various data pipe and chunk sizes ---------------------------
+
+// How data is moved through the data pipe: with |MojoWriteData()| and
+// |MojoReadData()|, or with two-phase writes and reads. (In the latter case,
+// the data is still copied into and out of the data pipe's buffer, as a
+// producer generating it or a consumer parsing it in place would touch it.)
+enum class IoMode { COPY, TWO_PHASE };
+
+struct ThroughputConfig {
+  uint32_t element_num_bytes;
+  uint32_t capacity_num_bytes;
+  // The amount written and read in each iteration.
+  uint32_t chunk_num_bytes;
+};
+
+const ThroughputConfig kCapacityThroughputConfigs[] = {
+    {1u, 4u * 1024u, 1024u},
+    {1u, 64u * 1024u, 16u * 1024u},
+    {1u, 1024u * 1024u, 256u * 1024u},
+    {1u, 16u * 1024u * 1024u, 4u * 1024u * 1024u},
+};
+
+const ThroughputConfig kChunkAndElementThroughputConfigs[] = {
+    {1u, 1024u * 1024u, 64u},
+    {1u, 1024u * 1024u, 1024u},
+    {1u, 1024u * 1024u, 16u * 1024u},
+    {1u, 1024u * 1024u, 1024u * 1024u},
+    {4u, 64u * 1024u, 16u * 1024u},
+    {16u, 64u * 1024u, 16u * 1024u},
+    {64u, 64u * 1024u, 16u * 1024u},
+};
+
+// Writes |num_bytes| bytes (a multiple of the element size), waiting for space
+// as necessary. Returns false if the consumer was closed.
+bool WriteAll(MojoHandle hp,
+              IoMode mode,
+              const char* bytes,
+              uint32_t num_bytes) {
+  while (num_bytes) {
+    uint32_t num_bytes_written = num_bytes;
+    MojoResult result;
+    if (mode == IoMode::COPY) {
+      result = MojoWriteData(hp, bytes, &num_bytes_written,
+                             MOJO_WRITE_DATA_FLAG_NONE);
+    } else {
+      void* write_pointer = nullptr;
+      result = MojoBeginWriteData(hp, &write_pointer, &num_bytes_written,
+                                  MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES);
+      if (result == MOJO_RESULT_OK) {
+        memcpy(write_pointer, bytes, num_bytes_written);
+        result = MojoEndWriteData(hp, num_bytes_written);
+      }
+    }
+    if (result == MOJO_RESULT_OK) {
+      bytes += num_bytes_written;
+      num_bytes -= num_bytes_written;
+      continue;
+    }
+
+    if (result == MOJO_RESULT_SHOULD_WAIT) {
+      result = MojoWait(hp, MOJO_HANDLE_SIGNAL_WRITABLE,
+                        MOJO_DEADLINE_INDEFINITE, nullptr);
+      if (result == MOJO_RESULT_OK)
+        continue;
+    }
+    assert(result == MOJO_RESULT_FAILED_PRECONDITION);
+    return false;
+  }
+  return true;
+}
+
+// Reads |num_bytes| bytes (a multiple of the element size), waiting for data as
+// necessary. Returns false if the producer was closed.
+bool ReadAll(MojoHandle hc, IoMode mode, char* bytes, uint32_t num_bytes) {
+  while (num_bytes) {
+    uint32_t num_bytes_read = num_bytes;
+    MojoResult result;
+    if (mode == IoMode::COPY) {
+      result =
+          MojoReadData(hc, bytes, &num_bytes_read, MOJO_READ_DATA_FLAG_NONE);
+    } else {
+      const void* read_pointer = nullptr;
+      result = MojoBeginReadData(hc, &read_pointer, &num_bytes_read,
+                                 MOJO_READ_DATA_FLAG_MAX_NUM_BYTES);
+      if (result == MOJO_RESULT_OK) {
+        memcpy(bytes, read_pointer, num_bytes_read);
+        result = MojoEndReadData(hc, num_bytes_read);
+      }
+    }
+    if (result == MOJO_RESULT_OK) {
+      bytes += num_bytes_read;
+      num_bytes -= num_bytes_read;
+      continue;
+    }
+
+    if (result == MOJO_RESULT_SHOULD_WAIT) {
+      result = MojoWait(hc, MOJO_HANDLE_SIGNAL_READABLE,
+                        MOJO_DEADLINE_INDEFINITE, nullptr);
+      if (result == MOJO_RESULT_OK)
+        continue;
+    }
+    assert(result == MOJO_RESULT_FAILED_PRECONDITION);
+    return false;
+  }
+  return true;
+}
+
+// Reports the throughput of writing and reading chunks, either alternately on
+// this thread or with a producer thread that writes as fast as this thread
+// reads.
+void DoThroughputTest(const ThroughputConfig& config,
+                      IoMode mode,
+                      bool threaded) {
+  const MojoCreateDataPipeOptions options = {
+      static_cast<uint32_t>(
+          sizeof(MojoCreateDataPipeOptions)),   // |struct_size|.
+      MOJO_CREATE_DATA_PIPE_OPTIONS_FLAG_NONE,  // |flags|.
+      config.element_num_bytes,                 // |element_num_bytes|.
+      config.capacity_num_bytes                 // |capacity_num_bytes|.
+  };
+  MojoHandle hp;
+  MojoHandle hc;
+  MojoResult result = MojoCreateDataPipe(&options, &hp, &hc);
+  MOJO_ALLOW_UNUSED_LOCAL(result);
+  assert(result == MOJO_RESULT_OK);
+
+  const uint32_t chunk_num_bytes = config.chunk_num_bytes;
+  std::vector<char> source(chunk_num_bytes, 'x');
+  std::vector<char> sink(chunk_num_bytes);
+
+  std::thread producer;
+  if (threaded) {
+    producer = std::thread([hp, mode, chunk_num_bytes, &source]() {
+      // Write until |hc| is closed.
+      while (WriteAll(hp, mode, source.data(), chunk_num_bytes)) {
+      }
+    });
+  }
+
+  char test_name[100];
+  snprintf(test_name, sizeof(test_name), "DataPipe_Throughput_%s_%s",
+           threaded ? "Threaded" : "SameThread",
+           mode == IoMode::COPY ? "Copy" : "TwoPhase");
+  char sub_test_name[100];
+  snprintf(sub_test_name, sizeof(sub_test_name),
+           "element%u_capacity%u_chunk%u",
+           static_cast<unsigned>(config.element_num_bytes),
+           static_cast<unsigned>(config.capacity_num_bytes),
+           static_cast<unsigned>(chunk_num_bytes));
+  mojo::test::IterateAndReportPerf(
+      test_name, sub_test_name, chunk_num_bytes,
+      [hp, hc, mode, threaded, chunk_num_bytes, &source, &sink]() {
+        bool ok = threaded ||
+                  WriteAll(hp, mode, source.data(), chunk_num_bytes);
+        ok = ok && ReadAll(hc, mode, sink.data(), chunk_num_bytes);
+        MOJO_ALLOW_UNUSED_LOCAL(ok);
+        assert(ok);
+      });
+
+  result = MojoClose(hc);
+  assert(result == MOJO_RESULT_OK);
+  if (threaded)
+    producer.join();
+  result = MojoClose(hp);
+  assert(result == MOJO_RESULT_OK);
+}
+
+TEST(DataPipePerftest, SameThreadThroughput) {
+  for (const auto& config : kCapacityThroughputConfigs) {
+    DoThroughputTest(config, IoMode::COPY, false);
+    DoThroughputTest(config, IoMode::TWO_PHASE, false);
+  }
+  for (const auto& config : kChunkAndElementThroughputConfigs) {
+    DoThroughputTest(config, IoMode::COPY, false);
+    DoThroughputTest(config, IoMode::TWO_PHASE, false);
+  }
+}
+
+TEST(DataPipePerftest, ThreadedThroughput) {
+  for (const auto& config : kCapacityThroughputConfigs) {
+    DoThroughputTest(config, IoMode::COPY, true);
+    DoThroughputTest(config, IoMode::TWO_PHASE, true);
+  }
+}
+
+}  // namespace
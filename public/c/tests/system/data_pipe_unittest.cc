@@ -440,6 +440,449 @@ TEST(DataPipeTest, ReadThreshold) {
   EXPECT_EQ(MOJO_RESULT_OK, MojoClose(hc));
 }
 
+TEST(DataPipeTest, AllOrNone) {
+  const MojoCreateDataPipeOptions options = {
+      static_cast<uint32_t>(
+          sizeof(MojoCreateDataPipeOptions)),   // |struct_size|.
+      MOJO_CREATE_DATA_PIPE_OPTIONS_FLAG_NONE,  // |flags|.
+      1u,                                       // |element_num_bytes|.
+      10u                                       // |capacity_num_bytes|.
+  };
+  MojoHandle hp = MOJO_HANDLE_INVALID;
+  MojoHandle hc = MOJO_HANDLE_INVALID;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoCreateDataPipe(&options, &hp, &hc));
+
+  // Writing more than the capacity shouldn't write anything.
+  static const char kData[] = "0123456789abcdef";
+  uint32_t num_bytes = 11u;
+  EXPECT_EQ(MOJO_RESULT_OUT_OF_RANGE,
+            MojoWriteData(hp, kData, &num_bytes,
+                          MOJO_WRITE_DATA_FLAG_ALL_OR_NONE));
+  num_bytes = 6u;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoWriteData(hp, kData, &num_bytes,
+                                          MOJO_WRITE_DATA_FLAG_ALL_OR_NONE));
+  EXPECT_EQ(6u, num_bytes);
+
+  // There's only space for 4 more bytes.
+  num_bytes = 5u;
+  EXPECT_EQ(MOJO_RESULT_OUT_OF_RANGE,
+            MojoWriteData(hp, kData + 6, &num_bytes,
+                          MOJO_WRITE_DATA_FLAG_ALL_OR_NONE));
+  num_bytes = 4u;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoWriteData(hp, kData + 6, &num_bytes,
+                                          MOJO_WRITE_DATA_FLAG_ALL_OR_NONE));
+  EXPECT_EQ(4u, num_bytes);
+
+  // There are only 10 bytes to read.
+  char buffer[20] = {};
+  num_bytes = 11u;
+  EXPECT_EQ(MOJO_RESULT_OUT_OF_RANGE,
+            MojoReadData(hc, buffer, &num_bytes,
+                         MOJO_READ_DATA_FLAG_ALL_OR_NONE));
+  num_bytes = 3u;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoReadData(hc, buffer, &num_bytes,
+                                         MOJO_READ_DATA_FLAG_ALL_OR_NONE));
+  EXPECT_EQ(3u, num_bytes);
+  EXPECT_EQ(0, memcmp(buffer, "012", 3u));
+
+  // Likewise for discarding.
+  num_bytes = 8u;
+  EXPECT_EQ(MOJO_RESULT_OUT_OF_RANGE,
+            MojoReadData(hc, nullptr, &num_bytes,
+                         MOJO_READ_DATA_FLAG_DISCARD |
+                             MOJO_READ_DATA_FLAG_ALL_OR_NONE));
+  num_bytes = 2u;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoReadData(hc, nullptr, &num_bytes,
+                                         MOJO_READ_DATA_FLAG_DISCARD |
+                                             MOJO_READ_DATA_FLAG_ALL_OR_NONE));
+  EXPECT_EQ(2u, num_bytes);
+
+  // Once the producer is closed, there'll never be enough data.
+  EXPECT_EQ(MOJO_RESULT_OK, MojoClose(hp));
+  num_bytes = 6u;
+  EXPECT_EQ(MOJO_RESULT_FAILED_PRECONDITION,
+            MojoReadData(hc, buffer, &num_bytes,
+                         MOJO_READ_DATA_FLAG_ALL_OR_NONE));
+  num_bytes = 5u;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoReadData(hc, buffer, &num_bytes,
+                                         MOJO_READ_DATA_FLAG_ALL_OR_NONE));
+  EXPECT_EQ(5u, num_bytes);
+  EXPECT_EQ(0, memcmp(buffer, "56789", 5u));
+
+  EXPECT_EQ(MOJO_RESULT_OK, MojoClose(hc));
+}
+
+TEST(DataPipeTest, DiscardQueryAndPeek) {
+  const MojoCreateDataPipeOptions options = {
+      static_cast<uint32_t>(
+          sizeof(MojoCreateDataPipeOptions)),   // |struct_size|.
+      MOJO_CREATE_DATA_PIPE_OPTIONS_FLAG_NONE,  // |flags|.
+      2u,                                       // |element_num_bytes|.
+      20u                                       // |capacity_num_bytes|.
+  };
+  MojoHandle hp = MOJO_HANDLE_INVALID;
+  MojoHandle hc = MOJO_HANDLE_INVALID;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoCreateDataPipe(&options, &hp, &hc));
+
+  // Invalid combinations of flags.
+  char buffer[20] = {};
+  uint32_t num_bytes = 2u;
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoReadData(hc, nullptr, &num_bytes,
+                         MOJO_READ_DATA_FLAG_DISCARD |
+                             MOJO_READ_DATA_FLAG_QUERY));
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoReadData(hc, buffer, &num_bytes,
+                         MOJO_READ_DATA_FLAG_DISCARD |
+                             MOJO_READ_DATA_FLAG_PEEK));
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoReadData(hc, buffer, &num_bytes,
+                         MOJO_READ_DATA_FLAG_QUERY | MOJO_READ_DATA_FLAG_PEEK));
+
+  // Query an empty data pipe.
+  num_bytes = 123u;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoReadData(hc, nullptr, &num_bytes,
+                                         MOJO_READ_DATA_FLAG_QUERY));
+  EXPECT_EQ(0u, num_bytes);
+
+  static const char kData[] = "abcdefghijkl";
+  num_bytes = 12u;
+  EXPECT_EQ(MOJO_RESULT_OK,
+            MojoWriteData(hp, kData, &num_bytes, MOJO_WRITE_DATA_FLAG_NONE));
+  EXPECT_EQ(12u, num_bytes);
+
+  num_bytes = 0u;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoReadData(hc, nullptr, &num_bytes,
+                                         MOJO_READ_DATA_FLAG_QUERY));
+  EXPECT_EQ(12u, num_bytes);
+
+  // Peeking must still be in whole elements.
+  num_bytes = 3u;
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoReadData(hc, buffer, &num_bytes, MOJO_READ_DATA_FLAG_PEEK));
+
+  // Peek (twice), which leaves the data in place.
+  for (int i = 0; i < 2; i++) {
+    memset(buffer, 0, sizeof(buffer));
+    num_bytes = 4u;
+    EXPECT_EQ(MOJO_RESULT_OK,
+              MojoReadData(hc, buffer, &num_bytes, MOJO_READ_DATA_FLAG_PEEK));
+    EXPECT_EQ(4u, num_bytes);
+    EXPECT_EQ(0, memcmp(buffer, "abcd", 4u));
+  }
+  num_bytes = 16u;
+  EXPECT_EQ(MOJO_RESULT_OUT_OF_RANGE,
+            MojoReadData(hc, buffer, &num_bytes,
+                         MOJO_READ_DATA_FLAG_PEEK |
+                             MOJO_READ_DATA_FLAG_ALL_OR_NONE));
+  num_bytes = 0u;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoReadData(hc, nullptr, &num_bytes,
+                                         MOJO_READ_DATA_FLAG_QUERY));
+  EXPECT_EQ(12u, num_bytes);
+
+  // Discard (up to) 6 bytes.
+  num_bytes = 6u;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoReadData(hc, nullptr, &num_bytes,
+                                         MOJO_READ_DATA_FLAG_DISCARD));
+  EXPECT_EQ(6u, num_bytes);
+  num_bytes = 0u;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoReadData(hc, nullptr, &num_bytes,
+                                         MOJO_READ_DATA_FLAG_QUERY));
+  EXPECT_EQ(6u, num_bytes);
+
+  // Read the rest.
+  memset(buffer, 0, sizeof(buffer));
+  num_bytes = 20u;
+  EXPECT_EQ(MOJO_RESULT_OK,
+            MojoReadData(hc, buffer, &num_bytes, MOJO_READ_DATA_FLAG_NONE));
+  EXPECT_EQ(6u, num_bytes);
+  EXPECT_STREQ("ghijkl", buffer);
+
+  // Discarding from an empty data pipe should fail as reading would.
+  num_bytes = 2u;
+  EXPECT_EQ(MOJO_RESULT_SHOULD_WAIT,
+            MojoReadData(hc, nullptr, &num_bytes, MOJO_READ_DATA_FLAG_DISCARD));
+
+  EXPECT_EQ(MOJO_RESULT_OK, MojoClose(hp));
+  EXPECT_EQ(MOJO_RESULT_FAILED_PRECONDITION,
+            MojoReadData(hc, nullptr, &num_bytes, MOJO_READ_DATA_FLAG_DISCARD));
+  num_bytes = 123u;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoReadData(hc, nullptr, &num_bytes,
+                                         MOJO_READ_DATA_FLAG_QUERY));
+  EXPECT_EQ(0u, num_bytes);
+
+  EXPECT_EQ(MOJO_RESULT_OK, MojoClose(hc));
+}
+
+TEST(DataPipeTest, TwoPhaseMaxNumBytes) {
+  const MojoCreateDataPipeOptions options = {
+      static_cast<uint32_t>(
+          sizeof(MojoCreateDataPipeOptions)),   // |struct_size|.
+      MOJO_CREATE_DATA_PIPE_OPTIONS_FLAG_NONE,  // |flags|.
+      2u,                                       // |element_num_bytes|.
+      100u                                      // |capacity_num_bytes|.
+  };
+  MojoHandle hp = MOJO_HANDLE_INVALID;
+  MojoHandle hc = MOJO_HANDLE_INVALID;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoCreateDataPipe(&options, &hp, &hc));
+
+  // The maximum must be a nonzero multiple of the element size.
+  void* write_pointer = nullptr;
+  uint32_t buffer_size = 0u;
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoBeginWriteData(hp, &write_pointer, &buffer_size,
+                               MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES));
+  buffer_size = 3u;
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoBeginWriteData(hp, &write_pointer, &buffer_size,
+                               MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES));
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoBeginWriteData(hp, &write_pointer, &buffer_size,
+                               MOJO_WRITE_DATA_FLAG_ALL_OR_NONE));
+
+  buffer_size = 10u;
+  ASSERT_EQ(MOJO_RESULT_OK,
+            MojoBeginWriteData(hp, &write_pointer, &buffer_size,
+                               MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES));
+  EXPECT_EQ(10u, buffer_size);
+  memcpy(write_pointer, "0123456789", 10u);
+  EXPECT_EQ(MOJO_RESULT_OK, MojoEndWriteData(hp, 10u));
+
+  // A maximum larger than what's available doesn't matter.
+  buffer_size = 1000u;
+  ASSERT_EQ(MOJO_RESULT_OK,
+            MojoBeginWriteData(hp, &write_pointer, &buffer_size,
+                               MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES));
+  EXPECT_GE(buffer_size, 2u);
+  EXPECT_LE(buffer_size, 90u);
+  memcpy(write_pointer, "ab", 2u);
+  EXPECT_EQ(MOJO_RESULT_OK, MojoEndWriteData(hp, 2u));
+
+  const void* read_pointer = nullptr;
+  buffer_size = 0u;
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoBeginReadData(hc, &read_pointer, &buffer_size,
+                              MOJO_READ_DATA_FLAG_MAX_NUM_BYTES));
+  buffer_size = 5u;
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoBeginReadData(hc, &read_pointer, &buffer_size,
+                              MOJO_READ_DATA_FLAG_MAX_NUM_BYTES));
+  buffer_size = 4u;
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoBeginReadData(hc, &read_pointer, &buffer_size,
+                              MOJO_READ_DATA_FLAG_PEEK));
+
+  buffer_size = 4u;
+  ASSERT_EQ(MOJO_RESULT_OK,
+            MojoBeginReadData(hc, &read_pointer, &buffer_size,
+                              MOJO_READ_DATA_FLAG_MAX_NUM_BYTES));
+  EXPECT_EQ(4u, buffer_size);
+  EXPECT_EQ(0, memcmp(read_pointer, "0123", 4u));
+  EXPECT_EQ(MOJO_RESULT_OK, MojoEndReadData(hc, 4u));
+
+  buffer_size = 1000u;
+  ASSERT_EQ(MOJO_RESULT_OK,
+            MojoBeginReadData(hc, &read_pointer, &buffer_size,
+                              MOJO_READ_DATA_FLAG_MAX_NUM_BYTES));
+  EXPECT_EQ(8u, buffer_size);
+  EXPECT_EQ(0, memcmp(read_pointer, "456789ab", 8u));
+  EXPECT_EQ(MOJO_RESULT_OK, MojoEndReadData(hc, 8u));
+
+  EXPECT_EQ(MOJO_RESULT_OK, MojoClose(hp));
+  EXPECT_EQ(MOJO_RESULT_OK, MojoClose(hc));
+}
+
+TEST(DataPipeTest, UnsupportedFlags) {
+  MojoHandle hp = MOJO_HANDLE_INVALID;
+  MojoHandle hc = MOJO_HANDLE_INVALID;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoCreateDataPipe(nullptr, &hp, &hc));
+
+  // Unknown flags are unimplemented.
+  static const char kData[] = "abcd";
+  char buffer[20] = {};
+  uint32_t num_bytes = 4u;
+  EXPECT_EQ(MOJO_RESULT_UNIMPLEMENTED,
+            MojoWriteData(hp, kData, &num_bytes, ~MOJO_WRITE_DATA_FLAG_NONE));
+  EXPECT_EQ(MOJO_RESULT_UNIMPLEMENTED,
+            MojoReadData(hc, buffer, &num_bytes, ~MOJO_READ_DATA_FLAG_NONE));
+  const MojoWriteDataSegment write_segment = {kData, 4u};
+  EXPECT_EQ(MOJO_RESULT_UNIMPLEMENTED,
+            MojoWriteDataV(hp, &write_segment, 1u, &num_bytes,
+                           ~MOJO_WRITE_DATA_FLAG_NONE));
+  const MojoReadDataSegment read_segment = {buffer, 4u};
+  EXPECT_EQ(MOJO_RESULT_UNIMPLEMENTED,
+            MojoReadDataV(hc, &read_segment, 1u, &num_bytes,
+                          ~MOJO_READ_DATA_FLAG_NONE));
+
+  // The "max num bytes" flags only apply to two-phase writes and reads.
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoWriteData(hp, kData, &num_bytes,
+                          MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES));
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoReadData(hc, buffer, &num_bytes,
+                         MOJO_READ_DATA_FLAG_MAX_NUM_BYTES));
+
+  // Nothing was written.
+  num_bytes = 123u;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoReadData(hc, nullptr, &num_bytes,
+                                         MOJO_READ_DATA_FLAG_QUERY));
+  EXPECT_EQ(0u, num_bytes);
+
+  EXPECT_EQ(MOJO_RESULT_OK, MojoClose(hp));
+  EXPECT_EQ(MOJO_RESULT_OK, MojoClose(hc));
+}
+
+TEST(DataPipeTest, NullNumBytes) {
+  MojoHandle hp = MOJO_HANDLE_INVALID;
+  MojoHandle hc = MOJO_HANDLE_INVALID;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoCreateDataPipe(nullptr, &hp, &hc));
+
+  static const char kData[] = "abcd";
+  char buffer[20] = {};
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoWriteData(hp, kData, nullptr, MOJO_WRITE_DATA_FLAG_NONE));
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoReadData(hc, buffer, nullptr, MOJO_READ_DATA_FLAG_NONE));
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoReadData(hc, nullptr, nullptr, MOJO_READ_DATA_FLAG_QUERY));
+  const MojoWriteDataSegment write_segment = {kData, 4u};
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoWriteDataV(hp, &write_segment, 1u, nullptr,
+                           MOJO_WRITE_DATA_FLAG_NONE));
+  const MojoReadDataSegment read_segment = {buffer, 4u};
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoReadDataV(hc, &read_segment, 1u, nullptr,
+                          MOJO_READ_DATA_FLAG_NONE));
+
+  // Nothing was written.
+  uint32_t num_bytes = 123u;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoReadData(hc, nullptr, &num_bytes,
+                                         MOJO_READ_DATA_FLAG_QUERY));
+  EXPECT_EQ(0u, num_bytes);
+
+  EXPECT_EQ(MOJO_RESULT_OK, MojoClose(hp));
+  EXPECT_EQ(MOJO_RESULT_OK, MojoClose(hc));
+}
+
+TEST(DataPipeTest, WriteDataVAndReadDataV) {
+  const MojoCreateDataPipeOptions options = {
+      static_cast<uint32_t>(
+          sizeof(MojoCreateDataPipeOptions)),   // |struct_size|.
+      MOJO_CREATE_DATA_PIPE_OPTIONS_FLAG_NONE,  // |flags|.
+      1u,                                       // |element_num_bytes|.
+      10u                                       // |capacity_num_bytes|.
+  };
+  MojoHandle hp = MOJO_HANDLE_INVALID;
+  MojoHandle hc = MOJO_HANDLE_INVALID;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoCreateDataPipe(&options, &hp, &hc));
+
+  uint32_t num_bytes = 0u;
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoWriteDataV(MOJO_HANDLE_INVALID, nullptr, 0u, &num_bytes,
+                           MOJO_WRITE_DATA_FLAG_NONE));
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoReadDataV(MOJO_HANDLE_INVALID, nullptr, 0u, &num_bytes,
+                          MOJO_READ_DATA_FLAG_NONE));
+
+  // Invalid segments.
+  static const char kData[] = "0123456789abcdef";
+  char buffer[20] = {};
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoWriteDataV(hp, nullptr, 1u, &num_bytes,
+                           MOJO_WRITE_DATA_FLAG_NONE));
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoReadDataV(hc, nullptr, 1u, &num_bytes,
+                          MOJO_READ_DATA_FLAG_NONE));
+  const MojoWriteDataSegment null_write_segment = {nullptr, 1u};
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoWriteDataV(hp, &null_write_segment, 1u, &num_bytes,
+                           MOJO_WRITE_DATA_FLAG_NONE));
+  const MojoReadDataSegment null_read_segment = {nullptr, 1u};
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoReadDataV(hc, &null_read_segment, 1u, &num_bytes,
+                          MOJO_READ_DATA_FLAG_NONE));
+
+  // A total size that overflows is invalid.
+  const MojoWriteDataSegment huge_write_segments[] = {
+      {kData, 0x80000000u}, {kData, 0x80000000u},
+  };
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoWriteDataV(hp, huge_write_segments, 2u, &num_bytes,
+                           MOJO_WRITE_DATA_FLAG_NONE));
+  const MojoReadDataSegment huge_read_segments[] = {
+      {buffer, 0x80000000u}, {buffer, 0x80000000u},
+  };
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoReadDataV(hc, huge_read_segments, 2u, &num_bytes,
+                          MOJO_READ_DATA_FLAG_NONE));
+
+  // Discarding and querying aren't supported.
+  const MojoReadDataSegment read_segment = {buffer, 2u};
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoReadDataV(hc, &read_segment, 1u, &num_bytes,
+                          MOJO_READ_DATA_FLAG_DISCARD));
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoReadDataV(hc, &read_segment, 1u, &num_bytes,
+                          MOJO_READ_DATA_FLAG_QUERY));
+
+  // Move the read/write position along, so that the next write wraps around.
+  num_bytes = 6u;
+  EXPECT_EQ(MOJO_RESULT_OK,
+            MojoWriteData(hp, kData, &num_bytes, MOJO_WRITE_DATA_FLAG_NONE));
+  EXPECT_EQ(6u, num_bytes);
+  EXPECT_EQ(MOJO_RESULT_OK,
+            MojoReadData(hc, buffer, &num_bytes, MOJO_READ_DATA_FLAG_NONE));
+  EXPECT_EQ(6u, num_bytes);
+
+  // The segments (including empty ones) are concatenated.
+  const MojoWriteDataSegment write_segments[] = {
+      {"abc", 3u}, {nullptr, 0u}, {"defgh", 5u},
+  };
+  EXPECT_EQ(MOJO_RESULT_OK, MojoWriteDataV(hp, write_segments, 3u, &num_bytes,
+                                           MOJO_WRITE_DATA_FLAG_NONE));
+  EXPECT_EQ(8u, num_bytes);
+
+  // There's only space for 2 more bytes.
+  const MojoWriteDataSegment more_write_segments[] = {{"i", 1u}, {"jk", 2u}};
+  EXPECT_EQ(MOJO_RESULT_OUT_OF_RANGE,
+            MojoWriteDataV(hp, more_write_segments, 2u, &num_bytes,
+                           MOJO_WRITE_DATA_FLAG_ALL_OR_NONE));
+  EXPECT_EQ(MOJO_RESULT_OK,
+            MojoWriteDataV(hp, more_write_segments, 2u, &num_bytes,
+                           MOJO_WRITE_DATA_FLAG_NONE));
+  EXPECT_EQ(2u, num_bytes);
+
+  // Peek, which leaves the data in place.
+  memset(buffer, 0, sizeof(buffer));
+  const MojoReadDataSegment peek_segments[] = {{buffer, 4u},
+                                               {buffer + 10, 3u}};
+  EXPECT_EQ(MOJO_RESULT_OK, MojoReadDataV(hc, peek_segments, 2u, &num_bytes,
+                                          MOJO_READ_DATA_FLAG_PEEK));
+  EXPECT_EQ(7u, num_bytes);
+  EXPECT_EQ(0, memcmp(buffer, "abcd", 4u));
+  EXPECT_EQ(0, memcmp(buffer + 10, "efg", 3u));
+
+  // There are only 10 bytes to read.
+  const MojoReadDataSegment read_segments[] = {
+      {buffer, 4u}, {nullptr, 0u}, {buffer + 4, 7u},
+  };
+  EXPECT_EQ(MOJO_RESULT_OUT_OF_RANGE,
+            MojoReadDataV(hc, read_segments, 3u, &num_bytes,
+                          MOJO_READ_DATA_FLAG_ALL_OR_NONE));
+  memset(buffer, 0, sizeof(buffer));
+  EXPECT_EQ(MOJO_RESULT_OK, MojoReadDataV(hc, read_segments, 3u, &num_bytes,
+                                          MOJO_READ_DATA_FLAG_NONE));
+  EXPECT_EQ(10u, num_bytes);
+  EXPECT_STREQ("abcdefghij", buffer);
+
+  EXPECT_EQ(MOJO_RESULT_SHOULD_WAIT,
+            MojoReadDataV(hc, read_segments, 3u, &num_bytes,
+                          MOJO_READ_DATA_FLAG_NONE));
+
+  EXPECT_EQ(MOJO_RESULT_OK, MojoClose(hp));
+  EXPECT_EQ(MOJO_RESULT_OK, MojoClose(hc));
+}
+
 // TODO(vtl): Add multi-threaded tests.
 
 }  // namespace
@@ -91,6 +91,82 @@ TEST(MessagePipePerftest, EmptyRead) {
   assert(result == MOJO_RESULT_OK);
 }
 
+// Reads a message from |h| into |buffer|, waiting for one if necessary.
+// Returns the result of the read (or of the wait, if that failed).
+MojoResult ReadMessageWaitingIfNecessary(MojoHandle h,
+                                         char* buffer,
+                                         uint32_t* num_bytes) {
+  const uint32_t buffer_size = *num_bytes;
+  for (;;) {
+    MojoResult result = MojoReadMessage(h, buffer, num_bytes, nullptr, nullptr,
+                                        MOJO_READ_MESSAGE_FLAG_NONE);
+    if (result != MOJO_RESULT_SHOULD_WAIT)
+      return result;
+    result = MojoWait(h, MOJO_HANDLE_SIGNAL_READABLE, MOJO_DEADLINE_INDEFINITE,
+                      nullptr);
+    if (result != MOJO_RESULT_OK)
+      return result;
+    *num_bytes = buffer_size;
+  }
+}
+
+// Measures round trips between two threads: each iteration writes a message,
+// which the other thread echoes back, and waits for the reply.
+TEST(MessagePipePerftest, PingPong) {
+  MojoHandle h0;
+  MojoHandle h1;
+  MojoResult result = MojoCreateMessagePipe(nullptr, &h0, &h1);
+  MOJO_ALLOW_UNUSED_LOCAL(result);
+  assert(result == MOJO_RESULT_OK);
+
+  std::thread echoer([h1]() {
+    char buffer[10000];
+    for (;;) {
+      uint32_t num_bytes = static_cast<uint32_t>(sizeof(buffer));
+      MojoResult result = ReadMessageWaitingIfNecessary(h1, buffer, &num_bytes);
+      if (result != MOJO_RESULT_OK) {
+        // |h0| was closed.
+        assert(result == MOJO_RESULT_FAILED_PRECONDITION);
+        break;
+      }
+      result = MojoWriteMessage(h1, buffer, num_bytes, nullptr, 0u,
+                                MOJO_WRITE_MESSAGE_FLAG_NONE);
+      assert(result == MOJO_RESULT_OK);
+    }
+  });
+
+  char buffer[10000] = {};
+  uint32_t num_bytes = 0u;
+  auto single_iteration = [&h0, &buffer, &num_bytes]() {
+    MojoResult result = MojoWriteMessage(h0, buffer, num_bytes, nullptr, 0u,
+                                         MOJO_WRITE_MESSAGE_FLAG_NONE);
+    MOJO_ALLOW_UNUSED_LOCAL(result);
+    assert(result == MOJO_RESULT_OK);
+    uint32_t read_bytes = static_cast<uint32_t>(sizeof(buffer));
+    result = ReadMessageWaitingIfNecessary(h0, buffer, &read_bytes);
+    assert(result == MOJO_RESULT_OK);
+    assert(read_bytes == num_bytes);
+  };
+  num_bytes = 10u;
+  mojo::test::IterateAndReportPerf("MessagePipe_PingPong", "10bytes",
+                                   single_iteration);
+  num_bytes = 100u;
+  mojo::test::IterateAndReportPerf("MessagePipe_PingPong", "100bytes",
+                                   single_iteration);
+  num_bytes = 1000u;
+  mojo::test::IterateAndReportPerf("MessagePipe_PingPong", "1000bytes",
+                                   single_iteration);
+  num_bytes = 10000u;
+  mojo::test::IterateAndReportPerf("MessagePipe_PingPong", "10000bytes",
+                                   single_iteration);
+
+  result = MojoClose(h0);
+  assert(result == MOJO_RESULT_OK);
+  echoer.join();
+  result = MojoClose(h1);
+  assert(result == MOJO_RESULT_OK);
+}
+
 void DoMessagePipeThreadedTest(unsigned num_writers,
                                unsigned num_readers,
                                uint32_t num_bytes) {
@@ -167,6 +167,62 @@ TEST(MessagePipeTest, ChecksTransferRight) {
   EXPECT_EQ(MOJO_RESULT_OK, MojoClose(h_not_transferrable));
 }
 
+TEST(MessagePipeTest, WriteMessageV) {
+  MojoHandle h0 = MOJO_HANDLE_INVALID;
+  MojoHandle h1 = MOJO_HANDLE_INVALID;
+  EXPECT_EQ(MOJO_RESULT_OK, MojoCreateMessagePipe(nullptr, &h0, &h1));
+
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoWriteMessageV(MOJO_HANDLE_INVALID, nullptr, 0u, nullptr, 0u,
+                              MOJO_WRITE_MESSAGE_FLAG_NONE));
+
+  // The segments (including empty ones) are concatenated.
+  static const char kHello[] = "hello";
+  static const char kWorld[] = " world";
+  const MojoMessageSegment segments[] = {
+      {kHello, static_cast<uint32_t>(sizeof(kHello) - 1u)},
+      {nullptr, 0u},
+      {kWorld, static_cast<uint32_t>(sizeof(kWorld))},
+  };
+  EXPECT_EQ(MOJO_RESULT_OK,
+            MojoWriteMessageV(h0, segments, 3u, nullptr, 0u,
+                              MOJO_WRITE_MESSAGE_FLAG_NONE));
+  char buffer[20] = {};
+  uint32_t buffer_size = static_cast<uint32_t>(sizeof(buffer));
+  EXPECT_EQ(MOJO_RESULT_OK,
+            MojoWait(h1, MOJO_HANDLE_SIGNAL_READABLE, MOJO_DEADLINE_INDEFINITE,
+                     nullptr));
+  EXPECT_EQ(MOJO_RESULT_OK,
+            MojoReadMessage(h1, buffer, &buffer_size, nullptr, nullptr,
+                            MOJO_READ_MESSAGE_FLAG_NONE));
+  EXPECT_EQ(static_cast<uint32_t>(sizeof(kHello) - 1u + sizeof(kWorld)),
+            buffer_size);
+  EXPECT_STREQ("hello world", buffer);
+
+  // No segments: an empty message.
+  EXPECT_EQ(MOJO_RESULT_OK, MojoWriteMessageV(h0, nullptr, 0u, nullptr, 0u,
+                                              MOJO_WRITE_MESSAGE_FLAG_NONE));
+  buffer_size = static_cast<uint32_t>(sizeof(buffer));
+  EXPECT_EQ(MOJO_RESULT_OK,
+            MojoWait(h1, MOJO_HANDLE_SIGNAL_READABLE, MOJO_DEADLINE_INDEFINITE,
+                     nullptr));
+  EXPECT_EQ(MOJO_RESULT_OK,
+            MojoReadMessage(h1, buffer, &buffer_size, nullptr, nullptr,
+                            MOJO_READ_MESSAGE_FLAG_NONE));
+  EXPECT_EQ(0u, buffer_size);
+
+  // A total size that overflows is invalid.
+  const MojoMessageSegment huge_segments[] = {
+      {kHello, 0x80000000u}, {kWorld, 0x80000000u},
+  };
+  EXPECT_EQ(MOJO_RESULT_INVALID_ARGUMENT,
+            MojoWriteMessageV(h0, huge_segments, 2u, nullptr, 0u,
+                              MOJO_WRITE_MESSAGE_FLAG_NONE));
+
+  EXPECT_EQ(MOJO_RESULT_OK, MojoClose(h0));
+  EXPECT_EQ(MOJO_RESULT_OK, MojoClose(h1));
+}
+
 // TODO(vtl): Add multi-threaded tests.
 
 }  // namespace
@@ -15,11 +15,11 @@
 namespace mojo {
 namespace test {
 
-// Iterates the given function for |kPerftestTimeMicroseconds| and reports the
+namespace {
+
+// Iterates the given function for |kPerftestTimeMicroseconds| and returns the
 // number of iterations executed per second.
-void IterateAndReportPerf(const char* test_name,
-                          const char* sub_test_name,
-                          std::function<void()> single_iteration) {
+double IterateForPerf(std::function<void()> single_iteration) {
   // TODO(vtl): These should be specifiable using command-line flags.
   static constexpr size_t kGranularity = 100u;
 
@@ -34,11 +34,28 @@ void IterateAndReportPerf(const char* test_name,
     end_time = MojoGetTimeTicksNow();
   } while (end_time - start_time < kPerftestTimeMicroseconds);
 
-  LogPerfResult(test_name, sub_test_name,
-                1000000.0 * iterations / (end_time - start_time),
+  return 1000000.0 * iterations / (end_time - start_time);
+}
+
+}  // namespace
+
+void IterateAndReportPerf(const char* test_name,
+                          const char* sub_test_name,
+                          std::function<void()> single_iteration) {
+  LogPerfResult(test_name, sub_test_name, IterateForPerf(single_iteration),
                 "iterations/second");
 }
 
+void IterateAndReportPerf(const char* test_name,
+                          const char* sub_test_name,
+                          size_t num_bytes_per_iteration,
+                          std::function<void()> single_iteration) {
+  LogPerfResult(test_name, sub_test_name,
+                IterateForPerf(single_iteration) * num_bytes_per_iteration /
+                    (1024.0 * 1024.0),
+                "MB/second");
+}
+
 void Sleep(MojoTimeTicks microseconds) {
   struct timespec req = {
       static_cast<time_t>(microseconds / 1000000),       // Seconds.
@@ -6,6 +6,7 @@
 #define MOJO_PUBLIC_C_TESTS_SYSTEM_PERFTEST_UTILS_H_
 
 #include <mojo/system/time.h>
+#include <stddef.h>
 
 #include <functional>
 
@@ -21,6 +22,14 @@ void IterateAndReportPerf(const char* test_name,
                           const char* sub_test_name,
                           std::function<void()> single_iteration);
 
+// Like the above, but for iterations that each transfer
+// |num_bytes_per_iteration| bytes, reporting the throughput (in megabytes per
+// second) instead.
+void IterateAndReportPerf(const char* test_name,
+                          const char* sub_test_name,
+                          size_t num_bytes_per_iteration,
+                          std::function<void()> single_iteration);
+
 // Sleeps for the given amount of time (in microseconds).
 void Sleep(MojoTimeTicks microseconds);
 
@@ -0,0 +1,95 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MOJO_PUBLIC_CPP_BINDINGS_ARRAY_DATA_VIEW_H_
+#define MOJO_PUBLIC_CPP_BINDINGS_ARRAY_DATA_VIEW_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <type_traits>
+
+#include "mojo/public/cpp/bindings/lib/array_internal.h"
+#include "mojo/public/cpp/bindings/lib/bindings_internal.h"
+
+namespace mojo {
+namespace internal {
+
+// Maps the element type of an |ArrayDataView| to the element type of the
+// serialized array, and converts serialized elements to views.
+//
+// Views of objects (strings, arrays, maps, structs and unions) have a |Data_|
+// type and can be constructed from a |const Data_*|. Unions are stored inline
+// in arrays; everything else is stored as a pointer.
+template <typename T, typename Enable = void>
+struct DataViewTraits {
+  using ViewData = typename T::Data_;
+  static const bool kIsUnion = IsUnionDataType<ViewData>::value;
+  using Data =
+      typename std::conditional<kIsUnion, ViewData, ViewData*>::type;
+
+  static T ToView(const ViewData* data) { return T(data); }
+  static T ToView(const ViewData& data) { return T(&data); }
+};
+
+template <typename T>
+struct DataViewTraits<
+    T,
+    typename std::enable_if<std::is_arithmetic<T>::value>::type> {
+  using Data = T;
+
+  static T ToView(T data) { return data; }
+};
+
+template <typename T>
+struct DataViewTraits<T,
+                      typename std::enable_if<std::is_enum<T>::value>::type> {
+  using Data = int32_t;
+
+  static T ToView(int32_t data) { return static_cast<T>(data); }
+};
+
+}  // namespace internal
+
+// A read-only view of a serialized (and validated) array, which can be null.
+// Like the other data views, it doesn't own (or copy) any data, so it is only
+// valid as long as the message (or buffer) it points into.
+//
+// |T| is the "view" type of the elements: a POD type, an enum, or another
+// data view type (e.g., |StringDataView| or a generated |FooDataView|).
+template <typename T>
+class ArrayDataView {
+ public:
+  using Data_ =
+      internal::Array_Data<typename internal::DataViewTraits<T>::Data>;
+
+  ArrayDataView() : data_(nullptr) {}
+  explicit ArrayDataView(const Data_* data) : data_(data) {}
+
+  bool is_null() const { return !data_; }
+
+  // The following are only valid if |!is_null()|.
+  size_t size() const { return data_->size(); }
+
+  T operator[](size_t offset) const {
+    return internal::DataViewTraits<T>::ToView(data_->at(offset));
+  }
+
+  // Returns the elements in place. Only available for arrays of numeric types
+  // other than bool (which are packed).
+  const T* data() const {
+    static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+                  "ArrayDataView::data() requires numeric elements");
+    return data_->storage();
+  }
+
+ private:
+  const Data_* data_;
+
+  // Copying and assignment allowed.
+};
+
+}  // namespace mojo
+
+#endif  // MOJO_PUBLIC_CPP_BINDINGS_ARRAY_DATA_VIEW_H_
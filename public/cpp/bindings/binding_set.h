@@ -12,7 +12,9 @@
 #include <vector>
 
 #include "mojo/public/cpp/bindings/binding.h"
+#include "mojo/public/cpp/bindings/lib/pooled_binding_set.h"
 #include "mojo/public/cpp/system/macros.h"
+#include "mojo/public/cpp/utility/run_loop_pool.h"
 
 namespace mojo {
 
@@ -22,12 +24,25 @@ template <typename Interface>
 class BindingSet {
  public:
   BindingSet() {}
+  // Distributes the bindings over the threads of |pool| (which must outlive
+  // this set), choosing a thread for each according to |policy|. Each binding
+  // is created, dispatches messages, and is destroyed on its thread, and the
+  // methods of this set must not be called on any of the pool's threads.
+  // An |impl| shared by several bindings may be called on several threads, so
+  // must then be thread-safe.
+  BindingSet(RunLoopPool* pool, RunLoopPool::Policy policy)
+      : pooled_bindings_(
+            new internal::PooledBindingSet<Interface>(pool, policy, false)) {}
   ~BindingSet() { CloseAllBindings(); }
 
   // Adds a binding to the list and arranges for it to be removed when
   // a connection error occurs.  Does not take ownership of |impl|, which
   // must outlive the binding set.
   void AddBinding(Interface* impl, InterfaceRequest<Interface> request) {
+    if (pooled_bindings_) {
+      pooled_bindings_->AddBinding(impl, request.Pass());
+      return;
+    }
     bindings_.emplace_back(new Binding<Interface>(impl, request.Pass()));
     auto* binding = bindings_.back().get();
     // Set the connection error handler for the newly added Binding to be a
@@ -43,12 +58,23 @@ class BindingSet {
     });
   }
 
-  void CloseAllBindings() { bindings_.clear(); }
+  void CloseAllBindings() {
+    if (pooled_bindings_) {
+      pooled_bindings_->CloseAllBindings();
+      return;
+    }
+    bindings_.clear();
+  }
 
-  size_t size() const { return bindings_.size(); }
+  size_t size() const {
+    return pooled_bindings_ ? pooled_bindings_->size() : bindings_.size();
+  }
 
  private:
   std::vector<std::unique_ptr<Binding<Interface>>> bindings_;
+  // Only set if this set was given a |RunLoopPool| (in which case |bindings_|
+  // is unused).
+  std::unique_ptr<internal::PooledBindingSet<Interface>> pooled_bindings_;
 
   MOJO_DISALLOW_COPY_AND_ASSIGN(BindingSet);
 };
@@ -5,11 +5,14 @@
 #ifndef MOJO_PUBLIC_CPP_BINDINGS_CALLBACK_H_
 #define MOJO_PUBLIC_CPP_BINDINGS_CALLBACK_H_
 
+#include <stddef.h>
+
 #include <functional>
+#include <new>
 #include <type_traits>
+#include <utility>
 
 #include "mojo/public/cpp/bindings/lib/callback_internal.h"
-#include "mojo/public/cpp/bindings/lib/shared_ptr.h"
 #include "mojo/public/cpp/bindings/lib/template_util.h"
 
 namespace mojo {
@@ -20,16 +23,34 @@ class Callback;
 // Represents a callback with any number of parameters and no return value. The
 // callback is executed by calling its Run() method. The callback may be "null",
 // meaning it does nothing.
+//
+// Sinks (e.g., lambdas) that are copyable and small enough (at most
+// |internal::kCallbackInlineStorageSize| bytes) are stored inline, so
+// constructing, copying, and moving such callbacks does not allocate (and
+// copying a callback copies the sink). Other sinks, and |Runnable|s, are
+// allocated on the heap and shared (reference counted, with the count kept in
+// the |Runnable|) between copies of the callback. Sinks may be move-only; such
+// a sink is moved into the callback (and always shared).
 template <typename... Args>
 class Callback<void(Args...)> {
  public:
   // An interface that may be implemented to define the Run() method.
   struct Runnable {
+    Runnable() {}
+    // The reference count isn't copied.
+    Runnable(const Runnable& /*other*/) {}
+    Runnable& operator=(const Runnable& /*other*/) { return *this; }
     virtual ~Runnable() {}
     virtual void Run(
         // ForwardType ensures String is passed as a const reference.
         typename internal::Callback_ParamTraits<Args>::ForwardType...)
         const = 0;
+
+   private:
+    friend class Callback;
+
+    // The number of |SharedRunnable|s referring to this runnable.
+    int ref_count_ = 0;
   };
 
   // Constructs a "null" callback that does nothing.
@@ -37,79 +58,240 @@ class Callback<void(Args...)> {
 
   // Constructs a callback that will run |runnable|. The callback takes
   // ownership of |runnable|.
-  explicit Callback(Runnable* runnable) : sink_(runnable) {}
-
-  // Adapts any type that is copy-constructable and has a compatible Run method
-  // or is convertible to std::function<void(Args...)> (such as a lambda of the
-  // correct type).
-  template <typename Sink>
-  Callback(const Sink& sink) {
-    using sink_type = typename std::conditional<
-        std::is_convertible<Sink, std::function<void(Args...)>>::value,
-        FunctorAdapter<Sink>, RunnableAdapter<Sink>>::type;
-    sink_ = internal::SharedPtr<Runnable>(new sink_type(sink));
+  explicit Callback(Runnable* runnable) {
+    Init<SharedRunnable, SharedRunnableInvoker>(SharedRunnable(runnable));
+  }
+
+  // Adapts any type that has a compatible Run method or is convertible to
+  // std::function<void(Args...)> (such as a lambda of the correct type).
+  template <typename Sink,
+            typename = typename std::enable_if<
+                !std::is_same<typename std::decay<Sink>::type,
+                              Callback>::value &&
+                !std::is_convertible<Sink, Runnable*>::value>::type>
+  Callback(Sink&& sink) {
+    using sink_type = typename std::decay<Sink>::type;
+    using invoker_type = typename std::conditional<
+        std::is_convertible<sink_type, std::function<void(Args...)>>::value,
+        FunctorInvoker<sink_type>, RunnableInvoker<sink_type>>::type;
+    InitFromSink<sink_type, invoker_type>(std::forward<Sink>(sink));
   }
 
   // As above, but can take a compatible function pointer.
   Callback(void (*function_ptr)(
-      typename internal::Callback_ParamTraits<Args>::ForwardType...))
-      : sink_(new FunctionPtrAdapter(function_ptr)) {}
+      typename internal::Callback_ParamTraits<Args>::ForwardType...)) {
+    Init<FunctionPtr, FunctionPtrInvoker>(function_ptr);
+  }
+
+  Callback(const Callback& other) { CopyFrom(other); }
+  // Leaves |other| null.
+  Callback(Callback&& other) { MoveFrom(&other); }
+
+  ~Callback() { reset(); }
+
+  Callback& operator=(const Callback& other) {
+    if (this != &other) {
+      reset();
+      CopyFrom(other);
+    }
+    return *this;
+  }
+  Callback& operator=(Callback&& other) {
+    if (this != &other) {
+      reset();
+      MoveFrom(&other);
+    }
+    return *this;
+  }
 
   // Executes the callback function, invoking Pass() on move-only types.
   void Run(typename internal::Callback_ParamTraits<Args>::ForwardType... args)
       const {
-    if (sink_.get())
-      sink_->Run(internal::Forward(args)...);
+    if (ops_)
+      ops_->run(&storage_, internal::Forward(args)...);
   }
 
-  bool is_null() const { return !sink_.get(); }
+  bool is_null() const { return !ops_; }
 
   // Resets the callback to the "null" state.
-  void reset() { sink_.reset(); }
+  void reset() {
+    if (ops_) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
 
  private:
-  // Adapts a class that has a Run() method but is not derived from Runnable to
-  // be callable by Callback.
-  template <typename Sink>
-  struct RunnableAdapter : public Runnable {
-    explicit RunnableAdapter(const Sink& sink) : sink(sink) {}
-    virtual void Run(
-        typename internal::Callback_ParamTraits<Args>::ForwardType... args)
-        const override {
+  static constexpr size_t kInlineStorageSize =
+      internal::kCallbackInlineStorageSize;
+  using Storage =
+      typename std::aligned_storage<kInlineStorageSize, alignof(void*)>::type;
+
+  // A reference to a heap-allocated |Runnable|, which is deleted when the last
+  // reference is dropped. (Unlike |internal::SharedPtr|, this needs no separate
+  // allocation for the reference count.)
+  class SharedRunnable {
+   public:
+    explicit SharedRunnable(Runnable* runnable) : runnable_(runnable) {
+      runnable_->ref_count_++;
+    }
+    SharedRunnable(const SharedRunnable& other) : runnable_(other.runnable_) {
+      runnable_->ref_count_++;
+    }
+    ~SharedRunnable() {
+      if (--runnable_->ref_count_ == 0)
+        delete runnable_;
+    }
+
+    const Runnable* operator->() const { return runnable_; }
+
+   private:
+    Runnable* const runnable_;
+
+    SharedRunnable& operator=(const SharedRunnable&) = delete;
+  };
+  using FunctionPtr = void (*)(
+      typename internal::Callback_ParamTraits<Args>::ForwardType...);
+
+  // Operations on an object of some type stored in |storage_|.
+  struct Ops {
+    void (*run)(const Storage* storage,
+                typename internal::Callback_ParamTraits<Args>::ForwardType...);
+    // Copy-constructs the object in |to| from the one in |from|.
+    void (*copy)(const Storage* from, Storage* to);
+    // Move-constructs the object in |to| from the one in |from|, and destroys
+    // the latter.
+    void (*move)(Storage* from, Storage* to);
+    void (*destroy)(Storage* storage);
+  };
+
+  // Invokers, which run an object of type |T| (as stored in |storage_|).
+
+  // Invokes a sink that has a Run() method (but is not derived from Runnable).
+  template <typename T>
+  struct RunnableInvoker {
+    static void Run(
+        const T& sink,
+        typename internal::Callback_ParamTraits<Args>::ForwardType... args) {
       sink.Run(internal::Forward(args)...);
     }
-    Sink sink;
   };
 
-  // Adapts a class that has a compatible operator() to be callable by Callback.
-  template <typename Sink>
-  struct FunctorAdapter : public Runnable {
-    explicit FunctorAdapter(const Sink& sink) : sink(sink) {}
-    virtual void Run(
-        typename internal::Callback_ParamTraits<Args>::ForwardType... args)
-        const override {
+  // Invokes a sink that has a compatible operator().
+  template <typename T>
+  struct FunctorInvoker {
+    static void Run(
+        const T& sink,
+        typename internal::Callback_ParamTraits<Args>::ForwardType... args) {
       sink.operator()(internal::Forward(args)...);
     }
-    Sink sink;
   };
 
-  // Adapts a function pointer.
-  struct FunctionPtrAdapter : public Runnable {
-    explicit FunctionPtrAdapter(void (*function_ptr)(
-        typename internal::Callback_ParamTraits<Args>::ForwardType...))
-        : function_ptr(function_ptr) {}
-    virtual void Run(
-        typename internal::Callback_ParamTraits<Args>::ForwardType... args)
-        const override {
+  struct FunctionPtrInvoker {
+    static void Run(
+        const FunctionPtr& function_ptr,
+        typename internal::Callback_ParamTraits<Args>::ForwardType... args) {
       (*function_ptr)(internal::Forward(args)...);
     }
-    void (*function_ptr)(
-        typename internal::Callback_ParamTraits<Args>::ForwardType...);
   };
 
-  internal::SharedPtr<Runnable> sink_;
+  struct SharedRunnableInvoker {
+    static void Run(
+        const SharedRunnable& runnable,
+        typename internal::Callback_ParamTraits<Args>::ForwardType... args) {
+      runnable->Run(internal::Forward(args)...);
+    }
+  };
+
+  // Adapts a sink (using |Invoker|) to a heap-allocated Runnable, for sinks
+  // that can't be stored inline.
+  template <typename Sink, typename Invoker>
+  struct RunnableAdapter : public Runnable {
+    template <typename S>
+    explicit RunnableAdapter(S&& sink) : sink(std::forward<S>(sink)) {}
+    void Run(typename internal::Callback_ParamTraits<Args>::ForwardType... args)
+        const override {
+      Invoker::Run(sink, internal::Forward(args)...);
+    }
+    Sink sink;
+  };
+
+  template <typename T>
+  struct CanStoreInline {
+    static constexpr bool value =
+        sizeof(T) <= kInlineStorageSize && alignof(T) <= alignof(Storage) &&
+        std::is_copy_constructible<T>::value;
+  };
+
+  template <typename T, typename Invoker>
+  struct InlineOps {
+    static void Run(
+        const Storage* storage,
+        typename internal::Callback_ParamTraits<Args>::ForwardType... args) {
+      Invoker::Run(*reinterpret_cast<const T*>(storage),
+                   internal::Forward(args)...);
+    }
+    static void Copy(const Storage* from, Storage* to) {
+      new (to) T(*reinterpret_cast<const T*>(from));
+    }
+    static void Move(Storage* from, Storage* to) {
+      new (to) T(std::move(*reinterpret_cast<T*>(from)));
+      Destroy(from);
+    }
+    static void Destroy(Storage* storage) {
+      reinterpret_cast<T*>(storage)->~T();
+    }
+
+    static const Ops* Get() {
+      static const Ops ops = {&Run, &Copy, &Move, &Destroy};
+      return &ops;
+    }
+  };
+
+  template <typename T, typename Invoker, typename U>
+  void Init(U&& value) {
+    static_assert(sizeof(T) <= kInlineStorageSize &&
+                      alignof(T) <= alignof(Storage),
+                  "T is too big to store inline");
+    new (&storage_) T(std::forward<U>(value));
+    ops_ = InlineOps<T, Invoker>::Get();
+  }
+
+  template <typename Sink, typename Invoker, typename S>
+  typename std::enable_if<CanStoreInline<Sink>::value>::type InitFromSink(
+      S&& sink) {
+    Init<Sink, Invoker>(std::forward<S>(sink));
+  }
+
+  template <typename Sink, typename Invoker, typename S>
+  typename std::enable_if<!CanStoreInline<Sink>::value>::type InitFromSink(
+      S&& sink) {
+    Init<SharedRunnable, SharedRunnableInvoker>(SharedRunnable(
+        new RunnableAdapter<Sink, Invoker>(std::forward<S>(sink))));
+  }
+
+  void CopyFrom(const Callback& other) {
+    if (other.ops_)
+      other.ops_->copy(&other.storage_, &storage_);
+    ops_ = other.ops_;
+  }
+
+  void MoveFrom(Callback* other) {
+    if (other->ops_)
+      other->ops_->move(&other->storage_, &storage_);
+    ops_ = other->ops_;
+    other->ops_ = nullptr;
+  }
+
+  // Null if this callback is null.
+  const Ops* ops_ = nullptr;
+  Storage storage_;
 };
 
+// static
+template <typename... Args>
+constexpr size_t Callback<void(Args...)>::kInlineStorageSize;
+
 // A specialization of Callback which takes no parameters.
 typedef Callback<void()> Closure;
 
@@ -37,8 +37,9 @@ std::ostream& operator<<(std::ostream& os, const mojo::Array<T>& array) {
 
 // Prints the contents of a map to an output stream in a human-readable
 // format.
-template <typename Key, typename Value>
-std::ostream& operator<<(std::ostream& os, const mojo::Map<Key, Value>& map) {
+template <typename Key, typename Value, typename Storage>
+std::ostream& operator<<(std::ostream& os,
+                         const mojo::Map<Key, Value, Storage>& map) {
   if (map) {
     os << "{";
     bool first = true;
@@ -0,0 +1,94 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Helpers for sending and receiving |mojo::LargeBytes| (see
+// mojo/public/interfaces/bindings/large_bytes.mojom): byte arrays that are sent
+// in a shared buffer, rather than in the message, if they are large.
+
+#ifndef MOJO_PUBLIC_CPP_BINDINGS_LARGE_BYTES_H_
+#define MOJO_PUBLIC_CPP_BINDINGS_LARGE_BYTES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mojo/public/cpp/system/buffer.h"
+#include "mojo/public/cpp/system/macros.h"
+#include "mojo/public/interfaces/bindings/large_bytes.mojom.h"
+
+namespace mojo {
+
+// |LargeBytes| with at most this many bytes are sent in the message itself.
+const size_t kMaxInlineLargeBytesNumBytes = 16u * 1024u;
+
+// Builds a |LargeBytes| of a given size, whose contents can be written in
+// place: for large sizes, directly into the (mapped) shared buffer, so that the
+// bytes need not first be assembled elsewhere and then copied.
+//
+//   LargeBytesBuilder builder(num_bytes);
+//   if (!builder.data())
+//     return;  // Couldn't create or map the shared buffer.
+//   RenderImage(builder.data(), num_bytes);
+//   proxy->SetImage(builder.Finish());
+class LargeBytesBuilder {
+ public:
+  // Allocates |num_bytes| bytes, inline if there are at most
+  // |kMaxInlineLargeBytesNumBytes| of them and in a new shared buffer
+  // otherwise.
+  explicit LargeBytesBuilder(size_t num_bytes);
+  ~LargeBytesBuilder();
+
+  // The bytes to be written, or null if allocation failed (or if |size()| is
+  // zero).
+  uint8_t* data() { return data_; }
+  size_t size() const { return num_bytes_; }
+
+  // Returns the |LargeBytes|, or null if allocation failed. This may only be
+  // called once, after which |data()| may no longer be used.
+  LargeBytesPtr Finish();
+
+ private:
+  const size_t num_bytes_;
+  Array<uint8_t> bytes_;
+  ScopedSharedBufferHandle buffer_;
+  uint8_t* data_;
+  bool failed_;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(LargeBytesBuilder);
+};
+
+// Returns a |LargeBytes| with a copy of the |num_bytes| bytes at |bytes|, or
+// null if a shared buffer was needed but couldn't be created.
+LargeBytesPtr CreateLargeBytes(const void* bytes, size_t num_bytes);
+
+// A read-only view of the bytes of a received |LargeBytes|, mapping its shared
+// buffer if it has one. Nothing is copied. The view remains valid for as long
+// as it exists (even if the |LargeBytes| is destroyed) for shared buffers, but
+// only as long as the |LargeBytes| for inline bytes.
+class LargeBytesView {
+ public:
+  LargeBytesView();
+  ~LargeBytesView();
+
+  // Makes this a view of |large_bytes|'s bytes. Returns false (leaving the view
+  // empty) if its shared buffer couldn't be mapped, e.g., because the range of
+  // bytes isn't within the buffer.
+  bool Init(const LargeBytes& large_bytes) MOJO_WARN_UNUSED_RESULT;
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return num_bytes_; }
+
+ private:
+  void Reset();
+
+  const uint8_t* data_;
+  size_t num_bytes_;
+  // The start of the mapping (if the bytes are in a shared buffer), to unmap.
+  void* mapping_;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(LargeBytesView);
+};
+
+}  // namespace mojo
+
+#endif  // MOJO_PUBLIC_CPP_BINDINGS_LARGE_BYTES_H_
@@ -4,11 +4,210 @@
 
 #include "mojo/public/cpp/bindings/lib/array_internal.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include <sstream>
 
 namespace mojo {
 namespace internal {
 
+namespace {
+
+static_assert(sizeof(Handle) == sizeof(MojoHandle), "Bad sizeof(Handle)");
+
+// Pointer slots are converted in bulk only where a pointer fills its whole
+// slot (i.e., on x86-64), so that the slot can be read as a 64-bit integer.
+#if defined(__SSE2__) && defined(__x86_64__)
+// Returns all ones in each 64-bit lane of |v| that is zero, and zero in the
+// others (SSE2 has no 64-bit comparison).
+__m128i IsZero64(__m128i v) {
+  const __m128i is_zero32 = _mm_cmpeq_epi32(v, _mm_setzero_si128());
+  return _mm_and_si128(is_zero32,
+                       _mm_shuffle_epi32(is_zero32, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+#endif
+
+#if defined(__SSE2__)
+// Returns a 4-bit mask of the 32-bit lanes of |v| that are equal to |value|.
+int Equal32Mask(__m128i v, __m128i value) {
+  return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, value)));
+}
+
+// Returns |kEncodedInvalidHandleValue| in each 32-bit lane. (This is a function
+// rather than a constant, to avoid a static initializer.)
+__m128i EncodedInvalidHandles() {
+  return _mm_set1_epi32(static_cast<int>(kEncodedInvalidHandleValue));
+}
+#endif
+
+// Returns the number of |num_elements| handles that are invalid.
+uint32_t CountInvalidHandles(const MojoHandle* values, uint32_t num_elements) {
+  uint32_t num_invalid = 0;
+  uint32_t i = 0;
+#if defined(__SSE2__)
+  const __m128i kInvalid = _mm_set1_epi32(kInvalidHandleValue);
+  for (; i + 4 <= num_elements; i += 4) {
+    const int mask = Equal32Mask(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i)),
+        kInvalid);
+    num_invalid += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) +
+                   ((mask >> 3) & 1);
+  }
+#endif
+  for (; i < num_elements; ++i)
+    num_invalid += values[i] == kInvalidHandleValue;
+  return num_invalid;
+}
+
+// Encodes a single handle whose index in |handles| (if it is valid) is
+// |*next_index|, and which has already been reserved.
+void EncodeHandleAt(MojoHandle* value, Handle* handles, size_t* next_index) {
+  if (*value == kInvalidHandleValue) {
+    *value = kEncodedInvalidHandleValue;
+    return;
+  }
+  handles[*next_index] = Handle(*value);
+  *value = static_cast<MojoHandle>((*next_index)++);
+}
+
+}  // namespace
+
+void EncodePointers(uint64_t* slots, uint32_t num_elements) {
+  uint32_t i = 0;
+#if defined(__SSE2__) && defined(__x86_64__)
+  __m128i slot_addresses =
+      _mm_set_epi64x(static_cast<int64_t>(reinterpret_cast<uintptr_t>(slots)) +
+                         static_cast<int64_t>(sizeof(uint64_t)),
+                     static_cast<int64_t>(reinterpret_cast<uintptr_t>(slots)));
+  const __m128i kStep = _mm_set1_epi64x(2 * sizeof(uint64_t));
+  for (; i + 2 <= num_elements; i += 2) {
+    __m128i* pair = reinterpret_cast<__m128i*>(slots + i);
+    const __m128i ptrs = _mm_loadu_si128(pair);
+    _mm_storeu_si128(pair,
+                     _mm_andnot_si128(IsZero64(ptrs),
+                                      _mm_sub_epi64(ptrs, slot_addresses)));
+    slot_addresses = _mm_add_epi64(slot_addresses, kStep);
+  }
+#endif
+  for (; i < num_elements; ++i)
+    EncodePointer(*reinterpret_cast<void**>(&slots[i]), &slots[i]);
+}
+
+void DecodePointers(uint64_t* slots, uint32_t num_elements) {
+  uint32_t i = 0;
+#if defined(__SSE2__) && defined(__x86_64__)
+  __m128i slot_addresses =
+      _mm_set_epi64x(static_cast<int64_t>(reinterpret_cast<uintptr_t>(slots)) +
+                         static_cast<int64_t>(sizeof(uint64_t)),
+                     static_cast<int64_t>(reinterpret_cast<uintptr_t>(slots)));
+  const __m128i kStep = _mm_set1_epi64x(2 * sizeof(uint64_t));
+  for (; i + 2 <= num_elements; i += 2) {
+    __m128i* pair = reinterpret_cast<__m128i*>(slots + i);
+    const __m128i offsets = _mm_loadu_si128(pair);
+    _mm_storeu_si128(pair,
+                     _mm_andnot_si128(IsZero64(offsets),
+                                      _mm_add_epi64(offsets, slot_addresses)));
+    slot_addresses = _mm_add_epi64(slot_addresses, kStep);
+  }
+#endif
+  for (; i < num_elements; ++i)
+    DecodePointer(&slots[i], reinterpret_cast<void**>(&slots[i]));
+}
+
+void EncodeHandles(Handle* elements,
+                   uint32_t num_elements,
+                   std::vector<Handle>* handles) {
+  MojoHandle* values = reinterpret_cast<MojoHandle*>(elements);
+  const uint32_t num_valid =
+      num_elements - CountInvalidHandles(values, num_elements);
+  size_t next_index = handles->size();
+  handles->resize(next_index + num_valid);
+  Handle* out = handles->data();
+
+  uint32_t i = 0;
+#if defined(__SSE2__)
+  const __m128i kInvalid = _mm_set1_epi32(kInvalidHandleValue);
+  const __m128i kEncodedInvalid = EncodedInvalidHandles();
+  const __m128i kLaneIndices = _mm_set_epi32(3, 2, 1, 0);
+  for (; i + 4 <= num_elements; i += 4) {
+    __m128i* block = reinterpret_cast<__m128i*>(values + i);
+    const __m128i v = _mm_loadu_si128(block);
+    const int invalid_mask = Equal32Mask(v, kInvalid);
+    if (invalid_mask == 0) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + next_index), v);
+      _mm_storeu_si128(
+          block, _mm_add_epi32(_mm_set1_epi32(static_cast<int>(next_index)),
+                               kLaneIndices));
+      next_index += 4;
+    } else if (invalid_mask == 0xF) {
+      _mm_storeu_si128(block, kEncodedInvalid);
+    } else {
+      for (uint32_t j = i; j < i + 4; ++j)
+        EncodeHandleAt(&values[j], out, &next_index);
+    }
+  }
+#endif
+  for (; i < num_elements; ++i)
+    EncodeHandleAt(&values[i], out, &next_index);
+  MOJO_DCHECK(next_index == handles->size());
+}
+
+void DecodeHandles(Handle* elements,
+                   uint32_t num_elements,
+                   std::vector<Handle>* handles) {
+  uint32_t i = 0;
+#if defined(__SSE2__)
+  MojoHandle* values = reinterpret_cast<MojoHandle*>(elements);
+  const size_t num_handles = handles->size();
+  const __m128i kEncodedInvalid = EncodedInvalidHandles();
+  const __m128i kLaneIndices = _mm_set_epi32(3, 2, 1, 0);
+  for (; i + 4 <= num_elements; i += 4) {
+    __m128i* block = reinterpret_cast<__m128i*>(values + i);
+    const __m128i v = _mm_loadu_si128(block);
+    const MojoHandle first = values[i];
+    // Handles are usually encoded in order, so a block typically holds four
+    // consecutive indices, which can be moved out of |handles| at once.
+    if (first < num_handles && num_handles - first >= 4 &&
+        Equal32Mask(v, _mm_add_epi32(_mm_set1_epi32(static_cast<int>(first)),
+                                     kLaneIndices)) == 0xF) {
+      __m128i* source = reinterpret_cast<__m128i*>(handles->data() + first);
+      _mm_storeu_si128(block, _mm_loadu_si128(source));
+      _mm_storeu_si128(source, _mm_set1_epi32(kInvalidHandleValue));
+    } else if (Equal32Mask(v, kEncodedInvalid) == 0xF) {
+      _mm_storeu_si128(block, _mm_set1_epi32(kInvalidHandleValue));
+    } else {
+      for (uint32_t j = i; j < i + 4; ++j)
+        DecodeHandle(&elements[j], handles);
+    }
+  }
+#endif
+  for (; i < num_elements; ++i)
+    DecodeHandle(&elements[i], handles);
+}
+
+uint32_t FindInvalidEncodedHandle(const Handle* elements,
+                                  uint32_t num_elements) {
+  const MojoHandle* values = reinterpret_cast<const MojoHandle*>(elements);
+  uint32_t i = 0;
+#if defined(__SSE2__)
+  const __m128i kEncodedInvalid = EncodedInvalidHandles();
+  for (; i + 4 <= num_elements; i += 4) {
+    const int mask = Equal32Mask(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i)),
+        kEncodedInvalid);
+    if (mask)
+      break;
+  }
+#endif
+  for (; i < num_elements; ++i) {
+    if (values[i] == kEncodedInvalidHandleValue)
+      return i;
+  }
+  return num_elements;
+}
+
 std::string MakeMessageWithArrayIndex(const char* message,
                                       size_t size,
                                       size_t index) {
@@ -57,8 +256,7 @@ void ArraySerializationHelper<Handle, true, false>::EncodePointersAndHandles(
     const ArrayHeader* header,
     ElementType* elements,
     std::vector<Handle>* handles) {
-  for (uint32_t i = 0; i < header->num_elements; ++i)
-    EncodeHandle(&elements[i], handles);
+  EncodeHandles(elements, header->num_elements, handles);
 }
 
 // static
@@ -66,6 +264,23 @@ void ArraySerializationHelper<Handle, true, false>::DecodePointersAndHandles(
     const ArrayHeader* header,
     ElementType* elements,
     std::vector<Handle>* handles) {
+  DecodeHandles(elements, header->num_elements, handles);
+}
+
+// static
+void ArraySerializationHelper<Interface_Data, false, false>::
+    EncodePointersAndHandles(const ArrayHeader* header,
+                             ElementType* elements,
+                             std::vector<Handle>* handles) {
+  for (uint32_t i = 0; i < header->num_elements; ++i)
+    EncodeHandle(&elements[i], handles);
+}
+
+// static
+void ArraySerializationHelper<Interface_Data, false, false>::
+    DecodePointersAndHandles(const ArrayHeader* header,
+                             ElementType* elements,
+                             std::vector<Handle>* handles) {
   for (uint32_t i = 0; i < header->num_elements; ++i)
     DecodeHandle(&elements[i], handles);
 }
@@ -39,6 +39,29 @@ std::string MakeMessageWithExpectedArraySize(const char* message,
                                              size_t size,
                                              size_t expected_size);
 
+// Bulk versions of |EncodePointer()| and |DecodePointer()|, for
+// |num_elements| consecutive pointer slots (i.e., |StructPointer|s,
+// |ArrayPointer|s, etc.). On x86-64 these convert two slots at a time using
+// SSE2.
+void EncodePointers(uint64_t* slots, uint32_t num_elements);
+void DecodePointers(uint64_t* slots, uint32_t num_elements);
+
+// Bulk versions of |EncodeHandle()| and |DecodeHandle()|, for |num_elements|
+// consecutive handles. |handles| grows at most once while encoding, and runs
+// of valid handles (and of consecutive handle indices, while decoding) are
+// converted four at a time using SSE2 where it is available.
+void EncodeHandles(Handle* elements,
+                   uint32_t num_elements,
+                   std::vector<Handle>* handles);
+void DecodeHandles(Handle* elements,
+                   uint32_t num_elements,
+                   std::vector<Handle>* handles);
+
+// Returns the index of the first of |num_elements| encoded handles that is
+// |kEncodedInvalidHandleValue|, or |num_elements| if there is none.
+uint32_t FindInvalidEncodedHandle(const Handle* elements,
+                                  uint32_t num_elements);
+
 template <typename T>
 struct ArrayDataTraits {
   typedef T StorageType;
@@ -185,7 +208,7 @@ struct ArraySerializationHelper<T, false, false> {
       const ElementType* elements,
       BoundsChecker* bounds_checker,
       const ArrayValidateParams* validate_params,
-      std::string* err) {
+      ValidationErrorRecord* err) {
     MOJO_DCHECK(!validate_params->element_is_nullable)
         << "Primitive type should be non-nullable";
     MOJO_DCHECK(!validate_params->element_validate_params)
@@ -211,22 +234,72 @@ struct ArraySerializationHelper<Handle, true, false> {
       const ElementType* elements,
       BoundsChecker* bounds_checker,
       const ArrayValidateParams* validate_params,
-      std::string* err) {
+      ValidationErrorRecord* err) {
     MOJO_DCHECK(!validate_params->element_validate_params)
         << "Handle type should not have array validate params";
 
+    // Handles before the first invalid one must still be claimed (and may be
+    // illegal), so that errors are reported in the same order as if each
+    // element were checked in turn.
+    const uint32_t first_invalid =
+        validate_params->element_is_nullable
+            ? header->num_elements
+            : FindInvalidEncodedHandle(elements, header->num_elements);
+    for (uint32_t i = 0; i < first_invalid; ++i) {
+      if (!bounds_checker->ClaimHandle(elements[i])) {
+        SetValidationErrorArrayIndex(err, header->num_elements, i);
+        return RecordValidationError(err, ValidationError::ILLEGAL_HANDLE,
+                                     &elements[i]);
+      }
+      bounds_checker->DecodeHandle(&elements[i]);
+    }
+    if (first_invalid < header->num_elements) {
+      SetValidationErrorArrayIndex(err, header->num_elements, first_invalid);
+      return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+          err, ValidationError::UNEXPECTED_INVALID_HANDLE,
+          &elements[first_invalid],
+          "invalid handle in array expecting valid handles");
+    }
+    return ValidationError::NONE;
+  }
+};
+
+// Arrays of interfaces, whose elements each hold a handle.
+template <>
+struct ArraySerializationHelper<Interface_Data, false, false> {
+  typedef ArrayDataTraits<Interface_Data>::StorageType ElementType;
+
+  static void EncodePointersAndHandles(const ArrayHeader* header,
+                                       ElementType* elements,
+                                       std::vector<Handle>* handles);
+
+  static void DecodePointersAndHandles(const ArrayHeader* header,
+                                       ElementType* elements,
+                                       std::vector<Handle>* handles);
+
+  static ValidationError ValidateElements(
+      const ArrayHeader* header,
+      const ElementType* elements,
+      BoundsChecker* bounds_checker,
+      const ArrayValidateParams* validate_params,
+      ValidationErrorRecord* err) {
+    MOJO_DCHECK(!validate_params->element_validate_params)
+        << "Interface type should not have array validate params";
+
     for (uint32_t i = 0; i < header->num_elements; ++i) {
       if (!validate_params->element_is_nullable &&
-          elements[i].value() == kEncodedInvalidHandleValue) {
-        MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err)
-            << "invalid handle in array expecting valid handles (array size="
-            << header->num_elements << ", index = " << i << ")";
-        return ValidationError::UNEXPECTED_INVALID_HANDLE;
+          elements[i].handle.value() == kEncodedInvalidHandleValue) {
+        SetValidationErrorArrayIndex(err, header->num_elements, i);
+        return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+            err, ValidationError::UNEXPECTED_INVALID_HANDLE, &elements[i],
+            "invalid interface in array expecting valid interfaces");
       }
-      if (!bounds_checker->ClaimHandle(elements[i])) {
-        MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err) << "";
-        return ValidationError::ILLEGAL_HANDLE;
+      if (!bounds_checker->ClaimHandle(elements[i].handle)) {
+        SetValidationErrorArrayIndex(err, header->num_elements, i);
+        return RecordValidationError(err, ValidationError::ILLEGAL_HANDLE,
+                                     &elements[i]);
       }
+      bounds_checker->DecodeHandle(&elements[i]);
     }
     return ValidationError::NONE;
   }
@@ -255,7 +328,7 @@ struct ArraySerializationHelper<H, true, false> {
       const ElementType* elements,
       BoundsChecker* bounds_checker,
       const ArrayValidateParams* validate_params,
-      std::string* err) {
+      ValidationErrorRecord* err) {
     return ArraySerializationHelper<Handle, true, false>::ValidateElements(
         header, elements, bounds_checker, validate_params, err);
   }
@@ -265,18 +338,29 @@ template <typename P>
 struct ArraySerializationHelper<P*, false, false> {
   typedef typename ArrayDataTraits<P*>::StorageType ElementType;
 
+  static_assert(sizeof(ElementType) == sizeof(uint64_t),
+                "Elements should be pointer slots");
+
+  // Like |Encode()| and |Decode()| for each element, but the pointers
+  // themselves are converted in bulk (which doesn't affect the pointees).
   static void EncodePointersAndHandles(const ArrayHeader* header,
                                        ElementType* elements,
                                        std::vector<Handle>* handles) {
-    for (uint32_t i = 0; i < header->num_elements; ++i)
-      Encode(&elements[i], handles);
+    for (uint32_t i = 0; i < header->num_elements; ++i) {
+      if (elements[i].ptr)
+        elements[i].ptr->EncodePointersAndHandles(handles);
+    }
+    EncodePointers(&elements->offset, header->num_elements);
   }
 
   static void DecodePointersAndHandles(const ArrayHeader* header,
                                        ElementType* elements,
                                        std::vector<Handle>* handles) {
-    for (uint32_t i = 0; i < header->num_elements; ++i)
-      Decode(&elements[i], handles);
+    DecodePointers(&elements->offset, header->num_elements);
+    for (uint32_t i = 0; i < header->num_elements; ++i) {
+      if (elements[i].ptr)
+        elements[i].ptr->DecodePointersAndHandles(handles);
+    }
   }
 
   static ValidationError ValidateElements(
@@ -284,18 +368,19 @@ struct ArraySerializationHelper<P*, false, false> {
       const ElementType* elements,
       BoundsChecker* bounds_checker,
       const ArrayValidateParams* validate_params,
-      std::string* err) {
+      ValidationErrorRecord* err) {
     for (uint32_t i = 0; i < header->num_elements; ++i) {
       if (!validate_params->element_is_nullable && !elements[i].offset) {
-        MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err)
-            << "null in array expecting valid pointers (size="
-            << header->num_elements << ", index = " << i << ")";
-        return ValidationError::UNEXPECTED_NULL_POINTER;
+        SetValidationErrorArrayIndex(err, header->num_elements, i);
+        return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+            err, ValidationError::UNEXPECTED_NULL_POINTER, &elements[i],
+            "null in array expecting valid pointers");
       }
 
       if (!ValidateEncodedPointer(&elements[i].offset)) {
-        MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err) << "";
-        return ValidationError::ILLEGAL_POINTER;
+        SetValidationErrorArrayIndex(err, header->num_elements, i);
+        return RecordValidationError(err, ValidationError::ILLEGAL_POINTER,
+                                     &elements[i]);
       }
 
       auto retval = ValidateCaller<P>::Run(
@@ -303,6 +388,7 @@ struct ArraySerializationHelper<P*, false, false> {
           validate_params->element_validate_params, err);
       if (retval != ValidationError::NONE)
         return retval;
+      bounds_checker->DecodePointer(&elements[i]);
     }
     return ValidationError::NONE;
   }
@@ -313,7 +399,7 @@ struct ArraySerializationHelper<P*, false, false> {
     static ValidationError Run(const void* data,
                                BoundsChecker* bounds_checker,
                                const ArrayValidateParams* validate_params,
-                               std::string* err) {
+                               ValidationErrorRecord* err) {
       MOJO_DCHECK(!validate_params)
           << "Struct type should not have array validate params";
 
@@ -326,7 +412,7 @@ struct ArraySerializationHelper<P*, false, false> {
     static ValidationError Run(const void* data,
                                BoundsChecker* bounds_checker,
                                const ArrayValidateParams* validate_params,
-                               std::string* err) {
+                               ValidationErrorRecord* err) {
       return Map_Data<Key, Value>::Validate(data, bounds_checker,
                                             validate_params, err);
     }
@@ -337,7 +423,7 @@ struct ArraySerializationHelper<P*, false, false> {
     static ValidationError Run(const void* data,
                                BoundsChecker* bounds_checker,
                                const ArrayValidateParams* validate_params,
-                               std::string* err) {
+                               ValidationErrorRecord* err) {
       return Array_Data<T>::Validate(data, bounds_checker, validate_params,
                                      err);
     }
@@ -368,15 +454,15 @@ struct ArraySerializationHelper<P, false, true> {
       const ElementType* elements,
       BoundsChecker* bounds_checker,
       const ArrayValidateParams* validate_params,
-      std::string* err) {
+      ValidationErrorRecord* err) {
     MOJO_DCHECK(!validate_params->element_validate_params)
         << "Union type should not have array validate params";
     for (uint32_t i = 0; i < header->num_elements; ++i) {
       if (!validate_params->element_is_nullable && elements[i].is_null()) {
-        MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err)
-            << "null union in array expecting non-null unions (size="
-            << header->num_elements << ", index = " << i << ")";
-        return ValidationError::UNEXPECTED_NULL_UNION;
+        SetValidationErrorArrayIndex(err, header->num_elements, i);
+        return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+            err, ValidationError::UNEXPECTED_NULL_UNION, &elements[i],
+            "null union in array expecting non-null unions");
       }
 
       auto retval = ElementType::Validate(
@@ -415,38 +501,37 @@ class Array_Data {
   static ValidationError Validate(const void* data,
                                   BoundsChecker* bounds_checker,
                                   const ArrayValidateParams* validate_params,
-                                  std::string* err) {
+                                  ValidationErrorRecord* err) {
     if (!data)
       return ValidationError::NONE;
     if (!IsAligned(data)) {
-      MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err) << "";
-      return ValidationError::MISALIGNED_OBJECT;
+      return RecordValidationError(err, ValidationError::MISALIGNED_OBJECT,
+                                   data);
     }
     if (!bounds_checker->IsValidRange(data, sizeof(ArrayHeader))) {
-      MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err) << "";
-      return ValidationError::ILLEGAL_MEMORY_RANGE;
+      return RecordValidationError(err, ValidationError::ILLEGAL_MEMORY_RANGE,
+                                   data);
     }
 
     const ArrayHeader* header = static_cast<const ArrayHeader*>(data);
     if (header->num_elements > Traits::kMaxNumElements ||
         header->num_bytes < Traits::GetStorageSize(header->num_elements)) {
-      MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err) << "";
-      return ValidationError::UNEXPECTED_ARRAY_HEADER;
+      return RecordValidationError(
+          err, ValidationError::UNEXPECTED_ARRAY_HEADER, data);
     }
 
     if (validate_params->expected_num_elements != 0 &&
         header->num_elements != validate_params->expected_num_elements) {
-      MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err)
-          << "fixed-size array has wrong number of elements (size="
-          << header->num_elements
-          << ", expected size=" << validate_params->expected_num_elements
-          << ")";
-      return ValidationError::UNEXPECTED_ARRAY_HEADER;
+      SetValidationErrorExpectedArraySize(
+          err, header->num_elements, validate_params->expected_num_elements);
+      return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+          err, ValidationError::UNEXPECTED_ARRAY_HEADER, data,
+          "fixed-size array has wrong number of elements");
     }
 
     if (!bounds_checker->ClaimMemory(data, header->num_bytes)) {
-      MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err) << "";
-      return ValidationError::ILLEGAL_MEMORY_RANGE;
+      return RecordValidationError(err, ValidationError::ILLEGAL_MEMORY_RANGE,
+                                   data);
     }
 
     const Array_Data<T>* object = static_cast<const Array_Data<T>*>(data);
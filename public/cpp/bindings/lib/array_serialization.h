@@ -28,6 +28,18 @@ namespace mojo {
 
 namespace internal {
 
+// Like |EncodeHandleInPlace()|, for the first |num_elements| handles of
+// |array|, which are encoded in bulk once they have all been serialized.
+template <typename H>
+inline void EncodeHandlesInPlace(Buffer* buf,
+                                 Array_Data<H>* array,
+                                 size_t num_elements) {
+  if (buf->encodes_in_place()) {
+    EncodeHandles(array->storage(), static_cast<uint32_t>(num_elements),
+                  buf->encoded_handles());
+  }
+}
+
 // The ArraySerializer template contains static methods for serializing |Array|s
 // of various types.  These methods include:
 //   * size_t GetSerializedSize(..)
@@ -88,7 +100,7 @@ struct ArraySerializer<
     return ValidationError::NONE;
   }
 
-  // We can optimize serializing PODs by |memcpy|ing directly.
+  // We can optimize serializing PODs by copying the bytes directly.
   // Note that this has precedence over its templated sibling defined above.
   static ValidationError SerializeElements(
       typename Array<E>::Iterator it,
@@ -101,7 +113,7 @@ struct ArraySerializer<
     MOJO_DCHECK(!validate_params->element_validate_params)
         << "Primitive type should not have array validate params";
     if (num_elements)
-      memcpy(output->storage(), &(*it), num_elements * sizeof(E));
+      buf->CopyBytes(output->storage(), &(*it), num_elements * sizeof(E));
 
     return ValidationError::NONE;
   }
@@ -171,6 +183,7 @@ struct ArraySerializer<ScopedHandleBase<H>, H, false> {
       // Transfer ownership of the handle.
       output->at(i) = it->release();
       if (!validate_params->element_is_nullable && !output->at(i).is_valid()) {
+        EncodeHandlesInPlace(buf, output, i);
         MOJO_INTERNAL_DLOG_SERIALIZATION_WARNING(
             ValidationError::UNEXPECTED_INVALID_HANDLE,
             MakeMessageWithArrayIndex(
@@ -179,6 +192,7 @@ struct ArraySerializer<ScopedHandleBase<H>, H, false> {
         return ValidationError::UNEXPECTED_INVALID_HANDLE;
       }
     }
+    EncodeHandlesInPlace(buf, output, num_elements);
 
     return ValidationError::NONE;
   }
@@ -214,6 +228,7 @@ struct ArraySerializer<InterfaceRequest<I>, MessagePipeHandle, false> {
       // Transfer ownership of the MessagePipeHandle.
       output->at(i) = it->PassMessagePipe().release();
       if (!validate_params->element_is_nullable && !output->at(i).is_valid()) {
+        EncodeHandlesInPlace(buf, output, i);
         MOJO_INTERNAL_DLOG_SERIALIZATION_WARNING(
             ValidationError::UNEXPECTED_INVALID_HANDLE,
             MakeMessageWithArrayIndex(
@@ -222,6 +237,7 @@ struct ArraySerializer<InterfaceRequest<I>, MessagePipeHandle, false> {
         return ValidationError::UNEXPECTED_INVALID_HANDLE;
       }
     }
+    EncodeHandlesInPlace(buf, output, num_elements);
 
     return ValidationError::NONE;
   }
@@ -268,6 +284,7 @@ struct ArraySerializer<InterfaceHandle<Interface>, Interface_Data, false> {
                 i));
         return ValidationError::UNEXPECTED_INVALID_HANDLE;
       }
+      EncodeHandleInPlace(buf, &output->at(i));
     }
 
     return ValidationError::NONE;
@@ -327,6 +344,7 @@ struct ArraySerializer<
                                       num_elements, i));
         return ValidationError::UNEXPECTED_NULL_POINTER;
       }
+      EncodePointerInPlace(buf, output->storage() + i);
     }
 
     return ValidationError::NONE;
@@ -383,11 +401,12 @@ struct ArraySerializer<
       return SerializeArray_(input, buf, output, validate_params);
     }
 
-    template <typename Key, typename Value>
-    static ValidationError Run(Map<Key, Value>* input,
-                               Buffer* buf,
-                               typename Map<Key, Value>::Data_** output,
-                               const ArrayValidateParams* validate_params) {
+    template <typename Key, typename Value, typename Storage>
+    static ValidationError Run(
+        Map<Key, Value, Storage>* input,
+        Buffer* buf,
+        typename Map<Key, Value, Storage>::Data_** output,
+        const ArrayValidateParams* validate_params) {
       return SerializeMap_(input, buf, output, validate_params);
     }
   };
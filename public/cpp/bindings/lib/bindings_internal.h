@@ -5,6 +5,7 @@
 #ifndef MOJO_PUBLIC_CPP_BINDINGS_LIB_BINDINGS_INTERNAL_H_
 #define MOJO_PUBLIC_CPP_BINDINGS_LIB_BINDINGS_INTERNAL_H_
 
+#include <map>
 #include <type_traits>
 
 #include "mojo/public/cpp/bindings/lib/template_util.h"
@@ -24,7 +25,7 @@ class InterfaceHandle;
 template <typename Interface>
 class InterfaceRequest;
 
-template <typename K, typename V>
+template <typename K, typename V, typename Storage = std::map<K, V>>
 class Map;
 
 namespace internal {
@@ -45,12 +45,6 @@ void EncodePointer(const void* ptr, uint64_t* offset) {
   *offset = static_cast<uint64_t>(p_obj - p_slot);
 }
 
-const void* DecodePointerRaw(const uint64_t* offset) {
-  if (!*offset)
-    return nullptr;
-  return reinterpret_cast<const char*>(offset) + *offset;
-}
-
 void EncodeHandle(Handle* handle, std::vector<Handle>* handles) {
   if (handle->is_valid()) {
     handles->push_back(*handle);
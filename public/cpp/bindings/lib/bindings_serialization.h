@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "mojo/public/cpp/bindings/lib/bindings_internal.h"
+#include "mojo/public/cpp/bindings/lib/buffer.h"
 #include "mojo/public/cpp/system/handle.h"
 
 namespace mojo {
@@ -38,7 +39,11 @@ bool IsAligned(const void* ptr);
 //
 void EncodePointer(const void* ptr, uint64_t* offset);
 // Note: This function doesn't validate the encoded pointer value.
-const void* DecodePointerRaw(const uint64_t* offset);
+inline const void* DecodePointerRaw(const uint64_t* offset) {
+  if (!*offset)
+    return nullptr;
+  return reinterpret_cast<const char*>(offset) + *offset;
+}
 
 // Note: This function doesn't validate the encoded pointer value.
 template <typename T>
@@ -75,6 +80,23 @@ inline void Decode(T* obj, std::vector<Handle>* handles) {
     obj->ptr->DecodePointersAndHandles(handles);
 }
 
+// The following 2 functions are used by serialization to encode an object
+// pointer (once the object has been serialized) or a handle as soon as it is
+// written, if |buf| encodes in place (see |Buffer::encodes_in_place()|).
+// Otherwise they do nothing, and |EncodePointersAndHandles()| must be used.
+
+template <typename T>
+inline void EncodePointerInPlace(Buffer* buf, T* obj) {
+  if (buf->encodes_in_place())
+    buf->EncodePointer(obj->ptr, &obj->offset);
+}
+
+template <typename T>
+inline void EncodeHandleInPlace(Buffer* buf, T* handle) {
+  if (buf->encodes_in_place())
+    EncodeHandle(handle, buf->encoded_handles());
+}
+
 template <typename T>
 inline void InterfaceHandleToData(InterfaceHandle<T> input,
                                   Interface_Data* output) {
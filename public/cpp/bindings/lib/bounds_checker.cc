@@ -14,10 +14,18 @@ namespace internal {
 BoundsChecker::BoundsChecker(const void* data,
                              uint32_t data_num_bytes,
                              size_t num_handles)
+    : BoundsChecker(data, data_num_bytes, num_handles, nullptr) {}
+
+BoundsChecker::BoundsChecker(const void* data,
+                             uint32_t data_num_bytes,
+                             size_t num_handles,
+                             std::vector<Handle>* handles)
     : data_begin_(reinterpret_cast<uintptr_t>(data)),
       data_end_(data_begin_ + data_num_bytes),
       handle_begin_(0),
-      handle_end_(static_cast<uint32_t>(num_handles)) {
+      handle_end_(static_cast<uint32_t>(num_handles)),
+      handles_(handles),
+      num_decoded_handles_(0) {
   if (data_end_ < data_begin_) {
     // The calculation of |data_end_| overflowed.
     // It shouldn't happen but if it does, set the range to empty so
@@ -36,42 +44,10 @@ BoundsChecker::BoundsChecker(const void* data,
 BoundsChecker::~BoundsChecker() {
 }
 
-bool BoundsChecker::ClaimMemory(const void* position, uint32_t num_bytes) {
-  uintptr_t begin = reinterpret_cast<uintptr_t>(position);
-  uintptr_t end = begin + num_bytes;
-
-  if (!InternalIsValidRange(begin, end))
-    return false;
-
-  data_begin_ = end;
-  return true;
-}
-
-bool BoundsChecker::ClaimHandle(const Handle& encoded_handle) {
-  uint32_t index = encoded_handle.value();
-  if (index == kEncodedInvalidHandleValue)
-    return true;
-
-  if (index < handle_begin_ || index >= handle_end_)
-    return false;
-
-  // |index| + 1 shouldn't overflow, because |index| is not the max value of
-  // uint32_t (it is less than |handle_end_|).
-  handle_begin_ = index + 1;
-  return true;
-}
-
-bool BoundsChecker::IsValidRange(const void* position,
-                                 uint32_t num_bytes) const {
-  uintptr_t begin = reinterpret_cast<uintptr_t>(position);
-  uintptr_t end = begin + num_bytes;
-
-  return InternalIsValidRange(begin, end);
-}
-
-bool BoundsChecker::InternalIsValidRange(uintptr_t begin, uintptr_t end) const {
-  return end > begin && begin >= data_begin_ && end <= data_end_;
-}
+DecodingBoundsChecker::DecodingBoundsChecker(void* data,
+                                             uint32_t data_num_bytes,
+                                             std::vector<Handle>* handles)
+    : BoundsChecker(data, data_num_bytes, handles->size(), handles) {}
 
 }  // namespace internal
 }  // namespace mojo
@@ -7,16 +7,27 @@
 
 #include <stdint.h>
 
+#include <utility>
+#include <vector>
+
+#include "mojo/public/cpp/bindings/lib/bindings_internal.h"
+#include "mojo/public/cpp/bindings/lib/bindings_serialization.h"
+#include "mojo/public/cpp/environment/logging.h"
+#include "mojo/public/cpp/system/handle.h"
 #include "mojo/public/cpp/system/macros.h"
 
 namespace mojo {
-
-class Handle;
-
 namespace internal {
 
 // BoundsChecker is used to validate object sizes, pointers and handle indices
 // for payload of incoming messages.
+//
+// Validation must pass each pointer that it has validated to |DecodePointer()|
+// and each handle that it has claimed to |DecodeHandle()|, so that a
+// |DecodingBoundsChecker| can decode the payload as it goes (which is then
+// validated and decoded in a single pass). The claim methods are inline, so
+// that the checker's state can stay in registers while a (generated)
+// |Validate()| function runs.
 class BoundsChecker {
  public:
   // [data, data + data_num_bytes) specifies the initial valid memory range.
@@ -30,21 +41,98 @@ class BoundsChecker {
   // the comments for IsValidRange().)
   // On success, the valid memory range is shrinked to begin right after the end
   // of the claimed range.
-  bool ClaimMemory(const void* position, uint32_t num_bytes);
+  bool ClaimMemory(const void* position, uint32_t num_bytes) {
+    uintptr_t begin = reinterpret_cast<uintptr_t>(position);
+    uintptr_t end = begin + num_bytes;
+
+    if (!InternalIsValidRange(begin, end))
+      return false;
+
+    data_begin_ = end;
+    return true;
+  }
 
   // Claims the specified encoded handle (which is basically a handle index).
   // The method succeeds if:
   // - |encoded_handle|'s value is |kEncodedInvalidHandleValue|.
   // - the handle is contained inside the valid range of handle indices. In this
   // case, the valid range is shinked to begin right after the claimed handle.
-  bool ClaimHandle(const Handle& encoded_handle);
+  bool ClaimHandle(const Handle& encoded_handle) {
+    uint32_t index = encoded_handle.value();
+    if (index == kEncodedInvalidHandleValue)
+      return true;
+
+    if (index < handle_begin_ || index >= handle_end_)
+      return false;
+
+    // |index| + 1 shouldn't overflow, because |index| is not the max value of
+    // uint32_t (it is less than |handle_end_|).
+    handle_begin_ = index + 1;
+    return true;
+  }
 
   // Returns true if the specified range is not empty, and the range is
   // contained inside the valid memory range.
-  bool IsValidRange(const void* position, uint32_t num_bytes) const;
+  bool IsValidRange(const void* position, uint32_t num_bytes) const {
+    uintptr_t begin = reinterpret_cast<uintptr_t>(position);
+    uintptr_t end = begin + num_bytes;
+
+    return InternalIsValidRange(begin, end);
+  }
+
+  // Returns true if this checker also decodes (see |DecodingBoundsChecker|).
+  bool decodes() const { return !!handles_; }
+
+  // If decoding, replaces the (validated) offset of |obj|, which is a
+  // |StructPointer|, |ArrayPointer|, |StringPointer| or |UnionPointer|, with
+  // the pointer.
+  template <typename T>
+  void DecodePointer(const T* obj) {
+    if (!handles_)
+      return;
+    T* mutable_obj = const_cast<T*>(obj);
+    internal::DecodePointer(&mutable_obj->offset, &mutable_obj->ptr);
+  }
+
+  // If decoding, replaces the (claimed) encoded handle with the handle.
+  void DecodeHandle(const Handle* encoded_handle) {
+    if (!handles_)
+      return;
+    Handle* handle = const_cast<Handle*>(encoded_handle);
+    if (handle->value() == kEncodedInvalidHandleValue) {
+      *handle = Handle();
+      return;
+    }
+    // Handles are claimed in increasing index order, so the handle at the
+    // claimed index hasn't been moved yet.
+    MOJO_DCHECK(handle->value() < handle_begin_);
+    Handle* decoded = &(*handles_)[num_decoded_handles_++];
+    std::swap(*decoded, (*handles_)[handle->value()]);
+    *handle = *decoded;
+  }
+  void DecodeHandle(const Interface_Data* encoded_interface) {
+    DecodeHandle(&encoded_interface->handle);
+  }
+  void DecodeHandle(const MojoHandle* encoded_handle) {
+    DecodeHandle(reinterpret_cast<const Handle*>(encoded_handle));
+  }
+
+  // The number of handles decoded so far, which are the first ones in the
+  // handles being decoded.
+  uint32_t num_decoded_handles() const { return num_decoded_handles_; }
+
+ protected:
+  // Like the public constructor, but also decodes, using |handles| (which has
+  // |num_handles| elements).
+  BoundsChecker(const void* data,
+                uint32_t data_num_bytes,
+                size_t num_handles,
+                std::vector<Handle>* handles);
 
  private:
-  bool InternalIsValidRange(uintptr_t begin, uintptr_t end) const;
+  bool InternalIsValidRange(uintptr_t begin, uintptr_t end) const {
+    return end > begin && begin >= data_begin_ && end <= data_end_;
+  }
 
   // [data_begin_, data_end_) is the valid memory range.
   uintptr_t data_begin_;
@@ -54,9 +142,31 @@ class BoundsChecker {
   uint32_t handle_begin_;
   uint32_t handle_end_;
 
+  // Null unless decoding.
+  std::vector<Handle>* const handles_;
+  uint32_t num_decoded_handles_;
+
   MOJO_DISALLOW_COPY_AND_ASSIGN(BoundsChecker);
 };
 
+// A |BoundsChecker| that also decodes the data as it is validated, converting
+// pointers and handles in place (so the data must be writable, even though
+// validation treats it as const). [0, handles->size()) is the initial valid
+// range of handle indices.
+//
+// The decoded handles are moved to the front of |handles|, which still owns
+// them (so that they're closed if validation fails, or the data is dropped)
+// until the data is deserialized (see |num_decoded_handles()|).
+class DecodingBoundsChecker : public BoundsChecker {
+ public:
+  DecodingBoundsChecker(void* data,
+                        uint32_t data_num_bytes,
+                        std::vector<Handle>* handles);
+
+ private:
+  MOJO_DISALLOW_COPY_AND_ASSIGN(DecodingBoundsChecker);
+};
+
 }  // namespace internal
 }  // namespace mojo
 
@@ -6,6 +6,12 @@
 #define MOJO_PUBLIC_CPP_BINDINGS_LIB_BUFFER_H_
 
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "mojo/public/cpp/system/handle.h"
 
 namespace mojo {
 namespace internal {
@@ -16,6 +22,45 @@ class Buffer {
  public:
   virtual ~Buffer() {}
   virtual void* Allocate(size_t num_bytes) = 0;
+
+  // Fills |num_bytes| bytes of an allocation, starting at |destination|, with
+  // the bytes at |source|. Serialization uses this for bulk data (e.g., the
+  // contents of strings and arrays of POD types). A subclass may defer the copy
+  // (e.g., to reference |source| in place); the caller must then ensure that
+  // |source| remains valid for as long as the subclass requires.
+  virtual void CopyBytes(void* destination,
+                         const void* source,
+                         size_t num_bytes) {
+    memcpy(destination, source, num_bytes);
+  }
+
+  // Returns true if serialization into this buffer encodes each pointer (see
+  // |EncodePointer()|) and handle (into |encoded_handles()|) as soon as it is
+  // written, so that no separate |EncodePointersAndHandles()| pass is needed
+  // (or allowed). See |ChunkedBuffer|.
+  bool encodes_in_place() const { return !!encoded_handles_; }
+
+  // Only valid if |encodes_in_place()|: the handles encoded so far, in order.
+  std::vector<Handle>* encoded_handles() { return encoded_handles_; }
+
+  // Encodes |ptr| (which must be null or point to a later allocation) as an
+  // offset relative to |offset| (see |internal::EncodePointer()|), where both
+  // are in memory allocated from this buffer. This default is for buffers
+  // whose allocations are contiguous.
+  virtual void EncodePointer(const void* ptr, uint64_t* offset) {
+    *offset = ptr ? static_cast<uint64_t>(static_cast<const char*>(ptr) -
+                                          reinterpret_cast<char*>(offset))
+                  : 0u;
+  }
+
+ protected:
+  Buffer() : encoded_handles_(nullptr) {}
+  // For buffers that encode in place, into |encoded_handles|.
+  explicit Buffer(std::vector<Handle>* encoded_handles)
+      : encoded_handles_(encoded_handles) {}
+
+ private:
+  std::vector<Handle>* const encoded_handles_;
 };
 
 }  // namespace internal
@@ -5,6 +5,8 @@
 #ifndef MOJO_PUBLIC_CPP_BINDINGS_LIB_CALLBACK_INTERNAL_H_
 #define MOJO_PUBLIC_CPP_BINDINGS_LIB_CALLBACK_INTERNAL_H_
 
+#include <stddef.h>
+
 #include "mojo/public/cpp/bindings/lib/template_util.h"
 
 namespace mojo {
@@ -12,6 +14,12 @@ class String;
 
 namespace internal {
 
+// The maximum size of a sink (e.g., a lambda and its captures) that a
+// |mojo::Callback| stores inline (instead of allocating it on the heap). This
+// also determines the size of a |mojo::Callback|, so it must be the same
+// everywhere (and hence is not configurable).
+constexpr size_t kCallbackInlineStorageSize = 4 * sizeof(void*);
+
 template <typename T>
 struct Callback_ParamTraits {
   typedef T ForwardType;
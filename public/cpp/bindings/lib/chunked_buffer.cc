@@ -0,0 +1,158 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "mojo/public/cpp/bindings/lib/chunked_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "mojo/public/cpp/bindings/lib/bindings_serialization.h"
+#include "mojo/public/cpp/environment/logging.h"
+
+namespace mojo {
+namespace internal {
+
+// static
+constexpr size_t ChunkedBuffer::kDefaultInitialChunkSize;
+// static
+constexpr size_t ChunkedBuffer::kMaxChunkGrowthSize;
+// static
+constexpr size_t ChunkedBuffer::kZeroingBlockSize;
+
+ChunkedBuffer::ChunkedBuffer(size_t initial_chunk_size)
+    : ChunkedBuffer(nullptr, initial_chunk_size) {}
+
+ChunkedBuffer::ChunkedBuffer(void* initial_chunk, size_t initial_chunk_size)
+    : Buffer(&handles_) {
+  MOJO_DCHECK(IsAligned(initial_chunk));
+  current_.data = static_cast<char*>(initial_chunk);
+  current_.capacity = initial_chunk ? initial_chunk_size
+                                    : Align(initial_chunk_size);
+  current_.num_bytes = 0u;
+  current_.offset = 0u;
+  current_.owned = false;
+  num_zeroed_bytes_ = 0u;
+}
+
+ChunkedBuffer::~ChunkedBuffer() {
+  FreeChunks();
+}
+
+size_t ChunkedBuffer::GetOffset(const void* ptr) const {
+  const char* p = static_cast<const char*>(ptr);
+  if (ChunkContains(current_, p))
+    return current_.offset + static_cast<size_t>(p - current_.data);
+  for (auto it = full_chunks_.rbegin(); it != full_chunks_.rend(); ++it) {
+    if (ChunkContains(*it, p))
+      return it->offset + static_cast<size_t>(p - it->data);
+  }
+  MOJO_CHECK(false) << "Pointer not allocated from this buffer";
+  return 0u;
+}
+
+void ChunkedBuffer::CopyTo(void* destination) const {
+  char* dest = static_cast<char*>(destination);
+  for (const auto& chunk : full_chunks_) {
+    memcpy(dest, chunk.data, chunk.num_bytes);
+    dest += chunk.num_bytes;
+  }
+  if (current_.num_bytes)
+    memcpy(dest, current_.data, current_.num_bytes);
+}
+
+void* ChunkedBuffer::Allocate(size_t num_bytes) {
+  num_bytes = Align(num_bytes);
+  if (num_bytes == 0) {
+    MOJO_DCHECK(false) << "Not reached";
+    return nullptr;
+  }
+
+  if (!current_.data || num_bytes > current_.capacity - current_.num_bytes)
+    StartChunk(num_bytes);
+
+  char* result = current_.data + current_.num_bytes;
+  current_.num_bytes += num_bytes;
+  if (current_.num_bytes > num_zeroed_bytes_) {
+    // Zero ahead, to avoid a (small) |memset()| for every allocation.
+    size_t end = std::min(
+        std::max(current_.num_bytes, num_zeroed_bytes_ + kZeroingBlockSize),
+        current_.capacity);
+    memset(current_.data + num_zeroed_bytes_, 0, end - num_zeroed_bytes_);
+    num_zeroed_bytes_ = end;
+  }
+  return result;
+}
+
+void ChunkedBuffer::EncodePointer(const void* ptr, uint64_t* offset) {
+  if (!ptr) {
+    *offset = 0u;
+    return;
+  }
+
+  // Usually, both are in the current chunk.
+  const char* p_obj = static_cast<const char*>(ptr);
+  const char* p_slot = reinterpret_cast<const char*>(offset);
+  if (ChunkContains(current_, p_obj) && ChunkContains(current_, p_slot)) {
+    MOJO_DCHECK(p_obj > p_slot);
+    *offset = static_cast<uint64_t>(p_obj - p_slot);
+    return;
+  }
+
+  size_t obj_offset = GetOffset(p_obj);
+  size_t slot_offset = GetOffset(p_slot);
+  MOJO_DCHECK(obj_offset > slot_offset);
+  *offset = static_cast<uint64_t>(obj_offset - slot_offset);
+}
+
+void* ChunkedBuffer::AllocateChunk(size_t num_bytes, size_t* capacity) {
+  *capacity = num_bytes;
+  return malloc(num_bytes);
+}
+
+void ChunkedBuffer::FreeChunk(void* data, size_t capacity) {
+  free(data);
+}
+
+void ChunkedBuffer::FreeChunks() {
+  for (const auto& chunk : full_chunks_) {
+    if (chunk.owned)
+      FreeChunk(chunk.data, chunk.capacity);
+  }
+  full_chunks_.clear();
+  if (current_.owned)
+    FreeChunk(current_.data, current_.capacity);
+  current_.data = nullptr;
+  current_.num_bytes = 0u;
+  current_.offset = 0u;
+  current_.owned = false;
+  num_zeroed_bytes_ = 0u;
+}
+
+void ChunkedBuffer::StartChunk(size_t num_bytes) {
+  // Before the first allocation, |current_.capacity| is the size requested
+  // for the first chunk.
+  size_t capacity = current_.capacity;
+  if (current_.data)
+    capacity = std::min(2u * capacity, kMaxChunkGrowthSize);
+  capacity = std::max(capacity, num_bytes);
+
+  size_t offset = size();
+  if (current_.num_bytes)
+    full_chunks_.push_back(current_);
+  else if (current_.owned)
+    FreeChunk(current_.data, current_.capacity);
+
+  current_.data = static_cast<char*>(AllocateChunk(capacity, &capacity));
+  MOJO_CHECK(current_.data);
+  current_.capacity = capacity;
+  current_.num_bytes = 0u;
+  current_.offset = offset;
+  current_.owned = true;
+  num_zeroed_bytes_ = 0u;
+}
+
+}  // namespace internal
+}  // namespace mojo
@@ -0,0 +1,138 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MOJO_PUBLIC_CPP_BINDINGS_LIB_CHUNKED_BUFFER_H_
+#define MOJO_PUBLIC_CPP_BINDINGS_LIB_CHUNKED_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "mojo/public/cpp/bindings/lib/buffer.h"
+#include "mojo/public/cpp/system/handle.h"
+#include "mojo/public/cpp/system/macros.h"
+
+namespace mojo {
+namespace internal {
+
+// ChunkedBuffer is a growable |Buffer|, for serializing without computing the
+// serialized size in advance. Objects are allocated from the current chunk of
+// memory; when it is full, a new chunk (twice as large, up to
+// |kMaxChunkGrowthSize|, or larger if needed) is started, so allocated objects
+// never move.
+//
+// Allocations are laid out in a "logical" address space: the concatenation of
+// the used bytes of all the chunks, in order (see |GetOffset()|). |CopyTo()|
+// produces this layout in contiguous memory. Pointers are encoded as offsets
+// in the logical address space, and handles are collected into |handles()|,
+// as soon as they are written (see |Buffer::encodes_in_place()|), so that the
+// copy is ready to send as is.
+//
+// Typical usage:
+//
+//   ChunkedBuffer buf;
+//   Foo_Data* data;
+//   Serialize_(foo, &buf, &data);
+//
+//   void* bytes = malloc(buf.size());
+//   buf.CopyTo(bytes);
+//   Send(bytes, buf.size(), buf.handles());
+class ChunkedBuffer : public Buffer {
+ public:
+  static constexpr size_t kDefaultInitialChunkSize = 1024u;
+  static constexpr size_t kMaxChunkGrowthSize = 64u * 1024u;
+
+  // |initial_chunk_size| is the size of the first chunk (which is allocated
+  // lazily).
+  explicit ChunkedBuffer(size_t initial_chunk_size = kDefaultInitialChunkSize);
+  // Like the above, but uses |initial_chunk| (which must be 8-byte aligned,
+  // and must outlive this object) for the first chunk.
+  ChunkedBuffer(void* initial_chunk, size_t initial_chunk_size);
+  ~ChunkedBuffer() override;
+
+  // Returns the number of bytes allocated so far, i.e., the size of the
+  // logical address space.
+  size_t size() const { return current_.offset + current_.num_bytes; }
+
+  // Returns the number of chunks that have been started.
+  size_t num_chunks() const {
+    return full_chunks_.size() + (current_.num_bytes ? 1u : 0u);
+  }
+
+  // The handles encoded so far, in order.
+  std::vector<Handle>* handles() { return &handles_; }
+
+  // Returns the logical offset of |ptr|, which must point into memory
+  // allocated from this buffer.
+  size_t GetOffset(const void* ptr) const;
+
+  // Copies the |size()| bytes allocated so far, in logical order, to
+  // |destination|.
+  void CopyTo(void* destination) const;
+
+  // Allocates |num_bytes| bytes (rounded up to a multiple of 8), which are
+  // 8-byte aligned and zero-filled.
+  void* Allocate(size_t num_bytes) override;
+
+  // |Buffer|:
+  void EncodePointer(const void* ptr, uint64_t* offset) override;
+
+ protected:
+  struct Chunk {
+    char* data;
+    size_t capacity;
+    // Number of bytes used.
+    size_t num_bytes;
+    // Logical offset of |data|.
+    size_t offset;
+    // Whether |data| was allocated by (and must be freed by) this object.
+    bool owned;
+  };
+
+  // Returns the |index|-th chunk (in logical order); |index| must be less than
+  // |num_chunks()|.
+  const Chunk& chunk(size_t index) const {
+    return index < full_chunks_.size() ? full_chunks_[index] : current_;
+  }
+
+  // Allocates (uninitialized) memory for a chunk of at least |num_bytes| bytes,
+  // setting |*capacity| to its actual size, and frees it. By default, these
+  // use the heap. Subclasses that override them must call |FreeChunks()| from
+  // their destructors.
+  virtual void* AllocateChunk(size_t num_bytes, size_t* capacity);
+  virtual void FreeChunk(void* data, size_t capacity);
+
+  // Frees all the chunks (and forgets everything allocated from them).
+  void FreeChunks();
+
+ private:
+  // Unused memory is zero-filled in blocks of this size (or less, at the end
+  // of a chunk).
+  static constexpr size_t kZeroingBlockSize = 256u;
+
+  static bool ChunkContains(const Chunk& chunk, const char* ptr) {
+    return ptr >= chunk.data && ptr < chunk.data + chunk.num_bytes;
+  }
+
+  // Starts a new chunk with room for at least |num_bytes| bytes.
+  void StartChunk(size_t num_bytes);
+
+  // The chunk that allocations are made from.
+  Chunk current_;
+  // Earlier chunks, in order.
+  std::vector<Chunk> full_chunks_;
+  // Number of bytes at the start of |current_| that have been zero-filled
+  // (at least |current_.num_bytes|).
+  size_t num_zeroed_bytes_;
+
+  std::vector<Handle> handles_;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(ChunkedBuffer);
+};
+
+}  // namespace internal
+}  // namespace mojo
+
+#endif  // MOJO_PUBLIC_CPP_BINDINGS_LIB_CHUNKED_BUFFER_H_
@@ -6,6 +6,7 @@
 
 #include "mojo/public/cpp/environment/logging.h"
 #include "mojo/public/cpp/system/macros.h"
+#include "mojo/public/cpp/system/time.h"
 #include "mojo/public/cpp/system/wait.h"
 
 namespace mojo {
@@ -13,11 +14,19 @@ namespace internal {
 
 // ----------------------------------------------------------------------------
 
+// static
+constexpr uint32_t Connector::kDefaultMaxMessagesPerWakeup;
+
 Connector::Connector(ScopedMessagePipeHandle message_pipe,
                      const MojoAsyncWaiter* waiter)
     : waiter_(waiter),
+      watcher_(waiter == Environment::GetDefaultAsyncWaiter()
+                   ? Environment::GetDefaultAsyncWatcher()
+                   : nullptr),
       message_pipe_(message_pipe.Pass()),
       incoming_receiver_(nullptr),
+      max_messages_per_wakeup_(kDefaultMaxMessagesPerWakeup),
+      max_time_per_wakeup_(MOJO_DEADLINE_INDEFINITE),
       async_wait_id_(0),
       error_(false),
       drop_writes_(false),
@@ -69,16 +78,7 @@ bool Connector::Accept(Message* message) {
   if (drop_writes_)
     return true;
 
-  MojoResult rv =
-      WriteMessageRaw(message_pipe_.get(),
-                      message->data(),
-                      message->data_num_bytes(),
-                      message->mutable_handles()->empty()
-                          ? nullptr
-                          : reinterpret_cast<const MojoHandle*>(
-                                &message->mutable_handles()->front()),
-                      static_cast<uint32_t>(message->mutable_handles()->size()),
-                      MOJO_WRITE_MESSAGE_FLAG_NONE);
+  MojoResult rv = WriteMessage(message_pipe_.get(), message);
 
   switch (rv) {
     case MOJO_RESULT_OK:
@@ -122,7 +122,10 @@ void Connector::CallOnHandleReady(void* closure, MojoResult result) {
 
 void Connector::OnHandleReady(MojoResult result) {
   MOJO_CHECK(async_wait_id_ != 0);
-  async_wait_id_ = 0;
+  // A watch stays active across notifications (but ends on error); a one-shot
+  // wait is always done.
+  if (!watcher_ || result != MOJO_RESULT_OK)
+    async_wait_id_ = 0;
   if (result != MOJO_RESULT_OK) {
     NotifyError();
     return;
@@ -132,6 +135,17 @@ void Connector::OnHandleReady(MojoResult result) {
 }
 
 void Connector::WaitToReadMore() {
+  if (watcher_) {
+    // The watch is persistent, so it only needs to be set up once.
+    if (!async_wait_id_) {
+      async_wait_id_ = watcher_->AsyncWatch(message_pipe_.get().value(),
+                                            MOJO_HANDLE_SIGNAL_READABLE,
+                                            &Connector::CallOnHandleReady,
+                                            this);
+    }
+    return;
+  }
+
   MOJO_CHECK(!async_wait_id_);
   async_wait_id_ = waiter_->AsyncWait(message_pipe_.get().value(),
                                       MOJO_HANDLE_SIGNAL_READABLE,
@@ -149,8 +163,9 @@ bool Connector::ReadSingleMessage(MojoResult* read_result) {
   bool* previous_destroyed_flag = destroyed_flag_;
   destroyed_flag_ = &was_destroyed_during_dispatch;
 
-  MojoResult rv = ReadAndDispatchMessage(
-      message_pipe_.get(), incoming_receiver_, &receiver_result);
+  MojoResult rv =
+      ReadAndDispatchMessage(message_pipe_.get(), incoming_receiver_,
+                             &receiver_result, &read_buffer_);
   if (read_result)
     *read_result = rv;
 
@@ -173,6 +188,12 @@ bool Connector::ReadSingleMessage(MojoResult* read_result) {
 }
 
 void Connector::ReadAllAvailableMessages() {
+  uint32_t num_messages_read = 0u;
+  MojoTimeTicks yield_time = 0;
+  if (max_time_per_wakeup_ != MOJO_DEADLINE_INDEFINITE)
+    yield_time = GetTimeTicksNow() + static_cast<MojoTimeTicks>(
+                                         max_time_per_wakeup_);
+
   while (!error_) {
     MojoResult rv;
 
@@ -184,6 +205,18 @@ void Connector::ReadAllAvailableMessages() {
       WaitToReadMore();
       break;
     }
+
+    // If we've used up our budget, yield to the run loop. The pipe is probably
+    // still readable, so we'll be called again once the other ready handles
+    // (and due tasks) have been serviced.
+    num_messages_read++;
+    if ((max_messages_per_wakeup_ &&
+         num_messages_read >= max_messages_per_wakeup_) ||
+        (yield_time && GetTimeTicksNow() >= yield_time)) {
+      if (!error_ && message_pipe_.is_valid())
+        WaitToReadMore();
+      break;
+    }
   }
 }
 
@@ -191,7 +224,10 @@ void Connector::CancelWait() {
   if (!async_wait_id_)
     return;
 
-  waiter_->CancelWait(async_wait_id_);
+  if (watcher_)
+    watcher_->CancelWatch(async_wait_id_);
+  else
+    waiter_->CancelWait(async_wait_id_);
   async_wait_id_ = 0;
 }
 
@@ -27,6 +27,9 @@ namespace internal {
 //
 class Connector : public MessageReceiver {
  public:
+  // The default value for |set_max_messages_per_wakeup()|.
+  static constexpr uint32_t kDefaultMaxMessagesPerWakeup = 64u;
+
   // The Connector takes ownership of |message_pipe|.
   explicit Connector(
       ScopedMessagePipeHandle message_pipe,
@@ -53,6 +56,22 @@ class Connector : public MessageReceiver {
     connection_error_handler_ = error_handler;
   }
 
+  // Sets the maximum number of messages that will be read and dispatched each
+  // time the pipe becomes readable, before yielding back to the run loop (so
+  // that other handles and tasks on the same thread get a turn). Zero means no
+  // limit, i.e., read until there are no more messages.
+  void set_max_messages_per_wakeup(uint32_t max_messages) {
+    max_messages_per_wakeup_ = max_messages;
+  }
+
+  // Like |set_max_messages_per_wakeup()|, but limits the time (in
+  // microseconds) spent reading and dispatching messages. This is checked after
+  // each message, so a single slow message may exceed it.
+  // |MOJO_DEADLINE_INDEFINITE| (the default) means no limit.
+  void set_max_time_per_wakeup(MojoDeadline max_time) {
+    max_time_per_wakeup_ = max_time;
+  }
+
   // Returns true if an error was encountered while reading from the pipe or
   // waiting to read from the pipe.
   bool encountered_error() const { return error_; }
@@ -82,28 +101,45 @@ class Connector : public MessageReceiver {
 
   MessagePipeHandle handle() const { return message_pipe_.get(); }
 
+  // The buffer used to read incoming messages; exposes statistics about how
+  // often a message could not be read with a single |MojoReadMessage()| call.
+  const MessageReadBuffer& read_buffer() const { return read_buffer_; }
+
  private:
   static void CallOnHandleReady(void* closure, MojoResult result);
   void OnHandleReady(MojoResult result);
 
+  // Arranges for |OnHandleReady()| to be called when |message_pipe_| is
+  // readable. If |watcher_| is set, this installs a persistent watch (if there
+  // isn't one already), which then keeps firing while the pipe stays readable,
+  // so that yielding to the run loop doesn't require re-registering.
   void WaitToReadMore();
 
   // Returns false if |this| was destroyed during message dispatch.
   MOJO_WARN_UNUSED_RESULT bool ReadSingleMessage(MojoResult* read_result);
 
-  // |this| can be destroyed during message dispatch.
+  // Reads messages until there are none left or the per-wakeup budget is
+  // exhausted. |this| can be destroyed during message dispatch.
   void ReadAllAvailableMessages();
 
   void NotifyError();
 
-  // Cancels any calls made to |waiter_|.
+  // Cancels any calls made to |waiter_| (or |watcher_|).
   void CancelWait();
 
   Closure connection_error_handler_;
   const MojoAsyncWaiter* waiter_;
+  // The default async watcher, if |waiter_| is the default async waiter (and
+  // there is a default async watcher); otherwise null, in which case |waiter_|
+  // is used for one-shot waits.
+  const MojoAsyncWatcher* watcher_;
 
   ScopedMessagePipeHandle message_pipe_;
   MessageReceiver* incoming_receiver_;
+  MessageReadBuffer read_buffer_;
+
+  uint32_t max_messages_per_wakeup_;
+  MojoDeadline max_time_per_wakeup_;
 
   MojoAsyncWaitID async_wait_id_;
   bool error_;
@@ -6,6 +6,7 @@
 #define MOJO_PUBLIC_CPP_BINDINGS_LIB_ITERATOR_UTIL_H_
 
 #include <algorithm>
+#include <map>
 
 #include "mojo/public/cpp/bindings/array.h"
 #include "mojo/public/cpp/bindings/map.h"
@@ -35,13 +36,13 @@ namespace internal {
 
 // Interface for iterating over a Map<K, V>'s keys.
 // To construct a |MapKeyIterator|, pass in a non-null pointer to a Map<K, V>;
-template <typename K, typename V>
+template <typename K, typename V, typename Storage = std::map<K, V>>
 class MapKeyIterator {
  public:
   class Iterator {
    public:
     Iterator() : it_() {}
-    explicit Iterator(typename Map<K, V>::MapIterator it) : it_(it) {}
+    explicit Iterator(typename Map<K, V, Storage>::MapIterator it) : it_(it) {}
     Iterator& operator++() {
       ++it_;
       return *this;
@@ -66,27 +67,29 @@ class MapKeyIterator {
     const K* operator->() { return &it_.GetKey(); }
 
    private:
-    typename Map<K, V>::MapIterator it_;
+    typename Map<K, V, Storage>::MapIterator it_;
   };
 
-  explicit MapKeyIterator(Map<K, V>* map) : map_(map) { MOJO_DCHECK(map); }
+  explicit MapKeyIterator(Map<K, V, Storage>* map) : map_(map) {
+    MOJO_DCHECK(map);
+  }
 
   size_t size() const { return map_->size(); }
   Iterator begin() const { return Iterator{map_->begin()}; }
   Iterator end() const { return Iterator{map_->end()}; }
 
  private:
-  Map<K, V>* const map_;
+  Map<K, V, Storage>* const map_;
 };
 
 // Interface for iterating over a Map<K, V>'s values.
-template <typename K, typename V>
+template <typename K, typename V, typename Storage = std::map<K, V>>
 class MapValueIterator {
  public:
   class Iterator {
    public:
-    Iterator() : it_(typename Map<K, V>::MapIterator()) {}
-    explicit Iterator(typename Map<K, V>::MapIterator it) : it_(it) {}
+    Iterator() : it_(typename Map<K, V, Storage>::MapIterator()) {}
+    explicit Iterator(typename Map<K, V, Storage>::MapIterator it) : it_(it) {}
     Iterator& operator++() {
       ++it_;
       return *this;
@@ -111,16 +114,18 @@ class MapValueIterator {
     V* operator->() { return &it_.GetValue(); }
 
    private:
-    typename Map<K, V>::MapIterator it_;
+    typename Map<K, V, Storage>::MapIterator it_;
   };
 
-  explicit MapValueIterator(Map<K, V>* map) : map_(map) { MOJO_DCHECK(map); }
+  explicit MapValueIterator(Map<K, V, Storage>* map) : map_(map) {
+    MOJO_DCHECK(map);
+  }
   size_t size() const { return map_->size(); }
   Iterator begin() const { return Iterator{map_->begin()}; }
   Iterator end() const { return Iterator{map_->end()}; }
 
  private:
-  Map<K, V>* const map_;
+  Map<K, V, Storage>* const map_;
 };
 
 }  // namespace internal
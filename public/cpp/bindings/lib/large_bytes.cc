@@ -0,0 +1,116 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "mojo/public/cpp/bindings/large_bytes.h"
+
+#include <string.h>
+
+#include "mojo/public/cpp/environment/logging.h"
+
+namespace mojo {
+
+LargeBytesBuilder::LargeBytesBuilder(size_t num_bytes)
+    : num_bytes_(num_bytes), data_(nullptr), failed_(false) {
+  if (num_bytes <= kMaxInlineLargeBytesNumBytes) {
+    bytes_ = Array<uint8_t>::New(num_bytes);
+    data_ = bytes_.data();
+    return;
+  }
+
+  void* mapping = nullptr;
+  if (CreateSharedBuffer(nullptr, num_bytes, &buffer_) != MOJO_RESULT_OK ||
+      MapBuffer(buffer_.get(), 0u, num_bytes, &mapping,
+                MOJO_MAP_BUFFER_FLAG_NONE) != MOJO_RESULT_OK) {
+    buffer_.reset();
+    failed_ = true;
+    return;
+  }
+  data_ = static_cast<uint8_t*>(mapping);
+}
+
+LargeBytesBuilder::~LargeBytesBuilder() {
+  if (buffer_.is_valid() && data_)
+    UnmapBuffer(data_);
+}
+
+LargeBytesPtr LargeBytesBuilder::Finish() {
+  if (failed_)
+    return nullptr;
+
+  LargeBytesPtr large_bytes = LargeBytes::New();
+  if (!buffer_.is_valid()) {
+    MOJO_DCHECK(!bytes_.is_null());
+    large_bytes->set_bytes(bytes_.Pass());
+    data_ = nullptr;
+    return large_bytes;
+  }
+
+  UnmapBuffer(data_);
+  data_ = nullptr;
+  SharedBufferBytesPtr shared_buffer_bytes = SharedBufferBytes::New();
+  shared_buffer_bytes->buffer = buffer_.Pass();
+  shared_buffer_bytes->offset = 0u;
+  shared_buffer_bytes->num_bytes = num_bytes_;
+  large_bytes->set_shared_buffer_bytes(shared_buffer_bytes.Pass());
+  return large_bytes;
+}
+
+LargeBytesPtr CreateLargeBytes(const void* bytes, size_t num_bytes) {
+  LargeBytesBuilder builder(num_bytes);
+  if (num_bytes) {
+    if (!builder.data())
+      return nullptr;
+    memcpy(builder.data(), bytes, num_bytes);
+  }
+  return builder.Finish();
+}
+
+LargeBytesView::LargeBytesView()
+    : data_(nullptr), num_bytes_(0u), mapping_(nullptr) {}
+
+LargeBytesView::~LargeBytesView() {
+  Reset();
+}
+
+bool LargeBytesView::Init(const LargeBytes& large_bytes) {
+  Reset();
+
+  if (large_bytes.is_bytes()) {
+    const Array<uint8_t>& bytes = large_bytes.get_bytes();
+    if (bytes.is_null())
+      return true;
+    data_ = bytes.data();
+    num_bytes_ = bytes.size();
+    return true;
+  }
+
+  if (!large_bytes.is_shared_buffer_bytes())
+    return false;
+  const SharedBufferBytesPtr& shared_buffer_bytes =
+      large_bytes.get_shared_buffer_bytes();
+  if (!shared_buffer_bytes || !shared_buffer_bytes->buffer.is_valid())
+    return false;
+  if (!shared_buffer_bytes->num_bytes)
+    return true;
+  // This also checks that the range is within the buffer.
+  if (MapBuffer(shared_buffer_bytes->buffer.get(), shared_buffer_bytes->offset,
+                shared_buffer_bytes->num_bytes, &mapping_,
+                MOJO_MAP_BUFFER_FLAG_NONE) != MOJO_RESULT_OK) {
+    mapping_ = nullptr;
+    return false;
+  }
+  data_ = static_cast<const uint8_t*>(mapping_);
+  num_bytes_ = static_cast<size_t>(shared_buffer_bytes->num_bytes);
+  return true;
+}
+
+void LargeBytesView::Reset() {
+  if (mapping_)
+    UnmapBuffer(mapping_);
+  data_ = nullptr;
+  num_bytes_ = 0u;
+  mapping_ = nullptr;
+}
+
+}  // namespace mojo
@@ -5,7 +5,6 @@
 #ifndef MOJO_PUBLIC_CPP_BINDINGS_LIB_MAP_DATA_INTERNAL_H_
 #define MOJO_PUBLIC_CPP_BINDINGS_LIB_MAP_DATA_INTERNAL_H_
 
-#include <string>
 #include <vector>
 
 #include "mojo/public/cpp/bindings/lib/array_internal.h"
@@ -61,7 +60,7 @@ class Map_Data {
       const void* data,
       BoundsChecker* bounds_checker,
       const ArrayValidateParams* value_validate_params,
-      std::string* err) {
+      ValidationErrorRecord* err) {
     if (!data)
       return ValidationError::NONE;
 
@@ -73,52 +72,55 @@ class Map_Data {
     const Map_Data* object = static_cast<const Map_Data*>(data);
     if (object->header_.num_bytes != sizeof(Map_Data) ||
         object->header_.version != 0) {
-      MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err) << "";
-      return ValidationError::UNEXPECTED_STRUCT_HEADER;
+      return RecordValidationError(
+          err, ValidationError::UNEXPECTED_STRUCT_HEADER, data);
     }
 
     if (!ValidateEncodedPointer(&object->keys.offset)) {
-      MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err) << "";
-      return ValidationError::ILLEGAL_POINTER;
+      return RecordValidationError(err, ValidationError::ILLEGAL_POINTER,
+                                   &object->keys);
     }
 
     if (!object->keys.offset) {
-      MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err) << "null key array in map struct";
-      return ValidationError::UNEXPECTED_NULL_POINTER;
+      return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+          err, ValidationError::UNEXPECTED_NULL_POINTER, &object->keys,
+          "null key array in map struct");
     }
 
+    const ArrayHeader* key_header =
+        static_cast<const ArrayHeader*>(DecodePointerRaw(&object->keys.offset));
     const ArrayValidateParams* key_validate_params =
         MapKeyValidateParamsFactory<Key>::Get();
-    retval =
-        Array_Data<Key>::Validate(DecodePointerRaw(&object->keys.offset),
-                                  bounds_checker, key_validate_params, err);
+    retval = Array_Data<Key>::Validate(key_header, bounds_checker,
+                                       key_validate_params, err);
     if (retval != ValidationError::NONE)
       return retval;
+    bounds_checker->DecodePointer(&object->keys);
 
     if (!ValidateEncodedPointer(&object->values.offset)) {
-      MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err) << "";
-      return ValidationError::ILLEGAL_POINTER;
+      return RecordValidationError(err, ValidationError::ILLEGAL_POINTER,
+                                   &object->values);
     }
 
     if (!object->values.offset) {
-      MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err)
-          << "null value array in map struct";
-      return ValidationError::UNEXPECTED_NULL_POINTER;
+      return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+          err, ValidationError::UNEXPECTED_NULL_POINTER, &object->values,
+          "null value array in map struct");
     }
 
-    retval =
-        Array_Data<Value>::Validate(DecodePointerRaw(&object->values.offset),
-                                    bounds_checker, value_validate_params, err);
+    const ArrayHeader* value_header = static_cast<const ArrayHeader*>(
+        DecodePointerRaw(&object->values.offset));
+    retval = Array_Data<Value>::Validate(value_header, bounds_checker,
+                                         value_validate_params, err);
     if (retval != ValidationError::NONE)
       return retval;
+    bounds_checker->DecodePointer(&object->values);
 
-    const ArrayHeader* key_header =
-        static_cast<const ArrayHeader*>(DecodePointerRaw(&object->keys.offset));
-    const ArrayHeader* value_header = static_cast<const ArrayHeader*>(
-        DecodePointerRaw(&object->values.offset));
     if (key_header->num_elements != value_header->num_elements) {
-      MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err) << "";
-      return ValidationError::DIFFERENT_SIZED_ARRAYS_IN_MAP;
+      SetValidationErrorExpectedArraySize(err, value_header->num_elements,
+                                          key_header->num_elements);
+      return RecordValidationError(
+          err, ValidationError::DIFFERENT_SIZED_ARRAYS_IN_MAP, value_header);
     }
 
     return ValidationError::NONE;
@@ -5,14 +5,162 @@
 #ifndef MOJO_PUBLIC_CPP_BINDINGS_LIB_MAP_INTERNAL_H_
 #define MOJO_PUBLIC_CPP_BINDINGS_LIB_MAP_INTERNAL_H_
 
+#include <algorithm>
 #include <map>
+#include <utility>
+#include <vector>
 
 #include "mojo/public/cpp/bindings/array.h"
 #include "mojo/public/cpp/bindings/lib/template_util.h"
+#include "mojo/public/cpp/environment/logging.h"
+#include "mojo/public/cpp/system/macros.h"
 
 namespace mojo {
 namespace internal {
 
+// The storage of a |FlatMap|: a container with the subset of the interface of
+// std::map used by |Map|, backed by a single vector of key-value pairs sorted
+// by key.
+//
+// The entries are always sorted, so reading a map never writes to it, and a
+// map may be read from several threads at once (as with std::map). Inserting
+// an entry takes linear time, unless its key is greater than all the keys
+// already in the map (as when a map is built in key order). To build a map
+// from entries in any order, append them all and then call |Sort()| once,
+// which is what |Map|'s constructor from arrays (and so deserialization)
+// does: building a map then costs one sort rather than an allocation per
+// entry, and no sort at all if the entries are already in order.
+//
+// Unlike std::map, inserting entries invalidates iterators and references.
+template <typename Key, typename Value>
+class FlatMapStorage {
+ public:
+  typedef std::pair<Key, Value> value_type;
+  typedef typename std::vector<value_type>::iterator iterator;
+  typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+  FlatMapStorage() {}
+
+  // Inserts |entry|, which is a pair of a key and a value, unless its key is
+  // already in the map.
+  template <typename Pair>
+  void insert(Pair&& entry) {
+    if (entries_.empty() || entries_.back().first < entry.first) {
+      entries_.emplace_back(std::forward<Pair>(entry));
+      return;
+    }
+    iterator it = LowerBound(entry.first);
+    if (entry.first < it->first)
+      entries_.emplace(it, std::forward<Pair>(entry));
+  }
+
+  // Appends |entry| without keeping the entries sorted. |Sort()| must be
+  // called once all the entries have been appended, before the map is used
+  // in any other way.
+  template <typename Pair>
+  void append(Pair&& entry) {
+    entries_.emplace_back(std::forward<Pair>(entry));
+  }
+
+  // Sorts the appended entries, dropping those whose key is the same as that
+  // of an entry appended before them (as std::map::insert() does).
+  void Sort() {
+    if (!std::is_sorted(entries_.begin(), entries_.end(), &KeyLess))
+      std::stable_sort(entries_.begin(), entries_.end(), &KeyLess);
+    entries_.erase(std::unique(entries_.begin(), entries_.end(),
+                               [](const value_type& a, const value_type& b) {
+                                 return !(a.first < b.first);
+                               }),
+                   entries_.end());
+  }
+
+  void reserve(size_t num_entries) { entries_.reserve(num_entries); }
+
+  size_t size() const { return entries_.size(); }
+
+  void clear() { entries_.clear(); }
+
+  void swap(FlatMapStorage& other) { entries_.swap(other.entries_); }
+
+  iterator begin() { return entries_.begin(); }
+  iterator end() { return entries_.end(); }
+  const_iterator begin() const { return entries_.cbegin(); }
+  const_iterator end() const { return entries_.cend(); }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+  iterator find(const Key& key) {
+    iterator it = LowerBound(key);
+    return it != entries_.end() && !(key < it->first) ? it : entries_.end();
+  }
+  const_iterator find(const Key& key) const {
+    return const_cast<FlatMapStorage*>(this)->find(key);
+  }
+
+  Value& at(const Key& key) {
+    iterator it = find(key);
+    MOJO_CHECK(it != entries_.end());
+    return it->second;
+  }
+  const Value& at(const Key& key) const {
+    return const_cast<FlatMapStorage*>(this)->at(key);
+  }
+
+  Value& operator[](const Key& key) {
+    iterator it = LowerBound(key);
+    if (it == entries_.end() || key < it->first)
+      it = entries_.insert(it, value_type(key, Value()));
+    return it->second;
+  }
+
+ private:
+  static bool KeyLess(const value_type& a, const value_type& b) {
+    return a.first < b.first;
+  }
+
+  iterator LowerBound(const Key& key) {
+    return std::lower_bound(
+        entries_.begin(), entries_.end(), key,
+        [](const value_type& entry, const Key& k) { return entry.first < k; });
+  }
+
+  std::vector<value_type> entries_;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(FlatMapStorage);
+};
+
+// Reserves room for |num_entries| entries in a map's storage, if the storage
+// supports it.
+template <typename Storage>
+inline void ReserveMapStorage(Storage* storage, size_t num_entries) {}
+
+template <typename Key, typename Value>
+inline void ReserveMapStorage(FlatMapStorage<Key, Value>* storage,
+                              size_t num_entries) {
+  storage->reserve(num_entries);
+}
+
+// Adds |entry| to a map's storage, which must be passed to |SortMapStorage()|
+// once all the entries have been added.
+template <typename Storage, typename Pair>
+inline void AppendToMapStorage(Storage* storage, Pair&& entry) {
+  storage->insert(std::forward<Pair>(entry));
+}
+
+template <typename Key, typename Value, typename Pair>
+inline void AppendToMapStorage(FlatMapStorage<Key, Value>* storage,
+                               Pair&& entry) {
+  storage->append(std::forward<Pair>(entry));
+}
+
+template <typename Storage>
+inline void SortMapStorage(Storage* storage) {}
+
+template <typename Key, typename Value>
+inline void SortMapStorage(FlatMapStorage<Key, Value>* storage) {
+  storage->Sort();
+}
+
 template <typename Key, typename Value, bool kValueIsMoveOnlyType>
 struct MapTraits {};
 
@@ -21,14 +169,22 @@ template <typename Key, typename Value>
 struct MapTraits<Key, Value, false> {
   typedef const Value& ValueForwardType;
 
-  static inline void Insert(std::map<Key, Value>* m,
+  template <typename Storage>
+  static inline void Insert(Storage* m,
                             const Key& key,
                             ValueForwardType value) {
     m->insert(std::make_pair(key, value));
   }
-  static inline void Clone(const std::map<Key, Value>& src,
-                           std::map<Key, Value>* dst) {
+  template <typename Storage>
+  static inline void Append(Storage* m,
+                            const Key& key,
+                            ValueForwardType value) {
+    AppendToMapStorage(m, std::make_pair(key, value));
+  }
+  template <typename Storage>
+  static inline void Clone(const Storage& src, Storage* dst) {
     dst->clear();
+    ReserveMapStorage(dst, src.size());
     for (auto it = src.begin(); it != src.end(); ++it)
       dst->insert(*it);
   }
@@ -39,14 +195,18 @@ template <typename Key, typename Value>
 struct MapTraits<Key, Value, true> {
   typedef Value ValueForwardType;
 
-  static inline void Insert(std::map<Key, Value>* m,
-                            const Key& key,
-                            Value& value) {
+  template <typename Storage>
+  static inline void Insert(Storage* m, const Key& key, Value& value) {
     m->insert(std::make_pair(key, value.Pass()));
   }
-  static inline void Clone(const std::map<Key, Value>& src,
-                           std::map<Key, Value>* dst) {
+  template <typename Storage>
+  static inline void Append(Storage* m, const Key& key, Value& value) {
+    AppendToMapStorage(m, std::make_pair(key, value.Pass()));
+  }
+  template <typename Storage>
+  static inline void Clone(const Storage& src, Storage* dst) {
     dst->clear();
+    ReserveMapStorage(dst, src.size());
     for (auto it = src.begin(); it != src.end(); ++it)
       dst->insert(std::make_pair(it->first, it->second.Clone()));
   }
@@ -96,8 +96,8 @@ struct MapSerializer<String, String_Data*, false, false> {
 
 // TODO(erg): This can't go away yet. We still need to calculate out the size
 // of a struct header, and two arrays.
-template <typename MapKey, typename MapValue>
-inline size_t GetSerializedSize_(const Map<MapKey, MapValue>& input) {
+template <typename MapKey, typename MapValue, typename Storage>
+inline size_t GetSerializedSize_(const Map<MapKey, MapValue, Storage>& input) {
   if (!input)
     return 0;
   typedef typename internal::WrapperTraits<MapKey>::DataType DataKey;
@@ -136,10 +136,11 @@ inline size_t GetSerializedSize_(const Map<MapKey, MapValue>& input) {
 // non-nullable strings.)
 template <typename MapKey,
           typename MapValue,
+          typename Storage,
           typename DataKey,
           typename DataValue>
 inline internal::ValidationError SerializeMap_(
-    Map<MapKey, MapValue>* input,
+    Map<MapKey, MapValue, Storage>* input,
     internal::Buffer* buf,
     internal::Map_Data<DataKey, DataValue>** output,
     const internal::ArrayValidateParams* value_validate_params) {
@@ -159,7 +160,7 @@ inline internal::ValidationError SerializeMap_(
       internal::Array_Data<DataKey>::New(input->size(), buf);
   result->keys.ptr = keys_data;
 
-  internal::MapKeyIterator<MapKey, MapValue> key_iter(input);
+  internal::MapKeyIterator<MapKey, MapValue, Storage> key_iter(input);
   const internal::ArrayValidateParams* key_validate_params =
       internal::MapKeyValidateParamsFactory<DataKey>::Get();
 
@@ -169,13 +170,14 @@ inline internal::ValidationError SerializeMap_(
           key_validate_params);
   if (keys_retval != internal::ValidationError::NONE)
     return keys_retval;
+  internal::EncodePointerInPlace(buf, &result->keys);
 
   // Now we try allocate an Array_Data for the values
   internal::Array_Data<DataValue>* values_data =
       internal::Array_Data<DataValue>::New(input->size(), buf);
   result->values.ptr = values_data;
 
-  internal::MapValueIterator<MapKey, MapValue> value_iter(input);
+  internal::MapValueIterator<MapKey, MapValue, Storage> value_iter(input);
 
   auto values_retval =
       internal::ArraySerializer<MapValue, DataValue>::SerializeElements(
@@ -183,6 +185,7 @@ inline internal::ValidationError SerializeMap_(
           value_validate_params);
   if (values_retval != internal::ValidationError::NONE)
     return values_retval;
+  internal::EncodePointerInPlace(buf, &result->values);
 
   *output = result;
   return internal::ValidationError::NONE;
@@ -190,10 +193,11 @@ inline internal::ValidationError SerializeMap_(
 
 template <typename MapKey,
           typename MapValue,
+          typename Storage,
           typename DataKey,
           typename DataValue>
 inline void Deserialize_(internal::Map_Data<DataKey, DataValue>* input,
-                         Map<MapKey, MapValue>* output) {
+                         Map<MapKey, MapValue, Storage>* output) {
   if (input) {
     Array<MapKey> keys;
     Array<MapValue> values;
@@ -201,7 +205,7 @@ inline void Deserialize_(internal::Map_Data<DataKey, DataValue>* input,
     Deserialize_(input->keys.ptr, &keys);
     Deserialize_(input->values.ptr, &values);
 
-    *output = Map<MapKey, MapValue>(keys.Pass(), values.Pass());
+    *output = Map<MapKey, MapValue, Storage>(keys.Pass(), values.Pass());
   } else {
     output->reset();
   }
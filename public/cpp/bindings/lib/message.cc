@@ -4,13 +4,113 @@
 
 #include "mojo/public/cpp/bindings/message.h"
 
-#include <stdlib.h>
+#include <string.h>
 
 #include <algorithm>
 
+#include "mojo/public/cpp/bindings/lib/message_buffer_pool.h"
 #include "mojo/public/cpp/environment/logging.h"
+#include "mojo/public/cpp/system/buffer.h"
+#include "mojo/public/cpp/system/macros.h"
 
 namespace mojo {
+namespace {
+
+// The initial sizes of a |MessageReadBuffer|'s buffer and handle array. Most
+// messages are small and carry few (if any) handles.
+constexpr uint32_t kInitialReadBufferNumBytes = 256u;
+constexpr uint32_t kInitialReadBufferNumHandles = 4u;
+
+// Writes |message|'s data to a new shared buffer (straight from its segments,
+// so that external data is not first copied into the message), and then writes
+// an envelope carrying the buffer and the message's handles.
+MojoResult WriteLargeMessage(MessagePipeHandle handle, const Message& message) {
+  const uint32_t num_bytes = message.data_num_bytes();
+  ScopedSharedBufferHandle buffer;
+  MojoResult rv = CreateSharedBuffer(nullptr, num_bytes, &buffer);
+  if (rv != MOJO_RESULT_OK)
+    return rv;
+
+  void* mapping = nullptr;
+  rv = MapBuffer(buffer.get(), 0u, num_bytes, &mapping,
+                 MOJO_MAP_BUFFER_FLAG_NONE);
+  if (rv != MOJO_RESULT_OK)
+    return rv;
+  std::vector<MojoMessageSegment> segments;
+  message.GetDataSegments(&segments);
+  uint8_t* cursor = static_cast<uint8_t*>(mapping);
+  for (const auto& segment : segments) {
+    if (segment.num_bytes) {
+      memcpy(cursor, segment.bytes, segment.num_bytes);
+      cursor += segment.num_bytes;
+    }
+  }
+  UnmapBuffer(mapping);
+
+  internal::LargeMessageEnvelope envelope = {};
+  envelope.header.num_bytes = sizeof(internal::MessageHeader);
+  envelope.header.name = internal::kLargeMessageEnvelopeName;
+  envelope.magic = internal::kLargeMessageEnvelopeMagic;
+  envelope.version = internal::kLargeMessageEnvelopeVersion;
+  envelope.num_bytes = num_bytes;
+
+  std::vector<MojoHandle> handles;
+  handles.reserve(message.handles()->size() + 1u);
+  for (const Handle& message_handle : *message.handles())
+    handles.push_back(message_handle.value());
+  handles.push_back(buffer.get().value());
+  rv = WriteMessageRaw(handle, &envelope, sizeof(envelope), handles.data(),
+                       static_cast<uint32_t>(handles.size()),
+                       MOJO_WRITE_MESSAGE_FLAG_NONE);
+  if (rv == MOJO_RESULT_OK)
+    ignore_result(buffer.release());
+  return rv;
+}
+
+// If |message| (which was just read) is a large message envelope, replaces it
+// with the message it carries. The data is copied out of the shared buffer into
+// the message (which, like any other, must be contiguous to be validated and
+// decoded in place), rather than validated in the buffer, since the sender may
+// still have it mapped and could change it after it has been validated.
+// Messages that merely have the envelope's name are left alone (and rejected
+// like any other message with an unknown name), but an envelope of an unknown
+// version is an error.
+MojoResult MaybeUnpackLargeMessage(Message* message) {
+  if (message->data_num_bytes() != sizeof(internal::LargeMessageEnvelope))
+    return MOJO_RESULT_OK;
+  const internal::LargeMessageEnvelope* envelope =
+      reinterpret_cast<const internal::LargeMessageEnvelope*>(message->data());
+  if (envelope->header.name != internal::kLargeMessageEnvelopeName ||
+      envelope->header.num_bytes != sizeof(internal::MessageHeader) ||
+      envelope->header.version != 0u || envelope->header.flags != 0u ||
+      envelope->magic != internal::kLargeMessageEnvelopeMagic)
+    return MOJO_RESULT_OK;
+  if (envelope->version != internal::kLargeMessageEnvelopeVersion)
+    return MOJO_RESULT_UNIMPLEMENTED;
+
+  const uint32_t num_bytes = envelope->num_bytes;
+  if (message->handles()->empty())
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  ScopedSharedBufferHandle buffer(
+      SharedBufferHandle(message->handles()->back().value()));
+  message->mutable_handles()->pop_back();
+
+  void* mapping = nullptr;
+  if (MapBuffer(buffer.get(), 0u, num_bytes, &mapping,
+                MOJO_MAP_BUFFER_FLAG_NONE) != MOJO_RESULT_OK)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+
+  std::vector<Handle> handles;
+  handles.swap(*message->mutable_handles());
+  message->Reset();
+  message->AllocUninitializedData(num_bytes);
+  memcpy(message->mutable_data(), mapping, num_bytes);
+  message->mutable_handles()->swap(handles);
+  UnmapBuffer(mapping);
+  return MOJO_RESULT_OK;
+}
+
+}  // namespace
 
 Message::Message() {
   Initialize();
@@ -30,36 +130,91 @@ void Message::Reset() {
 void Message::AllocData(uint32_t num_bytes) {
   MOJO_DCHECK(!data_);
   data_num_bytes_ = num_bytes;
-  data_ = static_cast<internal::MessageData*>(calloc(num_bytes, 1));
+  data_ = static_cast<internal::MessageData*>(
+      internal::MessageBufferPool::current()->AllocateZeroed(num_bytes,
+                                                             &data_capacity_));
 }
 
 void Message::AllocUninitializedData(uint32_t num_bytes) {
   MOJO_DCHECK(!data_);
   data_num_bytes_ = num_bytes;
-  data_ = static_cast<internal::MessageData*>(malloc(num_bytes));
+  data_ = static_cast<internal::MessageData*>(
+      internal::MessageBufferPool::current()->Allocate(num_bytes,
+                                                       &data_capacity_));
 }
 
 void Message::MoveTo(Message* destination) {
   MOJO_DCHECK(this != destination);
 
+  InlineExternalData();
+
   destination->FreeDataAndCloseHandles();
 
   // No copy needed.
   destination->data_num_bytes_ = data_num_bytes_;
+  destination->data_capacity_ = data_capacity_;
   destination->data_ = data_;
   std::swap(destination->handles_, handles_);
+  destination->payload_decoded_ = payload_decoded_;
+  destination->num_decoded_handles_ = num_decoded_handles_;
 
   handles_.clear();
   Initialize();
 }
 
+void Message::AddExternalData(uint32_t offset,
+                              const void* bytes,
+                              uint32_t num_bytes) {
+  MOJO_DCHECK(data_);
+  MOJO_DCHECK(offset >= data_->header.num_bytes);
+  MOJO_DCHECK(num_bytes <= data_num_bytes_ - offset);
+  MOJO_DCHECK(external_data_.empty() ||
+              offset >= external_data_.back().offset +
+                            external_data_.back().num_bytes);
+  if (!num_bytes)
+    return;
+  ExternalData external_data = {offset, bytes, num_bytes};
+  external_data_.push_back(external_data);
+}
+
+void Message::InlineExternalData() const {
+  for (const auto& external_data : external_data_) {
+    memcpy(reinterpret_cast<uint8_t*>(data_) + external_data.offset,
+           external_data.bytes, external_data.num_bytes);
+  }
+  external_data_.clear();
+}
+
+void Message::GetDataSegments(
+    std::vector<MojoMessageSegment>* segments) const {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data_);
+  uint32_t offset = 0u;
+  for (const auto& external_data : external_data_) {
+    MojoMessageSegment buffer_segment = {bytes + offset,
+                                         external_data.offset - offset};
+    segments->push_back(buffer_segment);
+    MojoMessageSegment external_segment = {external_data.bytes,
+                                           external_data.num_bytes};
+    segments->push_back(external_segment);
+    offset = external_data.offset + external_data.num_bytes;
+  }
+  MojoMessageSegment buffer_segment = {bytes + offset,
+                                       data_num_bytes_ - offset};
+  segments->push_back(buffer_segment);
+}
+
 void Message::Initialize() {
   data_num_bytes_ = 0;
+  data_capacity_ = 0;
   data_ = nullptr;
+  payload_decoded_ = false;
+  num_decoded_handles_ = 0u;
 }
 
 void Message::FreeDataAndCloseHandles() {
-  free(data_);
+  external_data_.clear();
+  if (data_)
+    internal::MessageBufferPool::current()->Free(data_, data_capacity_);
 
   for (std::vector<Handle>::iterator it = handles_.begin();
        it != handles_.end(); ++it) {
@@ -68,6 +223,38 @@ void Message::FreeDataAndCloseHandles() {
   }
 }
 
+MojoResult WriteMessage(MessagePipeHandle handle, Message* message) {
+  MOJO_DCHECK(handle.is_valid());
+  MOJO_DCHECK(message);
+
+  const MojoHandle* handles =
+      message->handles()->empty()
+          ? nullptr
+          : reinterpret_cast<const MojoHandle*>(&message->handles()->front());
+  uint32_t num_handles = static_cast<uint32_t>(message->handles()->size());
+
+  MojoResult rv;
+  if (!message->has_external_data()) {
+    rv = WriteMessageRaw(handle, message->data(), message->data_num_bytes(),
+                         handles, num_handles, MOJO_WRITE_MESSAGE_FLAG_NONE);
+  } else {
+    std::vector<MojoMessageSegment> segments;
+    message->GetDataSegments(&segments);
+    rv = WriteMessageRawV(handle, segments.data(),
+                          static_cast<uint32_t>(segments.size()), handles,
+                          num_handles, MOJO_WRITE_MESSAGE_FLAG_NONE);
+  }
+
+  // Only if the message is too large for the pipe (not, e.g., if memory ran
+  // out), fall back to sending it via a shared buffer (which only the C++
+  // bindings understand). The handles haven't been transferred, since the write
+  // failed.
+  if (rv == MOJO_RESULT_OUT_OF_RANGE &&
+      message->data_num_bytes() > sizeof(internal::LargeMessageEnvelope))
+    return WriteLargeMessage(handle, *message);
+  return rv;
+}
+
 MojoResult ReadMessage(MessagePipeHandle handle, Message* message) {
   MOJO_DCHECK(handle.is_valid());
   MOJO_DCHECK(message);
@@ -96,14 +283,92 @@ MojoResult ReadMessage(MessagePipeHandle handle, Message* message) {
   MOJO_DCHECK(num_bytes == num_bytes_actual);
   MOJO_DCHECK(num_handles == num_handles_actual);
 
-  return rv;
+  if (rv != MOJO_RESULT_OK)
+    return rv;
+  return MaybeUnpackLargeMessage(message);
+}
+
+MessageReadBuffer::MessageReadBuffer()
+    : num_bytes_(kInitialReadBufferNumBytes),
+      handles_(kInitialReadBufferNumHandles),
+      num_reads_(0u),
+      num_fallback_reads_(0u) {}
+
+MessageReadBuffer::~MessageReadBuffer() {}
+
+MojoResult ReadMessage(MessagePipeHandle handle,
+                       Message* message,
+                       MessageReadBuffer* read_buffer) {
+  MOJO_DCHECK(handle.is_valid());
+  MOJO_DCHECK(message);
+  MOJO_DCHECK(message->handles()->empty());
+  MOJO_DCHECK(message->data_num_bytes() == 0);
+  MOJO_DCHECK(read_buffer);
+
+  // Optimistically read directly into the message's (pooled) buffer, using all
+  // of its capacity.
+  message->AllocUninitializedData(read_buffer->num_bytes_);
+  uint32_t num_bytes = static_cast<uint32_t>(message->data_capacity_);
+  uint32_t num_handles = static_cast<uint32_t>(read_buffer->handles_.size());
+  MojoResult rv = ReadMessageRaw(
+      handle, message->mutable_data(), &num_bytes,
+      reinterpret_cast<MojoHandle*>(&read_buffer->handles_.front()),
+      &num_handles, MOJO_READ_MESSAGE_FLAG_NONE);
+
+  if (rv == MOJO_RESULT_OK) {
+    read_buffer->num_reads_++;
+    message->data_num_bytes_ = num_bytes;
+    message->mutable_handles()->assign(
+        read_buffer->handles_.begin(),
+        read_buffer->handles_.begin() + num_handles);
+    return MaybeUnpackLargeMessage(message);
+  }
+
+  message->Reset();
+  if (rv != MOJO_RESULT_RESOURCE_EXHAUSTED)
+    return rv;
+
+  // The message didn't fit. |num_bytes| and |num_handles| now hold its actual
+  // size; remember them for subsequent reads.
+  read_buffer->num_fallback_reads_++;
+  read_buffer->num_bytes_ = std::max(read_buffer->num_bytes_, num_bytes);
+  if (num_handles > read_buffer->handles_.size())
+    read_buffer->handles_.resize(num_handles);
+
+  message->AllocUninitializedData(num_bytes);
+  message->mutable_handles()->resize(num_handles);
+
+  uint32_t num_bytes_actual = num_bytes;
+  uint32_t num_handles_actual = num_handles;
+  rv = ReadMessageRaw(
+      handle, message->mutable_data(), &num_bytes_actual,
+      message->mutable_handles()->empty()
+          ? nullptr
+          : reinterpret_cast<MojoHandle*>(&message->mutable_handles()->front()),
+      &num_handles_actual, MOJO_READ_MESSAGE_FLAG_NONE);
+
+  MOJO_DCHECK(num_bytes == num_bytes_actual);
+  MOJO_DCHECK(num_handles == num_handles_actual);
+
+  if (rv != MOJO_RESULT_OK)
+    return rv;
+  read_buffer->num_reads_++;
+  return MaybeUnpackLargeMessage(message);
 }
 
 MojoResult ReadAndDispatchMessage(MessagePipeHandle handle,
                                   MessageReceiver* receiver,
                                   bool* receiver_result) {
+  return ReadAndDispatchMessage(handle, receiver, receiver_result, nullptr);
+}
+
+MojoResult ReadAndDispatchMessage(MessagePipeHandle handle,
+                                  MessageReceiver* receiver,
+                                  bool* receiver_result,
+                                  MessageReadBuffer* read_buffer) {
   Message message;
-  MojoResult rv = ReadMessage(handle, &message);
+  MojoResult rv = read_buffer ? ReadMessage(handle, &message, read_buffer)
+                              : ReadMessage(handle, &message);
   if (receiver && rv == MOJO_RESULT_OK)
     *receiver_result = receiver->Accept(&message);
 
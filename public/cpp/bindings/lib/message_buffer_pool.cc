@@ -0,0 +1,195 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "mojo/public/cpp/bindings/lib/message_buffer_pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mojo/public/cpp/environment/logging.h"
+
+namespace mojo {
+namespace internal {
+namespace {
+
+static_assert(MessageBufferPool::kMinBufferSize
+                      << (MessageBufferPool::kNumSizeClasses - 1u) ==
+                  MessageBufferPool::kMaxBufferSize,
+              "Size classes must span [kMinBufferSize, kMaxBufferSize]");
+
+pthread_key_t g_current_pool_key;
+
+void DeleteMessageBufferPool(void* pool) {
+  delete static_cast<MessageBufferPool*>(pool);
+}
+
+void InitializeCurrentPoolKeyIfNecessary() {
+  static pthread_once_t current_pool_key_once = PTHREAD_ONCE_INIT;
+  int error = pthread_once(&current_pool_key_once, []() {
+    int error = pthread_key_create(&g_current_pool_key,
+                                   &DeleteMessageBufferPool);
+    MOJO_ALLOW_UNUSED_LOCAL(error);
+    MOJO_DCHECK(!error);
+  });
+  MOJO_ALLOW_UNUSED_LOCAL(error);
+  MOJO_DCHECK(!error);
+}
+
+}  // namespace
+
+// static
+constexpr size_t MessageBufferPool::kMinBufferSize;
+constexpr size_t MessageBufferPool::kMaxBufferSize;
+constexpr size_t MessageBufferPool::kNumSizeClasses;
+constexpr size_t MessageBufferPool::kDefaultMaxCachedBuffersPerSizeClass;
+
+MessageBufferPool::MessageBufferPool()
+    : max_cached_buffers_per_size_class_(kDefaultMaxCachedBuffersPerSizeClass) {
+}
+
+MessageBufferPool::~MessageBufferPool() {
+  Trim();
+}
+
+// static
+MessageBufferPool* MessageBufferPool::current() {
+  InitializeCurrentPoolKeyIfNecessary();
+
+  MessageBufferPool* pool =
+      static_cast<MessageBufferPool*>(pthread_getspecific(g_current_pool_key));
+  if (!pool) {
+    pool = new MessageBufferPool();
+    int error = pthread_setspecific(g_current_pool_key, pool);
+    MOJO_ALLOW_UNUSED_LOCAL(error);
+    MOJO_DCHECK(!error);
+  }
+  return pool;
+}
+
+void* MessageBufferPool::Allocate(size_t num_bytes, size_t* capacity) {
+  MOJO_DCHECK(capacity);
+  stats_.num_allocations++;
+
+  if (num_bytes > kMaxBufferSize) {
+    *capacity = num_bytes;
+    return malloc(num_bytes);
+  }
+
+  size_t index = GetSizeClassIndex(num_bytes);
+  *capacity = kMinBufferSize << index;
+
+  SizeClass& size_class = size_classes_[index];
+  if (!size_class.head)
+    return malloc(*capacity);
+
+  stats_.num_cache_hits++;
+  FreeBuffer* buffer = size_class.head;
+  size_class.head = buffer->next;
+  size_class.count--;
+  return buffer;
+}
+
+void* MessageBufferPool::AllocateZeroed(size_t num_bytes, size_t* capacity) {
+  if (num_bytes > kMaxBufferSize) {
+    MOJO_DCHECK(capacity);
+    stats_.num_allocations++;
+    *capacity = num_bytes;
+    return calloc(num_bytes, 1u);
+  }
+
+  void* buffer = Allocate(num_bytes, capacity);
+  if (buffer)
+    memset(buffer, 0, num_bytes);
+  return buffer;
+}
+
+// static
+size_t MessageBufferPool::GetCapacity(size_t num_bytes) {
+  if (num_bytes > kMaxBufferSize)
+    return num_bytes;
+  return kMinBufferSize << GetSizeClassIndex(num_bytes);
+}
+
+void MessageBufferPool::Free(void* buffer, size_t capacity) {
+  if (!buffer)
+    return;
+  stats_.num_frees++;
+
+  if (capacity > kMaxBufferSize) {
+    free(buffer);
+    return;
+  }
+
+  size_t index = GetSizeClassIndex(capacity);
+  MOJO_DCHECK((kMinBufferSize << index) == capacity);
+  SizeClass& size_class = size_classes_[index];
+  if (size_class.count >= max_cached_buffers_per_size_class_) {
+    free(buffer);
+    return;
+  }
+
+  stats_.num_cached_frees++;
+  FreeBuffer* free_buffer = static_cast<FreeBuffer*>(buffer);
+  free_buffer->next = size_class.head;
+  size_class.head = free_buffer;
+  size_class.count++;
+}
+
+void MessageBufferPool::Trim() {
+  for (size_t i = 0u; i < kNumSizeClasses; i++)
+    TrimSizeClass(&size_classes_[i], 0u);
+}
+
+void MessageBufferPool::SetMaxCachedBuffersPerSizeClass(
+    size_t max_cached_buffers) {
+  max_cached_buffers_per_size_class_ = max_cached_buffers;
+  for (size_t i = 0u; i < kNumSizeClasses; i++)
+    TrimSizeClass(&size_classes_[i], max_cached_buffers);
+}
+
+size_t MessageBufferPool::GetNumCachedBuffers() const {
+  size_t num_cached_buffers = 0u;
+  for (size_t i = 0u; i < kNumSizeClasses; i++)
+    num_cached_buffers += size_classes_[i].count;
+  return num_cached_buffers;
+}
+
+// static
+size_t MessageBufferPool::GetSizeClassIndex(size_t num_bytes) {
+  MOJO_DCHECK(num_bytes <= kMaxBufferSize);
+  size_t index = 0u;
+  size_t size = kMinBufferSize;
+  while (size < num_bytes) {
+    size <<= 1;
+    index++;
+  }
+  return index;
+}
+
+void MessageBufferPool::TrimSizeClass(SizeClass* size_class,
+                                      size_t max_count) {
+  while (size_class->count > max_count) {
+    FreeBuffer* buffer = size_class->head;
+    size_class->head = buffer->next;
+    size_class->count--;
+    free(buffer);
+  }
+}
+
+// static
+void* MessageBufferPoolAllocated::operator new(size_t size) {
+  size_t capacity = 0u;
+  void* ptr = MessageBufferPool::current()->Allocate(size, &capacity);
+  MOJO_CHECK(ptr);
+  return ptr;
+}
+
+// static
+void MessageBufferPoolAllocated::operator delete(void* ptr, size_t size) {
+  MessageBufferPool::current()->Free(ptr, MessageBufferPool::GetCapacity(size));
+}
+
+}  // namespace internal
+}  // namespace mojo
@@ -0,0 +1,123 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MOJO_PUBLIC_CPP_BINDINGS_LIB_MESSAGE_BUFFER_POOL_H_
+#define MOJO_PUBLIC_CPP_BINDINGS_LIB_MESSAGE_BUFFER_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mojo/public/cpp/system/macros.h"
+
+namespace mojo {
+namespace internal {
+
+// MessageBufferPool is a per-thread cache of the memory backing
+// |mojo::Message| data. Buffers are grouped into power-of-two size classes
+// (from |kMinBufferSize| to |kMaxBufferSize| bytes); freed buffers are kept (up
+// to a bounded number per size class) and handed out again by later
+// allocations, so steady-state message traffic does not hit the heap. Requests
+// larger than |kMaxBufferSize| bypass the cache entirely.
+//
+// A buffer may be freed on a thread other than the one that allocated it; it is
+// then cached by the freeing thread's pool. This class is not thread-safe; use
+// |current()| to get the pool for the calling thread.
+class MessageBufferPool {
+ public:
+  static constexpr size_t kMinBufferSize = 64u;
+  static constexpr size_t kMaxBufferSize = 64u * 1024u;
+  static constexpr size_t kNumSizeClasses = 11u;
+  static constexpr size_t kDefaultMaxCachedBuffersPerSizeClass = 16u;
+
+  struct Stats {
+    // Number of calls to |Allocate()|.
+    uint64_t num_allocations = 0u;
+    // Number of allocations that were satisfied from the cache.
+    uint64_t num_cache_hits = 0u;
+    // Number of calls to |Free()|.
+    uint64_t num_frees = 0u;
+    // Number of freed buffers that were kept in the cache (the rest were
+    // returned to the heap).
+    uint64_t num_cached_frees = 0u;
+  };
+
+  MessageBufferPool();
+  ~MessageBufferPool();
+
+  // Returns the pool for the current thread, creating it if necessary. The
+  // pool (and any buffers it has cached) is destroyed when the thread exits.
+  static MessageBufferPool* current();
+
+  // Returns an uninitialized, 8-byte-aligned buffer of at least |num_bytes|
+  // bytes. |*capacity| is set to the actual size of the buffer, which must be
+  // passed back to |Free()|.
+  void* Allocate(size_t num_bytes, size_t* capacity);
+
+  // Like |Allocate()|, but the first |num_bytes| bytes of the buffer are
+  // zero-initialized. Large buffers come straight from |calloc()|, so that
+  // (typically) untouched pages need not be written at all.
+  void* AllocateZeroed(size_t num_bytes, size_t* capacity);
+
+  // Returns the capacity of the buffer that |Allocate()| returns for a request
+  // for |num_bytes| bytes.
+  static size_t GetCapacity(size_t num_bytes);
+
+  // Returns |buffer| (which must have been obtained from |Allocate()|, possibly
+  // from another thread's pool, with the given |capacity|) to the pool.
+  // |buffer| may be null.
+  void Free(void* buffer, size_t capacity);
+
+  // Releases all cached buffers back to the heap.
+  void Trim();
+
+  // Sets the maximum number of buffers cached per size class (trimming the
+  // cache if necessary). A value of zero disables caching.
+  void SetMaxCachedBuffersPerSizeClass(size_t max_cached_buffers);
+  size_t max_cached_buffers_per_size_class() const {
+    return max_cached_buffers_per_size_class_;
+  }
+
+  // Returns the number of buffers currently held in the cache.
+  size_t GetNumCachedBuffers() const;
+
+  const Stats& stats() const { return stats_; }
+  void ResetStats() { stats_ = Stats(); }
+
+ private:
+  // A cached buffer; the link is stored in the (otherwise unused) buffer
+  // memory itself.
+  struct FreeBuffer {
+    FreeBuffer* next;
+  };
+
+  struct SizeClass {
+    FreeBuffer* head = nullptr;
+    size_t count = 0u;
+  };
+
+  static size_t GetSizeClassIndex(size_t num_bytes);
+
+  void TrimSizeClass(SizeClass* size_class, size_t max_count);
+
+  SizeClass size_classes_[kNumSizeClasses];
+  size_t max_cached_buffers_per_size_class_;
+  Stats stats_;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(MessageBufferPool);
+};
+
+// Deriving from this class makes |new| and |delete| of the derived class use
+// the current thread's |MessageBufferPool|. This is meant for the small objects
+// allocated for each request or response (e.g., responders), which otherwise
+// add heap allocations to every round trip.
+class MessageBufferPoolAllocated {
+ public:
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr, size_t size);
+};
+
+}  // namespace internal
+}  // namespace mojo
+
+#endif  // MOJO_PUBLIC_CPP_BINDINGS_LIB_MESSAGE_BUFFER_POOL_H_
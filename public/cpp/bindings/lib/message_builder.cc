@@ -4,8 +4,12 @@
 
 #include "mojo/public/cpp/bindings/lib/message_builder.h"
 
+#include <string.h>
+
 #include "mojo/public/cpp/bindings/lib/bindings_serialization.h"
+#include "mojo/public/cpp/bindings/lib/message_buffer_pool.h"
 #include "mojo/public/cpp/bindings/message.h"
+#include "mojo/public/cpp/environment/logging.h"
 
 namespace mojo {
 namespace {
@@ -22,6 +26,103 @@ void Allocate(internal::Buffer* buf, Header** header) {
 
 namespace internal {
 
+// static
+constexpr size_t MessageBuffer::kMinExternalDataNumBytes;
+
+MessageBuffer::MessageBuffer() : message_(nullptr), scatter_gather_(false) {}
+
+MessageBuffer::~MessageBuffer() {}
+
+void MessageBuffer::Initialize(Message* message) {
+  message_ = message;
+  FixedBuffer::Initialize(message->mutable_data(), message->data_num_bytes());
+}
+
+void MessageBuffer::CopyBytes(void* destination,
+                              const void* source,
+                              size_t num_bytes) {
+  if (!scatter_gather_ || num_bytes < kMinExternalDataNumBytes) {
+    FixedBuffer::CopyBytes(destination, source, num_bytes);
+    return;
+  }
+
+  size_t offset = static_cast<size_t>(static_cast<char*>(destination) - ptr_);
+  MOJO_DCHECK(offset + num_bytes <= cursor_);
+  message_->AddExternalData(static_cast<uint32_t>(offset), source,
+                            static_cast<uint32_t>(num_bytes));
+}
+
+// static
+constexpr size_t ChunkedMessageBuffer::kInlineChunkSize;
+
+ChunkedMessageBuffer::ChunkedMessageBuffer()
+    : ChunkedBuffer(inline_chunk_, kInlineChunkSize), scatter_gather_(false) {}
+
+ChunkedMessageBuffer::~ChunkedMessageBuffer() {
+  FreeChunks();
+}
+
+void ChunkedMessageBuffer::MoveTo(Message* message) {
+  MOJO_DCHECK(!message->data_num_bytes());
+  message->AllocUninitializedData(static_cast<uint32_t>(size()));
+  uint8_t* data = message->mutable_data();
+
+  // The bytes of each chunk are copied or (if large enough, in scatter-gather
+  // mode) referenced, except for the blocks of bytes that |CopyBytes()|
+  // recorded, which are always referenced.
+  auto external_data = external_data_.begin();
+  for (size_t i = 0u; i < num_chunks(); i++) {
+    const Chunk& chunk = this->chunk(i);
+    const size_t end = chunk.offset + chunk.num_bytes;
+    size_t offset = chunk.offset;
+    while (offset < end) {
+      const bool at_external_data = external_data != external_data_.end() &&
+                                    external_data->offset < end;
+      const size_t next = at_external_data ? external_data->offset : end;
+      const char* bytes = chunk.data + (offset - chunk.offset);
+      if (scatter_gather_ &&
+          next - offset >= MessageBuffer::kMinExternalDataNumBytes) {
+        message->AddExternalData(static_cast<uint32_t>(offset), bytes,
+                                 static_cast<uint32_t>(next - offset));
+      } else {
+        memcpy(data + offset, bytes, next - offset);
+      }
+      if (!at_external_data)
+        break;
+      message->AddExternalData(external_data->offset, external_data->bytes,
+                               external_data->num_bytes);
+      offset = external_data->offset + external_data->num_bytes;
+      ++external_data;
+    }
+  }
+  MOJO_DCHECK(external_data == external_data_.end());
+  external_data_.clear();
+
+  message->mutable_handles()->swap(*handles());
+}
+
+void ChunkedMessageBuffer::CopyBytes(void* destination,
+                                     const void* source,
+                                     size_t num_bytes) {
+  if (!scatter_gather_ ||
+      num_bytes < MessageBuffer::kMinExternalDataNumBytes) {
+    ChunkedBuffer::CopyBytes(destination, source, num_bytes);
+    return;
+  }
+
+  ExternalData external_data = {static_cast<uint32_t>(GetOffset(destination)),
+                                source, static_cast<uint32_t>(num_bytes)};
+  external_data_.push_back(external_data);
+}
+
+void* ChunkedMessageBuffer::AllocateChunk(size_t num_bytes, size_t* capacity) {
+  return MessageBufferPool::current()->Allocate(num_bytes, capacity);
+}
+
+void ChunkedMessageBuffer::FreeChunk(void* data, size_t capacity) {
+  MessageBufferPool::current()->Free(data, capacity);
+}
+
 MessageWithRequestIDBuilder::MessageWithRequestIDBuilder(uint32_t name,
                                                          size_t payload_size,
                                                          uint32_t flags,
@@ -54,7 +155,36 @@ MessageBuilder::MessageBuilder() {}
 
 void MessageBuilder::Initialize(size_t size) {
   message_.AllocData(static_cast<uint32_t>(internal::Align(size)));
-  buf_.Initialize(message_.mutable_data(), message_.data_num_bytes());
+  buf_.Initialize(&message_);
+}
+
+SinglePassMessageBuilder::SinglePassMessageBuilder(uint32_t name)
+    : finished_(false) {
+  MessageHeader* header;
+  Allocate(&buf_, &header);
+  header->version = 0;
+  header->name = name;
+  header->flags = 0;
+}
+
+SinglePassMessageBuilder::SinglePassMessageBuilder(uint32_t name,
+                                                   uint32_t flags,
+                                                   uint64_t request_id)
+    : finished_(false) {
+  MessageHeaderWithRequestID* header;
+  Allocate(&buf_, &header);
+  header->version = 1;
+  header->name = name;
+  header->flags = flags;
+  header->request_id = request_id;
+}
+
+SinglePassMessageBuilder::~SinglePassMessageBuilder() {}
+
+void SinglePassMessageBuilder::Finish() {
+  MOJO_DCHECK(!finished_);
+  buf_.MoveTo(&message_);
+  finished_ = true;
 }
 
 }  // namespace mojo
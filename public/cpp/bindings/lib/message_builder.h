@@ -10,6 +10,9 @@
 
 #include <stdint.h>
 
+#include <vector>
+
+#include "mojo/public/cpp/bindings/lib/chunked_buffer.h"
 #include "mojo/public/cpp/bindings/lib/fixed_buffer.h"
 #include "mojo/public/cpp/bindings/lib/message_internal.h"
 #include "mojo/public/cpp/bindings/message.h"
@@ -18,6 +21,86 @@ namespace mojo {
 
 class Message;
 
+namespace internal {
+
+// The buffer used by |MessageBuilder|: a |FixedBuffer| over the message's data
+// that, in scatter-gather mode, records large blocks of bytes as external data
+// of the message (see |Message::AddExternalData()|) instead of copying them.
+class MessageBuffer : public FixedBuffer {
+ public:
+  // Blocks of bytes smaller than this are always copied, since for them the
+  // copy is cheaper than the bookkeeping.
+  static constexpr size_t kMinExternalDataNumBytes = 4096u;
+
+  MessageBuffer();
+  ~MessageBuffer() override;
+
+  void Initialize(Message* message);
+
+  void set_scatter_gather(bool scatter_gather) {
+    scatter_gather_ = scatter_gather;
+  }
+
+  // |Buffer|:
+  void CopyBytes(void* destination,
+                 const void* source,
+                 size_t num_bytes) override;
+
+ private:
+  Message* message_;
+  bool scatter_gather_;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(MessageBuffer);
+};
+
+// The buffer used by |SinglePassMessageBuilder|: a |ChunkedBuffer| whose first
+// chunk is inline and whose other chunks come from the |MessageBufferPool| (so
+// that typical messages don't need heap allocations). In scatter-gather mode,
+// large blocks of bytes (passed to |CopyBytes()| or allocated directly) are
+// added to the message as external data instead of being copied into it.
+class ChunkedMessageBuffer : public ChunkedBuffer {
+ public:
+  static constexpr size_t kInlineChunkSize = 512u;
+
+  ChunkedMessageBuffer();
+  ~ChunkedMessageBuffer() override;
+
+  void set_scatter_gather(bool scatter_gather) {
+    scatter_gather_ = scatter_gather;
+  }
+
+  // Gives |message| (which must not have any data yet) the data allocated so
+  // far, and transfers the encoded handles to it. In scatter-gather mode, the
+  // message may refer to this object's memory, so it must not outlive it
+  // unless its data is accessed (or it is moved) first.
+  void MoveTo(Message* message);
+
+  // |Buffer|:
+  void CopyBytes(void* destination,
+                 const void* source,
+                 size_t num_bytes) override;
+
+ protected:
+  // |ChunkedBuffer|:
+  void* AllocateChunk(size_t num_bytes, size_t* capacity) override;
+  void FreeChunk(void* data, size_t capacity) override;
+
+ private:
+  struct ExternalData {
+    uint32_t offset;
+    const void* bytes;
+    uint32_t num_bytes;
+  };
+
+  bool scatter_gather_;
+  std::vector<ExternalData> external_data_;
+  uint64_t inline_chunk_[kInlineChunkSize / sizeof(uint64_t)];
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(ChunkedMessageBuffer);
+};
+
+}  // namespace internal
+
 // MessageBuilder helps initialize and frame a |mojo::Message| that does not
 // expect a response message, and therefore does not tag the message with a
 // request id (which may save some bytes).
@@ -32,6 +115,14 @@ class MessageBuilder {
 
   Message* message() { return &message_; }
 
+  // Enables scatter-gather mode: large strings and arrays of POD types
+  // serialized using |buffer()| are not copied into the message, but
+  // referenced in place until the message is written (or its data is
+  // accessed). The serialized values must therefore outlive any use of the
+  // message; this is the case for generated proxies, which pass the message to
+  // their receiver synchronously.
+  void EnableScatterGather() { buf_.set_scatter_gather(true); }
+
   // TODO(vardhan): |buffer()| is internal and only consumed by internal classes
   // and unittests.  Consider making it private + friend class its consumers?
   internal::Buffer* buffer() { return &buf_; }
@@ -41,7 +132,7 @@ class MessageBuilder {
   void Initialize(size_t size);
 
   Message message_;
-  internal::FixedBuffer buf_;
+  internal::MessageBuffer buf_;
 
   MOJO_DISALLOW_COPY_AND_ASSIGN(MessageBuilder);
 };
@@ -87,6 +178,44 @@ class ResponseMessageBuilder : public internal::MessageWithRequestIDBuilder {
                                     request_id) {}
 };
 
+// SinglePassMessageBuilder builds a |mojo::Message| without computing the
+// payload size in advance: the payload is serialized into a growable buffer,
+// which encodes pointers and handles as it goes (see
+// |internal::ChunkedBuffer|), and the message is then assembled by |Finish()|.
+// This saves the walks over the input that |GetSerializedSize_()| and
+// |EncodePointersAndHandles()| would otherwise take (and the latter must not be
+// used).
+class SinglePassMessageBuilder {
+ public:
+  // Frames a message that doesn't have a request id (see |MessageBuilder|).
+  explicit SinglePassMessageBuilder(uint32_t name);
+  // Frames a message with the given request id and flags (see
+  // |RequestMessageBuilder| and |ResponseMessageBuilder|).
+  SinglePassMessageBuilder(uint32_t name, uint32_t flags, uint64_t request_id);
+  ~SinglePassMessageBuilder();
+
+  // See |MessageBuilder::EnableScatterGather()|.
+  void EnableScatterGather() { buf_.set_scatter_gather(true); }
+
+  internal::Buffer* buffer() { return &buf_; }
+
+  // Assembles the message from everything serialized using |buffer()|. This
+  // must be called (once) before |message()|.
+  void Finish();
+
+  Message* message() {
+    MOJO_DCHECK(finished_);
+    return &message_;
+  }
+
+ private:
+  Message message_;
+  internal::ChunkedMessageBuffer buf_;
+  bool finished_;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(SinglePassMessageBuilder);
+};
+
 }  // namespace mojo
 
 #endif  // MOJO_PUBLIC_CPP_BINDINGS_LIB_MESSAGE_BUILDER_H_
@@ -4,8 +4,6 @@
 
 #include "mojo/public/cpp/bindings/lib/message_header_validator.h"
 
-#include <string>
-
 #include "mojo/public/cpp/bindings/lib/bounds_checker.h"
 #include "mojo/public/cpp/bindings/lib/message_validation.h"
 #include "mojo/public/cpp/bindings/lib/validation_errors.h"
@@ -17,27 +15,27 @@ namespace internal {
 namespace {
 
 ValidationError ValidateMessageHeader(const MessageHeader* header,
-                                      std::string* err) {
+                                      ValidationErrorRecord* err) {
   // NOTE: Our goal is to preserve support for future extension of the message
   // header. If we encounter fields we do not understand, we must ignore them.
   // Extra validation of the struct header:
   if (header->version == 0) {
     if (header->num_bytes != sizeof(MessageHeader)) {
-      MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err)
-          << "message header size is incorrect";
-      return ValidationError::UNEXPECTED_STRUCT_HEADER;
+      return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+          err, ValidationError::UNEXPECTED_STRUCT_HEADER, header,
+          "message header size is incorrect");
     }
   } else if (header->version == 1) {
     if (header->num_bytes != sizeof(MessageHeaderWithRequestID)) {
-      MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err)
-          << "message header (version = 1) size is incorrect";
-      return ValidationError::UNEXPECTED_STRUCT_HEADER;
+      return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+          err, ValidationError::UNEXPECTED_STRUCT_HEADER, header,
+          "message header (version = 1) size is incorrect");
     }
   } else if (header->version > 1) {
     if (header->num_bytes < sizeof(MessageHeaderWithRequestID)) {
-      MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err)
-          << "message header (version > 1) size is too small";
-      return ValidationError::UNEXPECTED_STRUCT_HEADER;
+      return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+          err, ValidationError::UNEXPECTED_STRUCT_HEADER, header,
+          "message header (version > 1) size is too small");
     }
   }
 
@@ -46,19 +44,19 @@ ValidationError ValidateMessageHeader(const MessageHeader* header,
   // These flags require a RequestID.
   if (header->version < 1 && ((header->flags & kMessageExpectsResponse) ||
                               (header->flags & kMessageIsResponse))) {
-    MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err)
-        << "message header associates itself with a response but does not "
-           "contain a request id";
-    return ValidationError::MESSAGE_HEADER_MISSING_REQUEST_ID;
+    return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+        err, ValidationError::MESSAGE_HEADER_MISSING_REQUEST_ID, &header->flags,
+        "message header associates itself with a response but does not "
+        "contain a request id");
   }
 
   // These flags are mutually exclusive.
   if ((header->flags & kMessageExpectsResponse) &&
       (header->flags & kMessageIsResponse)) {
-    MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err)
-        << "message header cannot indicate itself as a response while also "
-           "expecting a response";
-    return ValidationError::MESSAGE_HEADER_INVALID_FLAGS;
+    return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+        err, ValidationError::MESSAGE_HEADER_INVALID_FLAGS, &header->flags,
+        "message header cannot indicate itself as a response while also "
+        "expecting a response");
   }
 
   return ValidationError::NONE;
@@ -66,22 +64,24 @@ ValidationError ValidateMessageHeader(const MessageHeader* header,
 
 }  // namespace
 
-ValidationError MessageHeaderValidator::Validate(const Message* message,
-                                                 std::string* err) {
+ValidationError MessageHeaderValidator::Validate(Message* message,
+                                                 ValidationErrorRecord* err) {
   // Pass 0 as number of handles because we don't expect any in the header, even
   // if |message| contains handles.
   BoundsChecker bounds_checker(message->data(), message->data_num_bytes(), 0);
 
   ValidationError result =
       ValidateStructHeaderAndClaimMemory(message->data(), &bounds_checker, err);
-  if (result != ValidationError::NONE)
-    return result;
-
-  return ValidateMessageHeader(message->header(), err);
+  if (result == ValidationError::NONE)
+    result = ValidateMessageHeader(message->header(), err);
+  // The header may be too small to contain a message name.
+  if (result != ValidationError::NONE && err)
+    err->data = message->data();
+  return result;
 }
 
 ValidationError ValidateControlRequest(const Message* message,
-                                       std::string* err) {
+                                       ValidationErrorRecord* err) {
   ValidationError retval;
   switch (message->header()->name) {
     case kRunMessageId: {
@@ -102,10 +102,11 @@ ValidationError ValidateControlRequest(const Message* message,
     }
 
     default: {
-      MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err)
-          << "unknown InterfaceControlMessage request message name: "
-          << message->header()->name;
-      return ValidationError::MESSAGE_HEADER_UNKNOWN_METHOD;
+      SetValidationErrorMessage(err, message->data(), message->header()->name);
+      return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+          err, ValidationError::MESSAGE_HEADER_UNKNOWN_METHOD,
+          &message->header()->name,
+          "unknown InterfaceControlMessage request message name");
     }
   }
 
@@ -113,7 +114,7 @@ ValidationError ValidateControlRequest(const Message* message,
 }
 
 ValidationError ValidateControlResponse(const Message* message,
-                                        std::string* err) {
+                                        ValidationErrorRecord* err) {
   ValidationError retval = ValidateMessageIsResponse(message, err);
   if (retval != ValidationError::NONE)
     return retval;
@@ -124,10 +125,11 @@ ValidationError ValidateControlResponse(const Message* message,
                                                                    err);
   }
 
-  MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err)
-      << "unknown InterfaceControlMessage response message name: "
-      << message->header()->name;
-  return ValidationError::MESSAGE_HEADER_UNKNOWN_METHOD;
+  SetValidationErrorMessage(err, message->data(), message->header()->name);
+  return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+      err, ValidationError::MESSAGE_HEADER_UNKNOWN_METHOD,
+      &message->header()->name,
+      "unknown InterfaceControlMessage response message name");
 }
 
 }  // namespace internal
@@ -5,8 +5,6 @@
 #ifndef MOJO_PUBLIC_CPP_BINDINGS_LIB_MESSAGE_HEADER_VALIDATOR_H_
 #define MOJO_PUBLIC_CPP_BINDINGS_LIB_MESSAGE_HEADER_VALIDATOR_H_
 
-#include <string>
-
 #include "mojo/public/cpp/bindings/lib/validation_errors.h"
 #include "mojo/public/cpp/bindings/message_validator.h"
 
@@ -15,15 +13,16 @@ namespace internal {
 
 class MessageHeaderValidator final : public MessageValidator {
  public:
-  ValidationError Validate(const Message* message, std::string* err) override;
+  ValidationError Validate(Message* message,
+                           ValidationErrorRecord* err) override;
 };
 
 // The following methods validate control messages defined in
 // interface_control_messages.mojom.
 ValidationError ValidateControlRequest(const Message* message,
-                                       std::string* err);
+                                       ValidationErrorRecord* err);
 ValidationError ValidateControlResponse(const Message* message,
-                                        std::string* err);
+                                        ValidationErrorRecord* err);
 
 }  // namespace internal
 }  // namespace mojo
@@ -14,6 +14,19 @@ namespace internal {
 
 enum { kMessageExpectsResponse = 1 << 0, kMessageIsResponse = 1 << 1 };
 
+// The name of the envelope that |WriteMessage()| sends in place of a message
+// that is too large for the message pipe. No interface method may have this
+// ordinal.
+const uint32_t kLargeMessageEnvelopeName = 0xFFFFFFF0;
+
+// Identifies a large message envelope, beyond its name (it is "MojoLrgM" in
+// memory).
+const uint64_t kLargeMessageEnvelopeMagic = 0x4d67724c6f6a6f4dull;
+
+// The version of the large message envelope's format written by this code, and
+// the only one that it can read.
+const uint32_t kLargeMessageEnvelopeVersion = 1u;
+
 struct MessageHeader : internal::StructHeader {
   uint32_t name;
   uint32_t flags;
@@ -33,6 +46,20 @@ struct MessageData {
 static_assert(sizeof(MessageData) == sizeof(MessageHeader),
               "Bad sizeof(MessageData)");
 
+// A large message envelope: the message's data is in a shared buffer, whose
+// handle follows the message's own handles.
+struct LargeMessageEnvelope {
+  MessageHeader header;
+  // Always |kLargeMessageEnvelopeMagic|.
+  uint64_t magic;
+  // |kLargeMessageEnvelopeVersion|, as of the writer.
+  uint32_t version;
+  // The number of bytes of message data at the start of the shared buffer.
+  uint32_t num_bytes;
+};
+static_assert(sizeof(LargeMessageEnvelope) == 32,
+              "Bad sizeof(LargeMessageEnvelope)");
+
 #pragma pack(pop)
 
 }  // namespace internal
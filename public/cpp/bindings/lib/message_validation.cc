@@ -4,51 +4,58 @@
 
 #include "mojo/public/cpp/bindings/lib/message_validation.h"
 
-#include <string>
-
 #include "mojo/public/cpp/bindings/lib/validation_errors.h"
 #include "mojo/public/cpp/bindings/message.h"
 
 namespace mojo {
 namespace internal {
 
-ValidationError ValidateMessageIsRequestWithoutResponse(const Message* message,
-                                                        std::string* err) {
+ValidationError ValidateMessageIsRequestWithoutResponse(
+    const Message* message,
+    ValidationErrorRecord* err) {
   if (message->has_flag(kMessageIsResponse)) {
-    MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err)
-        << "message should be a request, not a response";
-    return ValidationError::MESSAGE_HEADER_INVALID_FLAGS;
+    SetValidationErrorMessage(err, message->data(), message->header()->name);
+    return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+        err, ValidationError::MESSAGE_HEADER_INVALID_FLAGS,
+        &message->header()->flags,
+        "message should be a request, not a response");
   }
   if (message->has_flag(kMessageExpectsResponse)) {
-    MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err)
-        << "message should not expect a response";
-    return ValidationError::MESSAGE_HEADER_INVALID_FLAGS;
+    SetValidationErrorMessage(err, message->data(), message->header()->name);
+    return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+        err, ValidationError::MESSAGE_HEADER_INVALID_FLAGS,
+        &message->header()->flags, "message should not expect a response");
   }
   return ValidationError::NONE;
 }
 
 ValidationError ValidateMessageIsRequestExpectingResponse(
     const Message* message,
-    std::string* err) {
+    ValidationErrorRecord* err) {
   if (message->has_flag(kMessageIsResponse)) {
-    MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err)
-        << "message should be a request, not a response";
-    return ValidationError::MESSAGE_HEADER_INVALID_FLAGS;
+    SetValidationErrorMessage(err, message->data(), message->header()->name);
+    return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+        err, ValidationError::MESSAGE_HEADER_INVALID_FLAGS,
+        &message->header()->flags,
+        "message should be a request, not a response");
   }
   if (!message->has_flag(kMessageExpectsResponse)) {
-    MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err)
-        << "message should expect a response";
-    return ValidationError::MESSAGE_HEADER_INVALID_FLAGS;
+    SetValidationErrorMessage(err, message->data(), message->header()->name);
+    return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+        err, ValidationError::MESSAGE_HEADER_INVALID_FLAGS,
+        &message->header()->flags, "message should expect a response");
   }
   return ValidationError::NONE;
 }
 
 ValidationError ValidateMessageIsResponse(const Message* message,
-                                          std::string* err) {
+                                          ValidationErrorRecord* err) {
   if (message->has_flag(kMessageExpectsResponse) ||
       !message->has_flag(kMessageIsResponse)) {
-    MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err) << "message should be a response";
-    return ValidationError::MESSAGE_HEADER_INVALID_FLAGS;
+    SetValidationErrorMessage(err, message->data(), message->header()->name);
+    return MOJO_INTERNAL_RECORD_VALIDATION_ERROR(
+        err, ValidationError::MESSAGE_HEADER_INVALID_FLAGS,
+        &message->header()->flags, "message should be a response");
   }
   return ValidationError::NONE;
 }
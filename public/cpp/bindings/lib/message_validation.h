@@ -5,33 +5,55 @@
 #ifndef MOJO_PUBLIC_CPP_BINDINGS_LIB_MESSAGE_VALIDATION_H_
 #define MOJO_PUBLIC_CPP_BINDINGS_LIB_MESSAGE_VALIDATION_H_
 
-#include <string>
-
 #include "mojo/public/cpp/bindings/lib/bounds_checker.h"
 #include "mojo/public/cpp/bindings/lib/validation_errors.h"
 #include "mojo/public/cpp/bindings/message.h"
+#include "mojo/public/cpp/environment/logging.h"
 
 namespace mojo {
 namespace internal {
 
 // Validates that the message is a request which doesn't expect a response.
-ValidationError ValidateMessageIsRequestWithoutResponse(const Message* message,
-                                                        std::string* err);
+ValidationError ValidateMessageIsRequestWithoutResponse(
+    const Message* message,
+    ValidationErrorRecord* err);
 // Validates that the message is a request expecting a response.
 ValidationError ValidateMessageIsRequestExpectingResponse(
     const Message* message,
-    std::string* err);
+    ValidationErrorRecord* err);
 // Validates that the message is a response.
 ValidationError ValidateMessageIsResponse(const Message* message,
-                                          std::string* err);
+                                          ValidationErrorRecord* err);
 
 // Validates that the message payload is a valid struct of type ParamsType.
 template <typename ParamsType>
 ValidationError ValidateMessagePayload(const Message* message,
-                                       std::string* err) {
+                                       ValidationErrorRecord* err) {
   BoundsChecker bounds_checker(message->payload(), message->payload_num_bytes(),
                                message->handles()->size());
-  return ParamsType::Validate(message->payload(), &bounds_checker, err);
+  ValidationError result =
+      ParamsType::Validate(message->payload(), &bounds_checker, err);
+  if (result != ValidationError::NONE)
+    SetValidationErrorMessage(err, message->data(), message->header()->name);
+  return result;
+}
+
+// Like |ValidateMessagePayload()|, but also decodes the payload's pointers and
+// handles in the same pass (see |Message::DecodePayload()|). The payload is
+// left partially decoded if it is invalid, so it must not be used then.
+template <typename ParamsType>
+ValidationError ValidateAndDecodeMessagePayload(Message* message,
+                                                ValidationErrorRecord* err) {
+  MOJO_DCHECK(!message->payload_decoded());
+  void* payload = message->mutable_payload();
+  DecodingBoundsChecker bounds_checker(payload, message->payload_num_bytes(),
+                                       message->mutable_handles());
+  ValidationError result = ParamsType::Validate(payload, &bounds_checker, err);
+  if (result == ValidationError::NONE)
+    message->set_payload_decoded(bounds_checker.num_decoded_handles());
+  else
+    SetValidationErrorMessage(err, message->data(), message->header()->name);
+  return result;
 }
 
 }  // namespace internal
@@ -7,14 +7,14 @@
 namespace mojo {
 namespace internal {
 
-ValidationError PassThroughValidator::Validate(const Message* message,
-                                               std::string* err) {
+ValidationError PassThroughValidator::Validate(Message* message,
+                                               ValidationErrorRecord* err) {
   return ValidationError::NONE;
 }
 
 ValidationError RunValidatorsOnMessage(const MessageValidatorList& validators,
-                                       const Message* message,
-                                       std::string* err) {
+                                       Message* message,
+                                       ValidationErrorRecord* err) {
   for (const auto& validator : validators) {
     auto result = validator->Validate(message, err);
     if (result != ValidationError::NONE)
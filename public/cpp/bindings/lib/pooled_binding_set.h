@@ -0,0 +1,157 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MOJO_PUBLIC_CPP_BINDINGS_LIB_POOLED_BINDING_SET_H_
+#define MOJO_PUBLIC_CPP_BINDINGS_LIB_POOLED_BINDING_SET_H_
+
+#include <assert.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mojo/public/cpp/bindings/binding.h"
+#include "mojo/public/cpp/bindings/interface_request.h"
+#include "mojo/public/cpp/system/macros.h"
+#include "mojo/public/cpp/utility/run_loop_pool.h"
+
+namespace mojo {
+namespace internal {
+
+// The implementation of |BindingSet| and |StrongBindingSet| when they are
+// given a |RunLoopPool|: each binding is pinned to one of the pool's threads
+// (chosen when it is added), on which it is created, dispatches messages, and
+// is destroyed. The bindings for each thread are kept in a separate list,
+// which is only touched on that thread, so no locking is needed to maintain
+// them.
+//
+// The methods of this class must not be called on one of the pool's threads
+// (since some of them wait for tasks on those threads).
+template <typename Interface>
+class PooledBindingSet {
+ public:
+  // If |owns_impls| is true, the implementation for a binding is deleted when
+  // it is closed (as for |StrongBindingSet|).
+  PooledBindingSet(RunLoopPool* pool,
+                   RunLoopPool::Policy policy,
+                   bool owns_impls)
+      : pool_(pool),
+        policy_(policy),
+        owns_impls_(owns_impls),
+        thread_bindings_(pool->num_threads()) {}
+  ~PooledBindingSet() { CloseAllBindings(); }
+
+  void AddBinding(Interface* impl, InterfaceRequest<Interface> request) {
+    size_t thread_index = pool_->AcquireThread(policy_);
+    size_.fetch_add(1u);
+    // |std::function|s must be copyable, so the (move-only) request can't be
+    // captured by value.
+    auto shared_request =
+        std::make_shared<InterfaceRequest<Interface>>(request.Pass());
+    pool_->PostTask(thread_index, [this, thread_index, impl,
+                                   shared_request]() {
+      BindingList* bindings = &thread_bindings_[thread_index];
+      bindings->emplace_back(
+          new Binding<Interface>(impl, shared_request->Pass()));
+      auto* binding = bindings->back().get();
+      binding->set_connection_error_handler([this, thread_index, binding]() {
+        BindingList* bindings = &thread_bindings_[thread_index];
+        auto it =
+            std::find_if(bindings->begin(), bindings->end(),
+                         [binding](const std::unique_ptr<Binding<Interface>>&
+                                       b) { return (b.get() == binding); });
+        assert(it != bindings->end());
+        if (owns_impls_)
+          delete binding->impl();
+        // Erasing the binding destroys this closure (and its captures).
+        PooledBindingSet* self = this;
+        size_t index = thread_index;
+        bindings->erase(it);
+        self->OnBindingsRemoved(index, 1u);
+      });
+    });
+  }
+
+  // Removes all bindings for |impl| (which is not destroyed).
+  void RemoveBindings(Interface* impl) {
+    RunOnAllThreads([this, impl](size_t thread_index) {
+      BindingList* bindings = &thread_bindings_[thread_index];
+      auto it = std::remove_if(
+          bindings->begin(), bindings->end(),
+          [impl](const std::unique_ptr<Binding<Interface>>& b) {
+            return (b->impl() == impl);
+          });
+      size_t num_removed = static_cast<size_t>(bindings->end() - it);
+      bindings->erase(it, bindings->end());
+      OnBindingsRemoved(thread_index, num_removed);
+    });
+  }
+
+  void CloseAllBindings() {
+    RunOnAllThreads([this](size_t thread_index) {
+      BindingList* bindings = &thread_bindings_[thread_index];
+      if (owns_impls_) {
+        for (auto it = bindings->begin(); it != bindings->end(); ++it)
+          delete (*it)->impl();
+      }
+      size_t num_removed = bindings->size();
+      bindings->clear();
+      OnBindingsRemoved(thread_index, num_removed);
+    });
+  }
+
+  // Note: This includes bindings that have been added, but not yet created on
+  // their threads.
+  size_t size() const { return size_.load(); }
+
+ private:
+  using BindingList = std::vector<std::unique_ptr<Binding<Interface>>>;
+
+  void OnBindingsRemoved(size_t thread_index, size_t num_removed) {
+    for (size_t i = 0u; i < num_removed; i++)
+      pool_->ReleaseThread(thread_index);
+    size_.fetch_sub(num_removed);
+  }
+
+  // Runs |task| (given the thread index) on each of the pool's threads, and
+  // waits for all of them to complete. Since tasks run in the order posted,
+  // this happens after any bindings previously added have been created.
+  void RunOnAllThreads(const std::function<void(size_t)>& task) {
+    const size_t num_threads = pool_->num_threads();
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    size_t num_done = 0u;
+    for (size_t i = 0u; i < num_threads; i++) {
+      assert(!pool_->IsOnThread(i));
+      pool_->PostTask(i, [i, &task, &mutex, &done_cv, &num_done]() {
+        task(i);
+        std::lock_guard<std::mutex> lock(mutex);
+        num_done++;
+        done_cv.notify_one();
+      });
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [num_threads, &num_done]() {
+      return num_done == num_threads;
+    });
+  }
+
+  RunLoopPool* const pool_;
+  const RunLoopPool::Policy policy_;
+  const bool owns_impls_;
+  // Indexed by pool thread index; element i is only accessed on thread i.
+  std::vector<BindingList> thread_bindings_;
+  std::atomic<size_t> size_{0u};
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(PooledBindingSet);
+};
+
+}  // namespace internal
+}  // namespace mojo
+
+#endif  // MOJO_PUBLIC_CPP_BINDINGS_LIB_POOLED_BINDING_SET_H_
@@ -0,0 +1,117 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "mojo/public/cpp/bindings/lib/responder_table.h"
+
+#include <utility>
+
+#include "mojo/public/cpp/environment/logging.h"
+
+namespace mojo {
+namespace internal {
+
+// static
+constexpr size_t ResponderTable::kInitialCapacity;
+
+ResponderTable::ResponderTable()
+    : entries_(kInitialCapacity), size_(0u), max_size_(0u) {}
+
+ResponderTable::~ResponderTable() {}
+
+void ResponderTable::Insert(uint64_t request_id, MessageReceiver* responder) {
+  MOJO_DCHECK(request_id);
+  MOJO_DCHECK(responder);
+  MOJO_DCHECK(!Find(request_id));
+
+  // Keep the load factor at most 1/2.
+  if (2u * (size_ + 1u) > entries_.size())
+    Grow();
+
+  Entry entry;
+  entry.request_id = request_id;
+  entry.responder = responder;
+  InsertEntry(entry);
+
+  size_++;
+  if (size_ > max_size_)
+    max_size_ = size_;
+}
+
+MessageReceiver* ResponderTable::Remove(uint64_t request_id) {
+  Entry* entry = Find(request_id);
+  if (!entry)
+    return nullptr;
+  MessageReceiver* responder = entry->responder;
+  size_--;
+
+  // Shift the following entries (up to an empty one or one in its home slot)
+  // back by one, so that they stay in probe distance order.
+  const size_t mask = entries_.size() - 1u;
+  size_t hole = static_cast<size_t>(entry - entries_.data());
+  for (size_t next = (hole + 1u) & mask;
+       entries_[next].request_id && GetProbeDistance(next);
+       next = (next + 1u) & mask) {
+    entries_[hole] = entries_[next];
+    hole = next;
+  }
+  entries_[hole] = Entry();
+
+  return responder;
+}
+
+void ResponderTable::RemoveAll(std::vector<MessageReceiver*>* responders) {
+  for (Entry& entry : entries_) {
+    if (entry.request_id) {
+      responders->push_back(entry.responder);
+      entry = Entry();
+    }
+  }
+  size_ = 0u;
+}
+
+ResponderTable::Entry* ResponderTable::Find(uint64_t request_id) {
+  if (!request_id)
+    return nullptr;
+
+  const size_t mask = entries_.size() - 1u;
+  for (size_t index = GetIndex(request_id), distance = 0u;;
+       index = (index + 1u) & mask, distance++) {
+    if (entries_[index].request_id == request_id)
+      return &entries_[index];
+    // If the entry at |index| is closer to its home slot, |request_id| would
+    // have displaced it (were it in the table).
+    if (!entries_[index].request_id || GetProbeDistance(index) < distance)
+      return nullptr;
+  }
+}
+
+void ResponderTable::InsertEntry(Entry entry) {
+  const size_t mask = entries_.size() - 1u;
+  for (size_t index = GetIndex(entry.request_id), distance = 0u;;
+       index = (index + 1u) & mask, distance++) {
+    if (!entries_[index].request_id) {
+      entries_[index] = entry;
+      return;
+    }
+    // Take the slot from an entry that is closer to its home slot, and continue
+    // inserting that entry instead ("Robin Hood" hashing).
+    size_t existing_distance = GetProbeDistance(index);
+    if (existing_distance < distance) {
+      std::swap(entry, entries_[index]);
+      distance = existing_distance;
+    }
+  }
+}
+
+void ResponderTable::Grow() {
+  std::vector<Entry> old_entries(2u * entries_.size());
+  old_entries.swap(entries_);
+  for (const Entry& entry : old_entries) {
+    if (entry.request_id)
+      InsertEntry(entry);
+  }
+}
+
+}  // namespace internal
+}  // namespace mojo
@@ -0,0 +1,89 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MOJO_PUBLIC_CPP_BINDINGS_LIB_RESPONDER_TABLE_H_
+#define MOJO_PUBLIC_CPP_BINDINGS_LIB_RESPONDER_TABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "mojo/public/cpp/system/macros.h"
+
+namespace mojo {
+
+class MessageReceiver;
+
+namespace internal {
+
+// ResponderTable maps (nonzero) request IDs to the responders waiting for their
+// responses. It is an open-addressing hash table indexed by the low bits of the
+// request ID; since a |Router| hands out request IDs sequentially, the requests
+// in flight at any time occupy mostly consecutive slots, and insertion, lookup,
+// and removal are all O(1) with few collisions. Collisions are resolved by
+// linear probing, keeping entries ordered by probe distance ("Robin Hood"
+// hashing), so that lookups of missing IDs and removals stop early. The table
+// grows (by doubling) as needed, but never shrinks.
+//
+// The table does not own the responders.
+class ResponderTable {
+ public:
+  static constexpr size_t kInitialCapacity = 16u;
+
+  ResponderTable();
+  ~ResponderTable();
+
+  // Adds an entry for |request_id|, which must be nonzero and not already in
+  // the table. |responder| must not be null.
+  void Insert(uint64_t request_id, MessageReceiver* responder);
+
+  // Removes the entry for |request_id|, returning its responder, or returns
+  // null if there is no such entry.
+  MessageReceiver* Remove(uint64_t request_id);
+
+  // Removes all entries, appending their responders (in no particular order)
+  // to |responders|.
+  void RemoveAll(std::vector<MessageReceiver*>* responders);
+
+  size_t size() const { return size_; }
+  bool empty() const { return !size_; }
+  // The largest |size()| has been (since construction).
+  size_t max_size() const { return max_size_; }
+
+ private:
+  struct Entry {
+    // Zero if the entry is empty.
+    uint64_t request_id = 0u;
+    MessageReceiver* responder = nullptr;
+  };
+
+  // Returns the home slot for |request_id|.
+  size_t GetIndex(uint64_t request_id) const {
+    return static_cast<size_t>(request_id) & (entries_.size() - 1u);
+  }
+  // Returns how far the (nonempty) entry at |index| is from its home slot.
+  size_t GetProbeDistance(size_t index) const {
+    return (index - GetIndex(entries_[index].request_id)) &
+           (entries_.size() - 1u);
+  }
+
+  // Returns the entry for |request_id|, or null if there is none.
+  Entry* Find(uint64_t request_id);
+  // Adds |entry| (without updating |size_|); there must be an empty slot.
+  void InsertEntry(Entry entry);
+  void Grow();
+
+  // The size is always a power of two.
+  std::vector<Entry> entries_;
+  size_t size_;
+  size_t max_size_;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(ResponderTable);
+};
+
+}  // namespace internal
+}  // namespace mojo
+
+#endif  // MOJO_PUBLIC_CPP_BINDINGS_LIB_RESPONDER_TABLE_H_
@@ -4,9 +4,10 @@
 
 #include "mojo/public/cpp/bindings/lib/router.h"
 
-#include <string>
 #include <utility>
+#include <vector>
 
+#include "mojo/public/cpp/bindings/lib/message_buffer_pool.h"
 #include "mojo/public/cpp/bindings/message_validator.h"
 #include "mojo/public/cpp/environment/logging.h"
 
@@ -15,7 +16,8 @@ namespace internal {
 
 // ----------------------------------------------------------------------------
 
-class ResponderThunk : public MessageReceiverWithStatus {
+class ResponderThunk : public MessageReceiverWithStatus,
+                       public MessageBufferPoolAllocated {
  public:
   explicit ResponderThunk(const SharedData<Router*>& router)
       : router_(router), accept_was_invoked_(false) {}
@@ -89,11 +91,10 @@ Router::Router(ScopedMessagePipeHandle message_pipe,
 Router::~Router() {
   weak_self_.set_value(nullptr);
 
-  for (ResponderMap::const_iterator i = responders_.begin();
-       i != responders_.end();
-       ++i) {
-    delete i->second;
-  }
+  std::vector<MessageReceiver*> responders;
+  responders_.RemoveAll(&responders);
+  for (MessageReceiver* responder : responders)
+    delete responder;
 }
 
 bool Router::Accept(Message* message) {
@@ -114,7 +115,7 @@ bool Router::AcceptWithResponder(Message* message, MessageReceiver* responder) {
     return false;
 
   // We assume ownership of |responder|.
-  responders_[request_id] = responder;
+  responders_.Insert(request_id, responder);
   return true;
 }
 
@@ -124,13 +125,8 @@ void Router::EnableTestingMode() {
 }
 
 bool Router::HandleIncomingMessage(Message* message) {
-  std::string* err = nullptr;
-#ifndef NDEBUG
-  std::string err2;
-  err = &err2;
-#endif
-
-  ValidationError result = RunValidatorsOnMessage(validators_, message, err);
+  ValidationErrorRecord err;
+  ValidationError result = RunValidatorsOnMessage(validators_, message, &err);
   if (result != ValidationError::NONE)
     return false;
 
@@ -147,14 +143,11 @@ bool Router::HandleIncomingMessage(Message* message) {
     // listening, then we have no choice but to tear down the pipe.
     connector_.CloseMessagePipe();
   } else if (message->has_flag(kMessageIsResponse)) {
-    uint64_t request_id = message->request_id();
-    ResponderMap::iterator it = responders_.find(request_id);
-    if (it == responders_.end()) {
+    MessageReceiver* responder = responders_.Remove(message->request_id());
+    if (!responder) {
       MOJO_DCHECK(testing_mode_);
       return false;
     }
-    MessageReceiver* responder = it->second;
-    responders_.erase(it);
     bool ok = responder->Accept(message);
     delete responder;
     return ok;
@@ -5,10 +5,11 @@
 #ifndef MOJO_PUBLIC_CPP_BINDINGS_LIB_ROUTER_H_
 #define MOJO_PUBLIC_CPP_BINDINGS_LIB_ROUTER_H_
 
-#include <map>
+#include <stddef.h>
 
 #include "mojo/public/cpp/bindings/callback.h"
 #include "mojo/public/cpp/bindings/lib/connector.h"
+#include "mojo/public/cpp/bindings/lib/responder_table.h"
 #include "mojo/public/cpp/bindings/lib/shared_data.h"
 #include "mojo/public/cpp/bindings/lib/validation_errors.h"
 #include "mojo/public/cpp/bindings/message_validator.h"
@@ -42,6 +43,16 @@ class Router : public MessageReceiverWithResponder {
   // waiting to read from the pipe.
   bool encountered_error() const { return connector_.encountered_error(); }
 
+  // See |Connector::set_max_messages_per_wakeup()|.
+  void set_max_messages_per_wakeup(uint32_t max_messages) {
+    connector_.set_max_messages_per_wakeup(max_messages);
+  }
+
+  // See |Connector::set_max_time_per_wakeup()|.
+  void set_max_time_per_wakeup(MojoDeadline max_time) {
+    connector_.set_max_time_per_wakeup(max_time);
+  }
+
   // Is the router bound to a MessagePipe handle?
   bool is_valid() const { return connector_.is_valid(); }
 
@@ -75,9 +86,13 @@ class Router : public MessageReceiverWithResponder {
 
   MessagePipeHandle handle() const { return connector_.handle(); }
 
- private:
-  typedef std::map<uint64_t, MessageReceiver*> ResponderMap;
+  // Returns the number of requests sent (via |AcceptWithResponder()|) whose
+  // responses have not yet been received.
+  size_t num_pending_responses() const { return responders_.size(); }
+  // Returns the largest |num_pending_responses()| has been.
+  size_t max_pending_responses() const { return responders_.max_size(); }
 
+ private:
   // This class is registered for incoming messages from the |Connector|.  It
   // simply forwards them to |Router::HandleIncomingMessages|.
   class HandleIncomingMessageThunk : public MessageReceiver {
@@ -99,7 +114,7 @@ class Router : public MessageReceiverWithResponder {
   Connector connector_;
   SharedData<Router*> weak_self_;
   MessageReceiverWithResponderStatus* incoming_receiver_;
-  ResponderMap responders_;
+  ResponderTable responders_;
   uint64_t next_request_id_;
   bool testing_mode_;
 };
@@ -4,8 +4,6 @@
 
 #include "mojo/public/cpp/bindings/lib/string_serialization.h"
 
-#include <string.h>
-
 namespace mojo {
 
 size_t GetSerializedSize_(const String& input) {
@@ -21,7 +19,7 @@ void SerializeString_(const String& input,
     internal::String_Data* result =
         internal::String_Data::New(input.size(), buf);
     if (result)
-      memcpy(result->storage(), input.data(), input.size());
+      buf->CopyBytes(result->storage(), input.data(), input.size());
     *output = result;
   } else {
     *output = nullptr;
@@ -26,14 +26,7 @@ bool SynchronousConnector::Write(Message* msg_to_send) {
   MOJO_DCHECK(handle_.is_valid());
   MOJO_DCHECK(msg_to_send);
 
-  auto result = WriteMessageRaw(
-      handle_.get(), msg_to_send->data(), msg_to_send->data_num_bytes(),
-      msg_to_send->mutable_handles()->empty()
-          ? nullptr
-          : reinterpret_cast<const MojoHandle*>(
-                msg_to_send->mutable_handles()->data()),
-      static_cast<uint32_t>(msg_to_send->mutable_handles()->size()),
-      MOJO_WRITE_MESSAGE_FLAG_NONE);
+  auto result = WriteMessage(handle_.get(), msg_to_send);
 
   switch (result) {
     case MOJO_RESULT_OK:
@@ -45,7 +38,7 @@ bool SynchronousConnector::Write(Message* msg_to_send) {
     case MOJO_RESULT_UNIMPLEMENTED:
     case MOJO_RESULT_BUSY:
     default:
-      MOJO_LOG(WARNING) << "WriteMessageRaw unsuccessful. error = " << result;
+      MOJO_LOG(WARNING) << "WriteMessage unsuccessful. error = " << result;
       return false;
   }
 
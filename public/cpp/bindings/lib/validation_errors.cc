@@ -4,6 +4,7 @@
 
 #include "mojo/public/cpp/bindings/lib/validation_errors.h"
 
+#include <sstream>
 #include <string>
 
 #include "mojo/public/cpp/environment/logging.h"
@@ -55,12 +56,63 @@ const char* ValidationErrorToString(ValidationError error) {
   return "Unknown error";
 }
 
-void ReportValidationError(ValidationError error, std::string* description) {
+// static
+constexpr uint32_t ValidationErrorRecord::kNotSet;
+
+ValidationErrorRecord::ValidationErrorRecord()
+    : error(ValidationError::NONE),
+      data(nullptr),
+      position(nullptr),
+      description(nullptr),
+      context(nullptr),
+      message_name(kNotSet),
+      array_size(kNotSet),
+      array_index(kNotSet),
+      expected_array_size(kNotSet) {}
+
+int64_t ValidationErrorRecord::offset() const {
+  if (!data || !position)
+    return -1;
+  return static_cast<int64_t>(reinterpret_cast<uintptr_t>(position) -
+                              reinterpret_cast<uintptr_t>(data));
+}
+
+std::string ValidationErrorRecord::ToString() const {
+  std::ostringstream stream;
+  stream << ValidationErrorToString(error);
+  if (context)
+    stream << ": " << context;
+  if (message_name != kNotSet)
+    stream << (context ? ", " : ": ") << "message name " << message_name;
+  if (description)
+    stream << ": " << description;
+
+  // The details, if any, go in parentheses.
+  bool has_details = false;
+  if (array_size != kNotSet) {
+    stream << " (array size " << array_size;
+    if (array_index != kNotSet)
+      stream << ", index " << array_index;
+    if (expected_array_size != kNotSet)
+      stream << ", expected size " << expected_array_size;
+    has_details = true;
+  }
+  if (offset() >= 0) {
+    stream << (has_details ? "; " : " (") << "offset " << offset();
+    has_details = true;
+  }
+  if (has_details)
+    stream << ")";
+  return stream.str();
+}
+
+void ReportValidationError(ValidationError error,
+                           const ValidationErrorRecord* record) {
+  MOJO_DCHECK(!record || record->error == error);
   if (g_validation_error_observer) {
     g_validation_error_observer->set_last_error(error);
-  } else if (description) {
-    MOJO_LOG(ERROR) << "Invalid message: " << ValidationErrorToString(error)
-                    << " (" << *description << ")";
+  } else if (record) {
+    MOJO_LOG(ERROR) << "Invalid message: " << record->ToString();
   } else {
     MOJO_LOG(ERROR) << "Invalid message: " << ValidationErrorToString(error);
   }
@@ -77,13 +129,5 @@ ValidationErrorObserverForTesting::~ValidationErrorObserverForTesting() {
   g_validation_error_observer = nullptr;
 }
 
-ValidationErrorStringStream::ValidationErrorStringStream(std::string* err_msg)
-    : err_msg_(err_msg) {}
-
-ValidationErrorStringStream::~ValidationErrorStringStream() {
-  if (err_msg_)
-    *err_msg_ = stream_.str();
-}
-
 }  // namespace internal
 }  // namespace mojo
@@ -5,7 +5,8 @@
 #ifndef MOJO_PUBLIC_CPP_BINDINGS_LIB_VALIDATION_ERRORS_H_
 #define MOJO_PUBLIC_CPP_BINDINGS_LIB_VALIDATION_ERRORS_H_
 
-#include <sstream>
+#include <stdint.h>
+
 #include <string>
 
 #include "mojo/public/cpp/environment/logging.h"
@@ -63,9 +64,108 @@ enum class ValidationError {
 
 const char* ValidationErrorToString(ValidationError error);
 
+// A fixed-size record of why validation failed. Validators fill it in (if one
+// is supplied) as they fail, without allocating: descriptions, interface names
+// and the like are string literals, and the failure's offset is computed from
+// two pointers. It is only formatted into text (see |ToString()|) when someone
+// asks, e.g., when the error is reported.
+//
+// A record describes a single failure, so use a new one for each validation.
+struct ValidationErrorRecord {
+  // The value of a numeric field that hasn't been set.
+  static constexpr uint32_t kNotSet = 0xFFFFFFFF;
+
+  ValidationErrorRecord();
+
+  // Returns the offset of |position| in the validated data, or -1 if either
+  // |data| or |position| is unknown.
+  int64_t offset() const;
+
+  // Formats the record, e.g.: "VALIDATION_ERROR_UNEXPECTED_NULL_POINTER:
+  // request validation error for interface 'Foo', message name 3: null bar
+  // field in Baz struct (offset 40)".
+  std::string ToString() const;
+
+  ValidationError error;
+
+  // The start of the data being validated (e.g., the message), and the
+  // position in it at which validation failed (if known).
+  const void* data;
+  const void* position;
+
+  // What failed, e.g., "null bar field in Baz struct". Only set in debug
+  // builds (see |MOJO_INTERNAL_RECORD_VALIDATION_ERROR()|).
+  const char* description;
+
+  // What was being validated, e.g., "request validation error for interface
+  // 'Foo'", and the name (ordinal) of the message being validated.
+  const char* context;
+  uint32_t message_name;
+
+  // For errors in arrays: the number of elements in the array, and the index
+  // of the offending element or the expected number of elements.
+  uint32_t array_size;
+  uint32_t array_index;
+  uint32_t expected_array_size;
+};
+
+// Records |error| at |position| (and |description|, which must be a string
+// literal or null) in |err|, if it is not null. Returns |error|.
+inline ValidationError RecordValidationError(
+    ValidationErrorRecord* err,
+    ValidationError error,
+    const void* position,
+    const char* description = nullptr) {
+  if (err) {
+    err->error = error;
+    err->position = position;
+    err->description = description;
+  }
+  return error;
+}
+
+// Records, in |err| if it is not null, that the failure was in element |index|
+// of an array of |array_size| elements.
+inline void SetValidationErrorArrayIndex(ValidationErrorRecord* err,
+                                         uint32_t array_size,
+                                         uint32_t index) {
+  if (err) {
+    err->array_size = array_size;
+    err->array_index = index;
+  }
+}
+
+// Records, in |err| if it is not null, that an array of |array_size| elements
+// was expected to have |expected_size| elements.
+inline void SetValidationErrorExpectedArraySize(ValidationErrorRecord* err,
+                                                uint32_t array_size,
+                                                uint32_t expected_size) {
+  if (err) {
+    err->array_size = array_size;
+    err->expected_array_size = expected_size;
+  }
+}
+
+// Records, in |err| if it is not null, the message that failed validation: its
+// data and name, and (if not null) the |context| (a string literal) that it was
+// validated in.
+inline void SetValidationErrorMessage(ValidationErrorRecord* err,
+                                      const void* message_data,
+                                      uint32_t message_name,
+                                      const char* context = nullptr) {
+  if (err) {
+    err->data = message_data;
+    err->message_name = message_name;
+    if (context)
+      err->context = context;
+  }
+}
+
+// Logs |error|, and the details in |record| (which must describe |error|) if it
+// is not null.
 // TODO(vardhan): This can die, along with |ValidationErrorObserverForTesting|.
 void ReportValidationError(ValidationError error,
-                           std::string* description = nullptr);
+                           const ValidationErrorRecord* record = nullptr);
 
 // Only used by validation tests and when there is only one thread doing message
 // validation.
@@ -83,22 +183,6 @@ class ValidationErrorObserverForTesting {
   MOJO_DISALLOW_COPY_AND_ASSIGN(ValidationErrorObserverForTesting);
 };
 
-// This takes in a string pointer, and provides a string stream which you can
-// write to. On destruction, it sets the provided string to the contents of the
-// string stream.
-class ValidationErrorStringStream {
- public:
-  explicit ValidationErrorStringStream(std::string* err_msg);
-  ~ValidationErrorStringStream();
-  std::ostringstream& stream() { return stream_; }
-
- private:
-  std::string* err_msg_;
-  std::ostringstream stream_;
-
-  MOJO_DISALLOW_COPY_AND_ASSIGN(ValidationErrorStringStream);
-};
-
 }  // namespace internal
 }  // namespace mojo
 
@@ -109,20 +193,18 @@ class ValidationErrorStringStream {
                      << ValidationErrorToString(error)               \
                      << " at the receiving side (" << description << ")."
 
-// In a debug build, this will use |ValidationErrorStringStream::stream()| and
-// write to the supplied string if it is not null. In a non-debug + optimized
-// build it should do nothing, while also discarding away operator<<() calls.
+// Records |error| at |position| in |err| (see |RecordValidationError()|) and
+// evaluates to |error|. In a debug build, it also records |description| (a
+// string literal); in a non-debug build, the description is discarded, so that
+// it doesn't take up space in the binary.
 #ifdef NDEBUG
-// The compiler will reduce the |true ? (void)0 : ...| expression to |(void)0|,
-// thereby discarding the |ValidationErrorStringStream()| while still keeping
-// this macro's use semantically valid.
-#define MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err_msg) \
-  true ? (void)0                                   \
-       : ::mojo::internal::VoidifyOstream() &      \
-             ::mojo::internal::ValidationErrorStringStream(err_msg).stream()
+#define MOJO_INTERNAL_RECORD_VALIDATION_ERROR(err, error, position,  \
+                                              description)           \
+  ::mojo::internal::RecordValidationError(err, error, position, nullptr)
 #else
-#define MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err_msg) \
-  ::mojo::internal::ValidationErrorStringStream(err_msg).stream()
+#define MOJO_INTERNAL_RECORD_VALIDATION_ERROR(err, error, position,  \
+                                              description)           \
+  ::mojo::internal::RecordValidationError(err, error, position, description)
 #endif  // NDEBUG
 
 #endif  // MOJO_PUBLIC_CPP_BINDINGS_LIB_VALIDATION_ERRORS_H_
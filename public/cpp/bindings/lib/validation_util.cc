@@ -4,48 +4,33 @@
 
 #include "mojo/public/cpp/bindings/lib/validation_util.h"
 
-#include <limits>
-#include <string>
-
 #include "mojo/public/cpp/bindings/lib/bindings_serialization.h"
 #include "mojo/public/cpp/bindings/lib/validation_errors.h"
 
 namespace mojo {
 namespace internal {
 
-bool ValidateEncodedPointer(const uint64_t* offset) {
-  // - Make sure |*offset| is no more than 32-bits.
-  // - Cast |offset| to uintptr_t so overflow behavior is well defined across
-  //   32-bit and 64-bit systems.
-  return *offset <= std::numeric_limits<uint32_t>::max() &&
-         (reinterpret_cast<uintptr_t>(offset) +
-              static_cast<uint32_t>(*offset) >=
-          reinterpret_cast<uintptr_t>(offset));
-}
-
 ValidationError ValidateStructHeaderAndClaimMemory(
     const void* data,
     BoundsChecker* bounds_checker,
-    std::string* err) {
-  if (!IsAligned(data)) {
-    MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err) << "";
-    return ValidationError::MISALIGNED_OBJECT;
-  }
+    ValidationErrorRecord* err) {
+  if (!IsAligned(data))
+    return RecordValidationError(err, ValidationError::MISALIGNED_OBJECT, data);
   if (!bounds_checker->IsValidRange(data, sizeof(StructHeader))) {
-    MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err) << "";
-    return ValidationError::ILLEGAL_MEMORY_RANGE;
+    return RecordValidationError(err, ValidationError::ILLEGAL_MEMORY_RANGE,
+                                 data);
   }
 
   const StructHeader* header = static_cast<const StructHeader*>(data);
 
   if (header->num_bytes < sizeof(StructHeader)) {
-    MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err) << "";
-    return ValidationError::UNEXPECTED_STRUCT_HEADER;
+    return RecordValidationError(err, ValidationError::UNEXPECTED_STRUCT_HEADER,
+                                 data);
   }
 
   if (!bounds_checker->ClaimMemory(data, header->num_bytes)) {
-    MOJO_INTERNAL_DEBUG_SET_ERROR_MSG(err) << "";
-    return ValidationError::ILLEGAL_MEMORY_RANGE;
+    return RecordValidationError(err, ValidationError::ILLEGAL_MEMORY_RANGE,
+                                 data);
   }
 
   return ValidationError::NONE;
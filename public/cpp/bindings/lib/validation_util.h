@@ -7,7 +7,7 @@
 
 #include <stdint.h>
 
-#include <string>
+#include <limits>
 
 #include "mojo/public/cpp/bindings/lib/bounds_checker.h"
 #include "mojo/public/cpp/bindings/lib/validation_errors.h"
@@ -17,7 +17,15 @@ namespace internal {
 
 // Checks whether decoding the pointer will overflow and produce a pointer
 // smaller than |offset|.
-bool ValidateEncodedPointer(const uint64_t* offset);
+inline bool ValidateEncodedPointer(const uint64_t* offset) {
+  // - Make sure |*offset| is no more than 32-bits.
+  // - Cast |offset| to uintptr_t so overflow behavior is well defined across
+  //   32-bit and 64-bit systems.
+  return *offset <= std::numeric_limits<uint32_t>::max() &&
+         (reinterpret_cast<uintptr_t>(offset) +
+              static_cast<uint32_t>(*offset) >=
+          reinterpret_cast<uintptr_t>(offset));
+}
 
 // Validates that |data| contains a valid struct header, in terms of alignment
 // and size (i.e., the |num_bytes| field of the header is sufficient for storing
@@ -29,7 +37,7 @@ bool ValidateEncodedPointer(const uint64_t* offset);
 ValidationError ValidateStructHeaderAndClaimMemory(
     const void* data,
     BoundsChecker* bounds_checker,
-    std::string* err);
+    ValidationErrorRecord* err);
 
 }  // namespace internal
 }  // namespace mojo
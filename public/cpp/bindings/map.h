@@ -8,6 +8,7 @@
 #include <map>
 #include <type_traits>
 
+#include "mojo/public/cpp/bindings/lib/bindings_internal.h"
 #include "mojo/public/cpp/bindings/lib/map_internal.h"
 #include "mojo/public/cpp/bindings/lib/template_util.h"
 
@@ -22,7 +23,11 @@ namespace mojo {
 //   - There can only be one entry per unique key.
 //   - Values of move-only types will be moved into the Map when they are added
 //     using the insert() method.
-template <typename Key, typename Value>
+//
+// |Storage| is the container holding the entries, which is an std::map unless
+// specified otherwise (see |FlatMap| below). It is declared (with its default)
+// in bindings_internal.h.
+template <typename Key, typename Value, typename Storage>
 class Map {
  public:
   // Map keys cannot be move only classes.
@@ -49,8 +54,10 @@ class Map {
   Map(mojo::Array<KeyType> keys, mojo::Array<ValueType> values)
       : is_null_(false) {
     MOJO_DCHECK(keys.size() == values.size());
+    internal::ReserveMapStorage(&map_, keys.size());
     for (size_t i = 0; i < keys.size(); ++i)
-      Traits::Insert(&map_, keys[i], values[i]);
+      Traits::Append(&map_, keys[i], values[i]);
+    internal::SortMapStorage(&map_);
   }
 
   ~Map() {}
@@ -116,7 +123,7 @@ class Map {
 
   // Swaps the contents of this Map with another Map of the same type (including
   // nullness).
-  void Swap(Map<KeyType, ValueType>* other) {
+  void Swap(Map* other) {
     std::swap(is_null_, other->is_null_);
     map_.swap(other->map_);
   }
@@ -124,7 +131,7 @@ class Map {
   // Swaps the contents of this Map with an std::map containing keys and values
   // of the same type. Since std::map cannot represent the null state, the
   // std::map will be empty if Map is null. The Map will always be left in a
-  // non-null state.
+  // non-null state. Only available if the Map is backed by an std::map.
   void Swap(std::map<KeyType, ValueType>* other) {
     is_null_ = false;
     map_.swap(*other);
@@ -177,8 +184,8 @@ class Map {
   class InternalIterator {
     using InternalIteratorType = typename std::conditional<
         MutabilityType == IteratorMutability::kConst,
-        typename std::map<KeyType, ValueType>::const_iterator,
-        typename std::map<KeyType, ValueType>::iterator>::type;
+        typename Storage::const_iterator,
+        typename Storage::iterator>::type;
 
     using ReturnValueType =
         typename std::conditional<MutabilityType == IteratorMutability::kConst,
@@ -247,22 +254,34 @@ class Map {
     Swap(other);
   }
 
-  std::map<KeyType, ValueType> map_;
+  Storage map_;
   bool is_null_;
 
   MOJO_MOVE_ONLY_TYPE(Map);
 };
 
+// A Map backed by a vector of entries sorted by key rather than by an std::map
+// (see |internal::FlatMapStorage|), which is cheaper to build, look up, iterate
+// and serialize for maps that are written once and then only read, e.g., maps
+// that are built to be sent in a message or that have been received in one.
+// A FlatMap should be built in key order or from arrays of keys and values
+// (in any order): inserting a key that is not greater than all the others
+// takes linear time. FlatMaps are serialized exactly like Maps.
+template <typename Key, typename Value>
+using FlatMap = Map<Key, Value, internal::FlatMapStorage<Key, Value>>;
+
 // Copies the contents of an std::map to a new Map, optionally changing the
 // types of the keys and values along the way using TypeConverter.
 template <typename MojoKey,
           typename MojoValue,
+          typename Storage,
           typename STLKey,
           typename STLValue>
-struct TypeConverter<Map<MojoKey, MojoValue>, std::map<STLKey, STLValue>> {
-  static Map<MojoKey, MojoValue> Convert(
+struct TypeConverter<Map<MojoKey, MojoValue, Storage>,
+                     std::map<STLKey, STLValue>> {
+  static Map<MojoKey, MojoValue, Storage> Convert(
       const std::map<STLKey, STLValue>& input) {
-    Map<MojoKey, MojoValue> result;
+    Map<MojoKey, MojoValue, Storage> result;
     result.mark_non_null();
     for (auto& pair : input) {
       result.insert(TypeConverter<MojoKey, STLKey>::Convert(pair.first),
@@ -276,11 +295,13 @@ struct TypeConverter<Map<MojoKey, MojoValue>, std::map<STLKey, STLValue>> {
 // the keys and values along the way using TypeConverter.
 template <typename MojoKey,
           typename MojoValue,
+          typename Storage,
           typename STLKey,
           typename STLValue>
-struct TypeConverter<std::map<STLKey, STLValue>, Map<MojoKey, MojoValue>> {
+struct TypeConverter<std::map<STLKey, STLValue>,
+                     Map<MojoKey, MojoValue, Storage>> {
   static std::map<STLKey, STLValue> Convert(
-      const Map<MojoKey, MojoValue>& input) {
+      const Map<MojoKey, MojoValue, Storage>& input) {
     std::map<STLKey, STLValue> result;
     if (!input.is_null()) {
       for (auto it = input.cbegin(); it != input.cend(); ++it) {
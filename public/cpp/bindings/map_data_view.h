@@ -0,0 +1,47 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MOJO_PUBLIC_CPP_BINDINGS_MAP_DATA_VIEW_H_
+#define MOJO_PUBLIC_CPP_BINDINGS_MAP_DATA_VIEW_H_
+
+#include <stddef.h>
+
+#include "mojo/public/cpp/bindings/array_data_view.h"
+#include "mojo/public/cpp/bindings/lib/map_data_internal.h"
+
+namespace mojo {
+
+// A read-only view of a serialized (and validated) map, which can be null. The
+// keys and values are viewed as parallel arrays (of the same size). See
+// |ArrayDataView| for details.
+template <typename Key, typename Value>
+class MapDataView {
+ public:
+  using Data_ =
+      internal::Map_Data<typename internal::DataViewTraits<Key>::Data,
+                         typename internal::DataViewTraits<Value>::Data>;
+
+  MapDataView() : data_(nullptr) {}
+  explicit MapDataView(const Data_* data) : data_(data) {}
+
+  bool is_null() const { return !data_; }
+
+  // The following are only valid if |!is_null()|.
+  size_t size() const { return data_->keys.ptr->size(); }
+  ArrayDataView<Key> keys() const {
+    return ArrayDataView<Key>(data_->keys.ptr);
+  }
+  ArrayDataView<Value> values() const {
+    return ArrayDataView<Value>(data_->values.ptr);
+  }
+
+ private:
+  const Data_* data_;
+
+  // Copying and assignment allowed.
+};
+
+}  // namespace mojo
+
+#endif  // MOJO_PUBLIC_CPP_BINDINGS_MAP_DATA_VIEW_H_
@@ -9,13 +9,25 @@
 
 #include "mojo/public/cpp/bindings/lib/message_internal.h"
 #include "mojo/public/cpp/environment/logging.h"
+#include "mojo/public/cpp/system/message_pipe.h"
 
 namespace mojo {
 
+class MessageReadBuffer;
+
 // Message is a holder for the data and handles to be sent over a MessagePipe.
 // Message owns its data and handles, but a consumer of Message is free to
 // mutate the data and handles. The message's data is comprised of a header
 // followed by payload.
+//
+// The memory backing the message's data is obtained from (and returned to) the
+// current thread's |internal::MessageBufferPool|.
+//
+// Parts of the data may be "external": rather than being copied into the
+// message's buffer, they are referenced in place (see |AddExternalData()|) and
+// only gathered when the message is written to a pipe (see |WriteMessage()|).
+// Accessing the raw bytes or payload (or moving the message) first copies any
+// external data into the buffer, so consumers need not be aware of it.
 class Message {
  public:
   Message();
@@ -26,16 +38,38 @@ class Message {
   void AllocData(uint32_t num_bytes);
   void AllocUninitializedData(uint32_t num_bytes);
 
-  // Transfers data and handles to |destination|.
+  // Transfers data and handles to |destination|. Any external data is copied
+  // into the message's buffer first.
   void MoveTo(Message* destination);
 
+  // Records that the |num_bytes| bytes of data at |offset| (which must be
+  // allocated but not otherwise written, and after any previously added
+  // external data) are to be taken from |bytes|. |bytes| must remain valid
+  // until the message is written or destroyed, or the external data is copied
+  // in (see |InlineExternalData()|), whichever comes first.
+  void AddExternalData(uint32_t offset, const void* bytes, uint32_t num_bytes);
+
+  bool has_external_data() const { return !external_data_.empty(); }
+
+  // Copies all external data into the message's buffer. (This is done
+  // implicitly by the accessors for the raw bytes and payload below.)
+  void InlineExternalData() const;
+
+  // Appends segments describing the message's data (for |MojoWriteMessageV()|)
+  // to |segments|: parts of the buffer interleaved with the external data.
+  void GetDataSegments(std::vector<MojoMessageSegment>* segments) const;
+
   uint32_t data_num_bytes() const { return data_num_bytes_; }
 
   // Access the raw bytes of the message.
   const uint8_t* data() const {
+    MaybeInlineExternalData();
     return reinterpret_cast<const uint8_t*>(data_);
   }
-  uint8_t* mutable_data() { return reinterpret_cast<uint8_t*>(data_); }
+  uint8_t* mutable_data() {
+    MaybeInlineExternalData();
+    return reinterpret_cast<uint8_t*>(data_);
+  }
 
   // Access the header.
   const internal::MessageHeader* header() const { return &data_->header; }
@@ -58,9 +92,11 @@ class Message {
 
   // Access the payload.
   const uint8_t* payload() const {
+    MaybeInlineExternalData();
     return reinterpret_cast<const uint8_t*>(data_) + data_->header.num_bytes;
   }
   uint8_t* mutable_payload() {
+    MaybeInlineExternalData();
     return reinterpret_cast<uint8_t*>(data_) + data_->header.num_bytes;
   }
   uint32_t payload_num_bytes() const {
@@ -72,13 +108,62 @@ class Message {
   const std::vector<Handle>* handles() const { return &handles_; }
   std::vector<Handle>* mutable_handles() { return &handles_; }
 
+  // Records that the payload's pointers and handles were decoded in place
+  // while it was validated (see |internal::ValidateAndDecodeMessagePayload()|),
+  // the decoded handles being the first |num_decoded_handles| of |handles()|.
+  // The message still owns those handles, until |DecodePayload()|.
+  void set_payload_decoded(uint32_t num_decoded_handles) {
+    payload_decoded_ = true;
+    num_decoded_handles_ = num_decoded_handles;
+  }
+  bool payload_decoded() const { return payload_decoded_; }
+
+  // Returns the payload as a |T| (a generated |..._Data| struct), with its
+  // pointers and handles decoded, transferring ownership of the handles to it.
+  // If the payload was not already decoded during validation, this decodes it.
+  template <typename T>
+  T* DecodePayload() {
+    T* payload = reinterpret_cast<T*>(mutable_payload());
+    if (!payload_decoded_) {
+      payload->DecodePointersAndHandles(&handles_);
+      return payload;
+    }
+    for (uint32_t i = 0u; i < num_decoded_handles_; i++)
+      handles_[i] = Handle();
+    num_decoded_handles_ = 0u;
+    return payload;
+  }
+
  private:
+  friend MojoResult ReadMessage(MessagePipeHandle handle,
+                                Message* message,
+                                MessageReadBuffer* read_buffer);
+
+  struct ExternalData {
+    uint32_t offset;
+    const void* bytes;
+    uint32_t num_bytes;
+  };
+
   void Initialize();
   void FreeDataAndCloseHandles();
 
+  void MaybeInlineExternalData() const {
+    if (!external_data_.empty())
+      InlineExternalData();
+  }
+
   uint32_t data_num_bytes_;
+  // The size of the buffer backing |data_|, as returned by
+  // |internal::MessageBufferPool::Allocate()|.
+  size_t data_capacity_;
   internal::MessageData* data_;
   std::vector<Handle> handles_;
+  bool payload_decoded_;
+  uint32_t num_decoded_handles_;
+  // Sorted by offset. This is mutable since copying external data into the
+  // buffer doesn't change the logical contents of the message.
+  mutable std::vector<ExternalData> external_data_;
 
   MOJO_DISALLOW_COPY_AND_ASSIGN(Message);
 };
@@ -143,17 +228,79 @@ class MessageReceiverWithResponderStatus : public MessageReceiver {
       MOJO_WARN_UNUSED_RESULT = 0;
 };
 
+// Scratch state that allows |ReadMessage()| to usually read a message with a
+// single call to |MojoReadMessage()|, instead of first querying the size of the
+// message and then reading it. The message is read optimistically into a buffer
+// as large as the largest message seen so far (and the handles into a handle
+// array owned by this object); only if the message does not fit do we fall back
+// to a second read. This class is not thread-safe, and should be used with only
+// one message pipe (e.g., one per |internal::Connector|).
+class MessageReadBuffer {
+ public:
+  MessageReadBuffer();
+  ~MessageReadBuffer();
+
+  // Returns the number of messages successfully read using this object.
+  uint64_t num_reads() const { return num_reads_; }
+
+  // Returns the number of times that a message did not fit into the buffer (or
+  // handle array), so that a second call to |MojoReadMessage()| was needed.
+  uint64_t num_fallback_reads() const { return num_fallback_reads_; }
+
+ private:
+  friend MojoResult ReadMessage(MessagePipeHandle handle,
+                                Message* message,
+                                MessageReadBuffer* read_buffer);
+
+  uint32_t num_bytes_;
+  std::vector<Handle> handles_;
+  uint64_t num_reads_;
+  uint64_t num_fallback_reads_;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(MessageReadBuffer);
+};
+
+// Writes |message| (its data, including any external data, and its handles) to
+// the pipe. |handle| must be valid. Uses |MojoWriteMessageV()| if the message
+// has external data (so that it is not copied), and |MojoWriteMessage()|
+// otherwise. On success, the message's handles have been transferred, and the
+// caller should clear them (without closing them).
+//
+// If the message is too large for the pipe (i.e., the write fails with
+// |MOJO_RESULT_OUT_OF_RANGE|), its data is instead copied into a shared
+// buffer, and a small envelope (see |internal::LargeMessageEnvelope|) carrying
+// the buffer and the message's handles is written, which |ReadMessage()|
+// replaces with the original message. Only the C++ bindings understand this
+// envelope, but such a message could not have been sent at all otherwise.
+//
+// This method propagates any errors produced by the underlying write (or by
+// creating and mapping the shared buffer). See
+// mojo/public/c/include/mojo/system/message_pipe.h for a description of its
+// possible return values.
+MojoResult WriteMessage(MessagePipeHandle handle, Message* message);
+
 // Read a single message from the pipe into the supplied |message|. |handle|
 // must be valid. |message| must be non-null and empty (i.e., clear of any data
 // and handles).
 //
 // This method calls into |MojoReadMessage()| and propagates any errors it
 // produces. See mojo/public/c/include/mojo/system/message_pipe.h for a
-// description of its possible return values.
+// description of its possible return values. If the message read is a large
+// message envelope, it is replaced by the message whose data is in the
+// envelope's shared buffer (copied out, since the sender may still be able to
+// modify the buffer); |MOJO_RESULT_INVALID_ARGUMENT| is returned if that buffer
+// is missing or too small, and |MOJO_RESULT_UNIMPLEMENTED| if the envelope is
+// of an unknown version.
 //
 // NOTE: The message isn't validated and may be malformed!
 MojoResult ReadMessage(MessagePipeHandle handle, Message* message);
 
+// Like the above, but uses |read_buffer| (which must be non-null) to avoid
+// querying the size of the message before reading it in the common case.
+MojoResult ReadMessage(MessagePipeHandle handle,
+                       Message* message,
+                       MessageReadBuffer* read_buffer);
+
 // Read a single message from the pipe and dispatch to the given receiver.
 // |handle| must be valid. |receiver| may be null, in which case the read
 // message is simply discarded. If |receiver| is not null, then
@@ -167,6 +314,13 @@ MojoResult ReadAndDispatchMessage(MessagePipeHandle handle,
                                   MessageReceiver* receiver,
                                   bool* receiver_result);
 
+// Like the above, but reads the message using |read_buffer| (see
+// |ReadMessage()|). |read_buffer| may be null.
+MojoResult ReadAndDispatchMessage(MessagePipeHandle handle,
+                                  MessageReceiver* receiver,
+                                  bool* receiver_result,
+                                  MessageReadBuffer* read_buffer);
+
 }  // namespace mojo
 
 #endif  // MOJO_PUBLIC_CPP_BINDINGS_MESSAGE_H_
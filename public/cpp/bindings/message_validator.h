@@ -5,7 +5,6 @@
 #ifndef MOJO_PUBLIC_CPP_BINDINGS_MESSAGE_VALIDATOR_H_
 #define MOJO_PUBLIC_CPP_BINDINGS_MESSAGE_VALIDATOR_H_
 
-#include <string>
 #include <vector>
 
 #include "mojo/public/cpp/bindings/lib/validation_errors.h"
@@ -21,27 +20,30 @@ class MessageValidator {
  public:
   virtual ~MessageValidator() {}
   // Validates the message and returns ValidationError::NONE if valid.
-  // Otherwise returns a different value, and sets the |err| string if it is not
-  // null.
-  virtual ValidationError Validate(const Message* message,
-                                   std::string* err) = 0;
+  // Otherwise returns a different value, and records the details of the error
+  // in |err| if it is not null. A validator may decode the payload of a valid
+  // message as it validates it (see |Message::payload_decoded()|).
+  virtual ValidationError Validate(Message* message,
+                                   ValidationErrorRecord* err) = 0;
 };
 
 // A message validator that does nothing, and always returns a non-error.
 class PassThroughValidator final : public MessageValidator {
  public:
-  ValidationError Validate(const Message* message, std::string* err) override;
+  ValidationError Validate(Message* message,
+                           ValidationErrorRecord* err) override;
 };
 
 using MessageValidatorList = std::vector<std::unique_ptr<MessageValidator>>;
 
 // Iterates through |validators| and tries to validate the given |message| until
 // a validator fails.  If a validator fails, a |ValidationError| is returned and
-// the supplied |err| is set if it is not null.  |ValidationError::NONE| is
-// returned if the supplied |message| passes all the |validators|.
+// its details are recorded in the supplied |err| if it is not null.
+// |ValidationError::NONE| is returned if the supplied |message| passes all the
+// |validators|.
 ValidationError RunValidatorsOnMessage(const MessageValidatorList& validators,
-                                       const Message* message,
-                                       std::string* err);
+                                       Message* message,
+                                       ValidationErrorRecord* err);
 
 }  // namespace internal
 }  // namespace mojo
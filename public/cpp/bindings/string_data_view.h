@@ -0,0 +1,38 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MOJO_PUBLIC_CPP_BINDINGS_STRING_DATA_VIEW_H_
+#define MOJO_PUBLIC_CPP_BINDINGS_STRING_DATA_VIEW_H_
+
+#include <stddef.h>
+
+#include "mojo/public/cpp/bindings/lib/array_internal.h"
+
+namespace mojo {
+
+// A read-only view of a serialized (and validated) string, which can be null.
+// It doesn't own (or copy) any data: it is only valid as long as the message
+// (or buffer) it points into. Note that the characters are not NUL-terminated.
+class StringDataView {
+ public:
+  using Data_ = internal::String_Data;
+
+  StringDataView() : data_(nullptr) {}
+  explicit StringDataView(const Data_* data) : data_(data) {}
+
+  bool is_null() const { return !data_; }
+
+  // Only valid if |!is_null()|.
+  const char* storage() const { return data_->storage(); }
+  size_t size() const { return data_->size(); }
+
+ private:
+  const Data_* data_;
+
+  // Copying and assignment allowed.
+};
+
+}  // namespace mojo
+
+#endif  // MOJO_PUBLIC_CPP_BINDINGS_STRING_DATA_VIEW_H_
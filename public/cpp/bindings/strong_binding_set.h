@@ -12,7 +12,9 @@
 #include <vector>
 
 #include "mojo/public/cpp/bindings/binding.h"
+#include "mojo/public/cpp/bindings/lib/pooled_binding_set.h"
 #include "mojo/public/cpp/system/macros.h"
+#include "mojo/public/cpp/utility/run_loop_pool.h"
 
 namespace mojo {
 
@@ -23,12 +25,24 @@ template <typename Interface>
 class StrongBindingSet {
  public:
   StrongBindingSet() {}
+  // Distributes the bindings over the threads of |pool| (which must outlive
+  // this set), choosing a thread for each according to |policy|. Each binding
+  // is created, dispatches messages, and is destroyed on its thread, and the
+  // methods of this set must not be called on any of the pool's threads.
+  // Each implementation is only called (and deleted) on its binding's thread.
+  StrongBindingSet(RunLoopPool* pool, RunLoopPool::Policy policy)
+      : pooled_bindings_(
+            new internal::PooledBindingSet<Interface>(pool, policy, true)) {}
   ~StrongBindingSet() { CloseAllBindings(); }
 
   // Adds a binding to the list and arranges for it to be removed when
   // a connection error occurs.  Takes ownership of |impl|, which
   // will be deleted when the binding is closed.
   void AddBinding(Interface* impl, InterfaceRequest<Interface> request) {
+    if (pooled_bindings_) {
+      pooled_bindings_->AddBinding(impl, request.Pass());
+      return;
+    }
     bindings_.emplace_back(new Binding<Interface>(impl, request.Pass()));
     auto* binding = bindings_.back().get();
     // Set the connection error handler for the newly added Binding to be a
@@ -48,6 +62,10 @@ class StrongBindingSet {
   // Removes all bindings for the specified interface implementation.
   // The implementation object is not destroyed.
   void RemoveBindings(Interface* impl) {
+    if (pooled_bindings_) {
+      pooled_bindings_->RemoveBindings(impl);
+      return;
+    }
     bindings_.erase(
         std::remove_if(bindings_.begin(), bindings_.end(),
                        [impl](const std::unique_ptr<Binding<Interface>>& b) {
@@ -57,16 +75,25 @@ class StrongBindingSet {
 
   // Closes all bindings and deletes their associated interfaces.
   void CloseAllBindings() {
+    if (pooled_bindings_) {
+      pooled_bindings_->CloseAllBindings();
+      return;
+    }
     for (auto it = bindings_.begin(); it != bindings_.end(); ++it) {
       delete (*it)->impl();
     }
     bindings_.clear();
   }
 
-  size_t size() const { return bindings_.size(); }
+  size_t size() const {
+    return pooled_bindings_ ? pooled_bindings_->size() : bindings_.size();
+  }
 
  private:
   std::vector<std::unique_ptr<Binding<Interface>>> bindings_;
+  // Only set if this set was given a |RunLoopPool| (in which case |bindings_|
+  // is unused).
+  std::unique_ptr<internal::PooledBindingSet<Interface>> pooled_bindings_;
 
   MOJO_DISALLOW_COPY_AND_ASSIGN(StrongBindingSet);
 };
@@ -0,0 +1,134 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares encoding and decoding large arrays of handles and of pointers one
+// element at a time (using |EncodeHandle()|, |Encode()|, etc.) with the bulk
+// paths used by |Array_Data| (see |EncodeHandles()| and |EncodePointers()|).
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "mojo/public/cpp/bindings/lib/array_internal.h"
+#include "mojo/public/cpp/bindings/lib/bindings_serialization.h"
+#include "mojo/public/cpp/bindings/lib/fixed_buffer.h"
+#include "mojo/public/cpp/system/time.h"
+#include "mojo/public/cpp/test_support/test_support.h"
+#include "third_party/gtest/include/gtest/gtest.h"
+
+namespace mojo {
+namespace test {
+namespace {
+
+using HandleArray = internal::Array_Data<Handle>;
+using PointerArray = internal::Array_Data<internal::Array_Data<uint8_t>*>;
+
+// Each measurement encodes and decodes about this many elements in total.
+const size_t kNumElementsPerRun = 1u << 24;
+
+void EncodeHandlesPerElement(HandleArray* array, std::vector<Handle>* handles) {
+  for (size_t i = 0u; i < array->size(); i++)
+    internal::EncodeHandle(&array->storage()[i], handles);
+}
+
+void DecodeHandlesPerElement(HandleArray* array, std::vector<Handle>* handles) {
+  for (size_t i = 0u; i < array->size(); i++)
+    internal::DecodeHandle(&array->storage()[i], handles);
+}
+
+void EncodePointersPerElement(PointerArray* array,
+                              std::vector<Handle>* handles) {
+  for (size_t i = 0u; i < array->size(); i++)
+    internal::Encode(&array->storage()[i], handles);
+}
+
+void DecodePointersPerElement(PointerArray* array,
+                              std::vector<Handle>* handles) {
+  for (size_t i = 0u; i < array->size(); i++)
+    internal::Decode(&array->storage()[i], handles);
+}
+
+// Reports the time taken, per element, to encode and then decode |array| in
+// place, both one element at a time and in bulk.
+template <typename ArrayType>
+void RunPerfTest(const std::string& test_name,
+                 ArrayType* array,
+                 void (*encode_per_element)(ArrayType*, std::vector<Handle>*),
+                 void (*decode_per_element)(ArrayType*, std::vector<Handle>*)) {
+  const size_t num_iterations =
+      std::max<size_t>(1u, kNumElementsPerRun / array->size());
+  for (bool bulk : {false, true}) {
+    std::vector<Handle> handles;
+    const MojoTimeTicks start_time = GetTimeTicksNow();
+    for (size_t i = 0u; i < num_iterations; i++) {
+      handles.clear();
+      if (bulk) {
+        array->EncodePointersAndHandles(&handles);
+        array->DecodePointersAndHandles(&handles);
+      } else {
+        encode_per_element(array, &handles);
+        decode_per_element(array, &handles);
+      }
+    }
+    const MojoTimeTicks elapsed = GetTimeTicksNow() - start_time;
+    test::LogPerfResult(
+        test_name.c_str(), bulk ? "Bulk" : "PerElement",
+        static_cast<double>(elapsed) * 1000.0 /
+            static_cast<double>(num_iterations * array->size()),
+        "nanoseconds/element");
+  }
+}
+
+TEST(ArraySerializationPerftest, Handles) {
+  for (size_t num_elements : {1000u, 32000u, 1000000u}) {
+    internal::FixedBufferForTesting buf(
+        internal::ArrayDataTraits<Handle>::GetStorageSize(
+            static_cast<uint32_t>(num_elements)));
+    HandleArray* array = HandleArray::New(num_elements, &buf);
+    // The handles are never used, so any (valid) values will do. Every so
+    // often there is a null handle, as in arrays of nullable handles.
+    for (size_t i = 0u; i < num_elements; i++) {
+      array->at(i) = Handle(i % 64u == 63u ? MOJO_HANDLE_INVALID
+                                           : static_cast<MojoHandle>(i + 1u));
+    }
+
+    RunPerfTest("EncodeDecodeHandles_" + std::to_string(num_elements), array,
+                &EncodeHandlesPerElement, &DecodeHandlesPerElement);
+
+    for (size_t i = 0u; i < num_elements; i++) {
+      EXPECT_EQ(i % 64u == 63u ? MOJO_HANDLE_INVALID
+                               : static_cast<MojoHandle>(i + 1u),
+                array->at(i).value());
+    }
+  }
+}
+
+TEST(ArraySerializationPerftest, Pointers) {
+  for (size_t num_elements : {1000u, 32000u, 1000000u}) {
+    const uint32_t element_size =
+        internal::ArrayDataTraits<uint8_t>::GetStorageSize(0u);
+    internal::FixedBufferForTesting buf(
+        internal::ArrayDataTraits<internal::Array_Data<uint8_t>*>::
+            GetStorageSize(static_cast<uint32_t>(num_elements)) +
+        num_elements * internal::Align(element_size));
+    PointerArray* array = PointerArray::New(num_elements, &buf);
+    std::vector<internal::Array_Data<uint8_t>*> elements(num_elements);
+    for (size_t i = 0u; i < num_elements; i++) {
+      elements[i] = internal::Array_Data<uint8_t>::New(0u, &buf);
+      array->at(i) = elements[i];
+    }
+
+    RunPerfTest("EncodeDecodePointers_" + std::to_string(num_elements), array,
+                &EncodePointersPerElement, &DecodePointersPerElement);
+
+    for (size_t i = 0u; i < num_elements; i++)
+      EXPECT_EQ(elements[i], array->at(i));
+  }
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace mojo
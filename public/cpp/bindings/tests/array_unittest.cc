@@ -819,6 +819,90 @@ TEST(ArrayTest, Serialization_ArrayOfStructPtr) {
   }
 }
 
+std::vector<MojoHandle> HandleValues(const std::vector<Handle>& handles) {
+  std::vector<MojoHandle> result;
+  for (const auto& handle : handles)
+    result.push_back(handle.value());
+  return result;
+}
+
+// Tests that encoding and decoding arrays of handles in bulk gives the same
+// results as doing so one handle at a time, for all lengths up to a few SIMD
+// blocks, with null handles, runs of valid handles and of nulls.
+TEST(ArrayTest, BulkEncodeDecodeHandles) {
+  for (uint32_t num_elements = 0u; num_elements < 38u; num_elements++) {
+    std::vector<Handle> elements;
+    for (uint32_t i = 0u; i < num_elements; i++) {
+      const bool is_null = (i % 7u == 3u) || (i >= 24u && i < 32u);
+      elements.push_back(Handle(is_null ? MOJO_HANDLE_INVALID : i + 100u));
+    }
+
+    // Some handles are already encoded, as in messages that hold several
+    // arrays.
+    std::vector<Handle> expected_handles(3u, Handle(1u));
+    std::vector<Handle> expected = elements;
+    for (auto& handle : expected)
+      mojo::internal::EncodeHandle(&handle, &expected_handles);
+
+    std::vector<Handle> handles(3u, Handle(1u));
+    std::vector<Handle> encoded = elements;
+    mojo::internal::EncodeHandles(encoded.data(), num_elements, &handles);
+    EXPECT_EQ(HandleValues(expected), HandleValues(encoded));
+    EXPECT_EQ(HandleValues(expected_handles), HandleValues(handles));
+
+    EXPECT_EQ(num_elements > 3u ? 3u : num_elements,
+              mojo::internal::FindInvalidEncodedHandle(encoded.data(),
+                                                       num_elements));
+    const uint32_t num_valid = static_cast<uint32_t>(handles.size() - 3u);
+    EXPECT_EQ(num_valid, mojo::internal::FindInvalidEncodedHandle(
+                             handles.data() + 3u, num_valid));
+
+    mojo::internal::DecodeHandles(encoded.data(), num_elements, &handles);
+    EXPECT_EQ(HandleValues(elements), HandleValues(encoded));
+    for (size_t i = 3u; i < handles.size(); i++)
+      EXPECT_FALSE(handles[i].is_valid());
+  }
+
+  // Handles that aren't in order are decoded one at a time.
+  std::vector<Handle> handles = {Handle(10u), Handle(11u), Handle(12u),
+                                 Handle(13u), Handle(14u)};
+  std::vector<Handle> encoded = {Handle(4u), Handle(0u), Handle(1u),
+                                 Handle(2u), Handle(3u)};
+  mojo::internal::DecodeHandles(encoded.data(), 5u, &handles);
+  std::vector<Handle> expected = {Handle(14u), Handle(10u), Handle(11u),
+                                  Handle(12u), Handle(13u)};
+  EXPECT_EQ(HandleValues(expected), HandleValues(encoded));
+}
+
+// Tests that encoding and decoding arrays of pointers in bulk gives the same
+// results as doing so one pointer at a time.
+TEST(ArrayTest, BulkEncodeDecodePointers) {
+  for (uint32_t num_elements = 0u; num_elements < 11u; num_elements++) {
+    FixedBufferForTesting buf(1024);
+    auto array = Array_Data<Array_Data<uint8_t>*>::New(num_elements, &buf);
+    for (uint32_t i = 0u; i < num_elements; i++) {
+      if (i % 3u != 1u)
+        array->at(i) = Array_Data<uint8_t>::New(i, &buf);
+    }
+    std::vector<Array_Data<uint8_t>*> elements;
+    std::vector<uint64_t> expected;
+    for (uint32_t i = 0u; i < num_elements; i++) {
+      elements.push_back(array->at(i));
+      mojo::internal::EncodePointer(elements[i], &array->storage()[i].offset);
+      expected.push_back(array->storage()[i].offset);
+      array->at(i) = elements[i];
+    }
+
+    mojo::internal::EncodePointers(&array->storage()->offset, num_elements);
+    for (uint32_t i = 0u; i < num_elements; i++)
+      EXPECT_EQ(expected[i], array->storage()[i].offset);
+
+    mojo::internal::DecodePointers(&array->storage()->offset, num_elements);
+    for (uint32_t i = 0u; i < num_elements; i++)
+      EXPECT_EQ(elements[i], array->at(i));
+  }
+}
+
 }  // namespace
 }  // namespace test
 }  // namespace mojo
@@ -4,10 +4,14 @@
 
 #include "mojo/public/cpp/bindings/binding_set.h"
 
+#include <atomic>
+#include <thread>
+
 #include "mojo/public/cpp/bindings/binding.h"
 #include "mojo/public/cpp/bindings/interface_request.h"
 #include "mojo/public/cpp/system/macros.h"
 #include "mojo/public/cpp/utility/run_loop.h"
+#include "mojo/public/cpp/utility/run_loop_pool.h"
 #include "mojo/public/interfaces/bindings/tests/minimal_interface.mojom.h"
 #include "third_party/gtest/include/gtest/gtest.h"
 
@@ -102,5 +106,60 @@ TEST(BindingSetTest, FullLifeCycle) {
   }
 }
 
+// Like |MinimalInterfaceImpl|, but may be called on several threads.
+class ThreadSafeMinimalInterfaceImpl : public test::MinimalInterface {
+ public:
+  ThreadSafeMinimalInterfaceImpl() {}
+
+  void Message() override { call_count_.fetch_add(1); }
+
+  int call_count() const { return call_count_.load(); }
+
+ private:
+  std::atomic<int> call_count_{0};
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(ThreadSafeMinimalInterfaceImpl);
+};
+
+// Tests BindingSet with the bindings distributed over a RunLoopPool.
+TEST(BindingSetTest, PooledLifeCycle) {
+  // The interface pointers are used on this thread.
+  RunLoop loop;
+  constexpr size_t kNumThreads = 3;
+  RunLoopPool pool(kNumThreads);
+
+  const size_t kNumObjects = 10;
+  InterfacePtr<test::MinimalInterface> intrfc_ptrs[kNumObjects];
+  ThreadSafeMinimalInterfaceImpl impl;
+
+  BindingSet<test::MinimalInterface> binding_set(
+      &pool, RunLoopPool::Policy::ROUND_ROBIN);
+  for (size_t i = 0; i < kNumObjects; i++)
+    binding_set.AddBinding(&impl, GetProxy(&intrfc_ptrs[i]));
+  EXPECT_EQ(kNumObjects, binding_set.size());
+  for (size_t i = 0; i < kNumThreads; i++) {
+    EXPECT_EQ((kNumObjects + kNumThreads - 1 - i) / kNumThreads,
+              pool.GetThreadLoad(i));
+  }
+
+  // The messages are dispatched on the pool's threads.
+  for (InterfacePtr<test::MinimalInterface>& ptr : intrfc_ptrs)
+    ptr->Message();
+  while (impl.call_count() < static_cast<int>(kNumObjects))
+    std::this_thread::yield();
+
+  // Closing pipes removes their bindings (on the pool's threads).
+  for (size_t i = 0; i < kNumObjects / 2; i++)
+    intrfc_ptrs[i].reset();
+  while (binding_set.size() > kNumObjects / 2)
+    std::this_thread::yield();
+
+  binding_set.CloseAllBindings();
+  EXPECT_EQ(0u, binding_set.size());
+  for (size_t i = 0; i < kNumThreads; i++)
+    EXPECT_EQ(0u, pool.GetThreadLoad(i));
+  EXPECT_EQ(static_cast<int>(kNumObjects), impl.call_count());
+}
+
 }  // namespace
 }  // namespace mojo
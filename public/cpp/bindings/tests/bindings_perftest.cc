@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include "mojo/public/cpp/bindings/binding.h"
+#include "mojo/public/cpp/bindings/lib/message_buffer_pool.h"
 #include "mojo/public/cpp/test_support/test_support.h"
 #include "mojo/public/cpp/utility/run_loop.h"
 #include "mojo/public/interfaces/bindings/tests/ping_service.mojom.h"
@@ -114,6 +115,35 @@ TEST_F(MojoBindingsPerftest, InProcessPingPong) {
 
     delete[] inactive_services;
   }
+
+  // Compare against not caching message buffers (i.e., every message's data
+  // comes from the heap).
+  internal::MessageBufferPool* pool = internal::MessageBufferPool::current();
+  const size_t old_max_cached_buffers =
+      pool->max_cached_buffers_per_size_class();
+  for (size_t max_cached_buffers : {old_max_cached_buffers, size_t{0}}) {
+    pool->SetMaxCachedBuffersPerSizeClass(max_cached_buffers);
+    pool->ResetStats();
+
+    const unsigned int kIterations = 100000;
+    const MojoTimeTicks start_time = MojoGetTimeTicksNow();
+    test.Run(kIterations);
+    const MojoTimeTicks end_time = MojoGetTimeTicksNow();
+    const bool pooled = max_cached_buffers > 0u;
+    test::LogPerfResult("InProcessPingPong",
+                        pooled ? "0_Inactive_Pooled" : "0_Inactive_Unpooled",
+                        kIterations / MojoTicksToSeconds(end_time - start_time),
+                        "pings/second");
+    test::LogPerfResult(
+        "InProcessPingPong",
+        pooled ? "0_Inactive_Pooled_HeapAllocations"
+               : "0_Inactive_Unpooled_HeapAllocations",
+        static_cast<double>(pool->stats().num_allocations -
+                            pool->stats().num_cache_hits) /
+            kIterations,
+        "allocations/ping");
+  }
+  pool->SetMaxCachedBuffersPerSizeClass(old_max_cached_buffers);
 }
 
 }  // namespace
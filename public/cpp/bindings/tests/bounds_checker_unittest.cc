@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <limits>
+#include <vector>
 
 #include "mojo/public/cpp/bindings/lib/bindings_serialization.h"
 #include "mojo/public/cpp/bindings/lib/bounds_checker.h"
@@ -204,6 +205,53 @@ TEST(BoundsCheckerTest, ClaimMemory) {
   }
 }
 
+TEST(BoundsCheckerTest, Decode) {
+  struct Data {
+    internal::StructPointer<uint64_t> pointer;
+    uint64_t pointee;
+    Handle handles[3];
+  } data;
+  data.pointer.offset = 8u;
+  data.handles[0] = Handle(1);
+  data.handles[1] = Handle(internal::kEncodedInvalidHandleValue);
+  data.handles[2] = Handle(2);
+
+  {
+    // A plain checker doesn't decode.
+    std::vector<Handle> handles = {Handle(100), Handle(101), Handle(102)};
+    internal::BoundsChecker checker(&data, sizeof(data), handles.size());
+    EXPECT_FALSE(checker.decodes());
+    checker.DecodePointer(&data.pointer);
+    checker.DecodeHandle(&data.handles[0]);
+    EXPECT_EQ(8u, data.pointer.offset);
+    EXPECT_EQ(1u, data.handles[0].value());
+    EXPECT_EQ(0u, checker.num_decoded_handles());
+  }
+
+  std::vector<Handle> handles = {Handle(100), Handle(101), Handle(102)};
+  internal::DecodingBoundsChecker checker(&data, sizeof(data), &handles);
+  EXPECT_TRUE(checker.decodes());
+  EXPECT_TRUE(checker.ClaimMemory(&data, sizeof(data)));
+
+  checker.DecodePointer(&data.pointer);
+  EXPECT_EQ(&data.pointee, data.pointer.ptr);
+
+  for (size_t i = 0u; i < 3u; i++) {
+    EXPECT_TRUE(checker.ClaimHandle(data.handles[i]));
+    checker.DecodeHandle(&data.handles[i]);
+  }
+  EXPECT_EQ(101u, data.handles[0].value());
+  EXPECT_FALSE(data.handles[1].is_valid());
+  EXPECT_EQ(102u, data.handles[2].value());
+
+  // The decoded handles are moved to the front, in order.
+  EXPECT_EQ(2u, checker.num_decoded_handles());
+  ASSERT_EQ(3u, handles.size());
+  EXPECT_EQ(101u, handles[0].value());
+  EXPECT_EQ(102u, handles[1].value());
+  EXPECT_EQ(100u, handles[2].value());
+}
+
 }  // namespace
 }  // namespace test
 }  // namespace mojo
@@ -2,10 +2,17 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <string.h>
+
 #include <limits>
+#include <vector>
 
+#include "mojo/public/cpp/bindings/array.h"
+#include "mojo/public/cpp/bindings/lib/array_serialization.h"
 #include "mojo/public/cpp/bindings/lib/bindings_serialization.h"
+#include "mojo/public/cpp/bindings/lib/chunked_buffer.h"
 #include "mojo/public/cpp/bindings/lib/fixed_buffer.h"
+#include "mojo/public/cpp/bindings/string.h"
 #include "third_party/gtest/include/gtest/gtest.h"
 
 namespace mojo {
@@ -94,6 +101,91 @@ TEST(FixedBufferTest, TooBig) {
 }
 #endif
 
+// Tests that ChunkedBuffer grows by adding chunks, which are laid out
+// contiguously in its logical address space.
+TEST(ChunkedBufferTest, Growth) {
+  internal::ChunkedBuffer buf(32u);
+  EXPECT_EQ(0u, buf.size());
+  EXPECT_EQ(0u, buf.num_chunks());
+
+  std::vector<char*> allocations;
+  for (size_t i = 0u; i < 10u; i++) {
+    char* p = static_cast<char*>(buf.Allocate(10));
+    ASSERT_TRUE(p);
+    EXPECT_TRUE(IsZero(p, 10));
+    EXPECT_EQ(0, reinterpret_cast<ptrdiff_t>(p) % 8);
+    memset(p, static_cast<int>(i + 1u), 10);
+    allocations.push_back(p);
+  }
+  EXPECT_EQ(10u * 16u, buf.size());
+  // Chunks of 32, 64 and 128 bytes.
+  EXPECT_EQ(3u, buf.num_chunks());
+
+  // Objects allocated earlier have not moved.
+  for (size_t i = 0u; i < allocations.size(); i++) {
+    EXPECT_EQ(i * 16u, buf.GetOffset(allocations[i]));
+    EXPECT_EQ(i * 16u + 9u, buf.GetOffset(allocations[i] + 9));
+    EXPECT_EQ(static_cast<char>(i + 1u), allocations[i][0]);
+  }
+
+  std::vector<char> bytes(buf.size());
+  buf.CopyTo(&bytes[0]);
+  for (size_t i = 0u; i < allocations.size(); i++)
+    EXPECT_EQ(0, memcmp(&bytes[i * 16u], allocations[i], 16u));
+
+  // An allocation larger than twice the last chunk gets a chunk of its own.
+  char* big = static_cast<char*>(buf.Allocate(1000));
+  EXPECT_TRUE(IsZero(big, 1000));
+  EXPECT_EQ(4u, buf.num_chunks());
+  EXPECT_EQ(160u, buf.GetOffset(big));
+  EXPECT_EQ(160u + 1000u, buf.size());
+}
+
+// Tests that ChunkedBuffer uses the given initial chunk.
+TEST(ChunkedBufferTest, InitialChunk) {
+  uint64_t initial_chunk[4] = {1u, 2u, 3u, 4u};
+  internal::ChunkedBuffer buf(initial_chunk, sizeof(initial_chunk));
+
+  void* a = buf.Allocate(24);
+  EXPECT_EQ(initial_chunk, a);
+  EXPECT_TRUE(IsZero(a, 24));
+
+  void* b = buf.Allocate(16);
+  EXPECT_EQ(2u, buf.num_chunks());
+  EXPECT_EQ(24u, buf.GetOffset(b));
+}
+
+// Tests that serializing into a ChunkedBuffer (with pointers encoded in place)
+// produces the same bytes as serializing into a FixedBuffer of the computed
+// size and then encoding.
+TEST(ChunkedBufferTest, EncodesInPlace) {
+  auto array = Array<String>::New(4);
+  array[0] = "hello";
+  array[2] = "a somewhat longer string that won't fit in the first chunk";
+  array[3] = "world";
+  const internal::ArrayValidateParams validate_params(
+      0, true, new internal::ArrayValidateParams(0, false, nullptr));
+
+  internal::FixedBufferForTesting fixed_buf(GetSerializedSize_(array));
+  EXPECT_FALSE(fixed_buf.encodes_in_place());
+  internal::Array_Data<internal::String_Data*>* fixed_data = nullptr;
+  SerializeArray_(&array, &fixed_buf, &fixed_data, &validate_params);
+  std::vector<Handle> handles;
+  fixed_data->EncodePointersAndHandles(&handles);
+
+  internal::ChunkedBuffer chunked_buf(64u);
+  EXPECT_TRUE(chunked_buf.encodes_in_place());
+  internal::Array_Data<internal::String_Data*>* chunked_data = nullptr;
+  SerializeArray_(&array, &chunked_buf, &chunked_data, &validate_params);
+  EXPECT_LT(1u, chunked_buf.num_chunks());
+  EXPECT_TRUE(chunked_buf.handles()->empty());
+
+  ASSERT_EQ(fixed_buf.BytesUsed(), chunked_buf.size());
+  std::vector<char> bytes(chunked_buf.size());
+  chunked_buf.CopyTo(&bytes[0]);
+  EXPECT_EQ(0, memcmp(fixed_data, &bytes[0], bytes.size()));
+}
+
 }  // namespace
 }  // namespace test
 }  // namespace mojo
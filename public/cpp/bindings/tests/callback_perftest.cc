@@ -0,0 +1,137 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file has microbenchmarks for |mojo::Callback|: constructing, copying,
+// running, and destroying callbacks with small (inline) and large (shared)
+// sinks, compared against a callback that always heap-allocates and shares its
+// sink (as |mojo::Callback| used to) and against |std::function|.
+
+#include <stdint.h>
+
+#include <functional>
+
+#include "mojo/public/cpp/bindings/callback.h"
+#include "mojo/public/cpp/bindings/lib/shared_ptr.h"
+#include "mojo/public/cpp/system/time.h"
+#include "mojo/public/cpp/test_support/test_support.h"
+#include "third_party/gtest/include/gtest/gtest.h"
+
+namespace mojo {
+namespace {
+
+constexpr uint64_t kIterations = 10000000u;
+
+// A closure that always heap-allocates its sink (plus a reference count) and
+// shares it between copies.
+class SharedSinkClosure {
+ public:
+  template <typename Sink>
+  SharedSinkClosure(const Sink& sink) : sink_(new SinkAdapter<Sink>(sink)) {}
+
+  void Run() const { sink_->Run(); }
+
+ private:
+  struct Runnable {
+    virtual ~Runnable() {}
+    virtual void Run() const = 0;
+  };
+
+  template <typename Sink>
+  struct SinkAdapter : public Runnable {
+    explicit SinkAdapter(const Sink& sink) : sink(sink) {}
+    void Run() const override { sink(); }
+    Sink sink;
+  };
+
+  internal::SharedPtr<Runnable> sink_;
+};
+
+// Runs |make_and_run| (which should construct a closure, copy it, and run it)
+// |kIterations| times, and reports the number of iterations per second.
+template <typename MakeAndRun>
+void DoCallbackPerfTest(const char* test_name,
+                        const char* sub_test_name,
+                        MakeAndRun make_and_run) {
+  uint64_t count = 0u;
+  MojoTimeTicks start_time = GetTimeTicksNow();
+  for (uint64_t i = 0u; i < kIterations; i++)
+    make_and_run(&count);
+  MojoTimeTicks end_time = GetTimeTicksNow();
+  EXPECT_EQ(2u * kIterations, count);
+
+  double result = static_cast<double>(kIterations) /
+                  (static_cast<double>(end_time - start_time) / 1000000.0);
+  test::LogPerfResult(test_name, sub_test_name, result, "iterations/second");
+}
+
+// Constructs a closure from a lambda that captures a pointer (like a typical
+// response callback), makes a copy, and runs both.
+template <typename ClosureType>
+void MakeCopyAndRunSmall(uint64_t* count) {
+  ClosureType closure = [count]() { (*count)++; };
+  ClosureType closure_copy = closure;
+  closure.Run();
+  closure_copy.Run();
+}
+
+// As above, but with a lambda whose captures are too big to store inline in a
+// |mojo::Callback|.
+template <typename ClosureType>
+void MakeCopyAndRunLarge(uint64_t* count) {
+  uint64_t
+      padding[internal::kCallbackInlineStorageSize / sizeof(uint64_t)] = {};
+  ClosureType closure = [count, padding]() { (*count) += 1u + padding[0]; };
+  ClosureType closure_copy = closure;
+  closure.Run();
+  closure_copy.Run();
+}
+
+// |std::function| has a different interface.
+class StdFunctionClosure {
+ public:
+  template <typename Sink>
+  StdFunctionClosure(const Sink& sink) : function_(sink) {}
+
+  void Run() const { function_(); }
+
+ private:
+  std::function<void()> function_;
+};
+
+TEST(CallbackPerftest, SmallSink) {
+  DoCallbackPerfTest("CallbackPerftest.SmallSink", "Callback",
+                     &MakeCopyAndRunSmall<Closure>);
+  DoCallbackPerfTest("CallbackPerftest.SmallSink", "SharedSink",
+                     &MakeCopyAndRunSmall<SharedSinkClosure>);
+  DoCallbackPerfTest("CallbackPerftest.SmallSink", "StdFunction",
+                     &MakeCopyAndRunSmall<StdFunctionClosure>);
+}
+
+TEST(CallbackPerftest, LargeSink) {
+  DoCallbackPerfTest("CallbackPerftest.LargeSink", "Callback",
+                     &MakeCopyAndRunLarge<Closure>);
+  DoCallbackPerfTest("CallbackPerftest.LargeSink", "SharedSink",
+                     &MakeCopyAndRunLarge<SharedSinkClosure>);
+  DoCallbackPerfTest("CallbackPerftest.LargeSink", "StdFunction",
+                     &MakeCopyAndRunLarge<StdFunctionClosure>);
+}
+
+// Measures just running an existing callback.
+TEST(CallbackPerftest, Run) {
+  uint64_t count = 0u;
+  Closure closure = [&count]() { count++; };
+  MojoTimeTicks start_time = GetTimeTicksNow();
+  for (uint64_t i = 0u; i < kIterations; i++)
+    closure.Run();
+  MojoTimeTicks end_time = GetTimeTicksNow();
+  EXPECT_EQ(kIterations, count);
+
+  double result = static_cast<double>(kIterations) /
+                  (static_cast<double>(end_time - start_time) / 1000000.0);
+  test::LogPerfResult("CallbackPerftest.Run", "Callback", result,
+                      "runs/second");
+}
+
+}  // namespace
+}  // namespace mojo
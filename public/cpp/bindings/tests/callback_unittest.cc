@@ -3,6 +3,10 @@
 // found in the LICENSE file.
 
 #include "mojo/public/cpp/bindings/callback.h"
+
+#include <memory>
+#include <utility>
+
 #include "mojo/public/cpp/bindings/map.h"
 #include "mojo/public/cpp/bindings/string.h"
 #include "third_party/gtest/include/gtest/gtest.h"
@@ -160,6 +164,115 @@ TEST(Callback, CreateFromOverloadedFunctionPtr) {
   g_overloaded_function_with_double_param_called = false;
 }
 
+// Counts the live copies of itself (e.g., captured by a lambda).
+class CopyCounter {
+ public:
+  explicit CopyCounter(int* count) : count_(count) { (*count_)++; }
+  CopyCounter(const CopyCounter& other) : count_(other.count_) {
+    (*count_)++;
+  }
+  ~CopyCounter() { (*count_)--; }
+
+ private:
+  int* count_;
+};
+
+struct CountingRunnable : public Callback<void()>::Runnable {
+  CountingRunnable(int* calls, bool* destroyed)
+      : calls(calls), destroyed(destroyed) {}
+  ~CountingRunnable() override { *destroyed = true; }
+
+  void Run() const override { (*calls)++; }
+
+  int* calls;
+  bool* destroyed;
+};
+
+// Tests copying, moving, and resetting callbacks with small sinks (which are
+// stored inline and copied with the callback).
+TEST(Callback, CopyAndMoveInline) {
+  int calls = 0;
+  int num_copies = 0;
+  {
+    CopyCounter counter(&num_copies);
+    mojo::Closure cb = [&calls, counter]() { calls++; };
+    EXPECT_EQ(2, num_copies);
+
+    mojo::Closure cb_copy = cb;
+    EXPECT_EQ(3, num_copies);
+    cb.Run();
+    cb_copy.Run();
+    EXPECT_EQ(2, calls);
+
+    mojo::Closure cb_moved = std::move(cb);
+    EXPECT_TRUE(cb.is_null());
+    EXPECT_EQ(3, num_copies);
+    cb.Run();
+    cb_moved.Run();
+    EXPECT_EQ(3, calls);
+
+    cb_copy.reset();
+    EXPECT_TRUE(cb_copy.is_null());
+    EXPECT_EQ(2, num_copies);
+
+    cb = cb_moved;
+    EXPECT_EQ(3, num_copies);
+    cb_moved = mojo::Closure();
+    EXPECT_EQ(2, num_copies);
+    cb.Run();
+    EXPECT_EQ(4, calls);
+  }
+  EXPECT_EQ(0, num_copies);
+}
+
+// Tests that large sinks and |Runnable|s are shared between copies of a
+// callback.
+TEST(Callback, CopyShared) {
+  int calls = 0;
+  int num_copies = 0;
+  {
+    CopyCounter counter(&num_copies);
+    char padding[mojo::internal::kCallbackInlineStorageSize] = {};
+    mojo::Closure cb = [&calls, counter, padding]() { calls++; };
+    EXPECT_EQ(2, num_copies);
+
+    mojo::Closure cb_copy = cb;
+    mojo::Closure cb_moved = std::move(cb_copy);
+    EXPECT_EQ(2, num_copies);
+    cb.Run();
+    cb_moved.Run();
+    EXPECT_EQ(2, calls);
+  }
+  EXPECT_EQ(0, num_copies);
+
+  bool destroyed = false;
+  {
+    mojo::Closure cb(new CountingRunnable(&calls, &destroyed));
+    mojo::Closure cb_copy = cb;
+    cb.reset();
+    EXPECT_FALSE(destroyed);
+    cb_copy.Run();
+    EXPECT_EQ(3, calls);
+  }
+  EXPECT_TRUE(destroyed);
+}
+
+// Tests callbacks with move-only sinks.
+TEST(Callback, MoveOnlySink) {
+  int calls = 0;
+  std::unique_ptr<int> increment(new int(2));
+  mojo::Callback<void(int)> cb = [&calls, increment = std::move(increment)](
+      int multiplier) { calls += multiplier * *increment; };
+  EXPECT_FALSE(increment);
+  cb.Run(1);
+  EXPECT_EQ(2, calls);
+
+  mojo::Callback<void(int)> cb_copy = cb;
+  cb.reset();
+  cb_copy.Run(3);
+  EXPECT_EQ(8, calls);
+}
+
 }  // namespace
 }  // namespace test
 }  // namespace mojo
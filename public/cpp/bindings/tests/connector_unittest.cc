@@ -11,6 +11,7 @@
 #include "mojo/public/cpp/bindings/lib/message_builder.h"
 #include "mojo/public/cpp/bindings/tests/message_queue.h"
 #include "mojo/public/cpp/environment/logging.h"
+#include "mojo/public/cpp/system/buffer.h"
 #include "mojo/public/cpp/system/macros.h"
 #include "mojo/public/cpp/utility/run_loop.h"
 #include "third_party/gtest/include/gtest/gtest.h"
@@ -94,6 +95,39 @@ TEST_F(ConnectorTest, Basic) {
       std::string(reinterpret_cast<const char*>(message_received.payload())));
 }
 
+TEST_F(ConnectorTest, ScatterGather) {
+  internal::Connector connector0(handle0_.Pass());
+  internal::Connector connector1(handle1_.Pass());
+
+  const std::string large(internal::MessageBuffer::kMinExternalDataNumBytes,
+                          'x');
+  MessageBuilder builder(1, large.size() + 8u);
+  builder.EnableScatterGather();
+  void* text = builder.buffer()->Allocate(large.size());
+  builder.buffer()->CopyBytes(text, large.data(), large.size());
+  ASSERT_TRUE(builder.message()->has_external_data());
+
+  EXPECT_TRUE(connector0.Accept(builder.message()));
+  // Writing the message shouldn't have copied the external data into it.
+  EXPECT_TRUE(builder.message()->has_external_data());
+
+  MessageAccumulator accumulator;
+  connector1.set_incoming_receiver(&accumulator);
+
+  PumpMessages();
+
+  ASSERT_FALSE(accumulator.IsEmpty());
+
+  Message message_received;
+  accumulator.Pop(&message_received);
+
+  EXPECT_EQ(builder.message()->data_num_bytes(),
+            message_received.data_num_bytes());
+  EXPECT_EQ(large, std::string(reinterpret_cast<const char*>(
+                                   message_received.payload()),
+                               large.size()));
+}
+
 TEST_F(ConnectorTest, Basic_Synchronous) {
   internal::Connector connector0(handle0_.Pass());
   internal::Connector connector1(handle1_.Pass());
@@ -399,6 +433,210 @@ TEST_F(ConnectorTest, WaitForIncomingMessageWithReentrancy) {
   ASSERT_EQ(2, accumulator.number_of_calls());
 }
 
+TEST_F(ConnectorTest, ReadBufferFallback) {
+  internal::Connector connector0(handle0_.Pass());
+  internal::Connector connector1(handle1_.Pass());
+
+  MessageAccumulator accumulator;
+  connector1.set_incoming_receiver(&accumulator);
+
+  // Small messages should be read with a single read each.
+  const char kText[] = "hello world";
+  for (int i = 0; i < 3; i++) {
+    Message message;
+    AllocMessage(kText, &message);
+    connector0.Accept(&message);
+  }
+  PumpMessages();
+  EXPECT_EQ(3u, connector1.read_buffer().num_reads());
+  EXPECT_EQ(0u, connector1.read_buffer().num_fallback_reads());
+
+  // A large message requires a second read, but afterwards the read buffer is
+  // big enough for messages of that size.
+  std::string large_text(10000u, 'x');
+  for (int i = 0; i < 2; i++) {
+    Message message;
+    AllocMessage(large_text.c_str(), &message);
+    connector0.Accept(&message);
+  }
+  PumpMessages();
+  EXPECT_EQ(5u, connector1.read_buffer().num_reads());
+  EXPECT_EQ(1u, connector1.read_buffer().num_fallback_reads());
+
+  for (int i = 0; i < 3; i++) {
+    Message message_received;
+    accumulator.Pop(&message_received);
+    EXPECT_EQ(std::string(kText), std::string(reinterpret_cast<const char*>(
+                                      message_received.payload())));
+  }
+  for (int i = 0; i < 2; i++) {
+    Message message_received;
+    accumulator.Pop(&message_received);
+    EXPECT_EQ(large_text, std::string(reinterpret_cast<const char*>(
+                              message_received.payload())));
+  }
+  EXPECT_TRUE(accumulator.IsEmpty());
+}
+
+
+TEST_F(ConnectorTest, LargeMessage) {
+  internal::Connector connector0(handle0_.Pass());
+  internal::Connector connector1(handle1_.Pass());
+
+  MessageAccumulator accumulator;
+  connector1.set_incoming_receiver(&accumulator);
+
+  std::string large_text(256u * 1024u, 'x');
+  large_text[64u * 1024u] = 'y';
+  Message message;
+  AllocMessage(large_text.c_str(), &message);
+  const uint32_t num_bytes = message.data_num_bytes();
+  MessagePipe pipe;
+  message.mutable_handles()->push_back(pipe.handle0.release());
+
+  EXPECT_TRUE(connector0.Accept(&message));
+  EXPECT_TRUE(message.handles()->empty());
+  PumpMessages();
+
+  ASSERT_FALSE(accumulator.IsEmpty());
+  Message message_received;
+  accumulator.Pop(&message_received);
+  EXPECT_EQ(num_bytes, message_received.data_num_bytes());
+  EXPECT_EQ(1u, message_received.name());
+  EXPECT_EQ(large_text, std::string(reinterpret_cast<const char*>(
+                            message_received.payload())));
+  ASSERT_EQ(1u, message_received.handles()->size());
+  EXPECT_TRUE(message_received.handles()->front().is_valid());
+}
+
+// |WriteMessage()| only sends a large message envelope if the message is too
+// large for the pipe, so write one directly.
+TEST_F(ConnectorTest, LargeMessageEnvelope) {
+  internal::Connector connector1(handle1_.Pass());
+
+  MessageAccumulator accumulator;
+  connector1.set_incoming_receiver(&accumulator);
+
+  std::string large_text(256u * 1024u, 'x');
+  large_text[64u * 1024u] = 'y';
+  Message message;
+  AllocMessage(large_text.c_str(), &message);
+  const uint32_t num_bytes = message.data_num_bytes();
+
+  ScopedSharedBufferHandle buffer;
+  ASSERT_EQ(MOJO_RESULT_OK, CreateSharedBuffer(nullptr, num_bytes, &buffer));
+  void* mapping = nullptr;
+  ASSERT_EQ(MOJO_RESULT_OK, MapBuffer(buffer.get(), 0u, num_bytes, &mapping,
+                                      MOJO_MAP_BUFFER_FLAG_NONE));
+  memcpy(mapping, message.data(), num_bytes);
+  EXPECT_EQ(MOJO_RESULT_OK, UnmapBuffer(mapping));
+
+  internal::LargeMessageEnvelope envelope = {};
+  envelope.header.num_bytes = sizeof(internal::MessageHeader);
+  envelope.header.name = internal::kLargeMessageEnvelopeName;
+  envelope.magic = internal::kLargeMessageEnvelopeMagic;
+  envelope.version = internal::kLargeMessageEnvelopeVersion;
+  envelope.num_bytes = num_bytes;
+  // The buffer follows the message's own handles.
+  MessagePipe pipe;
+  MojoHandle handles[] = {pipe.handle0.release().value(),
+                          buffer.release().value()};
+  EXPECT_EQ(MOJO_RESULT_OK,
+            WriteMessageRaw(handle0_.get(), &envelope, sizeof(envelope),
+                            handles, 2u, MOJO_WRITE_MESSAGE_FLAG_NONE));
+  PumpMessages();
+
+  ASSERT_FALSE(accumulator.IsEmpty());
+  Message message_received;
+  accumulator.Pop(&message_received);
+  EXPECT_EQ(num_bytes, message_received.data_num_bytes());
+  EXPECT_EQ(1u, message_received.name());
+  EXPECT_EQ(large_text, std::string(reinterpret_cast<const char*>(
+                            message_received.payload())));
+  ASSERT_EQ(1u, message_received.handles()->size());
+  EXPECT_TRUE(message_received.handles()->front().is_valid());
+
+  // Only the (small) envelope was read from the pipe.
+  EXPECT_EQ(1u, connector1.read_buffer().num_reads());
+  EXPECT_EQ(0u, connector1.read_buffer().num_fallback_reads());
+}
+
+TEST_F(ConnectorTest, LargeMessageEnvelopeWithoutBuffer) {
+  internal::Connector connector1(handle1_.Pass());
+
+  bool error_handler_called = false;
+  connector1.set_connection_error_handler(
+      [&error_handler_called]() { error_handler_called = true; });
+  MessageAccumulator accumulator;
+  connector1.set_incoming_receiver(&accumulator);
+
+  internal::LargeMessageEnvelope envelope = {};
+  envelope.header.num_bytes = sizeof(internal::MessageHeader);
+  envelope.header.name = internal::kLargeMessageEnvelopeName;
+  envelope.magic = internal::kLargeMessageEnvelopeMagic;
+  envelope.version = internal::kLargeMessageEnvelopeVersion;
+  envelope.num_bytes = 256u * 1024u;
+  EXPECT_EQ(MOJO_RESULT_OK,
+            WriteMessageRaw(handle0_.get(), &envelope, sizeof(envelope),
+                            nullptr, 0u, MOJO_WRITE_MESSAGE_FLAG_NONE));
+  PumpMessages();
+
+  EXPECT_TRUE(error_handler_called);
+  EXPECT_TRUE(accumulator.IsEmpty());
+}
+
+TEST_F(ConnectorTest, LargeMessageEnvelopeOfUnknownVersion) {
+  internal::Connector connector1(handle1_.Pass());
+
+  bool error_handler_called = false;
+  connector1.set_connection_error_handler(
+      [&error_handler_called]() { error_handler_called = true; });
+  MessageAccumulator accumulator;
+  connector1.set_incoming_receiver(&accumulator);
+
+  ScopedSharedBufferHandle buffer;
+  ASSERT_EQ(MOJO_RESULT_OK, CreateSharedBuffer(nullptr, 4096u, &buffer));
+  internal::LargeMessageEnvelope envelope = {};
+  envelope.header.num_bytes = sizeof(internal::MessageHeader);
+  envelope.header.name = internal::kLargeMessageEnvelopeName;
+  envelope.magic = internal::kLargeMessageEnvelopeMagic;
+  envelope.version = internal::kLargeMessageEnvelopeVersion + 1u;
+  envelope.num_bytes = 4096u;
+  MojoHandle handles[] = {buffer.release().value()};
+  EXPECT_EQ(MOJO_RESULT_OK,
+            WriteMessageRaw(handle0_.get(), &envelope, sizeof(envelope),
+                            handles, 1u, MOJO_WRITE_MESSAGE_FLAG_NONE));
+  PumpMessages();
+
+  EXPECT_TRUE(error_handler_called);
+  EXPECT_TRUE(accumulator.IsEmpty());
+}
+
+// A message that merely has the envelope's name is delivered as is.
+TEST_F(ConnectorTest, LargeMessageEnvelopeWithoutMagic) {
+  internal::Connector connector1(handle1_.Pass());
+
+  MessageAccumulator accumulator;
+  connector1.set_incoming_receiver(&accumulator);
+
+  internal::LargeMessageEnvelope envelope = {};
+  envelope.header.num_bytes = sizeof(internal::MessageHeader);
+  envelope.header.name = internal::kLargeMessageEnvelopeName;
+  envelope.version = internal::kLargeMessageEnvelopeVersion;
+  envelope.num_bytes = 256u * 1024u;
+  EXPECT_EQ(MOJO_RESULT_OK,
+            WriteMessageRaw(handle0_.get(), &envelope, sizeof(envelope),
+                            nullptr, 0u, MOJO_WRITE_MESSAGE_FLAG_NONE));
+  PumpMessages();
+
+  ASSERT_FALSE(accumulator.IsEmpty());
+  Message message_received;
+  accumulator.Pop(&message_received);
+  EXPECT_EQ(sizeof(envelope), message_received.data_num_bytes());
+  EXPECT_EQ(internal::kLargeMessageEnvelopeName, message_received.name());
+}
+
+
 // This message receiver just accepts messages, and responds (to another fixed
 // receiver)
 class NoTaskStarvationReplier : public MessageReceiver {
@@ -443,9 +681,7 @@ class NoTaskStarvationReplier : public MessageReceiver {
   MOJO_DISALLOW_COPY_AND_ASSIGN(NoTaskStarvationReplier);
 };
 
-// TODO(vtl): This test currently fails. See the discussion on issue #604
-// (https://github.com/domokit/mojo/issues/604).
-TEST_F(ConnectorTest, DISABLED_NoTaskStarvation) {
+TEST_F(ConnectorTest, NoTaskStarvation) {
   internal::Connector connector0(handle0_.Pass());
   internal::Connector connector1(handle1_.Pass());
 
@@ -464,6 +700,93 @@ TEST_F(ConnectorTest, DISABLED_NoTaskStarvation) {
   EXPECT_GE(replier.num_accepted(), 10u);
 }
 
+
+// A receiver that, upon receiving its first message, posts a task that records
+// how many messages had been received by the time the task runs.
+class TaskInterleavingReceiver : public MessageReceiver {
+ public:
+  TaskInterleavingReceiver() {}
+
+  bool Accept(Message* message) override {
+    if (num_accepted_++ == 0u) {
+      RunLoop::current()->PostDelayedTask(
+          [this]() { num_accepted_when_task_ran_ = num_accepted_; }, 0);
+    }
+    return true;
+  }
+
+  unsigned num_accepted() const { return num_accepted_; }
+  unsigned num_accepted_when_task_ran() const {
+    return num_accepted_when_task_ran_;
+  }
+
+ private:
+  unsigned num_accepted_ = 0u;
+  unsigned num_accepted_when_task_ran_ = 0u;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(TaskInterleavingReceiver);
+};
+
+TEST_F(ConnectorTest, MaxMessagesPerWakeup) {
+  internal::Connector connector0(handle0_.Pass());
+  internal::Connector connector1(handle1_.Pass());
+
+  TaskInterleavingReceiver receiver;
+  connector1.set_incoming_receiver(&receiver);
+  connector1.set_max_messages_per_wakeup(2u);
+
+  for (int i = 0; i < 5; i++) {
+    MessageBuilder builder(1u, 0u);
+    ASSERT_TRUE(connector0.Accept(builder.message()));
+  }
+
+  PumpMessages();
+
+  // The connector should have yielded after two messages, letting the task run.
+  EXPECT_EQ(5u, receiver.num_accepted());
+  EXPECT_EQ(2u, receiver.num_accepted_when_task_ran());
+}
+
+TEST_F(ConnectorTest, UnlimitedMessagesPerWakeup) {
+  internal::Connector connector0(handle0_.Pass());
+  internal::Connector connector1(handle1_.Pass());
+
+  TaskInterleavingReceiver receiver;
+  connector1.set_incoming_receiver(&receiver);
+  connector1.set_max_messages_per_wakeup(0u);
+
+  for (int i = 0; i < 5; i++) {
+    MessageBuilder builder(1u, 0u);
+    ASSERT_TRUE(connector0.Accept(builder.message()));
+  }
+
+  PumpMessages();
+
+  EXPECT_EQ(5u, receiver.num_accepted());
+  EXPECT_EQ(5u, receiver.num_accepted_when_task_ran());
+}
+
+TEST_F(ConnectorTest, MaxTimePerWakeup) {
+  internal::Connector connector0(handle0_.Pass());
+  internal::Connector connector1(handle1_.Pass());
+
+  TaskInterleavingReceiver receiver;
+  connector1.set_incoming_receiver(&receiver);
+  connector1.set_max_messages_per_wakeup(0u);
+  // A zero time budget means that we'll yield after every message.
+  connector1.set_max_time_per_wakeup(0u);
+
+  for (int i = 0; i < 5; i++) {
+    MessageBuilder builder(1u, 0u);
+    ASSERT_TRUE(connector0.Accept(builder.message()));
+  }
+
+  PumpMessages();
+
+  EXPECT_EQ(5u, receiver.num_accepted());
+  EXPECT_EQ(1u, receiver.num_accepted_when_task_ran());
+}
+
 }  // namespace
 }  // namespace test
 }  // namespace mojo
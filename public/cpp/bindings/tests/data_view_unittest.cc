@@ -0,0 +1,160 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <string>
+
+#include "mojo/public/cpp/bindings/array.h"
+#include "mojo/public/cpp/bindings/array_data_view.h"
+#include "mojo/public/cpp/bindings/lib/array_internal.h"
+#include "mojo/public/cpp/bindings/lib/array_serialization.h"
+#include "mojo/public/cpp/bindings/lib/fixed_buffer.h"
+#include "mojo/public/cpp/bindings/lib/map_serialization.h"
+#include "mojo/public/cpp/bindings/map.h"
+#include "mojo/public/cpp/bindings/map_data_view.h"
+#include "mojo/public/cpp/bindings/string.h"
+#include "mojo/public/cpp/bindings/string_data_view.h"
+#include "third_party/gtest/include/gtest/gtest.h"
+
+namespace mojo {
+namespace test {
+namespace {
+
+using mojo::internal::Array_Data;
+using mojo::internal::ArrayValidateParams;
+using mojo::internal::FixedBufferForTesting;
+using mojo::internal::Map_Data;
+using mojo::internal::String_Data;
+
+enum class TestEnum : int32_t { FOO = 1, BAR = 2 };
+
+std::string ToStdString(const StringDataView& view) {
+  return std::string(view.storage(), view.size());
+}
+
+TEST(DataViewTest, Null) {
+  EXPECT_TRUE(StringDataView().is_null());
+  EXPECT_TRUE(ArrayDataView<int32_t>().is_null());
+  EXPECT_TRUE((MapDataView<StringDataView, int32_t>().is_null()));
+}
+
+TEST(DataViewTest, String) {
+  String string("hello world");
+  FixedBufferForTesting buf(GetSerializedSize_(string));
+  String_Data* data = nullptr;
+  SerializeString_(string, &buf, &data);
+
+  StringDataView view(data);
+  ASSERT_FALSE(view.is_null());
+  EXPECT_EQ(11u, view.size());
+  EXPECT_EQ("hello world", ToStdString(view));
+  // The view points into the serialized data.
+  EXPECT_EQ(data->storage(), view.storage());
+}
+
+TEST(DataViewTest, ArrayOfPOD) {
+  auto array = Array<int32_t>::New(4);
+  for (size_t i = 0u; i < array.size(); i++)
+    array[i] = static_cast<int32_t>(i * 10);
+  FixedBufferForTesting buf(GetSerializedSize_(array));
+  Array_Data<int32_t>* data = nullptr;
+  ArrayValidateParams validate_params(0, false, nullptr);
+  SerializeArray_(&array, &buf, &data, &validate_params);
+
+  ArrayDataView<int32_t> view(data);
+  ASSERT_EQ(4u, view.size());
+  for (size_t i = 0u; i < view.size(); i++)
+    EXPECT_EQ(static_cast<int32_t>(i * 10), view[i]);
+  EXPECT_EQ(data->storage(), view.data());
+  EXPECT_EQ(0, memcmp(&array[0], view.data(), 4u * sizeof(int32_t)));
+}
+
+TEST(DataViewTest, ArrayOfBool) {
+  auto array = Array<bool>::New(10);
+  for (size_t i = 0u; i < array.size(); i++)
+    array[i] = (i % 3u == 0u);
+  FixedBufferForTesting buf(GetSerializedSize_(array));
+  Array_Data<bool>* data = nullptr;
+  ArrayValidateParams validate_params(0, false, nullptr);
+  SerializeArray_(&array, &buf, &data, &validate_params);
+
+  ArrayDataView<bool> view(data);
+  ASSERT_EQ(10u, view.size());
+  for (size_t i = 0u; i < view.size(); i++)
+    EXPECT_EQ(i % 3u == 0u, view[i]);
+}
+
+TEST(DataViewTest, ArrayOfEnum) {
+  FixedBufferForTesting buf(64u);
+  Array_Data<int32_t>* data = Array_Data<int32_t>::New(2u, &buf);
+  data->at(0) = static_cast<int32_t>(TestEnum::BAR);
+  data->at(1) = static_cast<int32_t>(TestEnum::FOO);
+
+  ArrayDataView<TestEnum> view(data);
+  ASSERT_EQ(2u, view.size());
+  EXPECT_EQ(TestEnum::BAR, view[0]);
+  EXPECT_EQ(TestEnum::FOO, view[1]);
+}
+
+TEST(DataViewTest, ArrayOfNullableString) {
+  auto array = Array<String>::New(3);
+  array[0] = "hello";
+  array[2] = "world";
+  FixedBufferForTesting buf(GetSerializedSize_(array));
+  Array_Data<String_Data*>* data = nullptr;
+  ArrayValidateParams validate_params(
+      0, true, new ArrayValidateParams(0, false, nullptr));
+  SerializeArray_(&array, &buf, &data, &validate_params);
+
+  ArrayDataView<StringDataView> view(data);
+  ASSERT_EQ(3u, view.size());
+  EXPECT_EQ("hello", ToStdString(view[0]));
+  EXPECT_TRUE(view[1].is_null());
+  EXPECT_EQ("world", ToStdString(view[2]));
+}
+
+TEST(DataViewTest, ArrayOfArray) {
+  auto array = Array<Array<uint8_t>>::New(2);
+  array[0] = Array<uint8_t>::New(3);
+  array[1] = Array<uint8_t>::New(5);
+  for (size_t i = 0u; i < array[1].size(); i++)
+    array[1][i] = static_cast<uint8_t>(i + 1u);
+  FixedBufferForTesting buf(GetSerializedSize_(array));
+  Array_Data<Array_Data<uint8_t>*>* data = nullptr;
+  ArrayValidateParams validate_params(
+      0, false, new ArrayValidateParams(0, false, nullptr));
+  SerializeArray_(&array, &buf, &data, &validate_params);
+
+  ArrayDataView<ArrayDataView<uint8_t>> view(data);
+  ASSERT_EQ(2u, view.size());
+  EXPECT_EQ(3u, view[0].size());
+  ASSERT_EQ(5u, view[1].size());
+  for (size_t i = 0u; i < view[1].size(); i++)
+    EXPECT_EQ(i + 1u, view[1].data()[i]);
+}
+
+TEST(DataViewTest, Map) {
+  Map<String, int32_t> map;
+  map["one"] = 1;
+  map["two"] = 2;
+  map["three"] = 3;
+  FixedBufferForTesting buf(GetSerializedSize_(map));
+  Map_Data<String_Data*, int32_t>* data = nullptr;
+  ArrayValidateParams validate_params(0, false, nullptr);
+  SerializeMap_(&map, &buf, &data, &validate_params);
+
+  MapDataView<StringDataView, int32_t> view(data);
+  ASSERT_EQ(3u, view.size());
+  ASSERT_EQ(3u, view.keys().size());
+  ASSERT_EQ(3u, view.values().size());
+  for (size_t i = 0u; i < view.size(); i++) {
+    std::string key = ToStdString(view.keys()[i]);
+    EXPECT_EQ(map[key], view.values()[i]) << key;
+  }
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace mojo
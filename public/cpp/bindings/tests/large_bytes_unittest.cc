@@ -0,0 +1,121 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "mojo/public/cpp/bindings/large_bytes.h"
+#include "third_party/gtest/include/gtest/gtest.h"
+
+namespace mojo {
+namespace test {
+namespace {
+
+std::vector<uint8_t> MakeBytes(size_t num_bytes) {
+  std::vector<uint8_t> bytes(num_bytes);
+  for (size_t i = 0u; i < num_bytes; i++)
+    bytes[i] = static_cast<uint8_t>(i * 7u);
+  return bytes;
+}
+
+void ExpectViewEquals(const std::vector<uint8_t>& expected,
+                      const LargeBytesView& view) {
+  ASSERT_EQ(expected.size(), view.size());
+  EXPECT_EQ(expected, std::vector<uint8_t>(view.data(),
+                                           view.data() + view.size()));
+}
+
+TEST(LargeBytesTest, SmallBytesAreInline) {
+  const std::vector<uint8_t> bytes = MakeBytes(kMaxInlineLargeBytesNumBytes);
+  LargeBytesPtr large_bytes = CreateLargeBytes(bytes.data(), bytes.size());
+  ASSERT_TRUE(large_bytes);
+  ASSERT_TRUE(large_bytes->is_bytes());
+
+  LargeBytesView view;
+  ASSERT_TRUE(view.Init(*large_bytes));
+  ExpectViewEquals(bytes, view);
+  // Inline bytes are viewed in place.
+  EXPECT_EQ(large_bytes->get_bytes().data(), view.data());
+}
+
+TEST(LargeBytesTest, Empty) {
+  LargeBytesPtr large_bytes = CreateLargeBytes(nullptr, 0u);
+  ASSERT_TRUE(large_bytes);
+  EXPECT_TRUE(large_bytes->is_bytes());
+
+  LargeBytesView view;
+  ASSERT_TRUE(view.Init(*large_bytes));
+  EXPECT_EQ(0u, view.size());
+}
+
+TEST(LargeBytesTest, LargeBytesAreInSharedBuffer) {
+  const std::vector<uint8_t> bytes =
+      MakeBytes(kMaxInlineLargeBytesNumBytes * 64u + 3u);
+  LargeBytesPtr large_bytes = CreateLargeBytes(bytes.data(), bytes.size());
+  ASSERT_TRUE(large_bytes);
+  ASSERT_TRUE(large_bytes->is_shared_buffer_bytes());
+  EXPECT_TRUE(large_bytes->get_shared_buffer_bytes()->buffer.is_valid());
+  EXPECT_EQ(0u, large_bytes->get_shared_buffer_bytes()->offset);
+  EXPECT_EQ(bytes.size(), large_bytes->get_shared_buffer_bytes()->num_bytes);
+
+  LargeBytesView view;
+  ASSERT_TRUE(view.Init(*large_bytes));
+  // The mapping outlives the buffer handle.
+  large_bytes.reset();
+  ExpectViewEquals(bytes, view);
+}
+
+TEST(LargeBytesTest, Builder) {
+  const size_t kNumBytes = kMaxInlineLargeBytesNumBytes * 4u;
+  const std::vector<uint8_t> bytes = MakeBytes(kNumBytes);
+
+  LargeBytesBuilder builder(kNumBytes);
+  ASSERT_TRUE(builder.data());
+  EXPECT_EQ(kNumBytes, builder.size());
+  for (size_t i = 0u; i < kNumBytes; i++)
+    builder.data()[i] = bytes[i];
+  LargeBytesPtr large_bytes = builder.Finish();
+  ASSERT_TRUE(large_bytes);
+  EXPECT_TRUE(large_bytes->is_shared_buffer_bytes());
+
+  LargeBytesView view;
+  ASSERT_TRUE(view.Init(*large_bytes));
+  ExpectViewEquals(bytes, view);
+}
+
+TEST(LargeBytesTest, ViewOfPartOfBuffer) {
+  const std::vector<uint8_t> bytes =
+      MakeBytes(kMaxInlineLargeBytesNumBytes * 2u);
+  LargeBytesPtr large_bytes = CreateLargeBytes(bytes.data(), bytes.size());
+  ASSERT_TRUE(large_bytes);
+  ASSERT_TRUE(large_bytes->is_shared_buffer_bytes());
+  large_bytes->get_shared_buffer_bytes()->offset = 8u;
+  large_bytes->get_shared_buffer_bytes()->num_bytes = 100u;
+
+  LargeBytesView view;
+  ASSERT_TRUE(view.Init(*large_bytes));
+  ExpectViewEquals(
+      std::vector<uint8_t>(bytes.begin() + 8u, bytes.begin() + 108u), view);
+}
+
+TEST(LargeBytesTest, ViewOfInvalidRange) {
+  const std::vector<uint8_t> bytes =
+      MakeBytes(kMaxInlineLargeBytesNumBytes * 2u);
+  LargeBytesPtr large_bytes = CreateLargeBytes(bytes.data(), bytes.size());
+  ASSERT_TRUE(large_bytes);
+  ASSERT_TRUE(large_bytes->is_shared_buffer_bytes());
+  large_bytes->get_shared_buffer_bytes()->offset = 1u;
+
+  // The range extends past the end of the buffer.
+  LargeBytesView view;
+  EXPECT_FALSE(view.Init(*large_bytes));
+  EXPECT_FALSE(view.data());
+  EXPECT_EQ(0u, view.size());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace mojo
@@ -0,0 +1,133 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares Maps (backed by std::map) with FlatMaps (backed by a sorted vector)
+// for building, looking up, serializing and deserializing maps of various
+// sizes.
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "mojo/public/cpp/bindings/array.h"
+#include "mojo/public/cpp/bindings/lib/fixed_buffer.h"
+#include "mojo/public/cpp/bindings/lib/map_serialization.h"
+#include "mojo/public/cpp/bindings/map.h"
+#include "mojo/public/cpp/environment/logging.h"
+#include "mojo/public/cpp/system/time.h"
+#include "mojo/public/cpp/test_support/test_support.h"
+#include "third_party/gtest/include/gtest/gtest.h"
+
+namespace mojo {
+namespace test {
+namespace {
+
+// Each measurement handles about this many entries in total.
+const size_t kNumEntriesPerRun = 1u << 20;
+
+const size_t kMapSizes[] = {100u, 10000u, 100000u};
+
+// Returns the keys 0, ..., |num_entries| - 1 in a (deterministic) shuffled
+// order.
+std::vector<uint32_t> MakeKeys(size_t num_entries) {
+  std::vector<uint32_t> keys(num_entries);
+  for (size_t i = 0u; i < num_entries; i++)
+    keys[i] = static_cast<uint32_t>(i);
+  uint32_t state = 1u;
+  for (size_t i = num_entries - 1u; i > 0u; i--) {
+    state = state * 1664525u + 1013904223u;
+    std::swap(keys[i], keys[state % (i + 1u)]);
+  }
+  return keys;
+}
+
+// Builds a map from arrays of keys and values (as deserialization does), which
+// is how FlatMaps are meant to be built from keys in any order.
+template <typename MapType>
+MapType MakeMap(const std::vector<uint32_t>& keys) {
+  auto map_keys = Array<uint32_t>::New(keys.size());
+  auto map_values = Array<uint64_t>::New(keys.size());
+  for (size_t i = 0u; i < keys.size(); i++) {
+    map_keys[i] = keys[i];
+    map_values[i] = static_cast<uint64_t>(keys[i]) * 2u;
+  }
+  MapType map(map_keys.Pass(), map_values.Pass());
+  MOJO_CHECK(map.size() == keys.size());
+  return map;
+}
+
+// Reports the time taken per entry by each of |num_iterations| runs of |fn|
+// on maps of |num_entries| entries.
+template <typename Fn>
+void ReportPerf(const std::string& test_name,
+                const char* sub_test_name,
+                size_t num_entries,
+                size_t num_iterations,
+                Fn fn) {
+  const MojoTimeTicks start_time = GetTimeTicksNow();
+  for (size_t i = 0u; i < num_iterations; i++)
+    fn();
+  const MojoTimeTicks elapsed = GetTimeTicksNow() - start_time;
+  test::LogPerfResult(test_name.c_str(), sub_test_name,
+                      static_cast<double>(elapsed) * 1000.0 /
+                          static_cast<double>(num_iterations * num_entries),
+                      "nanoseconds/entry");
+}
+
+template <typename MapType>
+void RunPerfTests(const char* sub_test_name) {
+  for (size_t num_entries : kMapSizes) {
+    const std::string suffix = "_" + std::to_string(num_entries);
+    const size_t num_iterations =
+        std::max<size_t>(1u, kNumEntriesPerRun / num_entries);
+    const std::vector<uint32_t> keys = MakeKeys(num_entries);
+
+    ReportPerf("MapConstruction" + suffix, sub_test_name, num_entries,
+               num_iterations, [&keys]() { MakeMap<MapType>(keys); });
+
+    MapType map = MakeMap<MapType>(keys);
+    uint64_t sum = 0u;
+    ReportPerf("MapLookup" + suffix, sub_test_name, num_entries,
+               num_iterations, [&keys, &map, &sum]() {
+                 for (uint32_t key : keys)
+                   sum += map.find(key).GetValue();
+               });
+    EXPECT_EQ(static_cast<uint64_t>(num_iterations) * num_entries *
+                  (num_entries - 1u),
+              sum);
+
+    const internal::ArrayValidateParams validate_params(0, false, nullptr);
+    const size_t size = GetSerializedSize_(map);
+    internal::FixedBufferForTesting buf(size * num_iterations);
+    std::vector<typename MapType::Data_*> data(num_iterations);
+    size_t i = 0u;
+    ReportPerf("MapSerialization" + suffix, sub_test_name, num_entries,
+               num_iterations, [&map, &buf, &data, &i, &validate_params]() {
+                 GetSerializedSize_(map);
+                 SerializeMap_(&map, &buf, &data[i++], &validate_params);
+               });
+
+    i = 0u;
+    ReportPerf("MapDeserialization" + suffix, sub_test_name, num_entries,
+               num_iterations, [&data, &i]() {
+                 MapType deserialized;
+                 Deserialize_(data[i++], &deserialized);
+                 MOJO_CHECK(deserialized.size() == data[0]->keys.ptr->size());
+               });
+  }
+}
+
+TEST(MapPerftest, Map) {
+  RunPerfTests<Map<uint32_t, uint64_t>>("Map");
+}
+
+TEST(MapPerftest, FlatMap) {
+  RunPerfTests<FlatMap<uint32_t, uint64_t>>("FlatMap");
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace mojo
@@ -424,6 +424,105 @@ TEST(MapTest, Serialization_MapOfNullableStructs) {
   EXPECT_EQ(4, map2[1]->height);
 }
 
+// Tests that a FlatMap sorts entries inserted in any order, and that it keeps
+// the first value inserted for each key, like Map.
+TEST(MapTest, FlatMap_InsertOutOfOrder) {
+  FlatMap<int32_t, int32_t> map;
+  EXPECT_TRUE(map.is_null());
+  for (int32_t i = 0; i < 100; ++i)
+    map.insert((i * 37) % 100, i);
+  map.insert(5, -1);
+  map[200] = 200;
+  map[5] = map[5] + 1000;
+
+  ASSERT_EQ(101u, map.size());
+  int32_t expected_key = 0;
+  for (auto it = map.cbegin(); it != map.cend(); ++it) {
+    EXPECT_EQ(expected_key, it.GetKey());
+    expected_key = expected_key == 99 ? 200 : expected_key + 1;
+  }
+  EXPECT_EQ(1065, map.at(5));
+  EXPECT_EQ(200, map.at(200));
+  EXPECT_EQ(1, map.at(37));
+  EXPECT_TRUE(map.find(100) == map.end());
+
+  // Entries inserted after reading the map are sorted in.
+  map.insert(-1, -1);
+  map.insert(37, -1);
+  ASSERT_EQ(102u, map.size());
+  EXPECT_EQ(-1, map.cbegin().GetKey());
+  EXPECT_EQ(1, map.at(37));
+}
+
+// Tests that a FlatMap constructed from arrays of keys and values (as when it
+// is deserialized) is sorted once constructed, keeping the first value for
+// each key, so that it can be read through const methods.
+TEST(MapTest, FlatMap_ConstructedFromArrays) {
+  auto keys = Array<int32_t>::New(100);
+  auto values = Array<int32_t>::New(100);
+  for (int32_t i = 0; i < 100; ++i) {
+    keys[i] = (i * 37) % 50;
+    values[i] = i;
+  }
+  const FlatMap<int32_t, int32_t> map(keys.Pass(), values.Pass());
+
+  ASSERT_EQ(50u, map.size());
+  int32_t expected_key = 0;
+  for (auto it = map.cbegin(); it != map.cend(); ++it)
+    EXPECT_EQ(expected_key++, it.GetKey());
+  EXPECT_EQ(0, map.at(0));
+  EXPECT_EQ(1, map.at(37));
+  EXPECT_EQ(11, map.at(7));
+  EXPECT_TRUE(map.find(50) == map.cend());
+}
+
+TEST(MapTest, FlatMap_MoveOnlyValues) {
+  FlatMap<String, Array<String>> map;
+  for (size_t i = kStringIntDataSize; i > 0; --i) {
+    Array<String> s;
+    s.push_back(kStringIntData[i - 1].string_data);
+    map.insert(kStringIntData[i - 1].string_data, s.Pass());
+  }
+
+  FlatMap<String, Array<String>> clone = map.Clone();
+  EXPECT_TRUE(clone.Equals(map));
+  ASSERT_EQ(kStringIntDataSize, clone.size());
+  for (auto it = clone.begin(); it != clone.end(); ++it) {
+    ASSERT_EQ(1u, it.GetValue().size());
+    EXPECT_EQ(it.GetKey(), it.GetValue().at(0));
+  }
+}
+
+// Tests that FlatMaps are serialized like Maps.
+TEST(MapTest, FlatMap_Serialization) {
+  Map<String, int32_t> map;
+  FlatMap<String, int32_t> flat_map;
+  for (size_t i = 0; i < kStringIntDataSize; ++i) {
+    map.insert(kStringIntData[i].string_data, kStringIntData[i].int_data);
+    flat_map.insert(kStringIntData[i].string_data, kStringIntData[i].int_data);
+  }
+
+  const size_t size = GetSerializedSize_(map);
+  EXPECT_EQ(size, GetSerializedSize_(flat_map));
+  FixedBufferForTesting buf(size);
+  FixedBufferForTesting flat_buf(size);
+  Map_Data<String_Data*, int32_t>* data = nullptr;
+  Map_Data<String_Data*, int32_t>* flat_data = nullptr;
+  ArrayValidateParams validate_params(0, false, nullptr);
+  EXPECT_EQ(ValidationError::NONE,
+            SerializeMap_(&map, &buf, &data, &validate_params));
+  EXPECT_EQ(ValidationError::NONE,
+            SerializeMap_(&flat_map, &flat_buf, &flat_data, &validate_params));
+  EXPECT_EQ(buf.BytesUsed(), flat_buf.BytesUsed());
+
+  FlatMap<String, int32_t> deserialized;
+  Deserialize_(data, &deserialized);
+  EXPECT_TRUE(deserialized.Equals(flat_map));
+  Map<String, int32_t> deserialized_map;
+  Deserialize_(flat_data, &deserialized_map);
+  EXPECT_TRUE(deserialized_map.Equals(map));
+}
+
 }  // namespace
 }  // namespace test
 }  // namespace mojo
@@ -0,0 +1,211 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <pthread.h>
+#include <string.h>
+
+#include "mojo/public/cpp/bindings/lib/message_buffer_pool.h"
+#include "mojo/public/cpp/bindings/lib/message_builder.h"
+#include "mojo/public/cpp/bindings/message.h"
+#include "third_party/gtest/include/gtest/gtest.h"
+
+namespace mojo {
+namespace test {
+namespace {
+
+using internal::MessageBufferPool;
+
+TEST(MessageBufferPoolTest, SizeClasses) {
+  MessageBufferPool pool;
+  size_t capacity = 0u;
+
+  void* buffer = pool.Allocate(1u, &capacity);
+  ASSERT_TRUE(buffer);
+  EXPECT_EQ(MessageBufferPool::kMinBufferSize, capacity);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(buffer) % 8);
+  pool.Free(buffer, capacity);
+
+  buffer = pool.Allocate(MessageBufferPool::kMinBufferSize + 1u, &capacity);
+  EXPECT_EQ(2u * MessageBufferPool::kMinBufferSize, capacity);
+  pool.Free(buffer, capacity);
+
+  buffer = pool.Allocate(MessageBufferPool::kMaxBufferSize, &capacity);
+  EXPECT_EQ(MessageBufferPool::kMaxBufferSize, capacity);
+  pool.Free(buffer, capacity);
+
+  // Oversized buffers are exactly sized and never cached.
+  buffer = pool.Allocate(MessageBufferPool::kMaxBufferSize + 1u, &capacity);
+  EXPECT_EQ(MessageBufferPool::kMaxBufferSize + 1u, capacity);
+  pool.Free(buffer, capacity);
+
+  EXPECT_EQ(4u, pool.stats().num_allocations);
+  EXPECT_EQ(4u, pool.stats().num_frees);
+  EXPECT_EQ(3u, pool.stats().num_cached_frees);
+  EXPECT_EQ(3u, pool.GetNumCachedBuffers());
+}
+
+TEST(MessageBufferPoolTest, Reuse) {
+  MessageBufferPool pool;
+  size_t capacity = 0u;
+
+  void* buffer1 = pool.Allocate(100u, &capacity);
+  pool.Free(buffer1, capacity);
+  EXPECT_EQ(0u, pool.stats().num_cache_hits);
+
+  // An allocation in the same size class should get the same buffer back.
+  void* buffer2 = pool.Allocate(128u, &capacity);
+  EXPECT_EQ(buffer1, buffer2);
+  EXPECT_EQ(1u, pool.stats().num_cache_hits);
+  EXPECT_EQ(0u, pool.GetNumCachedBuffers());
+  pool.Free(buffer2, capacity);
+
+  // But not one in a different size class.
+  void* buffer3 = pool.Allocate(129u, &capacity);
+  EXPECT_NE(buffer1, buffer3);
+  EXPECT_EQ(1u, pool.stats().num_cache_hits);
+  pool.Free(buffer3, capacity);
+
+  pool.ResetStats();
+  EXPECT_EQ(0u, pool.stats().num_allocations);
+  EXPECT_EQ(2u, pool.GetNumCachedBuffers());
+  pool.Trim();
+  EXPECT_EQ(0u, pool.GetNumCachedBuffers());
+}
+
+TEST(MessageBufferPoolTest, AllocateZeroed) {
+  MessageBufferPool pool;
+  size_t capacity = 0u;
+
+  // Dirty a cached buffer, then get it back zeroed.
+  char* buffer = static_cast<char*>(pool.Allocate(100u, &capacity));
+  memset(buffer, 'x', capacity);
+  pool.Free(buffer, capacity);
+  char* zeroed = static_cast<char*>(pool.AllocateZeroed(100u, &capacity));
+  EXPECT_EQ(buffer, zeroed);
+  for (size_t i = 0u; i < 100u; i++)
+    ASSERT_EQ(0, zeroed[i]);
+  pool.Free(zeroed, capacity);
+
+  const size_t kLargeSize = MessageBufferPool::kMaxBufferSize + 1u;
+  zeroed = static_cast<char*>(pool.AllocateZeroed(kLargeSize, &capacity));
+  EXPECT_EQ(kLargeSize, capacity);
+  for (size_t i = 0u; i < kLargeSize; i++)
+    ASSERT_EQ(0, zeroed[i]);
+  pool.Free(zeroed, capacity);
+
+  EXPECT_EQ(3u, pool.stats().num_allocations);
+  EXPECT_EQ(1u, pool.stats().num_cache_hits);
+}
+
+TEST(MessageBufferPoolTest, BoundedCache) {
+  MessageBufferPool pool;
+  const size_t kMaxCached = 3u;
+  pool.SetMaxCachedBuffersPerSizeClass(kMaxCached);
+
+  const size_t kNumBuffers = 10u;
+  void* buffers[kNumBuffers];
+  size_t capacity = 0u;
+  for (size_t i = 0u; i < kNumBuffers; i++)
+    buffers[i] = pool.Allocate(200u, &capacity);
+  for (size_t i = 0u; i < kNumBuffers; i++)
+    pool.Free(buffers[i], capacity);
+
+  EXPECT_EQ(kMaxCached, pool.GetNumCachedBuffers());
+  EXPECT_EQ(kMaxCached, pool.stats().num_cached_frees);
+
+  // Lowering the bound trims the cache; zero disables caching.
+  pool.SetMaxCachedBuffersPerSizeClass(1u);
+  EXPECT_EQ(1u, pool.GetNumCachedBuffers());
+  pool.SetMaxCachedBuffersPerSizeClass(0u);
+  EXPECT_EQ(0u, pool.GetNumCachedBuffers());
+  void* buffer = pool.Allocate(200u, &capacity);
+  pool.Free(buffer, capacity);
+  EXPECT_EQ(0u, pool.GetNumCachedBuffers());
+}
+
+void* GetCurrentPool(void* result) {
+  *static_cast<MessageBufferPool**>(result) = MessageBufferPool::current();
+  return nullptr;
+}
+
+TEST(MessageBufferPoolTest, PerThread) {
+  MessageBufferPool* pool = MessageBufferPool::current();
+  ASSERT_TRUE(pool);
+  EXPECT_EQ(pool, MessageBufferPool::current());
+
+  MessageBufferPool* other_pool = nullptr;
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(&thread, nullptr, &GetCurrentPool, &other_pool));
+  ASSERT_EQ(0, pthread_join(thread, nullptr));
+  EXPECT_TRUE(other_pool);
+  EXPECT_NE(pool, other_pool);
+}
+
+TEST(MessageBufferPoolTest, MessagesReuseBuffers) {
+  MessageBufferPool* pool = MessageBufferPool::current();
+  pool->Trim();
+  pool->ResetStats();
+
+  const uint8_t* data = nullptr;
+  {
+    MessageBuilder builder(1u, 40u);
+    data = builder.message()->data();
+    // Dirty the buffer, to check that it gets zeroed when reused.
+    builder.message()->mutable_payload()[0] = 0xff;
+  }
+  EXPECT_EQ(1u, pool->stats().num_allocations);
+  EXPECT_EQ(1u, pool->stats().num_cached_frees);
+
+  {
+    MessageBuilder builder(2u, 40u);
+    EXPECT_EQ(data, builder.message()->data());
+    EXPECT_EQ(0u, builder.message()->payload()[0]);
+
+    // Moving a message should transfer the buffer rather than freeing it.
+    Message message;
+    builder.message()->MoveTo(&message);
+    EXPECT_EQ(data, message.data());
+    EXPECT_EQ(2u, message.name());
+  }
+  EXPECT_EQ(2u, pool->stats().num_allocations);
+  EXPECT_EQ(1u, pool->stats().num_cache_hits);
+  EXPECT_EQ(2u, pool->stats().num_frees);
+}
+
+class PoolAllocatedBase {
+ public:
+  virtual ~PoolAllocatedBase() {}
+};
+
+class PoolAllocatedObject : public PoolAllocatedBase,
+                            public internal::MessageBufferPoolAllocated {
+ public:
+  ~PoolAllocatedObject() override {}
+
+  char data[100];
+};
+
+TEST(MessageBufferPoolTest, PoolAllocated) {
+  MessageBufferPool* pool = MessageBufferPool::current();
+  pool->Trim();
+  pool->ResetStats();
+
+  // Deleting through a base class pointer should return the memory (with the
+  // right size) to the pool.
+  PoolAllocatedBase* object = new PoolAllocatedObject();
+  delete object;
+  EXPECT_EQ(1u, pool->stats().num_allocations);
+  EXPECT_EQ(1u, pool->stats().num_cached_frees);
+
+  PoolAllocatedBase* other_object = new PoolAllocatedObject();
+  EXPECT_EQ(object, other_object);
+  delete other_object;
+  EXPECT_EQ(2u, pool->stats().num_allocations);
+  EXPECT_EQ(1u, pool->stats().num_cache_hits);
+  EXPECT_EQ(2u, pool->stats().num_cached_frees);
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace mojo
@@ -2,9 +2,18 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "mojo/public/cpp/bindings/array.h"
+#include "mojo/public/cpp/bindings/lib/array_serialization.h"
 #include "mojo/public/cpp/bindings/lib/bindings_serialization.h"
 #include "mojo/public/cpp/bindings/lib/message_builder.h"
 #include "mojo/public/cpp/bindings/lib/message_internal.h"
+#include "mojo/public/cpp/bindings/lib/string_serialization.h"
+#include "mojo/public/cpp/bindings/string.h"
 #include "third_party/gtest/include/gtest/gtest.h"
 
 namespace mojo {
@@ -71,6 +80,205 @@ TEST(MessageBuilderTest, ResponseMessageBuilder) {
   EXPECT_EQ(sizeof(internal::MessageHeaderWithRequestID), msg_hdr->num_bytes);
 }
 
+TEST(MessageBuilderTest, ScatterGather) {
+  const size_t kLargeSize = internal::MessageBuffer::kMinExternalDataNumBytes;
+  const std::string large(kLargeSize, 'x');
+  const std::string small(kLargeSize - 1u, 'y');
+
+  MessageBuilder b(123u, 3u * kLargeSize);
+  b.EnableScatterGather();
+  void* large_dest = b.buffer()->Allocate(kLargeSize);
+  b.buffer()->CopyBytes(large_dest, large.data(), kLargeSize);
+  void* small_dest = b.buffer()->Allocate(kLargeSize - 1u);
+  b.buffer()->CopyBytes(small_dest, small.data(), kLargeSize - 1u);
+
+  // Only the large block is referenced in place; the small one was copied.
+  ASSERT_TRUE(b.message()->has_external_data());
+  std::vector<MojoMessageSegment> segments;
+  b.message()->GetDataSegments(&segments);
+  ASSERT_EQ(3u, segments.size());
+  EXPECT_EQ(sizeof(internal::MessageHeader), segments[0].num_bytes);
+  EXPECT_EQ(large.data(), segments[1].bytes);
+  EXPECT_EQ(kLargeSize, segments[1].num_bytes);
+  EXPECT_EQ(b.message()->data_num_bytes(),
+            segments[0].num_bytes + segments[1].num_bytes +
+                segments[2].num_bytes);
+
+  // Accessing the data copies the external data in.
+  const uint8_t* payload = b.message()->payload();
+  EXPECT_FALSE(b.message()->has_external_data());
+  EXPECT_EQ(0, memcmp(payload, large.data(), kLargeSize));
+  EXPECT_EQ(0, memcmp(payload + kLargeSize, small.data(), kLargeSize - 1u));
+}
+
+TEST(MessageBuilderTest, ScatterGatherString) {
+  const String large(std::string(
+      internal::MessageBuffer::kMinExternalDataNumBytes, 'x'));
+
+  // Without scatter-gather mode, strings are always copied.
+  {
+    MessageBuilder b(123u, GetSerializedSize_(large));
+    internal::String_Data* data = nullptr;
+    SerializeString_(large, b.buffer(), &data);
+    EXPECT_FALSE(b.message()->has_external_data());
+    EXPECT_EQ(0, memcmp(data->storage(), large.data(), large.size()));
+  }
+
+  {
+    MessageBuilder b(123u, GetSerializedSize_(large));
+    b.EnableScatterGather();
+    internal::String_Data* data = nullptr;
+    SerializeString_(large, b.buffer(), &data);
+    EXPECT_TRUE(b.message()->has_external_data());
+
+    // Moving the message copies the external data in.
+    Message message;
+    b.message()->MoveTo(&message);
+    EXPECT_FALSE(message.has_external_data());
+    EXPECT_EQ(0, memcmp(data->storage(), large.data(), large.size()));
+  }
+}
+
+TEST(MessageBuilderTest, SinglePassMessageBuilder) {
+  SinglePassMessageBuilder b(123u);
+  void* payload = b.buffer()->Allocate(41);
+  memset(payload, 'x', 41);
+  b.Finish();
+
+  EXPECT_EQ(48u, b.message()->payload_num_bytes());
+  EXPECT_EQ(48u + sizeof(internal::MessageHeader),
+            b.message()->data_num_bytes());
+  EXPECT_EQ(0, memcmp(b.message()->payload(), std::string(41, 'x').data(),
+                      41u));
+
+  const auto* msg_hdr =
+      reinterpret_cast<const internal::MessageHeader*>(b.message()->data());
+  EXPECT_EQ(123u, msg_hdr->name);
+  EXPECT_EQ(0u, msg_hdr->flags);
+  EXPECT_EQ(0u, msg_hdr->version);
+  EXPECT_EQ(sizeof(internal::MessageHeader), msg_hdr->num_bytes);
+}
+
+TEST(MessageBuilderTest, SinglePassMessageBuilderWithRequestID) {
+  SinglePassMessageBuilder b(123u, internal::kMessageIsResponse, 456u);
+  b.Finish();
+
+  EXPECT_EQ(0u, b.message()->payload_num_bytes());
+  const auto* msg_hdr =
+      reinterpret_cast<const internal::MessageHeaderWithRequestID*>(
+          b.message()->data());
+  EXPECT_EQ(123u, msg_hdr->name);
+  EXPECT_EQ(internal::kMessageIsResponse, msg_hdr->flags);
+  EXPECT_EQ(1u, msg_hdr->version);
+  EXPECT_EQ(456u, msg_hdr->request_id);
+  EXPECT_EQ(sizeof(internal::MessageHeaderWithRequestID), msg_hdr->num_bytes);
+}
+
+// Tests that a message built in a single pass, spanning several chunks, is the
+// same as one built by |MessageBuilder|.
+TEST(MessageBuilderTest, SinglePassMessageBuilderMatchesMessageBuilder) {
+  auto array = Array<String>::New(100);
+  for (size_t i = 0u; i < array.size(); i++)
+    array[i] = std::string(i, 'a' + static_cast<char>(i % 26u));
+  const internal::ArrayValidateParams validate_params(
+      0, false, new internal::ArrayValidateParams(0, false, nullptr));
+
+  MessageBuilder b1(123u, GetSerializedSize_(array));
+  internal::Array_Data<internal::String_Data*>* data1 = nullptr;
+  SerializeArray_(&array, b1.buffer(), &data1, &validate_params);
+  data1->EncodePointersAndHandles(b1.message()->mutable_handles());
+
+  SinglePassMessageBuilder b2(123u);
+  internal::Array_Data<internal::String_Data*>* data2 = nullptr;
+  SerializeArray_(&array, b2.buffer(), &data2, &validate_params);
+  b2.Finish();
+
+  ASSERT_EQ(b1.message()->data_num_bytes(), b2.message()->data_num_bytes());
+  EXPECT_EQ(0, memcmp(b1.message()->data(), b2.message()->data(),
+                      b1.message()->data_num_bytes()));
+}
+
+// Tests that, in scatter-gather mode, large chunks are referenced rather than
+// copied into the message.
+TEST(MessageBuilderTest, SinglePassMessageBuilderScatterGatherChunks) {
+  auto array = Array<String>::New(1000);
+  for (size_t i = 0u; i < array.size(); i++)
+    array[i] = "string";
+  const internal::ArrayValidateParams validate_params(
+      0, false, new internal::ArrayValidateParams(0, false, nullptr));
+
+  MessageBuilder b1(123u, GetSerializedSize_(array));
+  internal::Array_Data<internal::String_Data*>* data1 = nullptr;
+  SerializeArray_(&array, b1.buffer(), &data1, &validate_params);
+  data1->EncodePointersAndHandles(b1.message()->mutable_handles());
+
+  SinglePassMessageBuilder b2(123u);
+  b2.EnableScatterGather();
+  internal::Array_Data<internal::String_Data*>* data2 = nullptr;
+  SerializeArray_(&array, b2.buffer(), &data2, &validate_params);
+  b2.Finish();
+
+  ASSERT_TRUE(b2.message()->has_external_data());
+  std::vector<MojoMessageSegment> segments;
+  b2.message()->GetDataSegments(&segments);
+  EXPECT_LT(2u, segments.size());
+  size_t num_bytes = 0u;
+  for (const auto& segment : segments)
+    num_bytes += segment.num_bytes;
+  EXPECT_EQ(b2.message()->data_num_bytes(), num_bytes);
+
+  ASSERT_EQ(b1.message()->data_num_bytes(), b2.message()->data_num_bytes());
+  EXPECT_EQ(0, memcmp(b1.message()->data(), b2.message()->data(),
+                      b1.message()->data_num_bytes()));
+}
+
+TEST(MessageBuilderTest, SinglePassMessageBuilderHandles) {
+  // These handles are never used (but are closed if the message is
+  // destroyed with them).
+  auto array = Array<ScopedMessagePipeHandle>::New(3);
+  array[0].reset(MessagePipeHandle(10u));
+  array[2].reset(MessagePipeHandle(20u));
+  const internal::ArrayValidateParams validate_params(0, true, nullptr);
+
+  SinglePassMessageBuilder b(123u);
+  internal::Array_Data<MessagePipeHandle>* data = nullptr;
+  SerializeArray_(&array, b.buffer(), &data, &validate_params);
+  b.Finish();
+
+  std::vector<Handle>* handles = b.message()->mutable_handles();
+  ASSERT_EQ(2u, handles->size());
+  EXPECT_EQ(10u, handles->at(0).value());
+  EXPECT_EQ(20u, handles->at(1).value());
+  EXPECT_EQ(0u, data->at(0).value());
+  EXPECT_EQ(internal::kEncodedInvalidHandleValue, data->at(1).value());
+  EXPECT_EQ(1u, data->at(2).value());
+  handles->clear();
+}
+
+TEST(MessageBuilderTest, SinglePassMessageBuilderScatterGather) {
+  const String large(std::string(
+      internal::MessageBuffer::kMinExternalDataNumBytes, 'x'));
+
+  SinglePassMessageBuilder b(123u);
+  b.EnableScatterGather();
+  internal::String_Data* data = nullptr;
+  SerializeString_(large, b.buffer(), &data);
+  b.Finish();
+
+  ASSERT_TRUE(b.message()->has_external_data());
+  std::vector<MojoMessageSegment> segments;
+  b.message()->GetDataSegments(&segments);
+  ASSERT_EQ(3u, segments.size());
+  EXPECT_EQ(large.data(), segments[1].bytes);
+  EXPECT_EQ(large.size(), segments[1].num_bytes);
+  EXPECT_EQ(0u, segments[2].num_bytes);
+
+  const auto* string_data =
+      reinterpret_cast<const internal::String_Data*>(b.message()->payload());
+  EXPECT_EQ(large.size(), string_data->size());
+  EXPECT_EQ(0, memcmp(string_data->storage(), large.data(), large.size()));
+}
+
 }  // namespace
 }  // namespace test
 }  // namespace mojo
@@ -0,0 +1,114 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "mojo/public/cpp/bindings/lib/responder_table.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "mojo/public/cpp/bindings/message.h"
+#include "third_party/gtest/include/gtest/gtest.h"
+
+namespace mojo {
+namespace test {
+namespace {
+
+using internal::ResponderTable;
+
+// The table never dereferences responders, so fake (distinct) ones suffice.
+MessageReceiver* FakeResponder(uint64_t i) {
+  return reinterpret_cast<MessageReceiver*>(static_cast<uintptr_t>(8u * i));
+}
+
+TEST(ResponderTableTest, Basic) {
+  ResponderTable table;
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(nullptr, table.Remove(1u));
+  EXPECT_EQ(nullptr, table.Remove(0u));
+
+  table.Insert(1u, FakeResponder(1u));
+  table.Insert(2u, FakeResponder(2u));
+  // Collides with 1 (for the initial capacity).
+  table.Insert(1u + ResponderTable::kInitialCapacity, FakeResponder(3u));
+  EXPECT_EQ(3u, table.size());
+
+  EXPECT_EQ(nullptr, table.Remove(3u));
+  EXPECT_EQ(FakeResponder(1u), table.Remove(1u));
+  EXPECT_EQ(nullptr, table.Remove(1u));
+  EXPECT_EQ(FakeResponder(3u),
+            table.Remove(1u + ResponderTable::kInitialCapacity));
+  EXPECT_EQ(FakeResponder(2u), table.Remove(2u));
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(3u, table.max_size());
+}
+
+TEST(ResponderTableTest, RemoveAll) {
+  ResponderTable table;
+  for (uint64_t i = 1u; i <= 100u; i++)
+    table.Insert(i, FakeResponder(i));
+
+  std::vector<MessageReceiver*> responders;
+  table.RemoveAll(&responders);
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(100u, table.max_size());
+  ASSERT_EQ(100u, responders.size());
+  std::sort(responders.begin(), responders.end());
+  for (uint64_t i = 1u; i <= 100u; i++)
+    EXPECT_EQ(FakeResponder(i), responders[i - 1u]);
+
+  table.Insert(5u, FakeResponder(5u));
+  EXPECT_EQ(FakeResponder(5u), table.Remove(5u));
+}
+
+// Compares the table against |std::map|, with sequential request IDs (as a
+// |Router| issues them) completing in a pseudorandom order, plus some sparse
+// IDs to cause collisions.
+TEST(ResponderTableTest, MatchesReference) {
+  ResponderTable table;
+  std::map<uint64_t, MessageReceiver*> reference;
+
+  uint64_t random_state = 12345u;
+  auto random = [&random_state]() {
+    random_state = random_state * 6364136223846793005u + 1442695040888963407u;
+    return static_cast<uint32_t>(random_state >> 33);
+  };
+
+  uint64_t next_request_id = 1u;
+  size_t max_size = 0u;
+  for (int iteration = 0; iteration < 100000; iteration++) {
+    uint32_t action = random() % 8u;
+    if (action < 4u || reference.empty()) {
+      uint64_t request_id = next_request_id++;
+      if (action == 0u)
+        request_id = (uint64_t{random()} << 32) | 1u;
+      if (reference.count(request_id))
+        continue;
+      table.Insert(request_id, FakeResponder(request_id));
+      reference[request_id] = FakeResponder(request_id);
+    } else if (action == 7u) {
+      uint64_t request_id = next_request_id + random() % 10u;
+      EXPECT_EQ(nullptr, table.Remove(request_id));
+    } else {
+      // Remove an existing entry (biased towards older ones).
+      auto it = reference.begin();
+      std::advance(it, random() % std::min<size_t>(reference.size(), 64u));
+      ASSERT_EQ(it->second, table.Remove(it->first));
+      reference.erase(it);
+    }
+    max_size = std::max(max_size, reference.size());
+    ASSERT_EQ(reference.size(), table.size());
+  }
+  EXPECT_EQ(max_size, table.max_size());
+
+  for (const auto& entry : reference)
+    EXPECT_EQ(entry.second, table.Remove(entry.first));
+  EXPECT_TRUE(table.empty());
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace mojo
@@ -0,0 +1,196 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file has perf tests for |mojo::internal::Router| with many requests in
+// flight: the cost of round trips when all the requests are sent before any
+// responses are, and (in isolation) the cost of tracking the responders.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "mojo/public/cpp/bindings/lib/message_builder.h"
+#include "mojo/public/cpp/bindings/lib/responder_table.h"
+#include "mojo/public/cpp/bindings/lib/router.h"
+#include "mojo/public/cpp/bindings/message.h"
+#include "mojo/public/cpp/system/macros.h"
+#include "mojo/public/cpp/system/message_pipe.h"
+#include "mojo/public/cpp/system/time.h"
+#include "mojo/public/cpp/test_support/test_support.h"
+#include "mojo/public/cpp/utility/run_loop.h"
+#include "third_party/gtest/include/gtest/gtest.h"
+
+namespace mojo {
+namespace {
+
+constexpr uint32_t kMessageName = 1u;
+constexpr size_t kPayloadSize = 8u;
+
+double GetPerSecond(uint64_t count, MojoTimeTicks start_time) {
+  return static_cast<double>(count) /
+         (static_cast<double>(GetTimeTicksNow() - start_time) / 1000000.0);
+}
+
+// Counts the responses it's given (one per instance, since responders are
+// deleted after use).
+class CountingResponder : public MessageReceiver {
+ public:
+  explicit CountingResponder(uint64_t* count) : count_(count) {}
+  ~CountingResponder() override {}
+
+  bool Accept(Message* message) override {
+    (*count_)++;
+    return true;
+  }
+
+ private:
+  uint64_t* const count_;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(CountingResponder);
+};
+
+// Holds on to the requests it receives, until told to respond to them.
+class DeferredResponseGenerator : public MessageReceiverWithResponderStatus {
+ public:
+  DeferredResponseGenerator() {}
+  ~DeferredResponseGenerator() override {
+    for (const auto& request : pending_requests_)
+      delete request.second;
+  }
+
+  size_t num_pending_requests() const { return pending_requests_.size(); }
+
+  // Responds to all the pending requests, in the order received or in reverse
+  // order.
+  void RespondToAll(bool reverse) {
+    if (reverse) {
+      std::reverse(pending_requests_.begin(), pending_requests_.end());
+    }
+    for (const auto& request : pending_requests_) {
+      ResponseMessageBuilder builder(kMessageName, kPayloadSize, request.first);
+      builder.buffer()->Allocate(kPayloadSize);
+      EXPECT_TRUE(request.second->Accept(builder.message()));
+      delete request.second;
+    }
+    pending_requests_.clear();
+  }
+
+  // MessageReceiverWithResponderStatus:
+  bool Accept(Message* message) override { return false; }
+  bool AcceptWithResponder(Message* message,
+                           MessageReceiverWithStatus* responder) override {
+    pending_requests_.push_back(
+        std::make_pair(message->request_id(), responder));
+    return true;
+  }
+
+ private:
+  std::vector<std::pair<uint64_t, MessageReceiverWithStatus*>>
+      pending_requests_;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(DeferredResponseGenerator);
+};
+
+// Repeatedly sends |num_requests| requests, and then (once they've all been
+// received) responds to all of them, and reports the number of requests
+// completed per second.
+void DoOutstandingRequestsPerfTest(size_t num_requests, bool reverse) {
+  constexpr unsigned kNumRounds = 20u;
+
+  RunLoop run_loop;
+  MessagePipe pipe;
+  internal::Router router0(pipe.handle0.Pass(),
+                           internal::MessageValidatorList());
+  internal::Router router1(pipe.handle1.Pass(),
+                           internal::MessageValidatorList());
+  DeferredResponseGenerator generator;
+  router1.set_incoming_receiver(&generator);
+
+  uint64_t num_responses = 0u;
+  MojoTimeTicks start_time = GetTimeTicksNow();
+  for (unsigned round = 0u; round < kNumRounds; round++) {
+    for (size_t i = 0u; i < num_requests; i++) {
+      RequestMessageBuilder builder(kMessageName, kPayloadSize);
+      builder.buffer()->Allocate(kPayloadSize);
+      EXPECT_TRUE(router0.AcceptWithResponder(
+          builder.message(), new CountingResponder(&num_responses)));
+    }
+    while (generator.num_pending_requests() < num_requests)
+      run_loop.RunUntilIdle();
+    generator.RespondToAll(reverse);
+    while (router0.num_pending_responses() > 0u)
+      run_loop.RunUntilIdle();
+  }
+  double result = GetPerSecond(num_responses, start_time);
+  EXPECT_EQ(kNumRounds * num_requests, num_responses);
+  EXPECT_EQ(num_requests, router0.max_pending_responses());
+
+  char sub_test_name[100] = {};
+  sprintf(sub_test_name, "%u_%s", static_cast<unsigned>(num_requests),
+          reverse ? "Reversed" : "InOrder");
+  test::LogPerfResult("RouterPerftest.OutstandingRequests", sub_test_name,
+                      result, "requests/second");
+}
+
+TEST(RouterPerftest, OutstandingRequests) {
+  DoOutstandingRequestsPerfTest(1u, false);
+  DoOutstandingRequestsPerfTest(10000u, false);
+  DoOutstandingRequestsPerfTest(10000u, true);
+}
+
+// Measures just the responder bookkeeping that a |Router| does for
+// |kNumRequests| outstanding requests (inserting entries with sequential
+// request IDs and then removing them all), comparing |ResponderTable| with
+// |std::map|.
+template <typename InsertAndRemoveAll>
+void DoResponderTrackingPerfTest(const char* sub_test_name,
+                                 InsertAndRemoveAll insert_and_remove_all) {
+  constexpr uint64_t kNumRequests = 10000u;
+  constexpr unsigned kNumRounds = 200u;
+
+  uint64_t next_request_id = 1u;
+  MojoTimeTicks start_time = GetTimeTicksNow();
+  for (unsigned round = 0u; round < kNumRounds; round++) {
+    insert_and_remove_all(next_request_id, kNumRequests);
+    next_request_id += kNumRequests;
+  }
+  test::LogPerfResult("RouterPerftest.ResponderTracking", sub_test_name,
+                      GetPerSecond(kNumRounds * kNumRequests, start_time),
+                      "requests/second");
+}
+
+TEST(RouterPerftest, ResponderTracking) {
+  // The responders aren't used, so they needn't be real.
+  MessageReceiver* const kResponder = reinterpret_cast<MessageReceiver*>(8);
+
+  internal::ResponderTable table;
+  DoResponderTrackingPerfTest(
+      "ResponderTable", [&table, kResponder](uint64_t first_request_id,
+                                             uint64_t num_requests) {
+        for (uint64_t i = 0u; i < num_requests; i++)
+          table.Insert(first_request_id + i, kResponder);
+        for (uint64_t i = 0u; i < num_requests; i++)
+          EXPECT_EQ(kResponder, table.Remove(first_request_id + i));
+      });
+
+  std::map<uint64_t, MessageReceiver*> map;
+  DoResponderTrackingPerfTest(
+      "StdMap", [&map, kResponder](uint64_t first_request_id,
+                                   uint64_t num_requests) {
+        for (uint64_t i = 0u; i < num_requests; i++)
+          map[first_request_id + i] = kResponder;
+        for (uint64_t i = 0u; i < num_requests; i++) {
+          auto it = map.find(first_request_id + i);
+          EXPECT_EQ(kResponder, it->second);
+          map.erase(it);
+        }
+      });
+}
+
+}  // namespace
+}  // namespace mojo
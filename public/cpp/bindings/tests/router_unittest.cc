@@ -182,6 +182,36 @@ TEST_F(RouterTest, BasicRequestResponse) {
             std::string(reinterpret_cast<const char*>(response.payload())));
 }
 
+// Tests that the router keeps track of the number of requests in flight.
+TEST_F(RouterTest, PendingResponses) {
+  internal::Router router0(handle0_.Pass(), internal::MessageValidatorList());
+  internal::Router router1(handle1_.Pass(), internal::MessageValidatorList());
+
+  ResponseGenerator generator;
+  router1.set_incoming_receiver(&generator);
+
+  MessageQueue message_queue;
+  for (int i = 0; i < 3; i++) {
+    Message request;
+    AllocRequestMessage(1, "hello", &request);
+    EXPECT_TRUE(router0.AcceptWithResponder(
+        &request, new MessageAccumulator(&message_queue)));
+  }
+  EXPECT_EQ(3u, router0.num_pending_responses());
+  EXPECT_EQ(3u, router0.max_pending_responses());
+
+  PumpMessages();
+
+  EXPECT_EQ(0u, router0.num_pending_responses());
+  EXPECT_EQ(3u, router0.max_pending_responses());
+  for (int i = 0; i < 3; i++) {
+    ASSERT_FALSE(message_queue.IsEmpty());
+    Message response;
+    message_queue.Pop(&response);
+  }
+  EXPECT_TRUE(message_queue.IsEmpty());
+}
+
 TEST_F(RouterTest, BasicRequestResponse_Synchronous) {
   internal::Router router0(handle0_.Pass(), internal::MessageValidatorList());
   internal::Router router1(handle1_.Pass(), internal::MessageValidatorList());
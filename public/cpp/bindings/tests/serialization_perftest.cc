@@ -0,0 +1,162 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares building messages in two passes (computing the serialized size,
+// then serializing into a buffer of that size and encoding pointers and
+// handles) with building them in a single pass (see
+// |SinglePassMessageBuilder|).
+
+#include <string.h>
+
+#include <string>
+
+#include "mojo/public/cpp/bindings/array.h"
+#include "mojo/public/cpp/bindings/lib/array_serialization.h"
+#include "mojo/public/cpp/bindings/lib/message_builder.h"
+#include "mojo/public/cpp/bindings/map.h"
+#include "mojo/public/cpp/bindings/string.h"
+#include "mojo/public/cpp/test_support/test_support.h"
+#include "mojo/public/interfaces/bindings/tests/test_unions.mojom.h"
+#include "third_party/gtest/include/gtest/gtest.h"
+
+namespace mojo {
+namespace test {
+namespace {
+
+const uint32_t kMessageName = 1u;
+
+const double kMojoTicksPerSecond = 1000000.0;
+
+double MojoTicksToSeconds(MojoTimeTicks ticks) {
+  return ticks / kMojoTicksPerSecond;
+}
+
+// Returns a struct with nested structs, unions, arrays (of structs and unions)
+// and a map (of unions), each of the containers having |num_elements|
+// elements.
+SmallStructPtr MakeSmallStruct(size_t num_elements) {
+  auto result = SmallStruct::New();
+  result->dummy_struct = DummyStruct::New();
+  result->dummy_struct->f_int8 = 8;
+  result->pod_union = PodUnion::New();
+  result->pod_union->set_f_int64(64);
+  result->pod_union_array = Array<PodUnionPtr>::New(num_elements);
+  result->s_array = Array<DummyStructPtr>::New(num_elements);
+  result->pod_union_map = Map<String, PodUnionPtr>();
+  for (size_t i = 0u; i < num_elements; i++) {
+    result->pod_union_array[i] = PodUnion::New();
+    result->pod_union_array[i]->set_f_int32(static_cast<int32_t>(i));
+    result->s_array[i] = DummyStruct::New();
+    result->s_array[i]->f_int8 = static_cast<int8_t>(i);
+    auto value = PodUnion::New();
+    value->set_f_double(static_cast<double>(i));
+    result->pod_union_map.insert("key " + std::to_string(i), value.Pass());
+  }
+  return result;
+}
+
+// Returns unions holding strings, structs, arrays and maps.
+Array<ObjectUnionPtr> MakeObjectUnions(size_t num_elements) {
+  auto result = Array<ObjectUnionPtr>::New(num_elements);
+  for (size_t i = 0u; i < num_elements; i++) {
+    result[i] = ObjectUnion::New();
+    switch (i % 4u) {
+      case 0u:
+        result[i]->set_f_string("string " + std::to_string(i));
+        break;
+      case 1u: {
+        auto dummy = DummyStruct::New();
+        dummy->f_int8 = static_cast<int8_t>(i);
+        result[i]->set_f_dummy(dummy.Pass());
+        break;
+      }
+      case 2u:
+        result[i]->set_f_array_int8(Array<int8_t>::New(i));
+        break;
+      case 3u: {
+        Map<String, int8_t> map;
+        for (size_t j = 0u; j < 4u; j++)
+          map.insert("key " + std::to_string(j), static_cast<int8_t>(j));
+        result[i]->set_f_map_int8(map.Pass());
+        break;
+      }
+    }
+  }
+  return result;
+}
+
+template <typename E>
+void BuildMessageInTwoPasses(Array<E>* input, Message* message) {
+  const mojo::internal::ArrayValidateParams validate_params(0, false, nullptr);
+  MessageBuilder builder(kMessageName, GetSerializedSize_(*input));
+  typename Array<E>::Data_* data = nullptr;
+  SerializeArray_(input, builder.buffer(), &data, &validate_params);
+  data->EncodePointersAndHandles(builder.message()->mutable_handles());
+  builder.message()->MoveTo(message);
+}
+
+template <typename E>
+void BuildMessageInOnePass(Array<E>* input, Message* message) {
+  const mojo::internal::ArrayValidateParams validate_params(0, false, nullptr);
+  SinglePassMessageBuilder builder(kMessageName);
+  typename Array<E>::Data_* data = nullptr;
+  SerializeArray_(input, builder.buffer(), &data, &validate_params);
+  builder.Finish();
+  builder.message()->MoveTo(message);
+}
+
+template <typename E>
+void RunPerfTest(const char* test_name, Array<E> input) {
+  // Both ways produce the same message, except that |GetSerializedSize_()|
+  // counts the union fields of structs (which are inline) twice, which leaves
+  // some unused space at the end.
+  {
+    Message message1;
+    BuildMessageInTwoPasses(&input, &message1);
+    Message message2;
+    BuildMessageInOnePass(&input, &message2);
+    ASSERT_LE(message2.data_num_bytes(), message1.data_num_bytes());
+    EXPECT_EQ(0, memcmp(message1.data(), message2.data(),
+                        message2.data_num_bytes()));
+  }
+
+  const unsigned int kIterations = 10000;
+  for (bool one_pass : {false, true}) {
+    const MojoTimeTicks start_time = MojoGetTimeTicksNow();
+    for (unsigned int i = 0u; i < kIterations; i++) {
+      Message message;
+      if (one_pass)
+        BuildMessageInOnePass(&input, &message);
+      else
+        BuildMessageInTwoPasses(&input, &message);
+    }
+    const MojoTimeTicks end_time = MojoGetTimeTicksNow();
+    test::LogPerfResult(test_name, one_pass ? "OnePass" : "TwoPasses",
+                        kIterations / MojoTicksToSeconds(end_time - start_time),
+                        "messages/second");
+  }
+}
+
+TEST(SerializationPerftest, NestedStructs) {
+  for (size_t num_elements : {1u, 100u}) {
+    auto input = Array<SmallStructPtr>::New(num_elements);
+    for (size_t i = 0u; i < num_elements; i++)
+      input[i] = MakeSmallStruct(num_elements);
+    RunPerfTest(
+        ("SerializeNestedStructs_" + std::to_string(num_elements)).c_str(),
+        input.Pass());
+  }
+}
+
+TEST(SerializationPerftest, ObjectUnions) {
+  for (size_t num_elements : {4u, 1000u}) {
+    RunPerfTest(
+        ("SerializeObjectUnions_" + std::to_string(num_elements)).c_str(),
+        MakeObjectUnions(num_elements));
+  }
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace mojo
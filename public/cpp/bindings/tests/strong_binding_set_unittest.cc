@@ -4,10 +4,14 @@
 
 #include "mojo/public/cpp/bindings/strong_binding_set.h"
 
+#include <algorithm>
+#include <thread>
+
 #include "mojo/public/cpp/bindings/binding.h"
 #include "mojo/public/cpp/bindings/interface_request.h"
 #include "mojo/public/cpp/system/macros.h"
 #include "mojo/public/cpp/utility/run_loop.h"
+#include "mojo/public/cpp/utility/run_loop_pool.h"
 #include "mojo/public/interfaces/bindings/tests/minimal_interface.mojom.h"
 #include "third_party/gtest/include/gtest/gtest.h"
 
@@ -111,6 +115,60 @@ TEST(StrongBindingSetTest, FullLifeCycle) {
   }
 }
 
+// Tests StrongBindingSet with the bindings distributed over a RunLoopPool.
+TEST(StrongBindingSetTest, PooledLifeCycle) {
+  // The interface pointers are used on this thread.
+  RunLoop loop;
+  RunLoopPool pool(3);
+
+  const size_t kNumObjects = 10;
+  InterfacePtr<test::MinimalInterface> intrfc_ptrs[kNumObjects];
+  bool deleted_flags[kNumObjects] = {};
+
+  StrongBindingSet<test::MinimalInterface> binding_set(
+      &pool, RunLoopPool::Policy::LEAST_LOADED);
+  for (size_t i = 0; i < kNumObjects; i++) {
+    binding_set.AddBinding(new MinimalInterfaceImpl(&deleted_flags[i]),
+                           GetProxy(&intrfc_ptrs[i]));
+  }
+  EXPECT_EQ(kNumObjects, binding_set.size());
+  EXPECT_EQ(4u, pool.GetThreadLoad(0));
+  EXPECT_EQ(3u, pool.GetThreadLoad(1));
+  EXPECT_EQ(3u, pool.GetThreadLoad(2));
+
+  // Closing pipes removes their bindings and deletes their interfaces (on the
+  // pool's threads).
+  for (size_t i = 0; i < kNumObjects / 2; i++)
+    intrfc_ptrs[i].reset();
+  while (binding_set.size() > kNumObjects / 2)
+    std::this_thread::yield();
+  for (size_t i = 0; i < kNumObjects; i++) {
+    bool expected = (i < kNumObjects / 2);
+    EXPECT_EQ(expected, deleted_flags[i]);
+  }
+
+  // New bindings go to the least loaded threads.
+  size_t least_load = pool.GetThreadLoad(0);
+  for (size_t i = 1; i < pool.num_threads(); i++)
+    least_load = std::min(least_load, pool.GetThreadLoad(i));
+  size_t least_loaded_thread = 0;
+  while (pool.GetThreadLoad(least_loaded_thread) != least_load)
+    least_loaded_thread++;
+  bool extra_deleted_flag = false;
+  InterfacePtr<test::MinimalInterface> extra_ptr;
+  binding_set.AddBinding(new MinimalInterfaceImpl(&extra_deleted_flag),
+                         GetProxy(&extra_ptr));
+  EXPECT_EQ(least_load + 1, pool.GetThreadLoad(least_loaded_thread));
+
+  binding_set.CloseAllBindings();
+  EXPECT_EQ(0u, binding_set.size());
+  for (size_t i = 0; i < kNumObjects; i++)
+    EXPECT_TRUE(deleted_flags[i]);
+  EXPECT_TRUE(extra_deleted_flag);
+  for (size_t i = 0; i < pool.num_threads(); i++)
+    EXPECT_EQ(0u, pool.GetThreadLoad(i));
+}
+
 }  // namespace
 }  // namespace common
 }  // namespace mojo
@@ -28,7 +28,11 @@ using CalcCallback = mojo::Callback<void(double)>;
 class MathCalculatorImpl : public math::Calculator {
  public:
   explicit MathCalculatorImpl(InterfaceRequest<math::Calculator> request)
-      : total_(0.0), binding_(this, request.Pass()) {}
+      : total_(0.0), binding_(this, request.Pass()) {
+    // Stop this thread's run loop once the client goes away.
+    binding_.set_connection_error_handler(
+        []() { RunLoop::current()->Quit(); });
+  }
   ~MathCalculatorImpl() override {}
 
   void Clear(const CalcCallback& callback) override {
@@ -0,0 +1,170 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Compares validating the payloads of incoming messages and then decoding them
+// (in two passes) with validating and decoding them in a single pass (see
+// |internal::ValidateAndDecodeMessagePayload()|), using the valid inputs of the
+// validation conformance tests (see validation_unittest.cc). The inputs are
+// listed explicitly (rather than found by enumerating the test data
+// directory), so that a missing input is an error rather than a silent skip.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mojo/public/cpp/bindings/lib/message_validation.h"
+#include "mojo/public/cpp/bindings/lib/validation_errors.h"
+#include "mojo/public/cpp/bindings/message.h"
+#include "mojo/public/cpp/bindings/tests/validation_util.h"
+#include "mojo/public/cpp/environment/logging.h"
+#include "mojo/public/cpp/system/time.h"
+#include "mojo/public/cpp/test_support/test_support.h"
+#include "mojo/public/interfaces/bindings/tests/validation_test_interfaces.mojom.h"
+#include "third_party/gtest/include/gtest/gtest.h"
+
+namespace mojo {
+namespace test {
+namespace {
+
+using mojo::internal::ValidationError;
+
+// Number of messages prepared (outside of the timed section) for each timed
+// run, since the payloads are decoded in place.
+const size_t kNumMessagesPerRun = 1000u;
+const size_t kNumRuns = 100u;
+
+struct TestInput {
+  std::vector<uint8_t> data;
+  size_t num_handles;
+};
+
+// Reads the inputs of the given conformance tests, all of which must be
+// expected to pass validation.
+std::vector<TestInput> ReadValidInputs(
+    std::initializer_list<const char*> test_names) {
+  std::vector<TestInput> result;
+  for (const char* test_name : test_names) {
+    TestInput input;
+    std::string expected;
+    if (!validation_util::ReadTestCase(test_name, &input.data,
+                                       &input.num_handles, &expected)) {
+      ADD_FAILURE() << "Couldn't read test case " << test_name;
+      continue;
+    }
+    EXPECT_EQ("PASS", expected) << test_name;
+    result.push_back(input);
+  }
+  return result;
+}
+
+void InitMessage(const TestInput& input, Message* message) {
+  message->AllocUninitializedData(static_cast<uint32_t>(input.data.size()));
+  memcpy(message->mutable_data(), &input.data[0], input.data.size());
+  message->mutable_handles()->resize(input.num_handles);
+}
+
+template <typename ParamsType>
+void ValidateThenDecode(Message* message) {
+  ValidationError result =
+      mojo::internal::ValidateMessagePayload<ParamsType>(message, nullptr);
+  MOJO_CHECK(result == ValidationError::NONE);
+  message->DecodePayload<ParamsType>();
+}
+
+template <typename ParamsType>
+void ValidateAndDecode(Message* message) {
+  ValidationError result =
+      mojo::internal::ValidateAndDecodeMessagePayload<ParamsType>(message,
+                                                                  nullptr);
+  MOJO_CHECK(result == ValidationError::NONE);
+  message->DecodePayload<ParamsType>();
+}
+
+// Reports the time taken, per byte of payload, to validate and decode (both
+// ways) the inputs of the conformance tests |test_names| for method
+// |method_ordinal| of |ConformanceTestInterface|, whose parameters are
+// |ParamsType|.
+template <typename ParamsType>
+void RunPerfTest(int method_ordinal,
+                 std::initializer_list<const char*> test_names) {
+  const std::string method_name = std::to_string(method_ordinal);
+  std::vector<TestInput> inputs = ReadValidInputs(test_names);
+  ASSERT_EQ(test_names.size(), inputs.size());
+
+  const std::string test_name = "ValidateConformanceMethod" + method_name;
+  for (bool single_pass : {false, true}) {
+    MojoTimeTicks elapsed = 0;
+    uint64_t num_payload_bytes = 0u;
+    for (size_t run = 0u; run < kNumRuns; run++) {
+      std::unique_ptr<Message[]> messages(new Message[kNumMessagesPerRun]);
+      for (size_t i = 0u; i < kNumMessagesPerRun; i++) {
+        InitMessage(inputs[i % inputs.size()], &messages[i]);
+        num_payload_bytes += messages[i].payload_num_bytes();
+      }
+
+      const MojoTimeTicks start_time = GetTimeTicksNow();
+      for (size_t i = 0u; i < kNumMessagesPerRun; i++) {
+        if (single_pass)
+          ValidateAndDecode<ParamsType>(&messages[i]);
+        else
+          ValidateThenDecode<ParamsType>(&messages[i]);
+      }
+      elapsed += GetTimeTicksNow() - start_time;
+    }
+    test::LogPerfResult(
+        test_name.c_str(),
+        single_pass ? "ValidateAndDecode" : "ValidateThenDecode",
+        static_cast<double>(elapsed) * 1000.0 / num_payload_bytes,
+        "nanoseconds/byte");
+  }
+}
+
+TEST(ValidationPerftest, Structs) {
+  RunPerfTest<internal::ConformanceTestInterface_Method2_Params_Data>(
+      2, {"conformance_mthd2_good"});
+  RunPerfTest<internal::ConformanceTestInterface_Method11_Params_Data>(
+      11, {"conformance_mthd11_good_version0",
+           "conformance_mthd11_good_version1",
+           "conformance_mthd11_good_version2",
+           "conformance_mthd11_good_version3",
+           "conformance_mthd11_good_version_newer_than_known_1",
+           "conformance_mthd11_good_version_newer_than_known_2"});
+}
+
+TEST(ValidationPerftest, Arrays) {
+  RunPerfTest<internal::ConformanceTestInterface_Method6_Params_Data>(
+      6, {"conformance_mthd6_good"});
+  RunPerfTest<internal::ConformanceTestInterface_Method8_Params_Data>(
+      8, {"conformance_mthd8_good"});
+}
+
+TEST(ValidationPerftest, Maps) {
+  RunPerfTest<internal::ConformanceTestInterface_Method10_Params_Data>(
+      10,
+      {"conformance_mthd10_good", "conformance_mthd10_good_non_unique_keys"});
+}
+
+TEST(ValidationPerftest, Unions) {
+  RunPerfTest<internal::ConformanceTestInterface_Method14_Params_Data>(
+      14, {"conformance_mthd14_good_1",
+           "conformance_mthd14_good_array_in_union",
+           "conformance_mthd14_good_map_in_union",
+           "conformance_mthd14_good_nested_union",
+           "conformance_mthd14_good_null_array_in_union",
+           "conformance_mthd14_good_null_map_in_union",
+           "conformance_mthd14_good_struct_in_union",
+           "conformance_mthd14_good_unknown_union_tag"});
+  RunPerfTest<internal::ConformanceTestInterface_Method15_Params_Data>(
+      15, {"conformance_mthd15_good_union_in_array",
+           "conformance_mthd15_good_union_in_map",
+           "conformance_mthd15_good_union_in_struct"});
+}
+
+}  // namespace
+}  // namespace test
+}  // namespace mojo
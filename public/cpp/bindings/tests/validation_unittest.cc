@@ -30,6 +30,7 @@ namespace mojo {
 using internal::MessageValidator;
 using internal::MessageValidatorList;
 using internal::ValidationError;
+using internal::ValidationErrorRecord;
 using internal::ValidationErrorToString;
 
 namespace test {
@@ -70,6 +71,15 @@ bool TestInputParser(const std::string& input,
   return !result && !error_message.empty();
 }
 
+void InitMessage(const std::vector<uint8_t>& data,
+                 size_t num_handles,
+                 Message* message) {
+  message->AllocUninitializedData(data.size());
+  if (!data.empty())
+    memcpy(message->mutable_data(), &data[0], data.size());
+  message->mutable_handles()->resize(num_handles);
+}
+
 void RunValidationTests(const std::string& prefix,
                         const MessageValidatorList& validators,
                         MessageReceiver* test_message_receiver) {
@@ -83,18 +93,21 @@ void RunValidationTests(const std::string& prefix,
                                               &expected));
 
     Message message;
-    message.AllocUninitializedData(data.size());
-    if (!data.empty())
-      memcpy(message.mutable_data(), &data[0], data.size());
-    message.mutable_handles()->resize(num_handles);
+    InitMessage(data, num_handles, &message);
 
     std::string actual;
-    auto result = RunValidatorsOnMessage(validators, &message, nullptr);
+    ValidationErrorRecord err;
+    auto result = RunValidatorsOnMessage(validators, &message, &err);
     if (result == ValidationError::NONE) {
-      ignore_result(test_message_receiver->Accept(&message));
+      // Validation may have decoded the payload in place, so the receiver
+      // (which may send the message on) gets a new copy of the message.
+      Message message_copy;
+      InitMessage(data, num_handles, &message_copy);
+      ignore_result(test_message_receiver->Accept(&message_copy));
       actual = "PASS";
     } else {
       actual = ValidationErrorToString(result);
+      EXPECT_EQ(result, err.error) << "failed test: " << tests[i];
     }
 
     EXPECT_EQ(expected, actual) << "failed test: " << tests[i];
@@ -176,7 +189,8 @@ class IntegrationTestInterfaceImpl : public IntegrationTestInterface {
 class FailingValidator : public mojo::internal::MessageValidator {
  public:
   explicit FailingValidator(ValidationError err) : err_(err) {}
-  ValidationError Validate(const Message* message, std::string* err) override {
+  ValidationError Validate(Message* message,
+                           ValidationErrorRecord* err) override {
     return err_;
   }
 
@@ -299,6 +313,39 @@ TEST(ValidationTest, Conformance) {
   RunValidationTests("conformance_", validators, &dummy_receiver);
 }
 
+// Tests that the details of a validation error are recorded, so that they can
+// be formatted later.
+TEST(ValidationTest, ErrorRecord) {
+  MessageValidatorList validators;
+  validators.push_back(std::unique_ptr<MessageValidator>(
+      new mojo::internal::MessageHeaderValidator));
+  validators.push_back(std::unique_ptr<MessageValidator>(
+      new ConformanceTestInterface::RequestValidator_));
+
+  std::string expected;
+  std::vector<uint8_t> data;
+  size_t num_handles;
+  ASSERT_TRUE(validation_util::ReadTestCase(
+      "conformance_mthd2_wrong_layout_order", &data, &num_handles, &expected));
+  Message message;
+  InitMessage(data, num_handles, &message);
+
+  // The second struct parameter (at offset 56) overlaps the member of the
+  // first, which has already been claimed.
+  ValidationErrorRecord err;
+  EXPECT_EQ(ValidationError::ILLEGAL_MEMORY_RANGE,
+            RunValidatorsOnMessage(validators, &message, &err));
+  EXPECT_EQ(ValidationError::ILLEGAL_MEMORY_RANGE, err.error);
+  EXPECT_EQ(message.data(), err.data);
+  EXPECT_EQ(56, err.offset());
+  EXPECT_EQ(2u, err.message_name);
+  EXPECT_EQ(ValidationErrorRecord::kNotSet, err.array_index);
+  EXPECT_EQ(
+      "VALIDATION_ERROR_ILLEGAL_MEMORY_RANGE: request validation error for "
+      "interface 'ConformanceTestInterface', message name 2 (offset 56)",
+      err.ToString());
+}
+
 // This test is similar to Conformance test but its goal is specifically
 // do bounds-check testing of message validation. For example we test the
 // detection of off-by-one errors in method ordinals.
@@ -8,6 +8,7 @@
 #include "mojo/public/cpp/system/macros.h"
 
 struct MojoAsyncWaiter;
+struct MojoAsyncWatcher;
 struct MojoLogger;
 
 namespace mojo {
@@ -19,9 +20,17 @@ class Environment {
  public:
   static const MojoAsyncWaiter* GetDefaultAsyncWaiter();
   // Setting the default async waiter to null will use the original default
-  // implementation.
+  // implementation. Setting it to anything else also sets the default async
+  // watcher to null (since the default watcher is tied to the default waiter's
+  // run loop); use |SetDefaultAsyncWatcher()| to provide a matching one.
   static void SetDefaultAsyncWaiter(const MojoAsyncWaiter* async_waiter);
 
+  // The default async watcher waits using the same mechanism (e.g., run loop)
+  // as the default async waiter, but for persistent watches. It may be null, in
+  // which case users should fall back to (one-shot) async waits.
+  static const MojoAsyncWatcher* GetDefaultAsyncWatcher();
+  static void SetDefaultAsyncWatcher(const MojoAsyncWatcher* async_watcher);
+
   static const MojoLogger* GetDefaultLogger();
   // Setting the logger to null will use the will use the original default
   // implementation.
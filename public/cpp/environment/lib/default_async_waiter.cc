@@ -52,6 +52,45 @@ class RunLoopHandlerImpl : public RunLoopHandler {
   MOJO_DISALLOW_COPY_AND_ASSIGN(RunLoopHandlerImpl);
 };
 
+// RunLoopHandler implementation used for a request to AsyncWatch(). It is
+// registered with the RunLoop (using |RunLoop::AddWatch()|) once, and remains
+// registered across notifications. It is deleted either when an error is
+// reported or when CancelWatch() is invoked.
+class RunLoopWatchHandlerImpl : public RunLoopHandler {
+ public:
+  RunLoopWatchHandlerImpl(MojoAsyncWaitCallback callback, void* closure)
+      : id_(0u), callback_(callback), closure_(closure) {}
+
+  ~RunLoopWatchHandlerImpl() override {
+    RunLoop::current()->RemoveHandler(id_);
+  }
+
+  void set_id(Id id) { id_ = id; }
+
+  // RunLoopHandler:
+  void OnHandleReady(Id /*id*/) override {
+    // Note: The callback may cancel the watch (deleting this), so don't touch
+    // any members afterwards.
+    callback_(closure_, MOJO_RESULT_OK);
+  }
+
+  void OnHandleError(Id /*id*/, MojoResult result) override {
+    // The RunLoop has already unregistered us, so the watch is over.
+    MojoAsyncWaitCallback callback = callback_;
+    void* closure = closure_;
+    delete this;
+
+    callback(closure, result);
+  }
+
+ private:
+  Id id_;
+  const MojoAsyncWaitCallback callback_;
+  void* const closure_;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(RunLoopWatchHandlerImpl);
+};
+
 MojoAsyncWaitID AsyncWait(MojoHandle handle,
                           MojoHandleSignals signals,
                           MojoDeadline deadline,
@@ -73,11 +112,32 @@ void CancelWait(MojoAsyncWaitID wait_id) {
   delete reinterpret_cast<RunLoopHandlerImpl*>(wait_id);
 }
 
+MojoAsyncWaitID AsyncWatch(MojoHandle handle,
+                           MojoHandleSignals signals,
+                           MojoAsyncWaitCallback callback,
+                           void* closure) {
+  RunLoop* run_loop = RunLoop::current();
+  assert(run_loop);
+
+  // |run_loop_handler| is destroyed either when the handle can no longer be
+  // watched or if CancelWatch is invoked.
+  RunLoopWatchHandlerImpl* run_loop_handler =
+      new RunLoopWatchHandlerImpl(callback, closure);
+  run_loop_handler->set_id(
+      run_loop->AddWatch(run_loop_handler, Handle(handle), signals));
+  return reinterpret_cast<MojoAsyncWaitID>(run_loop_handler);
+}
+
+void CancelWatch(MojoAsyncWaitID watch_id) {
+  delete reinterpret_cast<RunLoopWatchHandlerImpl*>(watch_id);
+}
+
 }  // namespace
 
 namespace internal {
 
 const MojoAsyncWaiter kDefaultAsyncWaiter = {AsyncWait, CancelWait};
+const MojoAsyncWatcher kDefaultAsyncWatcher = {AsyncWatch, CancelWatch};
 
 }  // namespace internal
 
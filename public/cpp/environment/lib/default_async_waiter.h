@@ -6,11 +6,13 @@
 #define MOJO_PUBLIC_CPP_ENVIRONMENT_LIB_DEFAULT_ASYNC_WAITER_H_
 
 struct MojoAsyncWaiter;
+struct MojoAsyncWatcher;
 
 namespace mojo {
 namespace internal {
 
 extern const MojoAsyncWaiter kDefaultAsyncWaiter;
+extern const MojoAsyncWatcher kDefaultAsyncWatcher;
 
 }  // namespace internal
 }  // namespace mojo
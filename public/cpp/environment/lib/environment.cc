@@ -14,6 +14,8 @@
 namespace mojo {
 
 const MojoAsyncWaiter* g_default_async_waiter = &internal::kDefaultAsyncWaiter;
+const MojoAsyncWatcher* g_default_async_watcher =
+    &internal::kDefaultAsyncWatcher;
 const MojoLogger* g_default_logger = &internal::kDefaultLogger;
 
 // static
@@ -25,6 +27,19 @@ const MojoAsyncWaiter* Environment::GetDefaultAsyncWaiter() {
 void Environment::SetDefaultAsyncWaiter(const MojoAsyncWaiter* async_waiter) {
   g_default_async_waiter =
       async_waiter ? async_waiter : &internal::kDefaultAsyncWaiter;
+  g_default_async_watcher = async_waiter ? nullptr
+                                         : &internal::kDefaultAsyncWatcher;
+}
+
+// static
+const MojoAsyncWatcher* Environment::GetDefaultAsyncWatcher() {
+  return g_default_async_watcher;
+}
+
+// static
+void Environment::SetDefaultAsyncWatcher(
+    const MojoAsyncWatcher* async_watcher) {
+  g_default_async_watcher = async_watcher;
 }
 
 // static
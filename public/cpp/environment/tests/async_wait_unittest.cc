@@ -75,7 +75,7 @@ TEST_F(AsyncWaitTest, CallbackNotified) {
 
   CallAsyncWait(
       test_pipe.handle0.get(), MOJO_HANDLE_SIGNAL_READABLE, &callback);
-  RunLoop::current()->Run();
+  RunLoop::current()->RunUntilIdle();
   EXPECT_EQ(1, callback.result_count());
   EXPECT_EQ(MOJO_RESULT_OK, callback.last_result());
 }
@@ -94,7 +94,7 @@ TEST_F(AsyncWaitTest, TwoCallbacksNotified) {
   CallAsyncWait(
       test_pipe2.handle0.get(), MOJO_HANDLE_SIGNAL_READABLE, &callback2);
 
-  RunLoop::current()->Run();
+  RunLoop::current()->RunUntilIdle();
   EXPECT_EQ(1, callback1.result_count());
   EXPECT_EQ(MOJO_RESULT_OK, callback1.last_result());
   EXPECT_EQ(1, callback2.result_count());
@@ -109,9 +109,82 @@ TEST_F(AsyncWaitTest, CancelCallback) {
 
   CallCancelWait(CallAsyncWait(
       test_pipe.handle0.get(), MOJO_HANDLE_SIGNAL_READABLE, &callback));
-  RunLoop::current()->Run();
+  RunLoop::current()->RunUntilIdle();
   EXPECT_EQ(0, callback.result_count());
 }
 
+// Cancels its watch (from within the callback) once it has been notified
+// |max_result_count| times.
+class TestAsyncWatchCallback {
+ public:
+  explicit TestAsyncWatchCallback(int max_result_count)
+      : max_result_count_(max_result_count),
+        result_count_(0),
+        last_result_(MOJO_RESULT_OK),
+        watch_id_(0) {}
+  ~TestAsyncWatchCallback() {}
+
+  void set_watch_id(MojoAsyncWaitID watch_id) { watch_id_ = watch_id; }
+
+  int result_count() const { return result_count_; }
+
+  MojoResult last_result() const { return last_result_; }
+
+  // MojoAsyncWaitCallback:
+  static void OnHandleReady(void* closure, MojoResult result) {
+    TestAsyncWatchCallback* self =
+        static_cast<TestAsyncWatchCallback*>(closure);
+    self->result_count_++;
+    self->last_result_ = result;
+    if (result == MOJO_RESULT_OK &&
+        self->result_count_ >= self->max_result_count_)
+      Environment::GetDefaultAsyncWatcher()->CancelWatch(self->watch_id_);
+  }
+
+ private:
+  const int max_result_count_;
+  int result_count_;
+  MojoResult last_result_;
+  MojoAsyncWaitID watch_id_;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(TestAsyncWatchCallback);
+};
+
+void CallAsyncWatch(const Handle& handle,
+                    MojoHandleSignals signals,
+                    TestAsyncWatchCallback* callback) {
+  callback->set_watch_id(Environment::GetDefaultAsyncWatcher()->AsyncWatch(
+      handle.value(), signals, &TestAsyncWatchCallback::OnHandleReady,
+      callback));
+}
+
+// Verifies a watch callback is notified repeatedly while the pipe is ready,
+// until the watch is cancelled.
+TEST_F(AsyncWaitTest, WatchCallbackNotifiedRepeatedly) {
+  ASSERT_TRUE(Environment::GetDefaultAsyncWatcher());
+  TestAsyncWatchCallback callback(3);
+  MessagePipe test_pipe;
+  EXPECT_TRUE(test::WriteTextMessage(test_pipe.handle1.get(), std::string()));
+
+  CallAsyncWatch(
+      test_pipe.handle0.get(), MOJO_HANDLE_SIGNAL_READABLE, &callback);
+  RunLoop::current()->RunUntilIdle();
+  EXPECT_EQ(3, callback.result_count());
+  EXPECT_EQ(MOJO_RESULT_OK, callback.last_result());
+}
+
+// Verifies a watch ends (after notifying the callback) on error.
+TEST_F(AsyncWaitTest, WatchCallbackNotifiedOfError) {
+  TestAsyncWatchCallback callback(1);
+  MessagePipe test_pipe;
+  test_pipe.handle1.reset();
+
+  CallAsyncWatch(
+      test_pipe.handle0.get(), MOJO_HANDLE_SIGNAL_READABLE, &callback);
+  RunLoop::current()->RunUntilIdle();
+  EXPECT_EQ(1, callback.result_count());
+  EXPECT_EQ(MOJO_RESULT_FAILED_PRECONDITION, callback.last_result());
+}
+
 }  // namespace
 }  // namespace mojo
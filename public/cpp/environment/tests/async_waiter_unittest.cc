@@ -62,7 +62,7 @@ TEST_F(AsyncWaiterTest, CallbackNotified) {
 
   AsyncWaiter waiter(test_pipe.handle0.get(), MOJO_HANDLE_SIGNAL_READABLE,
                      ManualCallback(&callback));
-  RunLoop::current()->Run();
+  RunLoop::current()->RunUntilIdle();
   EXPECT_EQ(1, callback.result_count());
   EXPECT_EQ(MOJO_RESULT_OK, callback.last_result());
 }
@@ -81,7 +81,7 @@ TEST_F(AsyncWaiterTest, TwoCallbacksNotified) {
   AsyncWaiter waiter2(test_pipe2.handle0.get(), MOJO_HANDLE_SIGNAL_READABLE,
                       ManualCallback(&callback2));
 
-  RunLoop::current()->Run();
+  RunLoop::current()->RunUntilIdle();
   EXPECT_EQ(1, callback1.result_count());
   EXPECT_EQ(MOJO_RESULT_OK, callback1.last_result());
   EXPECT_EQ(1, callback2.result_count());
@@ -98,7 +98,7 @@ TEST_F(AsyncWaiterTest, CancelCallback) {
     AsyncWaiter waiter(test_pipe.handle0.get(), MOJO_HANDLE_SIGNAL_READABLE,
                        ManualCallback(&callback));
   }
-  RunLoop::current()->Run();
+  RunLoop::current()->RunUntilIdle();
   EXPECT_EQ(0, callback.result_count());
 }
 
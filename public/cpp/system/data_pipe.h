@@ -84,6 +84,17 @@ inline MojoResult WriteDataRaw(DataPipeProducerHandle data_pipe_producer,
   return MojoWriteData(data_pipe_producer.value(), elements, num_bytes, flags);
 }
 
+// Like |WriteDataRaw()|, but the data is gathered from |segments|. See
+// |MojoWriteDataV()| for complete documentation.
+inline MojoResult WriteDataRawV(DataPipeProducerHandle data_pipe_producer,
+                                const MojoWriteDataSegment* segments,
+                                uint32_t num_segments,
+                                uint32_t* num_bytes,
+                                MojoWriteDataFlags flags) {
+  return MojoWriteDataV(data_pipe_producer.value(), segments, num_segments,
+                        num_bytes, flags);
+}
+
 // Begins a two-phase write to a data pipe. See |MojoBeginWriteData()| for
 // complete documentation.
 inline MojoResult BeginWriteDataRaw(DataPipeProducerHandle data_pipe_producer,
@@ -144,6 +155,17 @@ inline MojoResult ReadDataRaw(DataPipeConsumerHandle data_pipe_consumer,
   return MojoReadData(data_pipe_consumer.value(), elements, num_bytes, flags);
 }
 
+// Like |ReadDataRaw()|, but the data is scattered into |segments|. See
+// |MojoReadDataV()| for complete documentation.
+inline MojoResult ReadDataRawV(DataPipeConsumerHandle data_pipe_consumer,
+                               const MojoReadDataSegment* segments,
+                               uint32_t num_segments,
+                               uint32_t* num_bytes,
+                               MojoReadDataFlags flags) {
+  return MojoReadDataV(data_pipe_consumer.value(), segments, num_segments,
+                       num_bytes, flags);
+}
+
 // Begins a two-phase read from a data pipe. See |MojoBeginReadData()| for
 // complete documentation.
 inline MojoResult BeginReadDataRaw(DataPipeConsumerHandle data_pipe_consumer,
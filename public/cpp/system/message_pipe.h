@@ -75,6 +75,18 @@ inline MojoResult WriteMessageRaw(MessagePipeHandle message_pipe,
       message_pipe.value(), bytes, num_bytes, handles, num_handles, flags);
 }
 
+// Like |WriteMessageRaw()|, but the message data is gathered from |segments|.
+// See |MojoWriteMessageV()| for complete documentation.
+inline MojoResult WriteMessageRawV(MessagePipeHandle message_pipe,
+                                   const MojoMessageSegment* segments,
+                                   uint32_t num_segments,
+                                   const MojoHandle* handles,
+                                   uint32_t num_handles,
+                                   MojoWriteMessageFlags flags) {
+  return MojoWriteMessageV(message_pipe.value(), segments, num_segments,
+                           handles, num_handles, flags);
+}
+
 // Reads from a message pipe. See |MojoReadMessage()| for complete
 // documentation.
 inline MojoResult ReadMessageRaw(MessagePipeHandle message_pipe,
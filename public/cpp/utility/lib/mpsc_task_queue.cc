@@ -0,0 +1,63 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "mojo/public/cpp/utility/lib/mpsc_task_queue.h"
+
+#include <utility>
+
+namespace mojo {
+namespace internal {
+
+MpscTaskQueue::MpscTaskQueue() : head_(&stub_), tail_(&stub_) {}
+
+MpscTaskQueue::~MpscTaskQueue() {
+  Task task;
+  while (Pop(&task))
+    ;  // Just drop the tasks.
+}
+
+void MpscTaskQueue::Push(Task task) {
+  Node* node = new Node();
+  node->task = std::move(task);
+  PushNode(node);
+}
+
+bool MpscTaskQueue::Pop(Task* task) {
+  Node* tail = tail_;
+  Node* next = tail->next.load(std::memory_order_acquire);
+  if (tail == &stub_) {
+    if (!next)
+      return false;
+    tail_ = next;
+    tail = next;
+    next = next->next.load(std::memory_order_acquire);
+  }
+
+  if (!next) {
+    // |tail| is the last node we can see. If it's not the head, then a push is
+    // in progress (the producer has swapped |head_| but not yet linked it in).
+    if (tail != head_.load(std::memory_order_acquire))
+      return false;
+    // Otherwise, push the stub so that we can pop |tail| (without leaving the
+    // queue without a node).
+    PushNode(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (!next)
+      return false;
+  }
+
+  tail_ = next;
+  *task = std::move(tail->task);
+  delete tail;
+  return true;
+}
+
+void MpscTaskQueue::PushNode(Node* node) {
+  node->next.store(nullptr, std::memory_order_relaxed);
+  Node* previous = head_.exchange(node, std::memory_order_acq_rel);
+  previous->next.store(node, std::memory_order_release);
+}
+
+}  // namespace internal
+}  // namespace mojo
@@ -0,0 +1,62 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MOJO_PUBLIC_CPP_UTILITY_LIB_MPSC_TASK_QUEUE_H_
+#define MOJO_PUBLIC_CPP_UTILITY_LIB_MPSC_TASK_QUEUE_H_
+
+#include <atomic>
+#include <functional>
+
+#include "mojo/public/cpp/system/macros.h"
+
+namespace mojo {
+namespace internal {
+
+// A lock-free, unbounded, multiple-producer single-consumer FIFO queue of tasks
+// (this is Dmitry Vyukov's non-intrusive MPSC node-based queue). |Push()| may
+// be called on any thread, concurrently; |Pop()| may only be called on a single
+// (consumer) thread at a time. Pushing is wait-free (one atomic exchange).
+//
+// Note that a |Pop()| that races with a |Push()| may fail to see the pushed
+// task (even if other, earlier tasks were pushed by other threads); the caller
+// must arrange to call |Pop()| again after |Push()| returns (e.g., by having
+// the producer signal the consumer after pushing).
+class MpscTaskQueue {
+ public:
+  using Task = std::function<void()>;
+
+  MpscTaskQueue();
+  // Destroys any tasks that are still queued. There must be no concurrent
+  // calls to |Push()|.
+  ~MpscTaskQueue();
+
+  // Adds |task| to the queue. This is thread-safe.
+  void Push(Task task);
+
+  // Removes the task at the front of the queue, moving it to |*task|. Returns
+  // false if the queue is empty (or the next task is still being pushed).
+  bool Pop(Task* task);
+
+ private:
+  struct Node {
+    std::atomic<Node*> next{nullptr};
+    Task task;
+  };
+
+  void PushNode(Node* node);
+
+  // The most-recently-pushed node (producers' end).
+  std::atomic<Node*> head_;
+  // The next node to pop (consumer's end); only accessed by the consumer.
+  Node* tail_;
+  // Placeholder node, so that the queue is never truly empty.
+  Node stub_;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(MpscTaskQueue);
+};
+
+}  // namespace internal
+}  // namespace mojo
+
+#endif  // MOJO_PUBLIC_CPP_UTILITY_LIB_MPSC_TASK_QUEUE_H_
@@ -25,6 +25,15 @@ namespace {
 constexpr uint32_t kInitialWaitSetNumResults = 16u;
 constexpr uint32_t kMaximumWaitSetNumResults = 256u;
 
+// The wait set cookie for |RunLoop::wakeup_read_handle_|. (No valid
+// |RunLoopHandler::Id| is zero.)
+constexpr uint64_t kWakeupCookie = 0u;
+
+// The maximum number of tasks posted using |RunLoop::PostTask()| to run before
+// going back to the wait set (so that a task that keeps posting tasks can't
+// starve handlers).
+constexpr uint32_t kMaxPostedTasksPerWakeup = 64u;
+
 pthread_key_t g_current_run_loop_key;
 
 // Ensures that the "current run loop" functionality is available (i.e., that we
@@ -48,14 +57,24 @@ void SetCurrentRunLoop(RunLoop* run_loop) {
   assert(!error);
 }
 
-}  // namespace
+// A |RunLoopHandler::Id| has the handler's slot index plus one (so that no
+// valid ID is zero) in its low 32 bits and the slot's generation in its high
+// 32 bits.
+RunLoopHandler::Id MakeHandlerId(uint32_t index, uint32_t generation) {
+  return (static_cast<RunLoopHandler::Id>(generation) << 32) |
+         static_cast<RunLoopHandler::Id>(index + 1u);
+}
+
+uint32_t GetHandlerIdIndex(RunLoopHandler::Id id) {
+  // Note: For an invalid ID with zero low bits, this yields a huge index.
+  return static_cast<uint32_t>(id) - 1u;
+}
 
-RunLoop::DelayedTaskInfo::DelayedTaskInfo(RunLoopHandler::Id id,
-                                          const Closure& task,
-                                          MojoTimeTicks absolute_run_time)
-    : id(id), task(task), absolute_run_time(absolute_run_time) {}
+uint32_t GetHandlerIdGeneration(RunLoopHandler::Id id) {
+  return static_cast<uint32_t>(id >> 32);
+}
 
-RunLoop::DelayedTaskInfo::~DelayedTaskInfo() {}
+}  // namespace
 
 struct RunLoop::RunState {
   bool should_quit = false;
@@ -72,6 +91,13 @@ RunLoop::RunLoop() {
   assert(result == MOJO_RESULT_OK);
   assert(wait_set_.is_valid());
 
+  result = CreateMessagePipe(nullptr, &wakeup_read_handle_,
+                             &wakeup_write_handle_);
+  assert(result == MOJO_RESULT_OK);
+  result = WaitSetAdd(wait_set_.get(), wakeup_read_handle_.get(),
+                      MOJO_HANDLE_SIGNAL_READABLE, kWakeupCookie, nullptr);
+  assert(result == MOJO_RESULT_OK);
+
   assert(!current());
   SetCurrentRunLoop(this);
 }
@@ -84,12 +110,15 @@ RunLoop::~RunLoop() {
   // even if we handle it correctly). (They could also call |AddHandler()|,
   // which would be even shadier; we handle this "correctly", but we may still
   // end up looping infinitely in that case.)
-  while (!handlers_.empty()) {
-    auto it = handlers_.begin();
-    auto handler = it->second.handler;
-    auto id = it->first;
-    handlers_.erase(it);
-    handler->OnHandleError(id, MOJO_RESULT_ABORTED);
+  while (num_handlers_) {
+    for (uint32_t index = 0u; index < handler_slots_.size(); index++) {
+      if (!handler_slots_[index].in_use)
+        continue;
+      auto id = MakeHandlerId(index, handler_slots_[index].generation);
+      auto handler = handler_slots_[index].info.handler;
+      FreeHandler(id);  // Invalidates any reference into |handler_slots_|.
+      handler->OnHandleError(id, MOJO_RESULT_ABORTED);
+    }
   }
 
   SetCurrentRunLoop(nullptr);
@@ -106,11 +135,6 @@ RunLoopHandler::Id RunLoop::AddHandler(RunLoopHandler* handler,
                                        MojoHandleSignals handle_signals,
                                        MojoDeadline deadline) {
   assert(current() == this);
-  assert(handler);
-  assert(handle.is_valid());
-
-  // Generate a |RunLoopHandler::Id|.
-  auto id = next_id_++;
 
   // Calculate the absolute deadline.
   auto absolute_deadline = kInvalidTimeTicks;  // Default to "forever".
@@ -118,36 +142,34 @@ RunLoopHandler::Id RunLoop::AddHandler(RunLoopHandler* handler,
       std::numeric_limits<MojoTimeTicks>::max();
   if (deadline <= static_cast<MojoDeadline>(kMaxMojoTimeTicks)) {
     auto now = GetTimeTicksNow();
-    if (deadline <= static_cast<MojoDeadline>(kMaxMojoTimeTicks - now)) {
+    if (deadline <= static_cast<MojoDeadline>(kMaxMojoTimeTicks - now))
       absolute_deadline = now + static_cast<MojoTimeTicks>(deadline);
-      handler_deadlines_.push(HandlerDeadlineInfo(id, absolute_deadline));
-    }
     // Else either |deadline| or |now| is so large (hopefully the former) that
     // |now + deadline| would overflow. We'll take that to mean forever.
   }
   // Else |deadline| is either very large (which we may as well take as forever)
   // or |MOJO_DEADLINE_INDEFINITE| (which is forever).
 
-  // Add an entry to |handlers_|.
-  handlers_.insert(std::make_pair(
-      id, HandlerInfo(handler, handle_signals, absolute_deadline)));
-  // Add an entry to the wait set.
-  MojoResult result =
-      WaitSetAdd(wait_set_.get(), handle, handle_signals, id, nullptr);
-  MOJO_ALLOW_UNUSED_LOCAL(result);
-  assert(result == MOJO_RESULT_OK);
+  return AddHandlerInternal(handler, handle, handle_signals, absolute_deadline,
+                            false);
+}
 
-  return id;
+RunLoopHandler::Id RunLoop::AddWatch(RunLoopHandler* handler,
+                                     const Handle& handle,
+                                     MojoHandleSignals handle_signals) {
+  assert(current() == this);
+
+  // Watches have no deadline.
+  return AddHandlerInternal(handler, handle, handle_signals, kInvalidTimeTicks,
+                            true);
 }
 
 void RunLoop::RemoveHandler(RunLoopHandler::Id id) {
   assert(current() == this);
 
-  // Remove the entry from |handlers_|.
-  auto it = handlers_.find(id);
-  if (it == handlers_.end())
+  if (!GetHandlerInfo(id))
     return;
-  handlers_.erase(it);
+  FreeHandler(id);
   // Remove the entry from the wait set.
   MojoResult result = WaitSetRemove(wait_set_.get(), id);
   MOJO_ALLOW_UNUSED_LOCAL(result);
@@ -157,16 +179,21 @@ void RunLoop::RemoveHandler(RunLoopHandler::Id id) {
 void RunLoop::PostDelayedTask(const Closure& task, MojoTimeTicks delay) {
   assert(current() == this);
 
-  // Generate a |RunLoopHandler::Id|.
-  auto id = next_id_++;
-
   // Calculate the absolute run time.
   auto now = GetTimeTicksNow();
   assert(delay <= std::numeric_limits<MojoTimeTicks>::max() - now);
   auto absolute_run_time = now + delay;
 
   // Add an entry to |delayed_tasks_|.
-  delayed_tasks_.push(DelayedTaskInfo(id, task, absolute_run_time));
+  delayed_tasks_.Add(absolute_run_time, task);
+}
+
+void RunLoop::PostTask(std::function<void()> task) {
+  posted_tasks_.Push(std::move(task));
+
+  // Note that this must happen after the push, so that the run loop is
+  // guaranteed to see the task after consuming the wakeup.
+  WakeUp();
 }
 
 void RunLoop::Run() {
@@ -206,25 +233,15 @@ bool RunLoop::DoIteration(bool quit_when_idle) {
 
   auto now = GetTimeTicksNow();
 
-  // First, execute any already-enqueued tasks that are ready.
-
-  // This is a fake task that we use to compare to enqueued tasks (if one were
-  // to post a task now with no delay, it'd look like this). This is convenient
-  // since |DelayedTaskInfo| has an |operator<| (used by the priority queue
-  // |delayed_tasks_|).
-  //
-  // We want to execute tasks that are "greater" than |now_task| (i.e.,
-  // |now_task| is less than them) -- this includes all tasks that are currently
-  // ready, but not any newly-posted tasks (i.e., those that are posted as a
-  // result of executing ready tasks).
-  DelayedTaskInfo now_task(next_id_, Closure(), now);
-
-  while (!delayed_tasks_.empty() && now_task < delayed_tasks_.top()) {
-    // We could just execute the task directly from |delayed_tasks_.top()|,
-    // since no newly-posted task should change the top of the priority queue,
-    // but doing the below is more obviously correct.
-    Closure task = delayed_tasks_.top().task;
-    delayed_tasks_.pop();
+  // First, execute any already-enqueued tasks that are ready. We move all the
+  // tasks that are currently ready to |ready_tasks_| first, so that we don't
+  // run any newly-posted tasks (i.e., those that are posted as a result of
+  // executing ready tasks) in this iteration.
+  delayed_tasks_.Expire(now, &ready_tasks_);
+
+  while (!ready_tasks_.empty()) {
+    Closure task = ready_tasks_.front();
+    ready_tasks_.pop_front();
     task.Run();
     should_continue = true;
 
@@ -232,9 +249,19 @@ bool RunLoop::DoIteration(bool quit_when_idle) {
       return false;
   }
 
-  // Next, "wait" and deal with handles/handlers.
+  // Then, run any tasks posted using |PostTask()|. (This is just a check of an
+  // atomic flag if there are none.)
+  if (wakeup_pending_.load()) {
+    should_continue |= RunPostedTasks();
+    if (run_state.should_quit)
+      return false;
+  }
 
-  if (handlers_.empty())
+  // Next, "wait" and deal with handles/handlers. Even without any handlers,
+  // |Run()| waits (on |wakeup_read_handle_|, which is always in the wait set)
+  // for tasks and delayed tasks until it's told to quit.
+
+  if (quit_when_idle && !num_handlers_)
     return should_continue;
 
   // Calculate the deadline for the wait. Don't wait if |quit_when_idle| is
@@ -292,62 +319,171 @@ bool RunLoop::DoIteration(bool quit_when_idle) {
   if (run_state.should_quit)
     return false;
 
-  return quit_when_idle ? should_continue : !handlers_.empty();
+  return quit_when_idle ? should_continue : true;
 }
 
-MojoTimeTicks RunLoop::CalculateAbsoluteDeadline(bool* is_delayed_task) {
-  assert(!handlers_.empty());
+RunLoopHandler::Id RunLoop::AddHandlerInternal(RunLoopHandler* handler,
+                                               const Handle& handle,
+                                               MojoHandleSignals handle_signals,
+                                               MojoTimeTicks absolute_deadline,
+                                               bool is_watch) {
+  assert(handler);
+  assert(handle.is_valid());
 
-  // Default to "forever".
-  MojoTimeTicks absolute_deadline = kInvalidTimeTicks;
-  if (delayed_tasks_.empty()) {
-    *is_delayed_task = false;
+  // Allocate a slot (reusing a free one if possible) and generate a
+  // |RunLoopHandler::Id|.
+  uint32_t index;
+  if (free_handler_slots_.empty()) {
+    index = static_cast<uint32_t>(handler_slots_.size());
+    handler_slots_.push_back(HandlerSlot());
   } else {
-    // If there are delayed tasks, our deadline can be no later than the
-    // earliest run time.
-    absolute_deadline = delayed_tasks_.top().absolute_run_time;
-    *is_delayed_task = true;
+    index = free_handler_slots_.back();
+    free_handler_slots_.pop_back();
   }
+  HandlerSlot& slot = handler_slots_[index];
+  assert(!slot.in_use);
+  auto id = MakeHandlerId(index, slot.generation);
+
+  slot.in_use = true;
+  slot.info.handler = handler;
+  slot.info.handle_signals = handle_signals;
+  slot.info.absolute_deadline = absolute_deadline;
+  slot.info.deadline_timer_id =
+      (absolute_deadline == kInvalidTimeTicks)
+          ? HandlerDeadlineWheel::kInvalidTimerId
+          : handler_deadlines_.Add(absolute_deadline, id);
+  slot.info.is_watch = is_watch;
+  num_handlers_++;
 
-  // Find the earliest handler deadline.
-  while (!handler_deadlines_.empty()) {
-    const HandlerDeadlineInfo& info = handler_deadlines_.top();
-    const auto it = handlers_.find(info.id);
-    // We might have a stale entry at the top. If so, remove it and continue.
-    if (it == handlers_.end()) {
-      handler_deadlines_.pop();
-      continue;
-    }
+  // Add an entry to the wait set.
+  MojoResult result =
+      WaitSetAdd(wait_set_.get(), handle, handle_signals, id, nullptr);
+  MOJO_ALLOW_UNUSED_LOCAL(result);
+  assert(result == MOJO_RESULT_OK);
 
-    if (absolute_deadline == kInvalidTimeTicks ||
-        info.absolute_deadline < absolute_deadline) {
-      absolute_deadline = info.absolute_deadline;
-      *is_delayed_task = false;
-    }
+  return id;
+}
+
+RunLoop::HandlerInfo* RunLoop::GetHandlerInfo(RunLoopHandler::Id id) {
+  uint32_t index = GetHandlerIdIndex(id);
+  if (index >= handler_slots_.size())
+    return nullptr;
+  HandlerSlot& slot = handler_slots_[index];
+  if (!slot.in_use || slot.generation != GetHandlerIdGeneration(id))
+    return nullptr;
+  return &slot.info;
+}
+
+void RunLoop::FreeHandler(RunLoopHandler::Id id) {
+  uint32_t index = GetHandlerIdIndex(id);
+  assert(index < handler_slots_.size());
+  HandlerSlot& slot = handler_slots_[index];
+  assert(slot.in_use && slot.generation == GetHandlerIdGeneration(id));
+
+  if (slot.info.deadline_timer_id != HandlerDeadlineWheel::kInvalidTimerId)
+    handler_deadlines_.Cancel(slot.info.deadline_timer_id);
+  slot.info = HandlerInfo();
+  slot.in_use = false;
+  slot.generation++;
+  free_handler_slots_.push_back(index);
+  num_handlers_--;
+}
+
+MojoTimeTicks RunLoop::CalculateAbsoluteDeadline(bool* is_delayed_task) {
+  // If there are ready tasks that haven't been run yet (because we quit), we
+  // shouldn't wait at all. (Tasks posted using |PostTask()| are taken care of
+  // by |wakeup_read_handle_|.)
+  if (!ready_tasks_.empty()) {
+    *is_delayed_task = true;
+    return GetTimeTicksNow();
+  }
 
-    break;
+  // Default to "forever". If there are delayed tasks, our deadline can be no
+  // later than the earliest run time.
+  MojoTimeTicks absolute_deadline = delayed_tasks_.GetNextExpiryTime();
+  *is_delayed_task = (absolute_deadline != kInvalidTimeTicks);
+
+  // Take the earliest handler deadline into account.
+  MojoTimeTicks handler_deadline = handler_deadlines_.GetNextExpiryTime();
+  if (handler_deadline != kInvalidTimeTicks &&
+      (absolute_deadline == kInvalidTimeTicks ||
+       handler_deadline < absolute_deadline)) {
+    absolute_deadline = handler_deadline;
+    *is_delayed_task = false;
   }
 
   return absolute_deadline;
 }
 
+void RunLoop::WakeUp() {
+  // Only the first wakeup since the run loop last consumed wakeups needs to
+  // actually write a message.
+  if (wakeup_pending_.exchange(true))
+    return;
+
+  MojoResult result =
+      WriteMessageRaw(wakeup_write_handle_.get(), nullptr, 0u, nullptr, 0u,
+                      MOJO_WRITE_MESSAGE_FLAG_NONE);
+  MOJO_ALLOW_UNUSED_LOCAL(result);
+  assert(result == MOJO_RESULT_OK);
+}
+
+bool RunLoop::RunPostedTasks() {
+  // Consume the wakeup(s) before popping tasks: any task pushed after this
+  // point will be accompanied by a new wakeup. (Spurious wakeups are fine.)
+  while (ReadMessageRaw(wakeup_read_handle_.get(), nullptr, nullptr, nullptr,
+                        nullptr, MOJO_READ_MESSAGE_FLAG_MAY_DISCARD) ==
+         MOJO_RESULT_OK)
+    ;  // Wakeup messages have no contents.
+  wakeup_pending_.store(false);
+
+  bool did_work = false;
+  std::function<void()> task;
+  for (uint32_t i = 0u; i < kMaxPostedTasksPerWakeup; i++) {
+    if (!posted_tasks_.Pop(&task))
+      return did_work;
+    task();
+    did_work = true;
+    if (current_run_state_->should_quit)
+      break;
+  }
+
+  // We stopped early, so there may be more tasks: make sure that we wake up
+  // again.
+  WakeUp();
+  return did_work;
+}
+
 bool RunLoop::NotifyResults(const std::vector<MojoWaitSetResult>& results) {
   assert(!results.empty());
 
   bool did_work = false;
   for (const auto& result : results) {
     auto id = result.cookie;
-    auto it = handlers_.find(id);
+    if (id == kWakeupCookie) {
+      assert(result.wait_result == MOJO_RESULT_OK);
+      did_work |= RunPostedTasks();
+      if (current_run_state_->should_quit)
+        break;
+      continue;
+    }
+
+    HandlerInfo* info = GetHandlerInfo(id);
     // Though we should find an entry for the first result, a handler that we
     // invoke may remove other handlers.
-    if (it == handlers_.end())
+    if (!info)
       continue;
 
-    auto handler = it->second.handler;
-    handlers_.erase(it);
-    MojoResult r = WaitSetRemove(wait_set_.get(), id);
-    MOJO_ALLOW_UNUSED_LOCAL(r);
-    assert(r == MOJO_RESULT_OK);
+    auto handler = info->handler;
+    // Watches remain registered (in both |handler_slots_| and the wait set)
+    // when their handle is ready; other handlers are unregistered before being
+    // notified.
+    if (!info->is_watch || result.wait_result != MOJO_RESULT_OK) {
+      FreeHandler(id);  // Invalidates |info|.
+      MojoResult r = WaitSetRemove(wait_set_.get(), id);
+      MOJO_ALLOW_UNUSED_LOCAL(r);
+      assert(r == MOJO_RESULT_OK);
+    }
     if (result.wait_result == MOJO_RESULT_OK)
       handler->OnHandleReady(id);
     else
@@ -361,34 +497,36 @@ bool RunLoop::NotifyResults(const std::vector<MojoWaitSetResult>& results) {
 }
 
 bool RunLoop::NotifyHandlersDeadlineExceeded(MojoTimeTicks absolute_deadline) {
-  assert(!handlers_.empty());
   assert(absolute_deadline != kInvalidTimeTicks);
 
-  bool did_work = false;
-  while (!handler_deadlines_.empty()) {
-    const HandlerDeadlineInfo& info = handler_deadlines_.top();
+  std::vector<RunLoopHandler::Id> expired_ids;
+  handler_deadlines_.Expire(absolute_deadline, &expired_ids);
 
-    if (info.absolute_deadline > absolute_deadline)
-      break;
+  bool did_work = false;
+  for (size_t i = 0u; i < expired_ids.size(); i++) {
+    auto id = expired_ids[i];
+    HandlerInfo* info = GetHandlerInfo(id);
+    // Previously-run handlers may have removed yet-to-be-run handlers (which
+    // cancels their deadlines, but not after they've been expired).
+    if (!info)
+      continue;
 
-    const auto it = handlers_.find(info.id);
-    // Though the top shouldn't be stale, there may be stale entries after it
-    // (with the same deadline). Moreover, previously-run handlers may have
-    // removed yet-to-be-run handlers.
-    if (it == handlers_.end()) {
-      handler_deadlines_.pop();
+    if (current_run_state_->should_quit) {
+      // Re-add the deadline, so that the handler will be notified later.
+      info->deadline_timer_id =
+          handler_deadlines_.Add(info->absolute_deadline, id);
       continue;
     }
 
-    auto handler = it->second.handler;
-    auto id = info.id;
-    handlers_.erase(it);       // Invalidates |it|.
-    handler_deadlines_.pop();  // Invalidates |info|.
+    auto handler = info->handler;
+    // The deadline has already been removed from |handler_deadlines_|.
+    info->deadline_timer_id = HandlerDeadlineWheel::kInvalidTimerId;
+    FreeHandler(id);  // Invalidates |info|.
+    MojoResult r = WaitSetRemove(wait_set_.get(), id);
+    MOJO_ALLOW_UNUSED_LOCAL(r);
+    assert(r == MOJO_RESULT_OK);
     handler->OnHandleError(id, MOJO_RESULT_DEADLINE_EXCEEDED);
     did_work = true;
-
-    if (current_run_state_->should_quit)
-      break;
   }
   return did_work;
 }
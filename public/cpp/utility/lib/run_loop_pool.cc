@@ -0,0 +1,118 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "mojo/public/cpp/utility/run_loop_pool.h"
+
+#include <assert.h>
+
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "mojo/public/cpp/utility/run_loop.h"
+
+namespace mojo {
+
+struct RunLoopPool::PoolThread {
+  PoolThread() {}
+
+  // Only written by the thread itself (before the constructor returns).
+  RunLoop* run_loop = nullptr;
+  std::thread::id thread_id;
+  std::thread thread;
+  std::atomic<size_t> load{0u};
+};
+
+RunLoopPool::RunLoopPool(size_t num_threads) {
+  assert(num_threads > 0u);
+
+  std::mutex mutex;
+  std::condition_variable started_cv;
+  size_t num_started = 0u;
+
+  for (size_t i = 0u; i < num_threads; i++) {
+    threads_.emplace_back(new PoolThread());
+    PoolThread* pool_thread = threads_.back().get();
+    pool_thread->thread = std::thread(
+        [pool_thread, &mutex, &started_cv, &num_started]() {
+          RunLoop run_loop;
+
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            pool_thread->run_loop = &run_loop;
+            pool_thread->thread_id = std::this_thread::get_id();
+            num_started++;
+            // Note: Once the lock is released, the constructor may return, so
+            // the variables captured by reference must not be used after this.
+            started_cv.notify_one();
+          }
+
+          run_loop.Run();
+        });
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  started_cv.wait(lock, [num_threads, &num_started]() {
+    return num_started == num_threads;
+  });
+}
+
+RunLoopPool::~RunLoopPool() {
+  for (size_t i = 0u; i < threads_.size(); i++)
+    PostTask(i, []() { RunLoop::current()->Quit(); });
+  for (auto& pool_thread : threads_) {
+    assert(pool_thread->thread_id != std::this_thread::get_id());
+    pool_thread->thread.join();
+  }
+}
+
+void RunLoopPool::PostTask(size_t thread_index, std::function<void()> task) {
+  assert(thread_index < threads_.size());
+  threads_[thread_index]->run_loop->PostTask(std::move(task));
+}
+
+size_t RunLoopPool::AcquireThread(Policy policy) {
+  size_t thread_index = 0u;
+  switch (policy) {
+    case Policy::ROUND_ROBIN:
+      thread_index = next_thread_index_.fetch_add(1u) % threads_.size();
+      break;
+    case Policy::LEAST_LOADED: {
+      // Note: This is racy with respect to concurrent acquisitions, which may
+      // then choose the same thread; that's fine.
+      size_t min_load = std::numeric_limits<size_t>::max();
+      for (size_t i = 0u; i < threads_.size(); i++) {
+        size_t load = threads_[i]->load.load();
+        if (load < min_load) {
+          min_load = load;
+          thread_index = i;
+        }
+      }
+      break;
+    }
+  }
+  threads_[thread_index]->load.fetch_add(1u);
+  return thread_index;
+}
+
+void RunLoopPool::ReleaseThread(size_t thread_index) {
+  assert(thread_index < threads_.size());
+  size_t old_load = threads_[thread_index]->load.fetch_sub(1u);
+  MOJO_ALLOW_UNUSED_LOCAL(old_load);
+  assert(old_load > 0u);
+}
+
+size_t RunLoopPool::GetThreadLoad(size_t thread_index) const {
+  assert(thread_index < threads_.size());
+  return threads_[thread_index]->load.load();
+}
+
+bool RunLoopPool::IsOnThread(size_t thread_index) const {
+  assert(thread_index < threads_.size());
+  return threads_[thread_index]->thread_id == std::this_thread::get_id();
+}
+
+}  // namespace mojo
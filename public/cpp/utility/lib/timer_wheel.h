@@ -0,0 +1,375 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MOJO_PUBLIC_CPP_UTILITY_LIB_TIMER_WHEEL_H_
+#define MOJO_PUBLIC_CPP_UTILITY_LIB_TIMER_WHEEL_H_
+
+#include <assert.h>
+#include <mojo/system/time.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "mojo/public/cpp/system/macros.h"
+
+namespace mojo {
+namespace internal {
+
+// A hierarchical timer wheel (see Varghese and Lauck, "Hashed and Hierarchical
+// Timing Wheels"), holding values of type |T| that expire at given absolute
+// times (in |MojoTimeTicks|). Adding and cancelling timers are O(1); expiring
+// timers is amortized O(1) per timer (each timer is moved between levels at
+// most |kNumLevels| times). Unlike a priority queue, cancelled timers are
+// removed immediately rather than left behind as stale entries.
+//
+// Time is divided into ticks of |kTickMicroseconds|. Level 0 has one slot per
+// tick, and each higher level has slots that are |kNumSlots| times as wide as
+// the level below it. Each timer is placed in the level whose range covers its
+// expiry (relative to the wheel's current tick); when the current tick reaches
+// a higher-level slot, that slot's timers are "cascaded" down. Expiry times are
+// kept exactly, so the tick size only affects bucketing, not precision.
+//
+// Timers expiring at the same time expire in the order they were added.
+//
+// The earliest expiry time is cached, so that |GetNextExpiryTime()| (which a
+// run loop calls on every iteration) is O(1) unless the earliest timer has been
+// cancelled or timers have expired since it was last called, in which case
+// only the first occupied slot of each level is examined.
+//
+// Nodes are kept in a single vector (with a free list) and linked into slots by
+// index, so the wheel does no allocation in steady state.
+template <typename T>
+class TimerWheel {
+ public:
+  using TimerId = uint32_t;
+
+  static constexpr TimerId kInvalidTimerId = static_cast<TimerId>(-1);
+  static constexpr MojoTimeTicks kTickMicroseconds = 1000;
+  static constexpr uint32_t kNumLevels = 6u;
+
+  TimerWheel() {}
+  ~TimerWheel() {}
+
+  bool empty() const { return num_timers_ == 0u; }
+  size_t size() const { return num_timers_; }
+
+  // Adds a timer that expires at |absolute_time| (which may be in the past),
+  // returning an ID that can be passed to |Cancel()| until it expires.
+  TimerId Add(MojoTimeTicks absolute_time, const T& value) {
+    TimerId id;
+    if (free_list_ != kInvalidTimerId) {
+      id = free_list_;
+      free_list_ = nodes_[id].next;
+    } else {
+      id = static_cast<TimerId>(nodes_.size());
+      nodes_.push_back(Node());
+    }
+    Node& node = nodes_[id];
+    node.absolute_time = absolute_time;
+    node.sequence_number = next_sequence_number_++;
+    node.value = value;
+
+    // If the wheel is empty, there's no state to preserve, so just move it to
+    // the new timer's tick. (Otherwise, the first timer added to a new wheel
+    // would have to be cascaded all the way down from the top level.)
+    if (num_timers_ == 0u) {
+      current_tick_ = std::max(current_tick_, GetTick(absolute_time));
+      next_expiry_time_ = absolute_time;
+      next_expiry_time_valid_ = true;
+    } else if (next_expiry_time_valid_ &&
+               absolute_time < next_expiry_time_) {
+      next_expiry_time_ = absolute_time;
+    }
+    num_timers_++;
+
+    Link(id);
+    return id;
+  }
+
+  // Cancels the timer with the given ID (which must not have expired).
+  void Cancel(TimerId id) {
+    assert(id < nodes_.size());
+    if (nodes_[id].absolute_time == next_expiry_time_)
+      next_expiry_time_valid_ = false;
+    Unlink(id);
+    FreeNode(id);
+    num_timers_--;
+  }
+
+  // Returns the earliest expiry time of any timer, or 0 if there are no timers.
+  MojoTimeTicks GetNextExpiryTime() {
+    if (num_timers_ == 0u)
+      return 0;
+    if (!next_expiry_time_valid_) {
+      next_expiry_time_ = ComputeNextExpiryTime();
+      next_expiry_time_valid_ = true;
+    }
+    return next_expiry_time_;
+  }
+
+  // Removes all timers that expire at or before |now|, appending their values
+  // to |*expired| (e.g., a |std::vector<T>| or |std::deque<T>|) in order of
+  // expiry.
+  template <typename Container>
+  void Expire(MojoTimeTicks now, Container* expired) {
+    assert(expired);
+    if (num_timers_ == 0u)
+      return;
+    // Nothing can have expired (and cascading doesn't change the earliest
+    // expiry time).
+    if (next_expiry_time_valid_ && next_expiry_time_ > now)
+      return;
+    ExpireInternal(now, expired);
+  }
+
+ private:
+  static constexpr uint32_t kSlotBits = 6u;
+  static constexpr uint32_t kNumSlots = 1u << kSlotBits;
+  static constexpr uint32_t kSlotMask = kNumSlots - 1u;
+
+  // Computes the earliest expiry time of any timer (there must be at least
+  // one), by examining the first occupied slot of each level.
+  MojoTimeTicks ComputeNextExpiryTime() const {
+    MojoTimeTicks result = 0;
+    bool have_result = false;
+    for (uint32_t level = 0u; level < kNumLevels; level++) {
+      uint32_t distance;
+      if (!FindFirstOccupiedSlot(level, &distance))
+        continue;
+      uint32_t slot = (GetLevelPosition(level) + distance) & kSlotMask;
+      for (TimerId id = levels_[level].heads[slot]; id != kInvalidTimerId;
+           id = nodes_[id].next) {
+        if (!have_result || nodes_[id].absolute_time < result) {
+          result = nodes_[id].absolute_time;
+          have_result = true;
+        }
+      }
+    }
+    assert(have_result);
+    return result;
+  }
+
+  template <typename Container>
+  void ExpireInternal(MojoTimeTicks now, Container* expired) {
+    uint64_t target_tick = GetTick(now);
+    std::vector<TimerId>& expired_ids = scratch_ids_;
+    expired_ids.clear();
+    for (;;) {
+      // Expire timers in the current slot. Since we only move past a tick once
+      // we've reached a later one, anything left in the current slot before
+      // moving on must have expired.
+      uint32_t slot = static_cast<uint32_t>(current_tick_) & kSlotMask;
+      TimerId id = levels_[0].heads[slot];
+      while (id != kInvalidTimerId) {
+        TimerId next = nodes_[id].next;
+        if (nodes_[id].absolute_time <= now) {
+          Unlink(id);
+          expired_ids.push_back(id);
+        }
+        id = next;
+      }
+
+      if (current_tick_ >= target_tick)
+        break;
+
+      // Skip ahead to the next tick at which something happens (i.e., a level
+      // 0 slot has timers or a higher-level slot needs to be cascaded).
+      uint64_t next_tick = GetNextEventTick();
+      if (next_tick > target_tick) {
+        current_tick_ = target_tick;
+        continue;
+      }
+      current_tick_ = next_tick;
+      for (uint32_t level = 1u; level < kNumLevels; level++) {
+        if (current_tick_ & ((uint64_t{1} << (level * kSlotBits)) - 1u))
+          break;
+        Cascade(level);
+      }
+    }
+
+    std::sort(expired_ids.begin(), expired_ids.end(),
+              [this](TimerId a, TimerId b) {
+                return (nodes_[a].absolute_time == nodes_[b].absolute_time)
+                           ? nodes_[a].sequence_number <
+                                 nodes_[b].sequence_number
+                           : nodes_[a].absolute_time < nodes_[b].absolute_time;
+              });
+    for (TimerId id : expired_ids) {
+      expired->push_back(std::move(nodes_[id].value));
+      FreeNode(id);
+    }
+    num_timers_ -= expired_ids.size();
+    if (!expired_ids.empty())
+      next_expiry_time_valid_ = false;
+  }
+
+  struct Node {
+    MojoTimeTicks absolute_time = 0;
+    uint64_t sequence_number = 0u;
+    T value = T();
+    TimerId prev = kInvalidTimerId;
+    TimerId next = kInvalidTimerId;
+    uint8_t level = 0u;
+    uint8_t slot = 0u;
+  };
+
+  struct Level {
+    Level() { std::fill(heads, heads + kNumSlots, kInvalidTimerId); }
+
+    TimerId heads[kNumSlots];
+    // Bit i is set if and only if |heads[i]| is nonempty.
+    uint64_t occupied = 0u;
+  };
+
+  static_assert(kNumSlots == 64u, "|Level::occupied| must have a bit per slot");
+
+  static uint64_t GetTick(MojoTimeTicks absolute_time) {
+    return (absolute_time <= 0)
+               ? 0u
+               : static_cast<uint64_t>(absolute_time / kTickMicroseconds);
+  }
+
+  // Returns the slot index in |level| of the current tick.
+  uint32_t GetLevelPosition(uint32_t level) const {
+    return static_cast<uint32_t>(current_tick_ >> (level * kSlotBits)) &
+           kSlotMask;
+  }
+
+  // Finds the first occupied slot in |level|, in expiry order, and sets
+  // |*distance| to its distance (in slots) from the current position. For
+  // level 0, this is in [0, kNumSlots); for higher levels, the current
+  // position has already been cascaded, so a timer in the current slot is a
+  // full turn away and this is in [1, kNumSlots].
+  bool FindFirstOccupiedSlot(uint32_t level, uint32_t* distance) const {
+    uint64_t occupied = levels_[level].occupied;
+    if (!occupied)
+      return false;
+    uint32_t start = GetLevelPosition(level);
+    if (level > 0u)
+      start = (start + 1u) & kSlotMask;
+    uint64_t rotated =
+        start ? ((occupied >> start) | (occupied << (kNumSlots - start)))
+              : occupied;
+    *distance = static_cast<uint32_t>(__builtin_ctzll(rotated)) +
+                (level > 0u ? 1u : 0u);
+    return true;
+  }
+
+  // Returns the next tick after the current one at which a level 0 slot has
+  // timers or a higher-level slot must be cascaded. Must only be called if the
+  // current level 0 slot is empty (and there are timers).
+  uint64_t GetNextEventTick() const {
+    uint64_t result = static_cast<uint64_t>(-1);
+    for (uint32_t level = 0u; level < kNumLevels; level++) {
+      uint32_t distance;
+      if (!FindFirstOccupiedSlot(level, &distance))
+        continue;
+      uint32_t shift = level * kSlotBits;
+      uint64_t tick = ((current_tick_ >> shift) + distance) << shift;
+      result = std::min(result, tick);
+    }
+    assert(result > current_tick_);
+    return result;
+  }
+
+  // Moves the timers in the current slot of |level| to lower levels.
+  void Cascade(uint32_t level) {
+    uint32_t slot = GetLevelPosition(level);
+    TimerId id = levels_[level].heads[slot];
+    levels_[level].heads[slot] = kInvalidTimerId;
+    levels_[level].occupied &= ~(uint64_t{1} << slot);
+    while (id != kInvalidTimerId) {
+      TimerId next = nodes_[id].next;
+      Link(id);
+      id = next;
+    }
+  }
+
+  // Links the node |id| into the slot appropriate for its expiry time.
+  void Link(TimerId id) {
+    Node& node = nodes_[id];
+    uint64_t tick = std::max(current_tick_, GetTick(node.absolute_time));
+    uint64_t delta = tick - current_tick_;
+    uint32_t level = 0u;
+    while (level < kNumLevels - 1u &&
+           delta >= (uint64_t{1} << ((level + 1u) * kSlotBits)))
+      level++;
+    // Timers beyond the range of the top level are parked at its far end, and
+    // placed properly when that slot is cascaded.
+    uint64_t max_delta = (uint64_t{1} << (kNumLevels * kSlotBits)) - 1u;
+    if (delta > max_delta)
+      tick = current_tick_ + max_delta;
+    uint32_t slot =
+        static_cast<uint32_t>(tick >> (level * kSlotBits)) & kSlotMask;
+
+    Level& l = levels_[level];
+    node.level = static_cast<uint8_t>(level);
+    node.slot = static_cast<uint8_t>(slot);
+    node.prev = kInvalidTimerId;
+    node.next = l.heads[slot];
+    if (node.next != kInvalidTimerId)
+      nodes_[node.next].prev = id;
+    l.heads[slot] = id;
+    l.occupied |= uint64_t{1} << slot;
+  }
+
+  void Unlink(TimerId id) {
+    Node& node = nodes_[id];
+    Level& l = levels_[node.level];
+    if (node.prev != kInvalidTimerId)
+      nodes_[node.prev].next = node.next;
+    else
+      l.heads[node.slot] = node.next;
+    if (node.next != kInvalidTimerId)
+      nodes_[node.next].prev = node.prev;
+    if (l.heads[node.slot] == kInvalidTimerId)
+      l.occupied &= ~(uint64_t{1} << node.slot);
+  }
+
+  void FreeNode(TimerId id) {
+    nodes_[id].value = T();
+    nodes_[id].next = free_list_;
+    free_list_ = id;
+  }
+
+  uint64_t current_tick_ = 0u;
+  uint64_t next_sequence_number_ = 0u;
+  size_t num_timers_ = 0u;
+  Level levels_[kNumLevels];
+  std::vector<Node> nodes_;
+  TimerId free_list_ = kInvalidTimerId;
+  // The cached result of |ComputeNextExpiryTime()|, if valid.
+  MojoTimeTicks next_expiry_time_ = 0;
+  bool next_expiry_time_valid_ = false;
+  // Used by |Expire()|; kept to avoid reallocating it each time.
+  std::vector<TimerId> scratch_ids_;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+// static
+template <typename T>
+constexpr typename TimerWheel<T>::TimerId TimerWheel<T>::kInvalidTimerId;
+// static
+template <typename T>
+constexpr MojoTimeTicks TimerWheel<T>::kTickMicroseconds;
+// static
+template <typename T>
+constexpr uint32_t TimerWheel<T>::kNumLevels;
+// static
+template <typename T>
+constexpr uint32_t TimerWheel<T>::kSlotBits;
+// static
+template <typename T>
+constexpr uint32_t TimerWheel<T>::kNumSlots;
+// static
+template <typename T>
+constexpr uint32_t TimerWheel<T>::kSlotMask;
+
+}  // namespace internal
+}  // namespace mojo
+
+#endif  // MOJO_PUBLIC_CPP_UTILITY_LIB_TIMER_WHEEL_H_
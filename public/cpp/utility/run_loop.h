@@ -7,20 +7,25 @@
 
 #include <mojo/system/time.h>
 
-#include <map>
-#include <queue>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <vector>
 
 #include "mojo/public/cpp/bindings/callback.h"
 #include "mojo/public/cpp/system/handle.h"
 #include "mojo/public/cpp/system/macros.h"
+#include "mojo/public/cpp/system/message_pipe.h"
 #include "mojo/public/cpp/system/wait_set.h"
+#include "mojo/public/cpp/utility/lib/mpsc_task_queue.h"
+#include "mojo/public/cpp/utility/lib/timer_wheel.h"
 #include "mojo/public/cpp/utility/run_loop_handler.h"
 
 namespace mojo {
 
 // Run loop (a.k.a. message loop): watches handles for signals and calls
 // handlers when they occur; can also execute posted (delayed) tasks. This class
-// is not thread-safe.
+// is not thread-safe, except for |PostTask()|.
 class RunLoop {
  public:
   RunLoop();
@@ -52,11 +57,42 @@ class RunLoop {
                                 MojoDeadline deadline);
   void RemoveHandler(RunLoopHandler::Id id);
 
+  // Registers a persistent ("watch") RunLoopHandler for the specified handle.
+  // This is like |AddHandler()| with an indefinite deadline, except that the
+  // handler is *not* unregistered when its OnHandleReady() is called: it (and
+  // its wait set entry) remains registered, and OnHandleReady() will be called
+  // again on each subsequent iteration for as long as the handle satisfies one
+  // of |handle_signals| (i.e., watches are level-triggered). This avoids the
+  // cost of re-adding the handler after every notification.
+  //
+  // A watch remains registered until it is removed with |RemoveHandler()| or an
+  // error occurs; as with |AddHandler()|, it is unregistered before
+  // OnHandleError() is called.
+  RunLoopHandler::Id AddWatch(RunLoopHandler* handler,
+                              const Handle& handle,
+                              MojoHandleSignals handle_signals);
+
   // Adds a task to be performed after delay has elapsed.
   void PostDelayedTask(const Closure& task, MojoTimeTicks delay);
 
+  // Adds a task to be performed (on this run loop's thread) as soon as
+  // possible. Unlike all other methods, this may be called on any thread
+  // (though the caller must ensure that the RunLoop is not destroyed
+  // concurrently). Tasks posted by a given thread are run in order. Tasks that
+  // haven't been run when the RunLoop is destroyed are destroyed (on its
+  // thread) without being run.
+  //
+  // Tasks are queued without locking, and at most one wakeup is outstanding at
+  // any time (however many tasks are posted), so this is much cheaper than
+  // writing a message to a message pipe per task.
+  //
+  // Note: This takes a |std::function| rather than a |Closure|, since the
+  // latter's reference count is not thread-safe.
+  void PostTask(std::function<void()> task);
+
   // Runs the loop servicing handles and tasks as they become ready. Returns
-  // when Quit() is invoked, or there are no more handles or tasks.
+  // when Quit() is invoked. (It keeps waiting for tasks, e.g., posted from
+  // other threads using |PostTask()|, even if there are no handlers.)
   void Run();
 
   // Runs the loop servicing any handles and tasks that are ready. Does not wait
@@ -68,73 +104,42 @@ class RunLoop {
 
   // Returns the number of registered handlers. (This is mostly used for
   // testing.)
-  size_t num_handlers() const { return handlers_.size(); }
+  size_t num_handlers() const { return num_handlers_; }
 
  private:
+  // Handler deadlines (keyed by handler ID) and delayed tasks are both kept in
+  // timer wheels. (Even though tasks are not handlers, the order in which they
+  // were posted is preserved for tasks with the same run time.)
+  using HandlerDeadlineWheel = internal::TimerWheel<RunLoopHandler::Id>;
+  using DelayedTaskWheel = internal::TimerWheel<Closure>;
+
   static constexpr MojoTimeTicks kInvalidTimeTicks = 0;
 
   // Contains the information that was passed to |AddHandler()|. These are
-  // stored in |handlers|, which is a map from |RunLoopHandler::Id|s
-  // (generated/returned by |AddHandler()| to |HandlerInfo|s. Each entry in
-  // |handlers_| also has a corresponding entry in |wait_set_| (with cookie the
+  // stored in |handler_slots_|, a "slot map" indexed by the low bits of the
+  // |RunLoopHandler::Id|s (generated/returned by |AddHandler()|); the high bits
+  // hold the slot's generation, which is incremented each time the slot is
+  // freed, so that stale IDs are never mistaken for live ones. Each registered
+  // handler also has a corresponding entry in |wait_set_| (with cookie the
   // |RunLoopHandler::Id|).
   struct HandlerInfo {
-    HandlerInfo(RunLoopHandler* handler,
-                MojoHandleSignals handle_signals,
-                MojoTimeTicks absolute_deadline)
-        : handler(handler),
-          handle_signals(handle_signals),
-          absolute_deadline(absolute_deadline) {}
-
-    RunLoopHandler* handler;
-    MojoHandleSignals handle_signals;
+    RunLoopHandler* handler = nullptr;
+    MojoHandleSignals handle_signals = MOJO_HANDLE_SIGNAL_NONE;
     // |kInvalidTimeTicks| means forever/no deadline/indefinite.
-    MojoTimeTicks absolute_deadline;
-  };
-  using IdToHandlerInfoMap = std::map<RunLoopHandler::Id, HandlerInfo>;
-
-  // Contains information about a handler with a deadline. These are stored in
-  // the |handler_deadlines_| priority queue (with the earliest/lowest
-  // |RunLoopHandler::Id| at the top). If |id| is not in |handlers_|, then this
-  // deadline is no longer valid (i.e., is stale).
-  struct HandlerDeadlineInfo {
-    HandlerDeadlineInfo(RunLoopHandler::Id id, MojoTimeTicks absolute_deadline)
-        : id(id), absolute_deadline(absolute_deadline) {}
-
-    // Needed to be in a priority queue. Note that |std::priority_queue<>|'s top
-    // is the "greatest" element, whereas we want the earliest.
-    bool operator<(const HandlerDeadlineInfo& other) const {
-      return (absolute_deadline == other.absolute_deadline)
-                 ? id < other.id
-                 : absolute_deadline > other.absolute_deadline;
-    }
-
-    RunLoopHandler::Id id;
-    MojoTimeTicks absolute_deadline;
+    MojoTimeTicks absolute_deadline = kInvalidTimeTicks;
+    // The handler's entry in |handler_deadlines_|, if it has a deadline.
+    HandlerDeadlineWheel::TimerId deadline_timer_id =
+        HandlerDeadlineWheel::kInvalidTimerId;
+    // True if this handler was added using |AddWatch()|.
+    bool is_watch = false;
   };
-  using HandlerDeadlineQueue = std::priority_queue<HandlerDeadlineInfo>;
-
-  // Contains information about a task posted using |PostDelayedTask()|. (Even
-  // though tasks are not handlers, we also assign them |RunLoopHandler::Id|s
-  // from the same namespace.) These are stored in the |delayed_tasks_| priority
-  // queue (with the earliest/lowest |RunLoopHandler::Id| at the top).
-  struct DelayedTaskInfo {
-    DelayedTaskInfo(RunLoopHandler::Id id,
-                    const Closure& task,
-                    MojoTimeTicks absolute_run_time);
-    ~DelayedTaskInfo();
-
-    bool operator<(const DelayedTaskInfo& other) const {
-      return (absolute_run_time == other.absolute_run_time)
-                 ? id > other.id
-                 : absolute_run_time > other.absolute_run_time;
-    }
-
-    RunLoopHandler::Id id;
-    Closure task;
-    MojoTimeTicks absolute_run_time;
+
+  struct HandlerSlot {
+    // The generation of the ID of the handler in this slot (if any).
+    uint32_t generation = 0u;
+    bool in_use = false;
+    HandlerInfo info;
   };
-  using DelayedTaskQueue = std::priority_queue<DelayedTaskInfo>;
 
   // Inside of |Run()|/|RunUntilIdle()| (i.e., really in |RunInternal()|), we
   // have one of these on the stack. |current_run_state_| points to the current
@@ -142,8 +147,7 @@ class RunLoop {
   struct RunState;
 
   // Helper for |Run()| and |RunUntilIdle()|, which loops and executes delayed
-  // tasks and handlers as handles become "ready". It will if:
-  //   - there are no more tasks or registered handlers,
+  // tasks and handlers as handles become "ready". It will quit if:
   //   - |Quit()| is called, or
   //   - no work is done in a given iteration if |quit_when_idle| is true.
   void RunInternal(bool quit_when_idle);
@@ -152,6 +156,14 @@ class RunLoop {
   // continue.
   bool DoIteration(bool quit_when_idle);
 
+  // Makes sure that the run loop will wake up (i.e., that |wakeup_pending_| is
+  // set and a wakeup message has been written). This is thread-safe.
+  void WakeUp();
+
+  // Called when |wakeup_pending_| is set: consumes wakeups and runs tasks
+  // posted using |PostTask()|. Returns true if any task was run.
+  bool RunPostedTasks();
+
   // Notifies handlers corresponding to the wait results in |results| (which
   // should not be empty). Returns true if work was done (i.e., any handler was
   // called).
@@ -162,17 +174,46 @@ class RunLoop {
   // handler was called).
   bool NotifyHandlersDeadlineExceeded(MojoTimeTicks absolute_deadline);
 
+  // Helper for |AddHandler()| and |AddWatch()|: allocates a slot (and ID) for
+  // the handler, registers its deadline (if any), and adds the wait set entry.
+  RunLoopHandler::Id AddHandlerInternal(RunLoopHandler* handler,
+                                        const Handle& handle,
+                                        MojoHandleSignals handle_signals,
+                                        MojoTimeTicks absolute_deadline,
+                                        bool is_watch);
+
+  // Returns the info for the handler with the given ID, or null if there is no
+  // such (registered) handler.
+  HandlerInfo* GetHandlerInfo(RunLoopHandler::Id id);
+
+  // Unregisters the handler with the given ID (which must be registered),
+  // cancelling its deadline (if any). This does not remove its wait set entry.
+  void FreeHandler(RunLoopHandler::Id id);
+
   // Calculates the absolute deadline (to be turned into a relative deadline)
-  // for the wait set wait. This should only be called if |handlers_| is
-  // nonempty. Returns |kInvalidTimeTicks| for "forever"/indefinite. Sets
+  // for the wait set wait. This should only be called if there are registered
+  // handlers. Returns |kInvalidTimeTicks| for "forever"/indefinite. Sets
   // |*is_delayed_task| to true if the deadline is for a delayed task.
   MojoTimeTicks CalculateAbsoluteDeadline(bool* is_delayed_task);
 
-  RunLoopHandler::Id next_id_ = 1u;
-  IdToHandlerInfoMap handlers_;
+  std::vector<HandlerSlot> handler_slots_;
+  // Indices of unused entries in |handler_slots_|.
+  std::vector<uint32_t> free_handler_slots_;
+  size_t num_handlers_ = 0u;
   ScopedWaitSetHandle wait_set_;
-  HandlerDeadlineQueue handler_deadlines_;
-  DelayedTaskQueue delayed_tasks_;
+  HandlerDeadlineWheel handler_deadlines_;
+  DelayedTaskWheel delayed_tasks_;
+  // Delayed tasks that have become ready (in order), but haven't yet been run
+  // (e.g., because |Quit()| was called).
+  std::deque<Closure> ready_tasks_;
+
+  // Tasks posted using |PostTask()|. Whenever |wakeup_pending_| becomes true,
+  // a message is written to |wakeup_write_handle_|; |wakeup_read_handle_| is in
+  // |wait_set_| (with a cookie that is never a valid |RunLoopHandler::Id|).
+  internal::MpscTaskQueue posted_tasks_;
+  std::atomic<bool> wakeup_pending_{false};
+  ScopedMessagePipeHandle wakeup_read_handle_;
+  ScopedMessagePipeHandle wakeup_write_handle_;
 
   RunState* current_run_state_ = nullptr;
 
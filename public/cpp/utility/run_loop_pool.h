@@ -0,0 +1,78 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MOJO_PUBLIC_CPP_UTILITY_RUN_LOOP_POOL_H_
+#define MOJO_PUBLIC_CPP_UTILITY_RUN_LOOP_POOL_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "mojo/public/cpp/system/macros.h"
+
+namespace mojo {
+
+class RunLoop;
+
+// A fixed-size pool of threads, each of which runs its own |RunLoop| (with its
+// own wait set) until the pool is destroyed. Work is given to a particular
+// thread using |PostTask()|; anything created on a pool thread that uses the
+// default async waiter (e.g., a |Binding|) is then serviced by that thread, so
+// it keeps the usual single-threaded semantics.
+//
+// Each thread also has a "load" (e.g., the number of bindings pinned to it),
+// which is maintained by users of the pool via |AcquireThread()| and
+// |ReleaseThread()|, and is used to choose threads for new work.
+//
+// All methods are thread-safe, except that the pool must not be destroyed on
+// one of its own threads (or concurrently with other calls).
+class RunLoopPool {
+ public:
+  // How |AcquireThread()| chooses a thread.
+  enum class Policy {
+    // Cycle through the threads in order.
+    ROUND_ROBIN,
+    // Choose the thread with the lowest load (the first such, on ties).
+    LEAST_LOADED,
+  };
+
+  // Starts |num_threads| (which must be nonzero) threads, and waits for each
+  // of their run loops to start.
+  explicit RunLoopPool(size_t num_threads);
+  // Quits each thread's run loop (after running any tasks already posted to
+  // it) and joins the threads.
+  ~RunLoopPool();
+
+  size_t num_threads() const { return threads_.size(); }
+
+  // Posts |task| to the run loop of the thread with the given index (see
+  // |RunLoop::PostTask()|).
+  void PostTask(size_t thread_index, std::function<void()> task);
+
+  // Chooses a thread according to |policy|, increments its load, and returns
+  // its index.
+  size_t AcquireThread(Policy policy);
+  // Decrements the load of the thread with the given index.
+  void ReleaseThread(size_t thread_index);
+  size_t GetThreadLoad(size_t thread_index) const;
+
+  // Returns true if called on the thread with the given index.
+  bool IsOnThread(size_t thread_index) const;
+
+ private:
+  struct PoolThread;
+
+  std::vector<std::unique_ptr<PoolThread>> threads_;
+  // Used by |Policy::ROUND_ROBIN|.
+  std::atomic<size_t> next_thread_index_{0u};
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(RunLoopPool);
+};
+
+}  // namespace mojo
+
+#endif  // MOJO_PUBLIC_CPP_UTILITY_RUN_LOOP_POOL_H_
@@ -0,0 +1,244 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file has perf tests for |mojo::RunLoop|: the per-iteration overhead with
+// varying numbers of registered handlers, and the cost of running tasks posted
+// from other threads.
+
+#include <stdio.h>
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mojo/public/cpp/system/macros.h"
+#include "mojo/public/cpp/system/message_pipe.h"
+#include "mojo/public/cpp/system/time.h"
+#include "mojo/public/cpp/test_support/test_support.h"
+#include "mojo/public/cpp/test_support/test_utils.h"
+#include "mojo/public/cpp/utility/run_loop.h"
+#include "mojo/public/cpp/utility/run_loop_handler.h"
+#include "third_party/gtest/include/gtest/gtest.h"
+
+namespace mojo {
+namespace {
+
+constexpr MojoTimeTicks kPerftestTimeMicroseconds = 3 * 1000000;
+// A delay (or deadline) that will not be reached during a perf test.
+constexpr MojoTimeTicks kFarOffMicroseconds = 1000 * kPerftestTimeMicroseconds;
+
+// A handler that is never expected to be called (until the run loop is
+// destroyed).
+class IdleRunLoopHandler : public RunLoopHandler {
+ public:
+  IdleRunLoopHandler() {}
+  ~IdleRunLoopHandler() override {}
+
+  // RunLoopHandler:
+  void OnHandleReady(Id id) override { ADD_FAILURE(); }
+  void OnHandleError(Id id, MojoResult result) override {
+    EXPECT_EQ(MOJO_RESULT_ABORTED, result);
+  }
+
+ private:
+  MOJO_DISALLOW_COPY_AND_ASSIGN(IdleRunLoopHandler);
+};
+
+// A handler that, each time its handle is readable, reads a message and writes
+// one back (so that it is ready again on the next run loop iteration).
+class PingPongRunLoopHandler : public RunLoopHandler {
+ public:
+  PingPongRunLoopHandler(MessagePipeHandle read_handle,
+                         MessagePipeHandle write_handle)
+      : read_handle_(read_handle), write_handle_(write_handle) {}
+  ~PingPongRunLoopHandler() override {}
+
+  uint64_t count() const { return count_; }
+
+  // RunLoopHandler:
+  void OnHandleReady(Id id) override {
+    std::string message;
+    EXPECT_TRUE(test::ReadTextMessage(read_handle_, &message));
+    EXPECT_TRUE(test::WriteTextMessage(write_handle_, message));
+    count_++;
+  }
+  void OnHandleError(Id id, MojoResult result) override {
+    EXPECT_EQ(MOJO_RESULT_ABORTED, result);
+  }
+
+ private:
+  const MessagePipeHandle read_handle_;
+  const MessagePipeHandle write_handle_;
+  uint64_t count_ = 0u;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(PingPongRunLoopHandler);
+};
+
+// Measures run loop iterations per second with |num_handlers| registered
+// handlers, only one of which is ever ready. Half of the idle handlers have
+// (far-off) deadlines, and a (far-off) delayed task is posted for each.
+void DoRunLoopIterationPerfTest(uint32_t num_handlers) {
+  MessagePipe ping_pong_pipe;
+  std::vector<MessagePipe> idle_pipes(num_handlers - 1u);
+  IdleRunLoopHandler idle_handler;
+  PingPongRunLoopHandler ping_pong_handler(ping_pong_pipe.handle0.get(),
+                                           ping_pong_pipe.handle1.get());
+
+  MojoTimeTicks start_time = 0;
+  MojoTimeTicks end_time = 0;
+  {
+    RunLoop run_loop;
+    for (uint32_t i = 0u; i < num_handlers - 1u; i++) {
+      MojoDeadline deadline =
+          (i % 2u) ? MOJO_DEADLINE_INDEFINITE
+                   : static_cast<MojoDeadline>(kFarOffMicroseconds + i);
+      run_loop.AddHandler(&idle_handler, idle_pipes[i].handle0.get(),
+                          MOJO_HANDLE_SIGNAL_READABLE, deadline);
+      if (i % 2u == 0u) {
+        run_loop.PostDelayedTask([]() { ADD_FAILURE(); },
+                                 kFarOffMicroseconds + i);
+      }
+    }
+    run_loop.AddWatch(&ping_pong_handler, ping_pong_pipe.handle0.get(),
+                      MOJO_HANDLE_SIGNAL_READABLE);
+    EXPECT_TRUE(test::WriteTextMessage(ping_pong_pipe.handle1.get(), "hello"));
+
+    run_loop.PostDelayedTask([]() { RunLoop::current()->Quit(); },
+                             kPerftestTimeMicroseconds);
+    start_time = GetTimeTicksNow();
+    run_loop.Run();
+    end_time = GetTimeTicksNow();
+  }
+
+  double result = static_cast<double>(ping_pong_handler.count()) /
+                  (static_cast<double>(end_time - start_time) / 1000000.0);
+  char sub_test_name[100] = {};
+  sprintf(sub_test_name, "%u", static_cast<unsigned>(num_handlers));
+  test::LogPerfResult("RunLoopPerftest.Iteration", sub_test_name, result,
+                      "iterations/second");
+}
+
+TEST(RunLoopPerftest, Iteration) {
+  DoRunLoopIterationPerfTest(10u);
+  DoRunLoopIterationPerfTest(1000u);
+  DoRunLoopIterationPerfTest(100000u);
+}
+
+// Runs |post_task| repeatedly on a separate thread (with tasks that should run
+// on |run_loop|'s thread, with a bounded number outstanding), and reports the
+// number of tasks run per second.
+void DoCrossThreadTaskPerfTest(
+    const char* sub_test_name,
+    RunLoop* run_loop,
+    std::function<void(const std::function<void()>&)> post_task) {
+  constexpr unsigned kMaxOutstandingTasks = 1000u;
+
+  std::atomic<bool> done(false);
+  std::atomic<unsigned> outstanding(0u);
+  uint64_t count = 0u;
+  const std::function<void()> task = [&outstanding, &count]() {
+    outstanding.fetch_sub(1u);
+    count++;
+  };
+
+  std::thread poster_thread([&post_task, &done, &outstanding, &task]() {
+    while (!done.load()) {
+      if (outstanding.load() >= kMaxOutstandingTasks) {
+        std::this_thread::yield();
+        continue;
+      }
+      outstanding.fetch_add(1u);
+      post_task(task);
+    }
+  });
+
+  run_loop->PostDelayedTask([]() { RunLoop::current()->Quit(); },
+                            kPerftestTimeMicroseconds);
+  MojoTimeTicks start_time = GetTimeTicksNow();
+  run_loop->Run();
+  MojoTimeTicks end_time = GetTimeTicksNow();
+  done.store(true);
+  poster_thread.join();
+
+  double result = static_cast<double>(count) /
+                  (static_cast<double>(end_time - start_time) / 1000000.0);
+  test::LogPerfResult("RunLoopPerftest.CrossThreadTask", sub_test_name, result,
+                      "tasks/second");
+}
+
+TEST(RunLoopPerftest, CrossThreadPostTask) {
+  RunLoop run_loop;
+  DoCrossThreadTaskPerfTest("PostTask", &run_loop,
+                            [&run_loop](const std::function<void()>& task) {
+                              run_loop.PostTask(task);
+                            });
+}
+
+// Runs tasks (given as a heap-allocated |std::function| whose address is the
+// message contents) read from a message pipe. This is the usual way of getting
+// work to a run loop's thread without |RunLoop::PostTask()|.
+class TrampolineRunLoopHandler : public RunLoopHandler {
+ public:
+  explicit TrampolineRunLoopHandler(MessagePipeHandle handle)
+      : handle_(handle) {}
+  ~TrampolineRunLoopHandler() override {}
+
+  // Reads and deletes tasks without running them.
+  void DiscardTasks() { ReadTasks(false); }
+
+  // RunLoopHandler:
+  void OnHandleReady(Id id) override { ReadTasks(true); }
+  void OnHandleError(Id id, MojoResult result) override {
+    EXPECT_EQ(MOJO_RESULT_ABORTED, result);
+  }
+
+ private:
+  void ReadTasks(bool run) {
+    for (;;) {
+      std::function<void()>* task = nullptr;
+      uint32_t num_bytes = static_cast<uint32_t>(sizeof(task));
+      MojoResult result = ReadMessageRaw(handle_, &task, &num_bytes, nullptr,
+                                         nullptr, MOJO_READ_MESSAGE_FLAG_NONE);
+      if (result == MOJO_RESULT_SHOULD_WAIT)
+        return;
+      ASSERT_EQ(MOJO_RESULT_OK, result);
+      ASSERT_EQ(sizeof(task), num_bytes);
+      if (run)
+        (*task)();
+      delete task;
+    }
+  }
+
+  const MessagePipeHandle handle_;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(TrampolineRunLoopHandler);
+};
+
+TEST(RunLoopPerftest, CrossThreadMessagePipeTrampoline) {
+  MessagePipe trampoline_pipe;
+  TrampolineRunLoopHandler trampoline_handler(trampoline_pipe.handle0.get());
+  RunLoop run_loop;
+  run_loop.AddWatch(&trampoline_handler, trampoline_pipe.handle0.get(),
+                    MOJO_HANDLE_SIGNAL_READABLE);
+
+  MessagePipeHandle write_handle = trampoline_pipe.handle1.get();
+  DoCrossThreadTaskPerfTest(
+      "MessagePipeTrampoline", &run_loop,
+      [write_handle](const std::function<void()>& task) {
+        std::function<void()>* task_copy = new std::function<void()>(task);
+        MojoResult result =
+            WriteMessageRaw(write_handle, &task_copy,
+                            static_cast<uint32_t>(sizeof(task_copy)), nullptr,
+                            0u, MOJO_WRITE_MESSAGE_FLAG_NONE);
+        EXPECT_EQ(MOJO_RESULT_OK, result);
+      });
+
+  // Clean up any tasks that weren't run.
+  trampoline_handler.DiscardTasks();
+}
+
+}  // namespace
+}  // namespace mojo
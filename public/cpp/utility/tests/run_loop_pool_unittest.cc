@@ -0,0 +1,125 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "mojo/public/cpp/utility/run_loop_pool.h"
+
+#include <stddef.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "mojo/public/cpp/utility/run_loop.h"
+#include "third_party/gtest/include/gtest/gtest.h"
+
+namespace mojo {
+namespace {
+
+// Posts |task| to each of |pool|'s threads and waits for all of them to run.
+void RunOnEachThreadAndWait(RunLoopPool* pool,
+                            const std::function<void(size_t)>& task) {
+  std::mutex mutex;
+  std::condition_variable done_cv;
+  size_t num_done = 0u;
+  for (size_t i = 0u; i < pool->num_threads(); i++) {
+    pool->PostTask(i, [i, &task, &mutex, &done_cv, &num_done]() {
+      task(i);
+      std::lock_guard<std::mutex> lock(mutex);
+      num_done++;
+      done_cv.notify_one();
+    });
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  done_cv.wait(lock, [pool, &num_done]() {
+    return num_done == pool->num_threads();
+  });
+}
+
+TEST(RunLoopPoolTest, TasksRunOnOwnThreads) {
+  constexpr size_t kNumThreads = 4u;
+  RunLoopPool pool(kNumThreads);
+  EXPECT_EQ(kNumThreads, pool.num_threads());
+  for (size_t i = 0u; i < kNumThreads; i++)
+    EXPECT_FALSE(pool.IsOnThread(i));
+
+  std::vector<std::thread::id> thread_ids(kNumThreads);
+  std::vector<RunLoop*> run_loops(kNumThreads);
+  RunOnEachThreadAndWait(&pool, [&pool, &thread_ids, &run_loops](size_t i) {
+    EXPECT_TRUE(pool.IsOnThread(i));
+    thread_ids[i] = std::this_thread::get_id();
+    run_loops[i] = RunLoop::current();
+  });
+
+  std::set<std::thread::id> distinct_thread_ids(thread_ids.begin(),
+                                                thread_ids.end());
+  EXPECT_EQ(kNumThreads, distinct_thread_ids.size());
+  EXPECT_EQ(0u, distinct_thread_ids.count(std::this_thread::get_id()));
+  std::set<RunLoop*> distinct_run_loops(run_loops.begin(), run_loops.end());
+  EXPECT_EQ(kNumThreads, distinct_run_loops.size());
+  EXPECT_EQ(0u, distinct_run_loops.count(nullptr));
+
+  // Tasks posted to a thread run in order, and on that thread.
+  constexpr int kNumTasks = 1000;
+  std::atomic<int> next_value(0);
+  for (int i = 0; i < kNumTasks; i++) {
+    pool.PostTask(1u, [i, &pool, &next_value]() {
+      EXPECT_TRUE(pool.IsOnThread(1u));
+      EXPECT_EQ(i, next_value.load());
+      next_value.store(i + 1);
+    });
+  }
+  RunOnEachThreadAndWait(&pool, [](size_t i) {});
+  EXPECT_EQ(kNumTasks, next_value.load());
+}
+
+// Tasks already posted when the pool is destroyed are run.
+TEST(RunLoopPoolTest, PendingTasksRunOnDestruction) {
+  std::atomic<int> count(0);
+  {
+    RunLoopPool pool(2u);
+    for (int i = 0; i < 100; i++)
+      pool.PostTask(i % 2, [&count]() { count.fetch_add(1); });
+  }
+  EXPECT_EQ(100, count.load());
+}
+
+TEST(RunLoopPoolTest, RoundRobin) {
+  RunLoopPool pool(3u);
+  for (size_t i = 0u; i < 7u; i++)
+    EXPECT_EQ(i % 3u, pool.AcquireThread(RunLoopPool::Policy::ROUND_ROBIN));
+  EXPECT_EQ(3u, pool.GetThreadLoad(0u));
+  EXPECT_EQ(2u, pool.GetThreadLoad(1u));
+  EXPECT_EQ(2u, pool.GetThreadLoad(2u));
+
+  pool.ReleaseThread(0u);
+  EXPECT_EQ(2u, pool.GetThreadLoad(0u));
+  // Round-robin ignores load.
+  EXPECT_EQ(1u, pool.AcquireThread(RunLoopPool::Policy::ROUND_ROBIN));
+}
+
+TEST(RunLoopPoolTest, LeastLoaded) {
+  RunLoopPool pool(3u);
+  for (size_t i = 0u; i < 6u; i++)
+    EXPECT_EQ(i % 3u, pool.AcquireThread(RunLoopPool::Policy::LEAST_LOADED));
+  for (size_t i = 0u; i < 3u; i++)
+    EXPECT_EQ(2u, pool.GetThreadLoad(i));
+
+  pool.ReleaseThread(2u);
+  pool.ReleaseThread(2u);
+  pool.ReleaseThread(1u);
+  EXPECT_EQ(2u, pool.AcquireThread(RunLoopPool::Policy::LEAST_LOADED));
+  // Ties go to the lowest index.
+  EXPECT_EQ(1u, pool.AcquireThread(RunLoopPool::Policy::LEAST_LOADED));
+  EXPECT_EQ(2u, pool.AcquireThread(RunLoopPool::Policy::LEAST_LOADED));
+  EXPECT_EQ(0u, pool.AcquireThread(RunLoopPool::Policy::LEAST_LOADED));
+  EXPECT_EQ(3u, pool.GetThreadLoad(0u));
+  EXPECT_EQ(2u, pool.GetThreadLoad(1u));
+  EXPECT_EQ(2u, pool.GetThreadLoad(2u));
+}
+
+}  // namespace
+}  // namespace mojo
@@ -5,9 +5,12 @@
 #include "mojo/public/cpp/utility/run_loop.h"
 
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "mojo/public/cpp/system/macros.h"
 #include "mojo/public/cpp/system/message_pipe.h"
+#include "mojo/public/cpp/system/time.h"
 #include "mojo/public/cpp/test_support/test_utils.h"
 #include "mojo/public/cpp/utility/run_loop_handler.h"
 #include "third_party/gtest/include/gtest/gtest.h"
@@ -62,10 +65,10 @@ class TestRunLoopHandler : public RunLoopHandler {
   MOJO_DISALLOW_COPY_AND_ASSIGN(TestRunLoopHandler);
 };
 
-// Trivial test to verify Run() with no added handles returns.
+// Trivial test to verify RunUntilIdle() with no added handles returns.
 TEST(RunLoopTest, ExitsWithNoHandles) {
   RunLoop run_loop;
-  run_loop.Run();
+  run_loop.RunUntilIdle();
 }
 
 class RemoveOnReadyRunLoopHandler : public TestRunLoopHandler {
@@ -87,7 +90,8 @@ class RemoveOnReadyRunLoopHandler : public TestRunLoopHandler {
   MOJO_DISALLOW_COPY_AND_ASSIGN(RemoveOnReadyRunLoopHandler);
 };
 
-// Verifies RunLoop quits when no more handles (handle is removed when ready).
+// Verifies RunLoop goes idle when no more handles (handle is removed when
+// ready).
 TEST(RunLoopTest, HandleReady) {
   RemoveOnReadyRunLoopHandler handler;
   MessagePipe test_pipe;
@@ -99,7 +103,7 @@ TEST(RunLoopTest, HandleReady) {
                                 MOJO_HANDLE_SIGNAL_READABLE,
                                 MOJO_DEADLINE_INDEFINITE);
   handler.set_expected_handler_id(id);
-  run_loop.Run();
+  run_loop.RunUntilIdle();
   EXPECT_EQ(1, handler.ready_count());
   EXPECT_EQ(0, handler.error_count());
   EXPECT_EQ(0u, run_loop.num_handlers());
@@ -189,6 +193,64 @@ TEST(RunLoopTest, QuitWhenDeadlineExpired) {
   EXPECT_EQ(0u, run_loop.num_handlers());
 }
 
+class RemoveAfterReadyCountRunLoopHandler : public TestRunLoopHandler {
+ public:
+  explicit RemoveAfterReadyCountRunLoopHandler(int max_ready_count)
+      : max_ready_count_(max_ready_count) {}
+  ~RemoveAfterReadyCountRunLoopHandler() override {}
+
+  void set_run_loop(RunLoop* run_loop) { run_loop_ = run_loop; }
+
+  // RunLoopHandler:
+  void OnHandleReady(Id id) override {
+    TestRunLoopHandler::OnHandleReady(id);
+    if (ready_count() >= max_ready_count_)
+      run_loop_->RemoveHandler(id);
+  }
+
+ private:
+  const int max_ready_count_;
+  RunLoop* run_loop_ = nullptr;
+
+  MOJO_DISALLOW_COPY_AND_ASSIGN(RemoveAfterReadyCountRunLoopHandler);
+};
+
+// Verifies that a watch stays registered (and keeps being notified while its
+// handle is ready) until it is removed.
+TEST(RunLoopTest, WatchHandleReady) {
+  RemoveAfterReadyCountRunLoopHandler handler(3);
+  MessagePipe test_pipe;
+  EXPECT_TRUE(test::WriteTextMessage(test_pipe.handle1.get(), std::string()));
+
+  RunLoop run_loop;
+  handler.set_run_loop(&run_loop);
+  run_loop.AddWatch(&handler, test_pipe.handle0.get(),
+                    MOJO_HANDLE_SIGNAL_READABLE);
+  EXPECT_EQ(1u, run_loop.num_handlers());
+  run_loop.RunUntilIdle();
+  EXPECT_EQ(3, handler.ready_count());
+  EXPECT_EQ(0, handler.error_count());
+  EXPECT_EQ(0u, run_loop.num_handlers());
+}
+
+// Verifies that a watch is unregistered when its handle can no longer satisfy
+// the watched signals.
+TEST(RunLoopTest, WatchHandleError) {
+  TestRunLoopHandler handler;
+  MessagePipe test_pipe;
+  test_pipe.handle1.reset();
+
+  RunLoop run_loop;
+  auto id = run_loop.AddWatch(&handler, test_pipe.handle0.get(),
+                              MOJO_HANDLE_SIGNAL_READABLE);
+  handler.set_expected_handler_id(id);
+  run_loop.RunUntilIdle();
+  EXPECT_EQ(0, handler.ready_count());
+  EXPECT_EQ(1, handler.error_count());
+  EXPECT_EQ(MOJO_RESULT_FAILED_PRECONDITION, handler.last_error_result());
+  EXPECT_EQ(0u, run_loop.num_handlers());
+}
+
 // Test that handlers are notified of loop destruction.
 TEST(RunLoopTest, Destruction) {
   TestRunLoopHandler handler;
@@ -326,10 +388,11 @@ class NestingRunLoopHandler : public TestRunLoopHandler {
     if (current_depth < kDepthLimit) {
       AddHandlerAndWriteSignal();
       run_loop_->Run();
-      // The innermost loop stops running due to Quit() being called; the outer
-      // loops stop running due to having no more handlers. No errors/timeouts
-      // should ever occur.
+      // The innermost loop stops running due to Quit() being called; each
+      // outer loop is then told to quit in turn. No errors/timeouts should ever
+      // occur.
       EXPECT_EQ(error_count(), 0);
+      run_loop_->Quit();
     } else {
       EXPECT_EQ(current_depth, kDepthLimit);
       reached_depth_limit_ = true;
@@ -431,5 +494,72 @@ TEST(RunLoopTest, QuitFromDelayedTask) {
   run_loop.Run();
 }
 
+// Verifies that |Run()| waits for delayed tasks even without any handlers.
+TEST(RunLoopTest, DelayedTaskWithNoHandles) {
+  RunLoop run_loop;
+  MojoTimeTicks start_time = GetTimeTicksNow();
+  run_loop.PostDelayedTask(Closure(QuittingTask(&run_loop)), 10000);
+  run_loop.Run();
+  EXPECT_GE(GetTimeTicksNow() - start_time, 10000);
+}
+
+TEST(RunLoopTest, PostTask) {
+  std::vector<int> sequence;
+  RunLoop run_loop;
+  run_loop.PostTask([&sequence]() { sequence.push_back(1); });
+  run_loop.PostDelayedTask(Closure(Task(2, &sequence)), 0);
+  run_loop.PostTask([&sequence, &run_loop]() {
+    sequence.push_back(3);
+    // Tasks posted from tasks are run too (in order).
+    run_loop.PostTask([&sequence]() { sequence.push_back(5); });
+  });
+  run_loop.PostTask([&sequence]() { sequence.push_back(4); });
+  run_loop.RunUntilIdle();
+
+  // Delayed tasks that are ready are run before posted tasks.
+  ASSERT_EQ(5u, sequence.size());
+  EXPECT_EQ(2, sequence[0]);
+  EXPECT_EQ(1, sequence[1]);
+  EXPECT_EQ(3, sequence[2]);
+  EXPECT_EQ(4, sequence[3]);
+  EXPECT_EQ(5, sequence[4]);
+
+  // Tasks that are never run are destroyed with the run loop.
+  run_loop.PostTask([]() { ADD_FAILURE(); });
+}
+
+// Tests that |PostTask()| can be called from other threads, and that posted
+// tasks wake up a waiting run loop.
+TEST(RunLoopTest, PostTaskFromOtherThreads) {
+  constexpr unsigned kNumThreads = 4u;
+  constexpr unsigned kNumTasksPerThread = 1000u;
+
+  // Note: |Run()| waits for posted tasks even without any handlers.
+  RunLoop run_loop;
+
+  unsigned count = 0u;
+  std::vector<unsigned> last_task_per_thread(kNumThreads, 0u);
+  std::vector<std::thread> threads;
+  for (unsigned i = 0u; i < kNumThreads; i++) {
+    threads.push_back(std::thread([i, &run_loop, &count,
+                                   &last_task_per_thread]() {
+      for (unsigned j = 1u; j <= kNumTasksPerThread; j++) {
+        run_loop.PostTask([i, j, &run_loop, &count, &last_task_per_thread]() {
+          // Tasks from each thread should be run in order.
+          EXPECT_EQ(j - 1u, last_task_per_thread[i]);
+          last_task_per_thread[i] = j;
+          if (++count == kNumThreads * kNumTasksPerThread)
+            run_loop.Quit();
+        });
+      }
+    }));
+  }
+
+  run_loop.Run();
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(kNumThreads * kNumTasksPerThread, count);
+}
+
 }  // namespace
 }  // namespace mojo
@@ -0,0 +1,151 @@
+// Copyright 2016 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "mojo/public/cpp/utility/lib/timer_wheel.h"
+
+#include <stdint.h>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "third_party/gtest/include/gtest/gtest.h"
+
+namespace mojo {
+namespace {
+
+using TestTimerWheel = internal::TimerWheel<int>;
+
+constexpr MojoTimeTicks kTick = TestTimerWheel::kTickMicroseconds;
+
+// Arbitrary "current" time, far from zero (like real time ticks).
+constexpr MojoTimeTicks kStartTime = 123456789012;
+
+TEST(TimerWheelTest, Basic) {
+  TestTimerWheel wheel;
+  EXPECT_TRUE(wheel.empty());
+  EXPECT_EQ(0, wheel.GetNextExpiryTime());
+
+  wheel.Add(kStartTime + 10 * kTick, 1);
+  wheel.Add(kStartTime + 5, 2);
+  wheel.Add(kStartTime + 100000 * kTick, 3);
+  EXPECT_EQ(3u, wheel.size());
+  EXPECT_EQ(kStartTime + 5, wheel.GetNextExpiryTime());
+
+  std::vector<int> expired;
+  wheel.Expire(kStartTime, &expired);
+  EXPECT_TRUE(expired.empty());
+
+  wheel.Expire(kStartTime + 5, &expired);
+  ASSERT_EQ(1u, expired.size());
+  EXPECT_EQ(2, expired[0]);
+  EXPECT_EQ(kStartTime + 10 * kTick, wheel.GetNextExpiryTime());
+
+  expired.clear();
+  wheel.Expire(kStartTime + 10 * kTick - 1, &expired);
+  EXPECT_TRUE(expired.empty());
+  wheel.Expire(kStartTime + 10 * kTick, &expired);
+  ASSERT_EQ(1u, expired.size());
+  EXPECT_EQ(1, expired[0]);
+  EXPECT_EQ(kStartTime + 100000 * kTick, wheel.GetNextExpiryTime());
+
+  expired.clear();
+  wheel.Expire(kStartTime + 200000 * kTick, &expired);
+  ASSERT_EQ(1u, expired.size());
+  EXPECT_EQ(3, expired[0]);
+  EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, SameTimeInAddOrder) {
+  TestTimerWheel wheel;
+  for (int i = 0; i < 10; i++)
+    wheel.Add(kStartTime + (i % 2) * 1000 * kTick, i);
+
+  std::vector<int> expired;
+  wheel.Expire(kStartTime + 1000 * kTick, &expired);
+  ASSERT_EQ(10u, expired.size());
+  for (int i = 0; i < 5; i++) {
+    EXPECT_EQ(2 * i, expired[i]);
+    EXPECT_EQ(2 * i + 1, expired[5 + i]);
+  }
+}
+
+TEST(TimerWheelTest, Cancel) {
+  TestTimerWheel wheel;
+  auto id1 = wheel.Add(kStartTime + kTick, 1);
+  wheel.Add(kStartTime + 2 * kTick, 2);
+  auto id3 = wheel.Add(kStartTime + 3 * kTick, 3);
+  EXPECT_EQ(kStartTime + kTick, wheel.GetNextExpiryTime());
+  // Cancelling the earliest timer changes the next expiry time.
+  wheel.Cancel(id1);
+  EXPECT_EQ(kStartTime + 2 * kTick, wheel.GetNextExpiryTime());
+  wheel.Cancel(id3);
+  EXPECT_EQ(1u, wheel.size());
+  EXPECT_EQ(kStartTime + 2 * kTick, wheel.GetNextExpiryTime());
+
+  std::vector<int> expired;
+  wheel.Expire(kStartTime + 10 * kTick, &expired);
+  ASSERT_EQ(1u, expired.size());
+  EXPECT_EQ(2, expired[0]);
+}
+
+// Compares the wheel against a simple reference implementation, for timers
+// spread over many levels (and beyond the range of the top level).
+TEST(TimerWheelTest, MatchesReference) {
+  using Key = std::pair<MojoTimeTicks, int>;
+  using Value = std::pair<int, TestTimerWheel::TimerId>;
+
+  TestTimerWheel wheel;
+  // Maps (time, add order) to (value, timer ID).
+  std::map<Key, Value> reference;
+
+  uint64_t random_state = 12345u;
+  auto random = [&random_state]() {
+    random_state = random_state * 6364136223846793005u + 1442695040888963407u;
+    return static_cast<uint32_t>(random_state >> 33);
+  };
+
+  MojoTimeTicks now = kStartTime;
+  int next_value = 0;
+  for (int iteration = 0; iteration < 2000; iteration++) {
+    // Add some timers, with delays of widely varying magnitudes.
+    for (int i = 0; i < 5; i++) {
+      uint32_t shift = random() % 50u;
+      MojoTimeTicks delay =
+          static_cast<MojoTimeTicks>((uint64_t{random()} << 20 | random()) >>
+                                     (52u - shift));
+      MojoTimeTicks time = now + delay - 10;
+      int value = next_value++;
+      reference[std::make_pair(time, value)] =
+          std::make_pair(value, wheel.Add(time, value));
+    }
+
+    // Cancel a timer now and then (sometimes the earliest one).
+    if (random() % 3u == 0u && !reference.empty()) {
+      auto it = reference.begin();
+      if (random() % 4u)
+        std::advance(it, random() % reference.size());
+      wheel.Cancel(it->second.second);
+      reference.erase(it);
+    }
+
+    ASSERT_EQ(reference.size(), wheel.size());
+    ASSERT_EQ(reference.empty() ? 0 : reference.begin()->first.first,
+              wheel.GetNextExpiryTime());
+
+    // Advance time, sometimes by a lot.
+    now += static_cast<MojoTimeTicks>(random() % 3000u) << (random() % 16u);
+    std::vector<int> expired;
+    wheel.Expire(now, &expired);
+    std::vector<int> expected;
+    while (!reference.empty() && reference.begin()->first.first <= now) {
+      expected.push_back(reference.begin()->second.first);
+      reference.erase(reference.begin());
+    }
+    ASSERT_EQ(expected, expired);
+  }
+}
+
+}  // namespace
+}  // namespace mojo
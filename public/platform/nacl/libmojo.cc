@@ -11,6 +11,7 @@
 #include <mojo/system/wait.h>
 #include <mojo/system/wait_set.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "mojo/public/platform/nacl/mojo_irt.h"
 #include "native_client/src/untrusted/irt/irt.h"
@@ -133,6 +134,46 @@ MojoResult MojoWriteMessage(MojoHandle message_pipe_handle,
                                     handles, num_handles, flags);
 }
 
+// The IRT interface has no vectored write, so gather the segments and write
+// them as a single buffer.
+MojoResult MojoWriteMessageV(MojoHandle message_pipe_handle,
+                             const struct MojoMessageSegment* segments,
+                             uint32_t num_segments,
+                             const MojoHandle* handles,
+                             uint32_t num_handles,
+                             MojoWriteMessageFlags flags) {
+  if (num_segments && !segments)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+
+  uint32_t num_bytes = 0u;
+  for (uint32_t i = 0u; i < num_segments; i++) {
+    if (segments[i].num_bytes && !segments[i].bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    if (segments[i].num_bytes > UINT32_MAX - num_bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    num_bytes += segments[i].num_bytes;
+  }
+
+  char* buffer = nullptr;
+  if (num_bytes) {
+    buffer = static_cast<char*>(malloc(num_bytes));
+    if (!buffer)
+      return MOJO_RESULT_RESOURCE_EXHAUSTED;
+    char* cursor = buffer;
+    for (uint32_t i = 0u; i < num_segments; i++) {
+      if (segments[i].num_bytes) {
+        memcpy(cursor, segments[i].bytes, segments[i].num_bytes);
+        cursor += segments[i].num_bytes;
+      }
+    }
+  }
+
+  MojoResult result = MojoWriteMessage(message_pipe_handle, buffer, num_bytes,
+                                       handles, num_handles, flags);
+  free(buffer);
+  return result;
+}
+
 MojoResult MojoReadMessage(MojoHandle message_pipe_handle,
                            void* bytes,
                            uint32_t* num_bytes,
@@ -188,6 +229,46 @@ MojoResult MojoWriteData(MojoHandle data_pipe_producer_handle,
                                  flags);
 }
 
+// The IRT interface has no vectored data pipe I/O either, so gather the
+// segments and write them as a single buffer.
+MojoResult MojoWriteDataV(MojoHandle data_pipe_producer_handle,
+                          const struct MojoWriteDataSegment* segments,
+                          uint32_t num_segments,
+                          uint32_t* num_bytes,
+                          MojoWriteDataFlags flags) {
+  if (num_segments && !segments)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+
+  uint32_t total_num_bytes = 0u;
+  for (uint32_t i = 0u; i < num_segments; i++) {
+    if (segments[i].num_bytes && !segments[i].bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    if (segments[i].num_bytes > UINT32_MAX - total_num_bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    total_num_bytes += segments[i].num_bytes;
+  }
+
+  char* buffer = nullptr;
+  if (total_num_bytes) {
+    buffer = static_cast<char*>(malloc(total_num_bytes));
+    if (!buffer)
+      return MOJO_RESULT_RESOURCE_EXHAUSTED;
+    char* cursor = buffer;
+    for (uint32_t i = 0u; i < num_segments; i++) {
+      if (segments[i].num_bytes) {
+        memcpy(cursor, segments[i].bytes, segments[i].num_bytes);
+        cursor += segments[i].num_bytes;
+      }
+    }
+  }
+
+  *num_bytes = total_num_bytes;
+  MojoResult result =
+      MojoWriteData(data_pipe_producer_handle, buffer, num_bytes, flags);
+  free(buffer);
+  return result;
+}
+
 MojoResult MojoBeginWriteData(MojoHandle data_pipe_producer_handle,
                               void** buffer,
                               uint32_t* buffer_num_bytes,
@@ -240,6 +321,54 @@ MojoResult MojoReadData(MojoHandle data_pipe_consumer_handle,
                                 flags);
 }
 
+// Similarly, read into a single buffer and then scatter the data.
+MojoResult MojoReadDataV(MojoHandle data_pipe_consumer_handle,
+                         const struct MojoReadDataSegment* segments,
+                         uint32_t num_segments,
+                         uint32_t* num_bytes,
+                         MojoReadDataFlags flags) {
+  if (flags & (MOJO_READ_DATA_FLAG_DISCARD | MOJO_READ_DATA_FLAG_QUERY))
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  if (num_segments && !segments)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+
+  uint32_t total_num_bytes = 0u;
+  for (uint32_t i = 0u; i < num_segments; i++) {
+    if (segments[i].num_bytes && !segments[i].bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    if (segments[i].num_bytes > UINT32_MAX - total_num_bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    total_num_bytes += segments[i].num_bytes;
+  }
+
+  char* buffer = nullptr;
+  if (total_num_bytes) {
+    buffer = static_cast<char*>(malloc(total_num_bytes));
+    if (!buffer)
+      return MOJO_RESULT_RESOURCE_EXHAUSTED;
+  }
+
+  *num_bytes = total_num_bytes;
+  MojoResult result =
+      MojoReadData(data_pipe_consumer_handle, buffer, num_bytes, flags);
+  if (result == MOJO_RESULT_OK) {
+    const char* cursor = buffer;
+    uint32_t num_bytes_left = *num_bytes;
+    for (uint32_t i = 0u; i < num_segments && num_bytes_left; i++) {
+      uint32_t n = segments[i].num_bytes < num_bytes_left
+                       ? segments[i].num_bytes
+                       : num_bytes_left;
+      if (n) {
+        memcpy(segments[i].bytes, cursor, n);
+        cursor += n;
+        num_bytes_left -= n;
+      }
+    }
+  }
+  free(buffer);
+  return result;
+}
+
 MojoResult MojoBeginReadData(MojoHandle data_pipe_consumer_handle,
                              const void** buffer,
                              uint32_t* buffer_num_bytes,
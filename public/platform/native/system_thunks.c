@@ -87,6 +87,17 @@ MojoResult MojoWriteMessage(MojoHandle message_pipe_handle,
                                num_handles, flags);
 }
 
+MojoResult MojoWriteMessageV(MojoHandle message_pipe_handle,
+                             const struct MojoMessageSegment* segments,
+                             uint32_t num_segments,
+                             const MojoHandle* handles,
+                             uint32_t num_handles,
+                             MojoWriteMessageFlags flags) {
+  assert(g_thunks.WriteMessageV);
+  return g_thunks.WriteMessageV(message_pipe_handle, segments, num_segments,
+                                handles, num_handles, flags);
+}
+
 MojoResult MojoReadMessage(MojoHandle message_pipe_handle,
                            void* bytes,
                            uint32_t* num_bytes,
@@ -132,6 +143,16 @@ MojoResult MojoWriteData(MojoHandle data_pipe_producer_handle,
                             flags);
 }
 
+MojoResult MojoWriteDataV(MojoHandle data_pipe_producer_handle,
+                          const struct MojoWriteDataSegment* segments,
+                          uint32_t num_segments,
+                          uint32_t* num_bytes,
+                          MojoWriteDataFlags flags) {
+  assert(g_thunks.WriteDataV);
+  return g_thunks.WriteDataV(data_pipe_producer_handle, segments, num_segments,
+                             num_bytes, flags);
+}
+
 MojoResult MojoBeginWriteData(MojoHandle data_pipe_producer_handle,
                               void** buffer,
                               uint32_t* buffer_num_elements,
@@ -173,6 +194,16 @@ MojoResult MojoReadData(MojoHandle data_pipe_consumer_handle,
                            flags);
 }
 
+MojoResult MojoReadDataV(MojoHandle data_pipe_consumer_handle,
+                         const struct MojoReadDataSegment* segments,
+                         uint32_t num_segments,
+                         uint32_t* num_bytes,
+                         MojoReadDataFlags flags) {
+  assert(g_thunks.ReadDataV);
+  return g_thunks.ReadDataV(data_pipe_consumer_handle, segments, num_segments,
+                            num_bytes, flags);
+}
+
 MojoResult MojoBeginReadData(MojoHandle data_pipe_consumer_handle,
                              const void** buffer,
                              uint32_t* buffer_num_elements,
@@ -149,6 +149,22 @@ struct MojoSystemThunks {
                             uint32_t* num_results,
                             struct MojoWaitSetResult* results,
                             uint32_t* max_results);
+  MojoResult (*WriteMessageV)(MojoHandle message_pipe_handle,
+                              const struct MojoMessageSegment* segments,
+                              uint32_t num_segments,
+                              const MojoHandle* handles,
+                              uint32_t num_handles,
+                              MojoWriteMessageFlags flags);
+  MojoResult (*WriteDataV)(MojoHandle data_pipe_producer_handle,
+                           const struct MojoWriteDataSegment* segments,
+                           uint32_t num_segments,
+                           uint32_t* num_bytes,
+                           MojoWriteDataFlags flags);
+  MojoResult (*ReadDataV)(MojoHandle data_pipe_consumer_handle,
+                          const struct MojoReadDataSegment* segments,
+                          uint32_t num_segments,
+                          uint32_t* num_bytes,
+                          MojoReadDataFlags flags);
 };
 #pragma pack(pop)
 
@@ -189,6 +205,9 @@ inline MojoSystemThunks MojoMakeSystemThunks() {
       MojoWaitSetAdd,
       MojoWaitSetRemove,
       MojoWaitSetWait,
+      MojoWriteMessageV,
+      MojoWriteDataV,
+      MojoReadDataV,
   };
   return system_thunks;
 }
@@ -257,6 +257,41 @@ def GetUnionGetterReturnType(kind):
     return "%s&" % GetCppWrapperType(kind)
   return GetCppResultWrapperType(kind)
 
+def GetCppDataViewType(kind):
+  if mojom.IsStructKind(kind) or mojom.IsUnionKind(kind):
+    return "%sDataView" % GetNameForKind(kind)
+  if mojom.IsArrayKind(kind):
+    return "mojo::ArrayDataView<%s>" % GetCppDataViewType(kind.kind)
+  if mojom.IsMapKind(kind):
+    return "mojo::MapDataView<%s, %s>" % (GetCppDataViewType(kind.key_kind),
+                                          GetCppDataViewType(kind.value_kind))
+  if mojom.IsStringKind(kind):
+    return "mojo::StringDataView"
+  if mojom.IsEnumKind(kind):
+    return GetNameForKind(kind)
+  return GetCppTypeForKind(kind)
+
+# Data views are read-only, so they don't provide access to handles (or
+# interfaces), which can only be taken out of a message by moving them.
+def HasDataView(kind):
+  if mojom.IsArrayKind(kind):
+    return HasDataView(kind.kind)
+  if mojom.IsMapKind(kind):
+    return HasDataView(kind.key_kind) and HasDataView(kind.value_kind)
+  return not (mojom.IsAnyHandleKind(kind) or mojom.IsInterfaceKind(kind))
+
+# Methods with the [CppDataView=true] attribute are dispatched (by the stub) to
+# a |<Method>WithDataView()| variant, which takes a view of the parameters.
+def UsesDataView(method):
+  if not method.attributes or not method.attributes.get("CppDataView"):
+    return False
+  for parameter in method.parameters:
+    if mojom.ContainsHandles(parameter.kind, set()):
+      raise Exception("Method %s.%s: [CppDataView] is not supported for "
+                      "parameters containing handles or interfaces" %
+                      (method.interface.name, method.name))
+  return True
+
 def TranslateConstants(token, kind):
   if isinstance(token, mojom.NamedValue):
     # Both variable and enum constants are constructed like:
@@ -382,6 +417,7 @@ class Generator(generator.Generator):
   cpp_filters = {
     "constant_value": ConstantValue,
     "cpp_const_wrapper_type": GetCppConstWrapperType,
+    "cpp_data_view_type": GetCppDataViewType,
     "cpp_field_type": GetCppFieldType,
     "cpp_union_field_type": GetCppUnionFieldType,
     "cpp_pod_type": GetCppPodType,
@@ -396,6 +432,7 @@ class Generator(generator.Generator):
     "get_name_for_kind": GetNameForKind,
     "get_pad": pack.GetPad,
     "has_callbacks": mojom.HasCallbacks,
+    "has_data_view": HasDataView,
     "should_inline": ShouldInlineStruct,
     "should_inline_union": ShouldInlineUnion,
     "is_array_kind": mojom.IsArrayKind,
@@ -416,6 +453,7 @@ class Generator(generator.Generator):
     "stylize_method": generator.StudlyCapsToCamel,
     "to_all_caps": generator.CamelCaseToAllCaps,
     "under_to_camel": generator.UnderToCamel,
+    "uses_data_view": UsesDataView,
   }
 
   def GetJinjaExports(self):
@@ -11,6 +11,7 @@
 #include <mojo/system/wait.h>
 #include <mojo/system/wait_set.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 
 // MojoTimeTicks is in microseconds.
@@ -262,7 +263,6 @@ MojoResult MojoWriteMessage(MojoHandle message_pipe_handle,
                             uint32_t num_handles,
                             MojoWriteMessageFlags flags) {
   mx_handle_t* mx_handles = (mx_handle_t*)handles;
-  // TODO(abarth): Handle messages that are too big to fit.
   mx_status_t status =
       mx_message_write((mx_handle_t)message_pipe_handle, bytes, num_bytes,
                        mx_handles, num_handles, flags);
@@ -279,12 +279,62 @@ MojoResult MojoWriteMessage(MojoHandle message_pipe_handle,
     case ERR_NO_MEMORY:
       return MOJO_RESULT_RESOURCE_EXHAUSTED;
     case ERR_TOO_BIG:
-    // TODO(abarth): Handle messages that are too big to fit.
+      // The message exceeds the kernel's size limit. (The C++ bindings then
+      // send the message via a shared buffer; see |mojo::WriteMessage()|.)
+      return MOJO_RESULT_OUT_OF_RANGE;
     default:
       return MOJO_RESULT_UNKNOWN;
   }
 }
 
+// The size of the stack buffer used by |MojoWriteMessageV()| to gather small
+// messages (larger ones are gathered into heap memory).
+#define WRITE_MESSAGE_V_STACK_BUFFER_SIZE 1024u
+
+MojoResult MojoWriteMessageV(MojoHandle message_pipe_handle,
+                             const struct MojoMessageSegment* segments,
+                             uint32_t num_segments,
+                             const MojoHandle* handles,
+                             uint32_t num_handles,
+                             MojoWriteMessageFlags flags) {
+  if (num_segments && !segments)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+
+  uint32_t num_bytes = 0u;
+  for (uint32_t i = 0u; i < num_segments; i++) {
+    if (segments[i].num_bytes && !segments[i].bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    if (segments[i].num_bytes > UINT32_MAX - num_bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    num_bytes += segments[i].num_bytes;
+  }
+
+  // mx_message_write() has no vectored variant, so gather the segments here.
+  // (This is still the only copy of the data made on this side of the pipe.)
+  char stack_buffer[WRITE_MESSAGE_V_STACK_BUFFER_SIZE];
+  char* buffer = stack_buffer;
+  if (num_bytes > sizeof(stack_buffer)) {
+    buffer = (char*)malloc(num_bytes);
+    if (!buffer)
+      return MOJO_RESULT_RESOURCE_EXHAUSTED;
+  }
+
+  char* cursor = buffer;
+  for (uint32_t i = 0u; i < num_segments; i++) {
+    if (segments[i].num_bytes) {
+      memcpy(cursor, segments[i].bytes, segments[i].num_bytes);
+      cursor += segments[i].num_bytes;
+    }
+  }
+
+  MojoResult result =
+      MojoWriteMessage(message_pipe_handle, num_bytes ? buffer : NULL,
+                       num_bytes, handles, num_handles, flags);
+  if (buffer != stack_buffer)
+    free(buffer);
+  return result;
+}
+
 MojoResult MojoReadMessage(MojoHandle message_pipe_handle,
                            void* bytes,
                            uint32_t* num_bytes,
@@ -366,17 +416,89 @@ MojoResult MojoGetDataPipeProducerOptions(
   return MOJO_RESULT_UNIMPLEMENTED;
 }
 
+// Checks the flags given to |MojoWriteData()| or |MojoWriteDataV()|.
+static MojoResult CheckWriteDataFlags(MojoWriteDataFlags flags) {
+  if (flags &
+      ~(MOJO_WRITE_DATA_FLAG_ALL_OR_NONE | MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES))
+    return MOJO_RESULT_UNIMPLEMENTED;
+  // This only applies to two-phase writes.
+  if (flags & MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  return MOJO_RESULT_OK;
+}
+
+// A position in a list of segments, for |MojoWriteDataV()| and
+// |MojoReadDataV()| to copy into or out of them piecemeal.
+struct SegmentCursor {
+  uint32_t index;
+  uint32_t offset;
+};
+
+// Copies |num_bytes| bytes out of the segments, from |*cursor| (advancing it).
+static void GatherWriteDataSegments(const struct MojoWriteDataSegment* segments,
+                                    struct SegmentCursor* cursor,
+                                    char* bytes,
+                                    uint32_t num_bytes) {
+  while (num_bytes) {
+    const struct MojoWriteDataSegment* segment = &segments[cursor->index];
+    uint32_t n = segment->num_bytes - cursor->offset;
+    if (n > num_bytes)
+      n = num_bytes;
+    if (n) {
+      memcpy(bytes, (const char*)segment->bytes + cursor->offset, n);
+      bytes += n;
+      num_bytes -= n;
+      cursor->offset += n;
+    }
+    if (cursor->offset == segment->num_bytes) {
+      cursor->index++;
+      cursor->offset = 0u;
+    }
+  }
+}
+
+// Copies |num_bytes| bytes into the segments, at |*cursor| (advancing it).
+static void ScatterReadDataSegments(const struct MojoReadDataSegment* segments,
+                                    struct SegmentCursor* cursor,
+                                    const char* bytes,
+                                    uint32_t num_bytes) {
+  while (num_bytes) {
+    const struct MojoReadDataSegment* segment = &segments[cursor->index];
+    uint32_t n = segment->num_bytes - cursor->offset;
+    if (n > num_bytes)
+      n = num_bytes;
+    if (n) {
+      memcpy((char*)segment->bytes + cursor->offset, bytes, n);
+      bytes += n;
+      num_bytes -= n;
+      cursor->offset += n;
+    }
+    if (cursor->offset == segment->num_bytes) {
+      cursor->index++;
+      cursor->offset = 0u;
+    }
+  }
+}
+
+// The size of the stack buffer used by |MojoWriteDataV()| and
+// |MojoReadDataV()| when they have to gather or scatter small amounts of data
+// (larger ones use heap memory).
+#define DATA_V_STACK_BUFFER_SIZE 1024u
+
 MojoResult MojoWriteData(MojoHandle data_pipe_producer_handle,
                          const void* elements,
                          uint32_t* num_bytes,
                          MojoWriteDataFlags flags) {
-  if (flags) {
-    // TODO: Support flags
-    return MOJO_RESULT_UNIMPLEMENTED;
-  }
+  if (!num_bytes)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  MojoResult result = CheckWriteDataFlags(flags);
+  if (result != MOJO_RESULT_OK)
+    return result;
+  uint32_t mx_flags = 0u;
+  if (flags & MOJO_WRITE_DATA_FLAG_ALL_OR_NONE)
+    mx_flags |= MX_DATAPIPE_WRITE_FLAG_ALL_OR_NONE;
   mx_ssize_t mx_bytes_written =
-      mx_data_pipe_write((mx_handle_t)data_pipe_producer_handle,
-                         0u,  // TODO: flags
+      mx_data_pipe_write((mx_handle_t)data_pipe_producer_handle, mx_flags,
                          *num_bytes, elements);
   if (mx_bytes_written < 0) {
     switch (mx_bytes_written) {
@@ -389,6 +511,8 @@ MojoResult MojoWriteData(MojoHandle data_pipe_producer_handle,
         return MOJO_RESULT_FAILED_PRECONDITION;
       case ERR_NOT_READY:
         return MOJO_RESULT_SHOULD_WAIT;
+      case ERR_OUT_OF_RANGE:
+        return MOJO_RESULT_OUT_OF_RANGE;
       default:
         return MOJO_RESULT_UNKNOWN;
     }
@@ -397,21 +521,87 @@ MojoResult MojoWriteData(MojoHandle data_pipe_producer_handle,
   return MOJO_RESULT_OK;
 }
 
+MojoResult MojoWriteDataV(MojoHandle data_pipe_producer_handle,
+                          const struct MojoWriteDataSegment* segments,
+                          uint32_t num_segments,
+                          uint32_t* num_bytes,
+                          MojoWriteDataFlags flags) {
+  if (!num_bytes)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  MojoResult result = CheckWriteDataFlags(flags);
+  if (result != MOJO_RESULT_OK)
+    return result;
+  if (num_segments && !segments)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+
+  uint32_t total_num_bytes = 0u;
+  for (uint32_t i = 0u; i < num_segments; i++) {
+    if (segments[i].num_bytes && !segments[i].bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    if (segments[i].num_bytes > UINT32_MAX - total_num_bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    total_num_bytes += segments[i].num_bytes;
+  }
+
+  // mx_data_pipe_write() has no vectored variant, so copy the segments directly
+  // into the data pipe with two-phase writes (two, if the space wraps around).
+  struct SegmentCursor cursor = {0u, 0u};
+  if (total_num_bytes && !(flags & MOJO_WRITE_DATA_FLAG_ALL_OR_NONE)) {
+    uint32_t num_bytes_written = 0u;
+    while (num_bytes_written < total_num_bytes) {
+      void* buffer = NULL;
+      uint32_t buffer_num_bytes = total_num_bytes - num_bytes_written;
+      result = MojoBeginWriteData(data_pipe_producer_handle, &buffer,
+                                  &buffer_num_bytes,
+                                  MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES);
+      if (result != MOJO_RESULT_OK) {
+        if (num_bytes_written)
+          break;
+        return result;
+      }
+      GatherWriteDataSegments(segments, &cursor, (char*)buffer,
+                              buffer_num_bytes);
+      result = MojoEndWriteData(data_pipe_producer_handle, buffer_num_bytes);
+      if (result != MOJO_RESULT_OK)
+        return result;
+      num_bytes_written += buffer_num_bytes;
+    }
+    *num_bytes = num_bytes_written;
+    return MOJO_RESULT_OK;
+  }
+
+  // Otherwise (a two-phase write can't tell whether there's enough space, if it
+  // wraps around), gather the segments and write them as a single buffer.
+  char stack_buffer[DATA_V_STACK_BUFFER_SIZE];
+  char* buffer = stack_buffer;
+  if (total_num_bytes > sizeof(stack_buffer)) {
+    buffer = (char*)malloc(total_num_bytes);
+    if (!buffer)
+      return MOJO_RESULT_RESOURCE_EXHAUSTED;
+  }
+  GatherWriteDataSegments(segments, &cursor, buffer, total_num_bytes);
+  *num_bytes = total_num_bytes;
+  result = MojoWriteData(data_pipe_producer_handle, buffer, num_bytes, flags);
+  if (buffer != stack_buffer)
+    free(buffer);
+  return result;
+}
+
 MojoResult MojoBeginWriteData(MojoHandle data_pipe_producer_handle,
                               void** buffer,
                               uint32_t* buffer_num_bytes,
                               MojoWriteDataFlags flags) {
-  if (flags) {
-    // TODO: Support flags
-    return MOJO_RESULT_UNIMPLEMENTED;
-  }
-  // TODO(abarth): MojoBeginWriteData doesn't have a way to limit the amount of
-  // virtual memory that it will map.
-  // See https://github.com/domokit/mojo/issues/812
+  if (flags & ~MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  // Unless a maximum is given, this maps as much as possible.
   mx_size_t requested = UINTPTR_MAX;
+  if (flags & MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES) {
+    if (!*buffer_num_bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    requested = *buffer_num_bytes;
+  }
   mx_ssize_t result =
-      mx_data_pipe_begin_write((mx_handle_t)data_pipe_producer_handle,
-                               0u,  // TODO: flags
+      mx_data_pipe_begin_write((mx_handle_t)data_pipe_producer_handle, 0u,
                                requested, (uintptr_t*)buffer);
   if (result < 0) {
     switch (result) {
@@ -466,16 +656,54 @@ MojoResult MojoGetDataPipeConsumerOptions(
   return MOJO_RESULT_UNIMPLEMENTED;
 }
 
+// Checks the flags given to |MojoReadData()| or |MojoReadDataV()|.
+static MojoResult CheckReadDataFlags(MojoReadDataFlags flags) {
+  if (flags & ~(MOJO_READ_DATA_FLAG_ALL_OR_NONE | MOJO_READ_DATA_FLAG_DISCARD |
+                MOJO_READ_DATA_FLAG_QUERY | MOJO_READ_DATA_FLAG_PEEK |
+                MOJO_READ_DATA_FLAG_MAX_NUM_BYTES))
+    return MOJO_RESULT_UNIMPLEMENTED;
+  // This only applies to two-phase reads.
+  if (flags & MOJO_READ_DATA_FLAG_MAX_NUM_BYTES)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  if ((flags & MOJO_READ_DATA_FLAG_DISCARD) &&
+      (flags & (MOJO_READ_DATA_FLAG_QUERY | MOJO_READ_DATA_FLAG_PEEK)))
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  if ((flags & MOJO_READ_DATA_FLAG_QUERY) && (flags & MOJO_READ_DATA_FLAG_PEEK))
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  return MOJO_RESULT_OK;
+}
+
 MojoResult MojoReadData(MojoHandle data_pipe_consumer_handle,
                         void* elements,
                         uint32_t* num_bytes,
                         MojoReadDataFlags flags) {
-  if (flags) {
-    // TODO: Support flags
-    return MOJO_RESULT_UNIMPLEMENTED;
+  if (!num_bytes)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  MojoResult result = CheckReadDataFlags(flags);
+  if (result != MOJO_RESULT_OK)
+    return result;
+
+  // The kernel's flags have the same meanings, but aren't assumed to have the
+  // same values.
+  uint32_t mx_flags = 0u;
+  mx_size_t requested = *num_bytes;
+  if (flags & MOJO_READ_DATA_FLAG_QUERY) {
+    // Everything else is ignored.
+    mx_flags = MX_DATAPIPE_READ_FLAG_QUERY;
+    requested = 0u;
+    elements = NULL;
+  } else {
+    if (flags & MOJO_READ_DATA_FLAG_ALL_OR_NONE)
+      mx_flags |= MX_DATAPIPE_READ_FLAG_ALL_OR_NONE;
+    if (flags & MOJO_READ_DATA_FLAG_DISCARD) {
+      mx_flags |= MX_DATAPIPE_READ_FLAG_DISCARD;
+      elements = NULL;
+    }
+    if (flags & MOJO_READ_DATA_FLAG_PEEK)
+      mx_flags |= MX_DATAPIPE_READ_FLAG_PEEK;
   }
   mx_ssize_t bytes_read = mx_data_pipe_read(
-      (mx_handle_t)data_pipe_consumer_handle, 0u, *num_bytes, elements);
+      (mx_handle_t)data_pipe_consumer_handle, mx_flags, requested, elements);
   if (bytes_read < 0) {
     switch (bytes_read) {
       case ERR_INVALID_ARGS:
@@ -487,6 +715,8 @@ MojoResult MojoReadData(MojoHandle data_pipe_consumer_handle,
         return MOJO_RESULT_FAILED_PRECONDITION;
       case ERR_NOT_READY:
         return MOJO_RESULT_SHOULD_WAIT;
+      case ERR_OUT_OF_RANGE:
+        return MOJO_RESULT_OUT_OF_RANGE;
       default:
         return MOJO_RESULT_INTERNAL;
     }
@@ -498,21 +728,91 @@ MojoResult MojoReadData(MojoHandle data_pipe_consumer_handle,
   return MOJO_RESULT_OK;
 }
 
+MojoResult MojoReadDataV(MojoHandle data_pipe_consumer_handle,
+                         const struct MojoReadDataSegment* segments,
+                         uint32_t num_segments,
+                         uint32_t* num_bytes,
+                         MojoReadDataFlags flags) {
+  if (!num_bytes)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  MojoResult result = CheckReadDataFlags(flags);
+  if (result != MOJO_RESULT_OK)
+    return result;
+  if (flags & (MOJO_READ_DATA_FLAG_DISCARD | MOJO_READ_DATA_FLAG_QUERY))
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  if (num_segments && !segments)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+
+  uint32_t total_num_bytes = 0u;
+  for (uint32_t i = 0u; i < num_segments; i++) {
+    if (segments[i].num_bytes && !segments[i].bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    if (segments[i].num_bytes > UINT32_MAX - total_num_bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    total_num_bytes += segments[i].num_bytes;
+  }
+
+  // mx_data_pipe_read() has no vectored variant, so copy the data directly
+  // into the segments with two-phase reads (two, if the data wraps around).
+  struct SegmentCursor cursor = {0u, 0u};
+  if (total_num_bytes && !(flags & (MOJO_READ_DATA_FLAG_ALL_OR_NONE |
+                                    MOJO_READ_DATA_FLAG_PEEK))) {
+    uint32_t num_bytes_read = 0u;
+    while (num_bytes_read < total_num_bytes) {
+      const void* buffer = NULL;
+      uint32_t buffer_num_bytes = total_num_bytes - num_bytes_read;
+      result = MojoBeginReadData(data_pipe_consumer_handle, &buffer,
+                                 &buffer_num_bytes,
+                                 MOJO_READ_DATA_FLAG_MAX_NUM_BYTES);
+      if (result != MOJO_RESULT_OK) {
+        if (num_bytes_read)
+          break;
+        return result;
+      }
+      ScatterReadDataSegments(segments, &cursor, (const char*)buffer,
+                              buffer_num_bytes);
+      result = MojoEndReadData(data_pipe_consumer_handle, buffer_num_bytes);
+      if (result != MOJO_RESULT_OK)
+        return result;
+      num_bytes_read += buffer_num_bytes;
+    }
+    *num_bytes = num_bytes_read;
+    return MOJO_RESULT_OK;
+  }
+
+  // Otherwise (a two-phase read can't do either), read into a single buffer and
+  // then scatter the data.
+  char stack_buffer[DATA_V_STACK_BUFFER_SIZE];
+  char* buffer = stack_buffer;
+  if (total_num_bytes > sizeof(stack_buffer)) {
+    buffer = (char*)malloc(total_num_bytes);
+    if (!buffer)
+      return MOJO_RESULT_RESOURCE_EXHAUSTED;
+  }
+  *num_bytes = total_num_bytes;
+  result = MojoReadData(data_pipe_consumer_handle, buffer, num_bytes, flags);
+  if (result == MOJO_RESULT_OK)
+    ScatterReadDataSegments(segments, &cursor, buffer, *num_bytes);
+  if (buffer != stack_buffer)
+    free(buffer);
+  return result;
+}
+
 MojoResult MojoBeginReadData(MojoHandle data_pipe_consumer_handle,
                              const void** buffer,
                              uint32_t* buffer_num_bytes,
                              MojoReadDataFlags flags) {
-  if (flags) {
-    // TODO: Support flags
-    return MOJO_RESULT_UNIMPLEMENTED;
-  }
-  // TODO(abarth): MojoBeginReadData doesn't have a way to limit the amount of
-  // virtual memory that it will map.
-  // See https://github.com/domokit/mojo/issues/812
+  if (flags & ~MOJO_READ_DATA_FLAG_MAX_NUM_BYTES)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  // Unless a maximum is given, this maps as much as possible.
   mx_size_t requested = UINTPTR_MAX;
+  if (flags & MOJO_READ_DATA_FLAG_MAX_NUM_BYTES) {
+    if (!*buffer_num_bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    requested = *buffer_num_bytes;
+  }
   mx_ssize_t result =
-      mx_data_pipe_begin_read((mx_handle_t)data_pipe_consumer_handle,
-                              0u,  // TODO: flags
+      mx_data_pipe_begin_read((mx_handle_t)data_pipe_consumer_handle, 0u,
                               requested, (uintptr_t*)buffer);
   if (result < 0) {
     switch (result) {
@@ -0,0 +1,2547 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// An implementation of the Mojo system C API on Linux, so that the SDK (and,
+// in particular, its tests and perftests) can be run on ordinary Linux hosts.
+// Everything is in-process: message pipes and data pipes are queues in memory,
+// shared buffers are memfds, and waits (including on wait sets) block on
+// futexes.
+//
+// State is protected by a single mutex, |g_mutex|, except that reading and
+// writing messages without handles doesn't take it (see the message pipe
+// section below). Waiters add a |struct Watch| to each object that they're
+// waiting on; whenever an object's signals state may have changed for the
+// better (or a handle to it is closed), its watches are notified.
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <linux/futex.h>
+#include <mojo/system/buffer.h>
+#include <mojo/system/data_pipe.h>
+#include <mojo/system/handle.h>
+#include <mojo/system/message_pipe.h>
+#include <mojo/system/time.h>
+#include <mojo/system/wait.h>
+#include <mojo/system/wait_set.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Like |offsetof()|, but includes that data itself.
+// TODO(vtl): This isn't quite right/safe: even if |member_name| is within
+// |EXTENT_OF(struct_type, member_name)|, looking at
+// |struct_instance->member_name| might not be safe.
+#define EXTENT_OF(struct_type, member_name) \
+  (offsetof(struct_type, member_name) + sizeof(((struct_type*)0)->member_name))
+
+// Gets a pointer to the |struct_type| that has |*pointer| as its |member_name|.
+#define CONTAINER_OF(pointer, struct_type, member_name) \
+  ((struct_type*)(void*)((char*)(pointer)-offsetof(struct_type, member_name)))
+
+#define DEFAULT_MESSAGE_PIPE_HANDLE_RIGHTS                         \
+  (MOJO_HANDLE_RIGHT_TRANSFER | MOJO_HANDLE_RIGHT_READ |           \
+   MOJO_HANDLE_RIGHT_WRITE | MOJO_HANDLE_RIGHT_GET_OPTIONS |       \
+   MOJO_HANDLE_RIGHT_SET_OPTIONS)
+#define DEFAULT_DATA_PIPE_PRODUCER_HANDLE_RIGHTS                   \
+  (MOJO_HANDLE_RIGHT_TRANSFER | MOJO_HANDLE_RIGHT_WRITE |          \
+   MOJO_HANDLE_RIGHT_GET_OPTIONS | MOJO_HANDLE_RIGHT_SET_OPTIONS)
+#define DEFAULT_DATA_PIPE_CONSUMER_HANDLE_RIGHTS                   \
+  (MOJO_HANDLE_RIGHT_TRANSFER | MOJO_HANDLE_RIGHT_READ |           \
+   MOJO_HANDLE_RIGHT_GET_OPTIONS | MOJO_HANDLE_RIGHT_SET_OPTIONS)
+#define DEFAULT_SHARED_BUFFER_HANDLE_RIGHTS                        \
+  (MOJO_HANDLE_RIGHT_DUPLICATE | MOJO_HANDLE_RIGHT_TRANSFER |      \
+   MOJO_HANDLE_RIGHT_GET_OPTIONS | MOJO_HANDLE_RIGHT_SET_OPTIONS | \
+   MOJO_HANDLE_RIGHT_MAP_READABLE | MOJO_HANDLE_RIGHT_MAP_WRITABLE | \
+   MOJO_HANDLE_RIGHT_MAP_EXECUTABLE)
+#define DEFAULT_WAIT_SET_HANDLE_RIGHTS                             \
+  (MOJO_HANDLE_RIGHT_READ | MOJO_HANDLE_RIGHT_WRITE |              \
+   MOJO_HANDLE_RIGHT_GET_OPTIONS | MOJO_HANDLE_RIGHT_SET_OPTIONS)
+
+// Handle values are |(generation << HANDLE_INDEX_BITS) | index|, where |index|
+// is an index into |g_handle_entries| (and is never 0, so that no handle value
+// is |MOJO_HANDLE_INVALID|).
+#define HANDLE_INDEX_BITS 20u
+#define MAX_NUM_HANDLE_ENTRIES (1u << HANDLE_INDEX_BITS)
+#define HANDLE_GENERATION_MASK ((1u << (32u - HANDLE_INDEX_BITS)) - 1u)
+// Handle entries are allocated in chunks of this many, which are never moved or
+// freed (so that they can be looked at without |g_mutex|).
+#define HANDLE_ENTRY_CHUNK_SIZE 1024u
+#define MAX_NUM_HANDLE_ENTRY_CHUNKS \
+  (MAX_NUM_HANDLE_ENTRIES / HANDLE_ENTRY_CHUNK_SIZE)
+// Free handle entries are only reused once there are at least this many of
+// them (oldest first), so that handle values aren't reused eagerly.
+#define MIN_FREE_HANDLE_ENTRIES_TO_REUSE 1024u
+
+#define MAX_MESSAGE_NUM_BYTES (256u * 1024u * 1024u)
+#define MAX_MESSAGE_NUM_HANDLES 10000u
+#define DEFAULT_DATA_PIPE_CAPACITY_NUM_BYTES (1024u * 1024u)
+#define MAX_DATA_PIPE_CAPACITY_NUM_BYTES (256u * 1024u * 1024u)
+#define MAX_SHARED_BUFFER_NUM_BYTES ((uint64_t)1 << 40)
+
+// The number of handles that |MojoWaitMany()| can wait on without allocating.
+#define WAIT_MANY_STACK_WATCHES 16u
+
+// A "time" later than any deadline.
+#define END_TIME_INFINITE INT64_MAX
+
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// objects ---------------------------------------------------------------------
+
+enum ObjectType {
+  OBJECT_TYPE_MESSAGE_PIPE_ENDPOINT,
+  OBJECT_TYPE_DATA_PIPE_PRODUCER,
+  OBJECT_TYPE_DATA_PIPE_CONSUMER,
+  OBJECT_TYPE_SHARED_BUFFER,
+  OBJECT_TYPE_WAIT_SET,
+};
+
+struct Watch;
+
+struct Object {
+  enum ObjectType type;
+  // References are held by handles, by messages that the object is being sent
+  // in, and by waits on the object. When the last one goes away, the object is
+  // "closed" (e.g., a message pipe endpoint's peer becomes peer-closed).
+  uint32_t ref_count;
+  // Doubly-linked list of the watches on this object.
+  struct Watch* watches;
+  // The number of watches (which may be read without |g_mutex|, to see if the
+  // watches need to be notified).
+  uint32_t num_watches;
+};
+
+// Something (a waiting thread, or a wait set entry) watching an object through
+// a particular handle.
+struct Watch {
+  // The watched object, or null if the watch isn't (or is no longer) added.
+  struct Object* object;
+  // The handle (to |object|) through which the object is being watched.
+  MojoHandle handle;
+  // Called when |object|'s signals state may have changed or, with |cancelled|
+  // set, when |handle| has been closed (in which case the watch has already
+  // been removed).
+  void (*notify)(struct Watch* watch, bool cancelled);
+  struct Watch* previous;
+  struct Watch* next;
+};
+
+static void InitObject(struct Object* object, enum ObjectType type) {
+  object->type = type;
+  object->ref_count = 1u;
+  object->watches = NULL;
+  object->num_watches = 0u;
+}
+
+static void AddWatch(struct Object* object,
+                     struct Watch* watch,
+                     MojoHandle handle,
+                     void (*notify)(struct Watch* watch, bool cancelled)) {
+  watch->object = object;
+  watch->handle = handle;
+  watch->notify = notify;
+  watch->previous = NULL;
+  watch->next = object->watches;
+  if (object->watches)
+    object->watches->previous = watch;
+  object->watches = watch;
+  __atomic_add_fetch(&object->num_watches, 1u, __ATOMIC_SEQ_CST);
+}
+
+static void RemoveWatch(struct Watch* watch) {
+  if (!watch->object)
+    return;
+  if (watch->previous)
+    watch->previous->next = watch->next;
+  else
+    watch->object->watches = watch->next;
+  if (watch->next)
+    watch->next->previous = watch->previous;
+  __atomic_sub_fetch(&watch->object->num_watches, 1u, __ATOMIC_RELAXED);
+  watch->object = NULL;
+}
+
+static void NotifyWatches(struct Object* object) {
+  for (struct Watch* watch = object->watches; watch; watch = watch->next)
+    watch->notify(watch, false);
+}
+
+// Removes and notifies the watches on |object| through |handle|, which is being
+// closed.
+static void CancelWatches(struct Object* object, MojoHandle handle) {
+  struct Watch* watch = object->watches;
+  while (watch) {
+    struct Watch* next = watch->next;
+    if (watch->handle == handle) {
+      RemoveWatch(watch);
+      watch->notify(watch, true);
+    }
+    watch = next;
+  }
+}
+
+static void AddRefObject(struct Object* object) {
+  object->ref_count++;
+}
+
+static void ReleaseObject(struct Object* object);
+
+// handle table ----------------------------------------------------------------
+
+struct HandleEntry {
+  // Null if the entry is free. This, |type|, |rights| and |generation| are only
+  // modified with |g_mutex| held, but may be read without it (see
+  // |LookupMessagePipeEndpointWithoutLock()|).
+  struct Object* object;
+  // |object->type| (which can be read without dereferencing |object|).
+  enum ObjectType type;
+  MojoHandleRights rights;
+  uint32_t generation;
+  // Set while the handle is being checked for sending in a message (to catch a
+  // handle being sent twice).
+  bool being_sent;
+  // The next entry in the free list (if this entry is free).
+  uint32_t next_free;
+};
+
+static struct HandleEntry* g_handle_entry_chunks[MAX_NUM_HANDLE_ENTRY_CHUNKS];
+// Entry 0 is never used.
+static uint32_t g_num_handle_entries = 1u;
+static uint32_t g_first_free_handle_entry = 0u;
+static uint32_t g_last_free_handle_entry = 0u;
+static uint32_t g_num_free_handle_entries = 0u;
+
+static struct HandleEntry* GetHandleEntry(uint32_t index) {
+  return &g_handle_entry_chunks[index / HANDLE_ENTRY_CHUNK_SIZE]
+                               [index % HANDLE_ENTRY_CHUNK_SIZE];
+}
+
+// Adds a handle to |object| with the given rights, taking ownership of a
+// reference to |object|. Returns |MOJO_HANDLE_INVALID| (and doesn't take the
+// reference) if there are too many handles.
+static MojoHandle AllocHandle(struct Object* object, MojoHandleRights rights) {
+  uint32_t index;
+  if (g_num_free_handle_entries >= MIN_FREE_HANDLE_ENTRIES_TO_REUSE ||
+      (g_num_free_handle_entries &&
+       g_num_handle_entries == MAX_NUM_HANDLE_ENTRIES)) {
+    index = g_first_free_handle_entry;
+    g_first_free_handle_entry = GetHandleEntry(index)->next_free;
+    g_num_free_handle_entries--;
+  } else {
+    if (g_num_handle_entries == MAX_NUM_HANDLE_ENTRIES)
+      return MOJO_HANDLE_INVALID;
+    uint32_t chunk = g_num_handle_entries / HANDLE_ENTRY_CHUNK_SIZE;
+    if (!g_handle_entry_chunks[chunk]) {
+      struct HandleEntry* entries = (struct HandleEntry*)calloc(
+          HANDLE_ENTRY_CHUNK_SIZE, sizeof(struct HandleEntry));
+      if (!entries)
+        return MOJO_HANDLE_INVALID;
+      __atomic_store_n(&g_handle_entry_chunks[chunk], entries,
+                       __ATOMIC_RELEASE);
+    }
+    index = g_num_handle_entries++;
+  }
+
+  struct HandleEntry* entry = GetHandleEntry(index);
+  __atomic_store_n(&entry->type, object->type, __ATOMIC_RELAXED);
+  __atomic_store_n(&entry->rights, rights, __ATOMIC_RELAXED);
+  __atomic_store_n(&entry->object, object, __ATOMIC_RELEASE);
+  entry->being_sent = false;
+  return (MojoHandle)((entry->generation << HANDLE_INDEX_BITS) | index);
+}
+
+static struct HandleEntry* LookupHandle(MojoHandle handle) {
+  uint32_t index = handle & (MAX_NUM_HANDLE_ENTRIES - 1u);
+  if (!index || index >= g_num_handle_entries)
+    return NULL;
+  struct HandleEntry* entry = GetHandleEntry(index);
+  if (!entry->object || entry->generation != handle >> HANDLE_INDEX_BITS)
+    return NULL;
+  return entry;
+}
+
+// Looks up |handle|, which must be to an object of the given type with (at
+// least) the given rights.
+static MojoResult LookupObject(MojoHandle handle,
+                               enum ObjectType type,
+                               MojoHandleRights required_rights,
+                               struct Object** object) {
+  struct HandleEntry* entry = LookupHandle(handle);
+  if (!entry || entry->object->type != type)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  if ((entry->rights & required_rights) != required_rights)
+    return MOJO_RESULT_PERMISSION_DENIED;
+  *object = entry->object;
+  return MOJO_RESULT_OK;
+}
+
+static void AbortTwoPhase(struct Object* object);
+
+// Invalidates |handle| (which must be valid), cancelling everything watching
+// through it and aborting any two-phase read or write on it. Returns its
+// object, whose reference (formerly held by the handle) is now the caller's.
+static struct Object* InvalidateHandle(MojoHandle handle) {
+  struct HandleEntry* entry = LookupHandle(handle);
+  assert(entry);
+  struct Object* object = entry->object;
+
+  __atomic_store_n(&entry->generation,
+                   (entry->generation + 1u) & HANDLE_GENERATION_MASK,
+                   __ATOMIC_SEQ_CST);
+  __atomic_store_n(&entry->object, NULL, __ATOMIC_RELAXED);
+
+  uint32_t index = handle & (MAX_NUM_HANDLE_ENTRIES - 1u);
+  entry->next_free = 0u;
+  if (g_num_free_handle_entries)
+    GetHandleEntry(g_last_free_handle_entry)->next_free = index;
+  else
+    g_first_free_handle_entry = index;
+  g_last_free_handle_entry = index;
+  g_num_free_handle_entries++;
+
+  CancelWatches(object, handle);
+  AbortTwoPhase(object);
+  return object;
+}
+
+// time ------------------------------------------------------------------------
+
+static MojoTimeTicks GetTimeTicksNow(void) {
+  struct timespec now;
+  int rv = clock_gettime(CLOCK_MONOTONIC, &now);
+  assert(rv == 0);
+  (void)rv;
+  return (MojoTimeTicks)now.tv_sec * 1000000 +
+         (MojoTimeTicks)now.tv_nsec / 1000;
+}
+
+static MojoTimeTicks DeadlineToEndTime(MojoDeadline deadline) {
+  if (deadline > (MojoDeadline)(END_TIME_INFINITE / 2))
+    return END_TIME_INFINITE;
+  return GetTimeTicksNow() + (MojoTimeTicks)deadline;
+}
+
+// waiters ---------------------------------------------------------------------
+
+#define WAITER_AWAKE 0u
+#define WAITER_SLEEPING 1u
+#define WAITER_NOTIFIED 2u
+
+// A thread waiting in |MojoWait()|, |MojoWaitMany()|, or |MojoWaitSetWait()|.
+struct Waiter {
+  // One of the |WAITER_...| values above; this is the futex word.
+  uint32_t state;
+  // Whether one of the handles being waited on was closed, and if so which.
+  bool cancelled;
+  uint32_t cancelled_index;
+};
+
+struct WaiterWatch {
+  struct Watch watch;
+  struct Waiter* waiter;
+  struct Object* object;
+  uint32_t index;
+};
+
+static void InitWaiter(struct Waiter* waiter) {
+  waiter->state = WAITER_AWAKE;
+  waiter->cancelled = false;
+  waiter->cancelled_index = 0u;
+}
+
+static void NotifyWaiter(struct Watch* watch, bool cancelled) {
+  struct WaiterWatch* waiter_watch =
+      CONTAINER_OF(watch, struct WaiterWatch, watch);
+  struct Waiter* waiter = waiter_watch->waiter;
+  if (cancelled && !waiter->cancelled) {
+    waiter->cancelled = true;
+    waiter->cancelled_index = waiter_watch->index;
+  }
+  // Only make the system call if the waiter is actually (going) to sleep.
+  if (__atomic_exchange_n(&waiter->state, WAITER_NOTIFIED, __ATOMIC_RELEASE) ==
+      WAITER_SLEEPING)
+    syscall(SYS_futex, &waiter->state, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+// Releases |g_mutex|, sleeps until |waiter| is notified or |end_time| is
+// reached, and then reacquires |g_mutex|. (The caller should set |waiter|'s
+// state to |WAITER_AWAKE| and check for whatever it's waiting for, with
+// |g_mutex| held, before each call.)
+static void Sleep(struct Waiter* waiter, MojoTimeTicks end_time) {
+  pthread_mutex_unlock(&g_mutex);
+  uint32_t expected = WAITER_AWAKE;
+  if (__atomic_compare_exchange_n(&waiter->state, &expected, WAITER_SLEEPING,
+                                  false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+    while (__atomic_load_n(&waiter->state, __ATOMIC_ACQUIRE) ==
+           WAITER_SLEEPING) {
+      struct timespec timeout;
+      struct timespec* timeout_ptr = NULL;
+      if (end_time != END_TIME_INFINITE) {
+        MojoTimeTicks remaining = end_time - GetTimeTicksNow();
+        if (remaining <= 0)
+          break;
+        timeout.tv_sec = (time_t)(remaining / 1000000);
+        timeout.tv_nsec = (long)(remaining % 1000000) * 1000L;
+        timeout_ptr = &timeout;
+      }
+      syscall(SYS_futex, &waiter->state, FUTEX_WAIT_PRIVATE, WAITER_SLEEPING,
+              timeout_ptr, NULL, 0);
+    }
+  }
+  pthread_mutex_lock(&g_mutex);
+}
+
+// message pipes ---------------------------------------------------------------
+//
+// Messages without handles are written and read without |g_mutex|. Each
+// endpoint has a lock-free single-producer/single-consumer queue of the
+// messages to be read from it, whose "producer" is whichever thread is writing
+// to its peer and whose "consumer" is whichever thread is reading from it.
+// Threads claim these roles with a flag; a thread that can't (immediately) do
+// so, or that has handles to transfer, takes |g_mutex| (and then waits for the
+// role) instead. Writers only take |g_mutex| to notify watches.
+//
+// Such a thread looks up its handle without |g_mutex| and checks that the
+// handle is still valid once it has its role. An endpoint is only destroyed
+// after its handles have been invalidated, and it first takes (waiting for) the
+// roles. Message pipes are never freed, but reused, so a thread that looked up
+// a handle just before its endpoint was destroyed may still (harmlessly) claim
+// a role.
+
+struct TransferredHandle {
+  struct Object* object;
+  MojoHandleRights rights;
+};
+
+// Allocated together with its (|num_handles|) transferred handles, followed by
+// its (|num_bytes|) bytes.
+struct Message {
+  uint32_t num_bytes;
+  uint32_t num_handles;
+};
+
+static struct TransferredHandle* MessageHandles(struct Message* message) {
+  return (struct TransferredHandle*)(void*)(message + 1);
+}
+
+static char* MessageBytes(struct Message* message) {
+  return (char*)(MessageHandles(message) + message->num_handles);
+}
+
+// (If |message| has handles, this must be called with |g_mutex| held.)
+static void DestroyMessage(struct Message* message) {
+  struct TransferredHandle* handles = MessageHandles(message);
+  for (uint32_t i = 0u; i < message->num_handles; i++)
+    ReleaseObject(handles[i].object);
+  free(message);
+}
+
+struct MessageQueueNode {
+  struct MessageQueueNode* next;
+  struct Message* message;
+};
+
+// An unbounded single-producer/single-consumer queue (after Dmitry Vyukov's).
+// The nodes form a list from |first_free_node| to |producer_node|;
+// |consumer_node| is the last node whose message has been consumed (initially a
+// dummy), and the nodes before it are recycled by the producer. Nodes are only
+// freed with the queue.
+struct MessageQueue {
+  // Only used by the producer.
+  struct MessageQueueNode* producer_node;
+  struct MessageQueueNode* first_free_node;
+  struct MessageQueueNode* consumer_node_copy;
+  // Only modified by the consumer.
+  struct MessageQueueNode* consumer_node;
+};
+
+static bool InitMessageQueue(struct MessageQueue* queue) {
+  struct MessageQueueNode* node =
+      (struct MessageQueueNode*)malloc(sizeof(struct MessageQueueNode));
+  if (!node)
+    return false;
+  node->next = NULL;
+  node->message = NULL;
+  queue->producer_node = node;
+  queue->first_free_node = node;
+  queue->consumer_node_copy = node;
+  queue->consumer_node = node;
+  return true;
+}
+
+// Gets a node for |PushMessage()| (producer only). Returns null on allocation
+// failure.
+static struct MessageQueueNode* AllocMessageQueueNode(
+    struct MessageQueue* queue) {
+  if (queue->first_free_node == queue->consumer_node_copy) {
+    queue->consumer_node_copy =
+        __atomic_load_n(&queue->consumer_node, __ATOMIC_ACQUIRE);
+  }
+  if (queue->first_free_node != queue->consumer_node_copy) {
+    struct MessageQueueNode* node = queue->first_free_node;
+    queue->first_free_node = node->next;
+    return node;
+  }
+  return (struct MessageQueueNode*)malloc(sizeof(struct MessageQueueNode));
+}
+
+// Producer only. (The message is published sequentially consistently, so that
+// the producer can then check whether the consumer is being watched.)
+static void PushMessage(struct MessageQueue* queue,
+                        struct MessageQueueNode* node,
+                        struct Message* message) {
+  node->next = NULL;
+  node->message = message;
+  __atomic_store_n(&queue->producer_node->next, node, __ATOMIC_SEQ_CST);
+  queue->producer_node = node;
+}
+
+// Returns the next message, if any, without removing it (consumer only).
+static struct Message* PeekMessage(struct MessageQueue* queue) {
+  struct MessageQueueNode* next =
+      __atomic_load_n(&queue->consumer_node->next, __ATOMIC_SEQ_CST);
+  return next ? next->message : NULL;
+}
+
+// Removes the next message, which must exist (consumer only).
+static void PopMessage(struct MessageQueue* queue) {
+  __atomic_store_n(&queue->consumer_node, queue->consumer_node->next,
+                   __ATOMIC_RELEASE);
+}
+
+// Claims a producer or consumer role, given its flag. (This is sequentially
+// consistent, so that the handle that was used can then be checked.)
+static bool TryAcquireRole(uint32_t* busy) {
+  return !__atomic_exchange_n(busy, 1u, __ATOMIC_SEQ_CST);
+}
+
+// (Only called with |g_mutex| held.)
+static void AcquireRole(uint32_t* busy) {
+  while (!TryAcquireRole(busy))
+    sched_yield();
+}
+
+static void ReleaseRole(uint32_t* busy) {
+  __atomic_store_n(busy, 0u, __ATOMIC_RELEASE);
+}
+
+struct MessagePipe;
+
+struct MessagePipeEndpoint {
+  struct Object object;
+  struct MessagePipe* message_pipe;
+  struct MessagePipeEndpoint* peer;
+  // Cleared (with |g_mutex| held, and all the roles that use this endpoint)
+  // when the endpoint is destroyed.
+  bool is_open;
+  // The messages to be read from this endpoint, and the flags for its producer
+  // and consumer roles.
+  struct MessageQueue queue;
+  uint32_t producer_busy;
+  uint32_t consumer_busy;
+};
+
+// The two endpoints are allocated together. Once both have been destroyed, the
+// message pipe (with its empty queues) goes on the free list.
+struct MessagePipe {
+  struct MessagePipeEndpoint endpoints[2];
+  struct MessagePipe* next_free;
+};
+
+static struct MessagePipe* g_free_message_pipes = NULL;
+
+// Looks up |handle| without |g_mutex|, returning its endpoint if it's a message
+// pipe endpoint with the given right (and null otherwise). Once the caller has
+// claimed a role, it must check |IsHandleStillValid(*entry, handle)|.
+static struct MessagePipeEndpoint* LookupMessagePipeEndpointWithoutLock(
+    MojoHandle handle,
+    MojoHandleRights required_right,
+    struct HandleEntry** entry) {
+  uint32_t index = handle & (MAX_NUM_HANDLE_ENTRIES - 1u);
+  uint32_t generation = handle >> HANDLE_INDEX_BITS;
+  struct HandleEntry* entries =
+      __atomic_load_n(&g_handle_entry_chunks[index / HANDLE_ENTRY_CHUNK_SIZE],
+                      __ATOMIC_ACQUIRE);
+  if (!index || !entries)
+    return NULL;
+  struct HandleEntry* e = &entries[index % HANDLE_ENTRY_CHUNK_SIZE];
+  if (__atomic_load_n(&e->generation, __ATOMIC_ACQUIRE) != generation)
+    return NULL;
+  struct Object* object = __atomic_load_n(&e->object, __ATOMIC_ACQUIRE);
+  if (!object ||
+      __atomic_load_n(&e->type, __ATOMIC_ACQUIRE) !=
+          OBJECT_TYPE_MESSAGE_PIPE_ENDPOINT ||
+      !(__atomic_load_n(&e->rights, __ATOMIC_ACQUIRE) & required_right))
+    return NULL;
+  // The above is consistent if the generation hasn't changed.
+  if (__atomic_load_n(&e->generation, __ATOMIC_ACQUIRE) != generation)
+    return NULL;
+  *entry = e;
+  return CONTAINER_OF(object, struct MessagePipeEndpoint, object);
+}
+
+static bool IsHandleStillValid(struct HandleEntry* entry, MojoHandle handle) {
+  return __atomic_load_n(&entry->generation, __ATOMIC_SEQ_CST) ==
+         handle >> HANDLE_INDEX_BITS;
+}
+
+// (Must be called with |g_mutex| held.)
+static struct MojoHandleSignalsState GetMessagePipeEndpointSignalsState(
+    struct MessagePipeEndpoint* endpoint) {
+  struct MojoHandleSignalsState state = {MOJO_HANDLE_SIGNAL_NONE,
+                                         MOJO_HANDLE_SIGNAL_PEER_CLOSED};
+  AcquireRole(&endpoint->consumer_busy);
+  bool readable = !!PeekMessage(&endpoint->queue);
+  ReleaseRole(&endpoint->consumer_busy);
+  if (readable) {
+    state.satisfied_signals |= MOJO_HANDLE_SIGNAL_READABLE;
+    state.satisfiable_signals |= MOJO_HANDLE_SIGNAL_READABLE;
+  }
+  if (endpoint->peer->is_open) {
+    state.satisfied_signals |= MOJO_HANDLE_SIGNAL_WRITABLE;
+    state.satisfiable_signals |=
+        MOJO_HANDLE_SIGNAL_READABLE | MOJO_HANDLE_SIGNAL_WRITABLE;
+  } else {
+    state.satisfied_signals |= MOJO_HANDLE_SIGNAL_PEER_CLOSED;
+  }
+  return state;
+}
+
+static void DestroyMessagePipeEndpoint(struct MessagePipeEndpoint* endpoint) {
+  // Wait for any thread still reading from, or writing to or from, this
+  // endpoint (which looked up its handle before it was invalidated).
+  struct MessagePipeEndpoint* peer = endpoint->peer;
+  AcquireRole(&endpoint->consumer_busy);
+  AcquireRole(&endpoint->producer_busy);
+  AcquireRole(&peer->producer_busy);
+  __atomic_store_n(&endpoint->is_open, false, __ATOMIC_RELEASE);
+  // Discard the unread messages.
+  struct Message* message;
+  while ((message = PeekMessage(&endpoint->queue))) {
+    PopMessage(&endpoint->queue);
+    DestroyMessage(message);
+  }
+  ReleaseRole(&peer->producer_busy);
+  ReleaseRole(&endpoint->producer_busy);
+  ReleaseRole(&endpoint->consumer_busy);
+
+  if (peer->is_open) {
+    NotifyWatches(&peer->object);
+    return;
+  }
+  endpoint->message_pipe->next_free = g_free_message_pipes;
+  g_free_message_pipes = endpoint->message_pipe;
+}
+
+// data pipes ------------------------------------------------------------------
+
+struct DataPipe {
+  struct Object producer;
+  struct Object consumer;
+  bool producer_open;
+  bool consumer_open;
+  uint32_t element_num_bytes;
+  uint32_t capacity_num_bytes;
+  // Zero means the default (one element).
+  uint32_t write_threshold_num_bytes;
+  uint32_t read_threshold_num_bytes;
+  // A circular buffer holding |num_bytes| of data starting at |read_offset|.
+  char* buffer;
+  uint32_t read_offset;
+  uint32_t num_bytes;
+  // Nonzero during a two-phase write/read (the amount of space/data offered).
+  uint32_t two_phase_write_num_bytes;
+  uint32_t two_phase_read_num_bytes;
+};
+
+static struct MojoHandleSignalsState GetDataPipeProducerSignalsState(
+    const struct DataPipe* data_pipe) {
+  struct MojoHandleSignalsState state = {MOJO_HANDLE_SIGNAL_NONE,
+                                         MOJO_HANDLE_SIGNAL_PEER_CLOSED};
+  if (!data_pipe->consumer_open) {
+    state.satisfied_signals |= MOJO_HANDLE_SIGNAL_PEER_CLOSED;
+    return state;
+  }
+  state.satisfiable_signals |=
+      MOJO_HANDLE_SIGNAL_WRITABLE | MOJO_HANDLE_SIGNAL_WRITE_THRESHOLD;
+  if (data_pipe->two_phase_write_num_bytes)
+    return state;
+  uint32_t available = data_pipe->capacity_num_bytes - data_pipe->num_bytes;
+  uint32_t threshold = data_pipe->write_threshold_num_bytes
+                           ? data_pipe->write_threshold_num_bytes
+                           : data_pipe->element_num_bytes;
+  if (available)
+    state.satisfied_signals |= MOJO_HANDLE_SIGNAL_WRITABLE;
+  if (available >= threshold)
+    state.satisfied_signals |= MOJO_HANDLE_SIGNAL_WRITE_THRESHOLD;
+  return state;
+}
+
+static struct MojoHandleSignalsState GetDataPipeConsumerSignalsState(
+    const struct DataPipe* data_pipe) {
+  struct MojoHandleSignalsState state = {MOJO_HANDLE_SIGNAL_NONE,
+                                         MOJO_HANDLE_SIGNAL_PEER_CLOSED};
+  uint32_t threshold = data_pipe->read_threshold_num_bytes
+                           ? data_pipe->read_threshold_num_bytes
+                           : data_pipe->element_num_bytes;
+  if (data_pipe->producer_open) {
+    state.satisfiable_signals |=
+        MOJO_HANDLE_SIGNAL_READABLE | MOJO_HANDLE_SIGNAL_READ_THRESHOLD;
+  } else {
+    state.satisfied_signals |= MOJO_HANDLE_SIGNAL_PEER_CLOSED;
+    if (data_pipe->num_bytes)
+      state.satisfiable_signals |= MOJO_HANDLE_SIGNAL_READABLE;
+    if (data_pipe->num_bytes >= threshold)
+      state.satisfiable_signals |= MOJO_HANDLE_SIGNAL_READ_THRESHOLD;
+  }
+  if (data_pipe->two_phase_read_num_bytes)
+    return state;
+  if (data_pipe->num_bytes)
+    state.satisfied_signals |= MOJO_HANDLE_SIGNAL_READABLE;
+  if (data_pipe->num_bytes >= threshold)
+    state.satisfied_signals |= MOJO_HANDLE_SIGNAL_READ_THRESHOLD;
+  return state;
+}
+
+static void DestroyDataPipeProducer(struct DataPipe* data_pipe) {
+  data_pipe->producer_open = false;
+  if (data_pipe->consumer_open) {
+    NotifyWatches(&data_pipe->consumer);
+    return;
+  }
+  free(data_pipe->buffer);
+  free(data_pipe);
+}
+
+static void DestroyDataPipeConsumer(struct DataPipe* data_pipe) {
+  data_pipe->consumer_open = false;
+  if (data_pipe->producer_open) {
+    NotifyWatches(&data_pipe->producer);
+    return;
+  }
+  free(data_pipe->buffer);
+  free(data_pipe);
+}
+
+// Copies |num_bytes| bytes into the circular buffer at |offset|.
+static void CopyToDataPipe(struct DataPipe* data_pipe,
+                           uint32_t offset,
+                           const char* bytes,
+                           uint32_t num_bytes) {
+  uint32_t first_num_bytes = data_pipe->capacity_num_bytes - offset;
+  if (first_num_bytes > num_bytes)
+    first_num_bytes = num_bytes;
+  memcpy(data_pipe->buffer + offset, bytes, first_num_bytes);
+  memcpy(data_pipe->buffer, bytes + first_num_bytes,
+         num_bytes - first_num_bytes);
+}
+
+// Copies |num_bytes| bytes out of the circular buffer, from |offset|.
+static void CopyFromDataPipe(const struct DataPipe* data_pipe,
+                             uint32_t offset,
+                             char* bytes,
+                             uint32_t num_bytes) {
+  uint32_t first_num_bytes = data_pipe->capacity_num_bytes - offset;
+  if (first_num_bytes > num_bytes)
+    first_num_bytes = num_bytes;
+  memcpy(bytes, data_pipe->buffer + offset, first_num_bytes);
+  memcpy(bytes + first_num_bytes, data_pipe->buffer,
+         num_bytes - first_num_bytes);
+}
+
+static uint32_t DataPipeWriteOffset(const struct DataPipe* data_pipe) {
+  return (data_pipe->read_offset + data_pipe->num_bytes) %
+         data_pipe->capacity_num_bytes;
+}
+
+static void ConsumeFromDataPipe(struct DataPipe* data_pipe,
+                                uint32_t num_bytes) {
+  data_pipe->read_offset =
+      (data_pipe->read_offset + num_bytes) % data_pipe->capacity_num_bytes;
+  data_pipe->num_bytes -= num_bytes;
+  NotifyWatches(&data_pipe->producer);
+}
+
+// shared buffers --------------------------------------------------------------
+
+struct SharedBuffer {
+  struct Object object;
+  // A memfd.
+  int fd;
+  uint64_t num_bytes;
+};
+
+static void DestroySharedBuffer(struct SharedBuffer* shared_buffer) {
+  // Existing mappings keep the memory alive.
+  close(shared_buffer->fd);
+  free(shared_buffer);
+}
+
+struct Mapping {
+  // The address given out by |MojoMapBuffer()|.
+  void* address;
+  // The page-aligned start and the length of the actual mapping.
+  void* base;
+  size_t length;
+};
+
+static struct Mapping* g_mappings = NULL;
+static size_t g_num_mappings = 0u;
+static size_t g_mappings_capacity = 0u;
+
+// wait sets -------------------------------------------------------------------
+
+struct WaitSet;
+
+struct WaitSetEntry {
+  // |watch.object| is the object being watched (null once |watch.handle| has
+  // been closed).
+  struct Watch watch;
+  struct WaitSet* wait_set;
+  MojoHandleSignals signals;
+  uint64_t cookie;
+  // Doubly-linked list of all the wait set's entries.
+  struct WaitSetEntry* previous;
+  struct WaitSetEntry* next;
+  // Doubly-linked list of entries that may be ready (i.e., that have a signal
+  // satisfied, that can no longer be satisfied, or that were cancelled). This
+  // is checked (and pruned) on each wait, so the wait doesn't look at entries
+  // that can't possibly be ready.
+  bool is_ready;
+  struct WaitSetEntry* previous_ready;
+  struct WaitSetEntry* next_ready;
+};
+
+struct WaitSet {
+  // |object.watches| has the waiters (which are notified when an entry becomes
+  // ready).
+  struct Object object;
+  struct WaitSetEntry* first_entry;
+  struct WaitSetEntry* first_ready;
+  struct WaitSetEntry* last_ready;
+};
+
+static struct MojoHandleSignalsState GetSignalsState(struct Object* object);
+
+static bool IsWaitSetEntryReady(struct WaitSetEntry* entry,
+                                MojoResult* wait_result,
+                                struct MojoHandleSignalsState* signals_state) {
+  if (!entry->watch.object) {
+    *wait_result = MOJO_RESULT_CANCELLED;
+    signals_state->satisfied_signals = MOJO_HANDLE_SIGNAL_NONE;
+    signals_state->satisfiable_signals = MOJO_HANDLE_SIGNAL_NONE;
+    return true;
+  }
+  *signals_state = GetSignalsState(entry->watch.object);
+  if (signals_state->satisfied_signals & entry->signals) {
+    *wait_result = MOJO_RESULT_OK;
+    return true;
+  }
+  if (!(signals_state->satisfiable_signals & entry->signals)) {
+    *wait_result = MOJO_RESULT_FAILED_PRECONDITION;
+    return true;
+  }
+  return false;
+}
+
+static void RemoveReadyWaitSetEntry(struct WaitSetEntry* entry) {
+  struct WaitSet* wait_set = entry->wait_set;
+  if (entry->previous_ready)
+    entry->previous_ready->next_ready = entry->next_ready;
+  else
+    wait_set->first_ready = entry->next_ready;
+  if (entry->next_ready)
+    entry->next_ready->previous_ready = entry->previous_ready;
+  else
+    wait_set->last_ready = entry->previous_ready;
+  entry->is_ready = false;
+}
+
+static void NotifyWaitSetEntry(struct Watch* watch, bool cancelled) {
+  struct WaitSetEntry* entry = CONTAINER_OF(watch, struct WaitSetEntry, watch);
+  if (entry->is_ready)
+    return;
+  MojoResult wait_result;
+  struct MojoHandleSignalsState signals_state;
+  if (!cancelled && !IsWaitSetEntryReady(entry, &wait_result, &signals_state))
+    return;
+
+  struct WaitSet* wait_set = entry->wait_set;
+  entry->is_ready = true;
+  entry->previous_ready = wait_set->last_ready;
+  entry->next_ready = NULL;
+  if (wait_set->last_ready)
+    wait_set->last_ready->next_ready = entry;
+  else
+    wait_set->first_ready = entry;
+  wait_set->last_ready = entry;
+  NotifyWatches(&wait_set->object);
+}
+
+static void DestroyWaitSet(struct WaitSet* wait_set) {
+  while (wait_set->first_entry) {
+    struct WaitSetEntry* entry = wait_set->first_entry;
+    wait_set->first_entry = entry->next;
+    RemoveWatch(&entry->watch);
+    free(entry);
+  }
+  free(wait_set);
+}
+
+// objects (continued) ---------------------------------------------------------
+
+static struct MojoHandleSignalsState GetSignalsState(struct Object* object) {
+  switch (object->type) {
+    case OBJECT_TYPE_MESSAGE_PIPE_ENDPOINT:
+      return GetMessagePipeEndpointSignalsState(
+          CONTAINER_OF(object, struct MessagePipeEndpoint, object));
+    case OBJECT_TYPE_DATA_PIPE_PRODUCER:
+      return GetDataPipeProducerSignalsState(
+          CONTAINER_OF(object, struct DataPipe, producer));
+    case OBJECT_TYPE_DATA_PIPE_CONSUMER:
+      return GetDataPipeConsumerSignalsState(
+          CONTAINER_OF(object, struct DataPipe, consumer));
+    case OBJECT_TYPE_SHARED_BUFFER:
+    case OBJECT_TYPE_WAIT_SET:
+      break;
+  }
+  struct MojoHandleSignalsState state = {MOJO_HANDLE_SIGNAL_NONE,
+                                         MOJO_HANDLE_SIGNAL_NONE};
+  return state;
+}
+
+static void AbortTwoPhase(struct Object* object) {
+  if (object->type == OBJECT_TYPE_DATA_PIPE_PRODUCER) {
+    struct DataPipe* data_pipe =
+        CONTAINER_OF(object, struct DataPipe, producer);
+    if (data_pipe->two_phase_write_num_bytes) {
+      data_pipe->two_phase_write_num_bytes = 0u;
+      NotifyWatches(object);
+    }
+  } else if (object->type == OBJECT_TYPE_DATA_PIPE_CONSUMER) {
+    struct DataPipe* data_pipe =
+        CONTAINER_OF(object, struct DataPipe, consumer);
+    if (data_pipe->two_phase_read_num_bytes) {
+      data_pipe->two_phase_read_num_bytes = 0u;
+      NotifyWatches(object);
+    }
+  }
+}
+
+static void ReleaseObject(struct Object* object) {
+  assert(object->ref_count > 0u);
+  if (--object->ref_count)
+    return;
+  // Everything watching the object does so through a handle (and holds a
+  // reference while waiting), so there can't be any watches left.
+  assert(!object->watches);
+  switch (object->type) {
+    case OBJECT_TYPE_MESSAGE_PIPE_ENDPOINT:
+      DestroyMessagePipeEndpoint(
+          CONTAINER_OF(object, struct MessagePipeEndpoint, object));
+      break;
+    case OBJECT_TYPE_DATA_PIPE_PRODUCER:
+      DestroyDataPipeProducer(CONTAINER_OF(object, struct DataPipe, producer));
+      break;
+    case OBJECT_TYPE_DATA_PIPE_CONSUMER:
+      DestroyDataPipeConsumer(CONTAINER_OF(object, struct DataPipe, consumer));
+      break;
+    case OBJECT_TYPE_SHARED_BUFFER:
+      DestroySharedBuffer(CONTAINER_OF(object, struct SharedBuffer, object));
+      break;
+    case OBJECT_TYPE_WAIT_SET:
+      DestroyWaitSet(CONTAINER_OF(object, struct WaitSet, object));
+      break;
+  }
+}
+
+// Adds handles for two new objects, or neither (in which case it releases both
+// and returns |MOJO_RESULT_RESOURCE_EXHAUSTED|).
+static MojoResult AllocHandlePair(struct Object* object0,
+                                  MojoHandleRights rights0,
+                                  struct Object* object1,
+                                  MojoHandleRights rights1,
+                                  MojoHandle* handle0,
+                                  MojoHandle* handle1) {
+  MojoHandle h0 = AllocHandle(object0, rights0);
+  MojoHandle h1 = h0 != MOJO_HANDLE_INVALID ? AllocHandle(object1, rights1)
+                                            : MOJO_HANDLE_INVALID;
+  if (h1 == MOJO_HANDLE_INVALID) {
+    if (h0 != MOJO_HANDLE_INVALID)
+      ReleaseObject(InvalidateHandle(h0));
+    else
+      ReleaseObject(object0);
+    ReleaseObject(object1);
+    return MOJO_RESULT_RESOURCE_EXHAUSTED;
+  }
+  *handle0 = h0;
+  *handle1 = h1;
+  return MOJO_RESULT_OK;
+}
+
+// handle.h --------------------------------------------------------------------
+
+MojoResult MojoClose(MojoHandle handle) {
+  pthread_mutex_lock(&g_mutex);
+  if (!LookupHandle(handle)) {
+    pthread_mutex_unlock(&g_mutex);
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  }
+  ReleaseObject(InvalidateHandle(handle));
+  pthread_mutex_unlock(&g_mutex);
+  return MOJO_RESULT_OK;
+}
+
+MojoResult MojoGetRights(MojoHandle handle, MojoHandleRights* rights) {
+  pthread_mutex_lock(&g_mutex);
+  struct HandleEntry* entry = LookupHandle(handle);
+  if (entry)
+    *rights = entry->rights;
+  pthread_mutex_unlock(&g_mutex);
+  return entry ? MOJO_RESULT_OK : MOJO_RESULT_INVALID_ARGUMENT;
+}
+
+MojoResult MojoReplaceHandleWithReducedRights(MojoHandle handle,
+                                              MojoHandleRights rights_to_remove,
+                                              MojoHandle* replacement_handle) {
+  pthread_mutex_lock(&g_mutex);
+  struct HandleEntry* entry = LookupHandle(handle);
+  if (!entry) {
+    pthread_mutex_unlock(&g_mutex);
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  }
+  // The new handle takes over the old handle's reference.
+  MojoHandle new_handle =
+      AllocHandle(entry->object, entry->rights & ~rights_to_remove);
+  if (new_handle == MOJO_HANDLE_INVALID) {
+    pthread_mutex_unlock(&g_mutex);
+    return MOJO_RESULT_RESOURCE_EXHAUSTED;
+  }
+  InvalidateHandle(handle);
+  pthread_mutex_unlock(&g_mutex);
+  *replacement_handle = new_handle;
+  return MOJO_RESULT_OK;
+}
+
+// Duplicates |handle|, which must be to an object of type |*type| (if |type| is
+// non-null).
+static MojoResult DuplicateHandle(MojoHandle handle,
+                                  const enum ObjectType* type,
+                                  MojoHandleRights rights_to_remove,
+                                  MojoHandle* new_handle) {
+  pthread_mutex_lock(&g_mutex);
+  struct HandleEntry* entry = LookupHandle(handle);
+  MojoResult result = MOJO_RESULT_OK;
+  if (!entry || (type && entry->object->type != *type)) {
+    result = MOJO_RESULT_INVALID_ARGUMENT;
+  } else if (!(entry->rights & MOJO_HANDLE_RIGHT_DUPLICATE)) {
+    result = MOJO_RESULT_PERMISSION_DENIED;
+  } else {
+    struct Object* object = entry->object;
+    MojoHandle h = AllocHandle(object, entry->rights & ~rights_to_remove);
+    if (h == MOJO_HANDLE_INVALID) {
+      result = MOJO_RESULT_RESOURCE_EXHAUSTED;
+    } else {
+      AddRefObject(object);
+      *new_handle = h;
+    }
+  }
+  pthread_mutex_unlock(&g_mutex);
+  return result;
+}
+
+MojoResult MojoDuplicateHandleWithReducedRights(
+    MojoHandle handle,
+    MojoHandleRights rights_to_remove,
+    MojoHandle* new_handle) {
+  return DuplicateHandle(handle, NULL, rights_to_remove, new_handle);
+}
+
+MojoResult MojoDuplicateHandle(MojoHandle handle, MojoHandle* new_handle) {
+  return DuplicateHandle(handle, NULL, MOJO_HANDLE_RIGHT_NONE, new_handle);
+}
+
+// time.h ----------------------------------------------------------------------
+
+MojoTimeTicks MojoGetTimeTicksNow() {
+  return GetTimeTicksNow();
+}
+
+// wait.h ----------------------------------------------------------------------
+
+MojoResult MojoWait(MojoHandle handle,
+                    MojoHandleSignals signals,
+                    MojoDeadline deadline,
+                    struct MojoHandleSignalsState* signals_state) {
+  return MojoWaitMany(&handle, &signals, 1u, deadline, NULL, signals_state);
+}
+
+MojoResult MojoWaitMany(const MojoHandle* handles,
+                        const MojoHandleSignals* signals,
+                        uint32_t num_handles,
+                        MojoDeadline deadline,
+                        uint32_t* result_index,
+                        struct MojoHandleSignalsState* signals_states) {
+  MojoTimeTicks end_time = DeadlineToEndTime(deadline);
+  struct Waiter waiter;
+  InitWaiter(&waiter);
+
+  if (!num_handles) {
+    pthread_mutex_lock(&g_mutex);
+    while (end_time == END_TIME_INFINITE || GetTimeTicksNow() < end_time) {
+      __atomic_store_n(&waiter.state, WAITER_AWAKE, __ATOMIC_RELAXED);
+      Sleep(&waiter, end_time);
+    }
+    pthread_mutex_unlock(&g_mutex);
+    return MOJO_RESULT_DEADLINE_EXCEEDED;
+  }
+
+  struct WaiterWatch stack_watches[WAIT_MANY_STACK_WATCHES];
+  struct WaiterWatch* watches = stack_watches;
+  if (num_handles > WAIT_MANY_STACK_WATCHES) {
+    watches = (struct WaiterWatch*)malloc(num_handles *
+                                          sizeof(struct WaiterWatch));
+    if (!watches)
+      return MOJO_RESULT_RESOURCE_EXHAUSTED;
+  }
+
+  pthread_mutex_lock(&g_mutex);
+  for (uint32_t i = 0u; i < num_handles; i++) {
+    struct HandleEntry* entry = LookupHandle(handles[i]);
+    if (!entry) {
+      pthread_mutex_unlock(&g_mutex);
+      if (watches != stack_watches)
+        free(watches);
+      if (result_index)
+        *result_index = i;
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    }
+    watches[i].watch.object = NULL;
+    watches[i].waiter = &waiter;
+    watches[i].object = entry->object;
+    watches[i].index = i;
+  }
+
+  MojoResult result;
+  bool watching = false;
+  for (;;) {
+    __atomic_store_n(&waiter.state, WAITER_AWAKE, __ATOMIC_RELAXED);
+
+    // (Check the signals states before checking for cancellation, so that a
+    // wait that was satisfied, or became unsatisfiable, before a handle was
+    // closed reports that instead.)
+    result = MOJO_RESULT_DEADLINE_EXCEEDED;
+    for (uint32_t i = 0u; i < num_handles; i++) {
+      struct MojoHandleSignalsState state = GetSignalsState(watches[i].object);
+      if (signals_states)
+        signals_states[i] = state;
+      if (result != MOJO_RESULT_DEADLINE_EXCEEDED)
+        continue;
+      if (state.satisfied_signals & signals[i])
+        result = MOJO_RESULT_OK;
+      else if (!(state.satisfiable_signals & signals[i]))
+        result = MOJO_RESULT_FAILED_PRECONDITION;
+      else
+        continue;
+      if (result_index)
+        *result_index = i;
+      if (!signals_states)
+        break;
+    }
+    if (result != MOJO_RESULT_DEADLINE_EXCEEDED)
+      break;
+    if (waiter.cancelled) {
+      result = MOJO_RESULT_CANCELLED;
+      if (result_index)
+        *result_index = waiter.cancelled_index;
+      break;
+    }
+    if (end_time != END_TIME_INFINITE && GetTimeTicksNow() >= end_time)
+      break;
+
+    if (!watching) {
+      for (uint32_t i = 0u; i < num_handles; i++) {
+        AddRefObject(watches[i].object);
+        AddWatch(watches[i].object, &watches[i].watch, handles[i],
+                 &NotifyWaiter);
+      }
+      watching = true;
+      // Check again, since a message may have been written (without
+      // |g_mutex|) before the watches were added.
+      continue;
+    }
+    Sleep(&waiter, end_time);
+  }
+
+  if (result == MOJO_RESULT_CANCELLED && signals_states) {
+    for (uint32_t i = 0u; i < num_handles; i++) {
+      if (watches[i].watch.object) {
+        signals_states[i] = GetSignalsState(watches[i].object);
+      } else {
+        signals_states[i].satisfied_signals = MOJO_HANDLE_SIGNAL_NONE;
+        signals_states[i].satisfiable_signals = MOJO_HANDLE_SIGNAL_NONE;
+      }
+    }
+  }
+
+  if (watching) {
+    for (uint32_t i = 0u; i < num_handles; i++) {
+      RemoveWatch(&watches[i].watch);
+      ReleaseObject(watches[i].object);
+    }
+  }
+  pthread_mutex_unlock(&g_mutex);
+
+  if (watches != stack_watches)
+    free(watches);
+  return result;
+}
+
+// message_pipe.h --------------------------------------------------------------
+
+MojoResult MojoCreateMessagePipe(
+    const struct MojoCreateMessagePipeOptions* options,
+    MojoHandle* message_pipe_handle0,
+    MojoHandle* message_pipe_handle1) {
+  if (options) {
+    if (options->struct_size <
+        EXTENT_OF(struct MojoCreateMessagePipeOptions, struct_size))
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    if (options->struct_size >=
+            EXTENT_OF(struct MojoCreateMessagePipeOptions, flags) &&
+        options->flags != MOJO_CREATE_MESSAGE_PIPE_OPTIONS_FLAG_NONE)
+      return MOJO_RESULT_UNIMPLEMENTED;
+  }
+
+  pthread_mutex_lock(&g_mutex);
+  struct MessagePipe* message_pipe = g_free_message_pipes;
+  if (message_pipe) {
+    g_free_message_pipes = message_pipe->next_free;
+  } else {
+    message_pipe = (struct MessagePipe*)malloc(sizeof(struct MessagePipe));
+    if (!message_pipe) {
+      pthread_mutex_unlock(&g_mutex);
+      return MOJO_RESULT_RESOURCE_EXHAUSTED;
+    }
+    if (!InitMessageQueue(&message_pipe->endpoints[0].queue)) {
+      pthread_mutex_unlock(&g_mutex);
+      free(message_pipe);
+      return MOJO_RESULT_RESOURCE_EXHAUSTED;
+    }
+    if (!InitMessageQueue(&message_pipe->endpoints[1].queue)) {
+      pthread_mutex_unlock(&g_mutex);
+      free(message_pipe->endpoints[0].queue.producer_node);
+      free(message_pipe);
+      return MOJO_RESULT_RESOURCE_EXHAUSTED;
+    }
+    for (int i = 0; i < 2; i++) {
+      message_pipe->endpoints[i].message_pipe = message_pipe;
+      message_pipe->endpoints[i].peer = &message_pipe->endpoints[1 - i];
+      message_pipe->endpoints[i].producer_busy = 0u;
+      message_pipe->endpoints[i].consumer_busy = 0u;
+    }
+  }
+  // (A reused message pipe's queues are empty, but its roles may still briefly
+  // be held by threads that looked up handles to its previous endpoints.)
+  struct MessagePipeEndpoint* endpoint0 = &message_pipe->endpoints[0];
+  struct MessagePipeEndpoint* endpoint1 = &message_pipe->endpoints[1];
+  InitObject(&endpoint0->object, OBJECT_TYPE_MESSAGE_PIPE_ENDPOINT);
+  __atomic_store_n(&endpoint0->is_open, true, __ATOMIC_RELEASE);
+  InitObject(&endpoint1->object, OBJECT_TYPE_MESSAGE_PIPE_ENDPOINT);
+  __atomic_store_n(&endpoint1->is_open, true, __ATOMIC_RELEASE);
+
+  MojoResult result = AllocHandlePair(
+      &endpoint0->object, DEFAULT_MESSAGE_PIPE_HANDLE_RIGHTS,
+      &endpoint1->object, DEFAULT_MESSAGE_PIPE_HANDLE_RIGHTS,
+      message_pipe_handle0, message_pipe_handle1);
+  pthread_mutex_unlock(&g_mutex);
+  return result;
+}
+
+// Tries to write |message| (which has no handles) without taking |g_mutex|
+// (except to notify watches). Returns false if it can't, in which case
+// |message| is still the caller's; otherwise |*result| is set.
+static bool WriteMessageWithoutLock(MojoHandle message_pipe_handle,
+                                    struct Message* message,
+                                    MojoResult* result) {
+  struct HandleEntry* entry;
+  struct MessagePipeEndpoint* endpoint = LookupMessagePipeEndpointWithoutLock(
+      message_pipe_handle, MOJO_HANDLE_RIGHT_WRITE, &entry);
+  if (!endpoint)
+    return false;
+  struct MessagePipeEndpoint* peer = endpoint->peer;
+  if (!TryAcquireRole(&peer->producer_busy))
+    return false;
+  if (!IsHandleStillValid(entry, message_pipe_handle)) {
+    ReleaseRole(&peer->producer_busy);
+    return false;
+  }
+
+  struct MessageQueueNode* node = NULL;
+  if (!__atomic_load_n(&peer->is_open, __ATOMIC_ACQUIRE)) {
+    *result = MOJO_RESULT_FAILED_PRECONDITION;
+  } else if (!(node = AllocMessageQueueNode(&peer->queue))) {
+    *result = MOJO_RESULT_RESOURCE_EXHAUSTED;
+  } else {
+    PushMessage(&peer->queue, node, message);
+    *result = MOJO_RESULT_OK;
+  }
+  ReleaseRole(&peer->producer_busy);
+  if (!node) {
+    free(message);
+    return true;
+  }
+
+  // Anything watching the peer has to be notified with |g_mutex| held. (By
+  // then, the peer may have been destroyed, or even reused, in which case the
+  // notification is merely spurious.)
+  if (__atomic_load_n(&peer->object.num_watches, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&g_mutex);
+    NotifyWatches(&peer->object);
+    pthread_mutex_unlock(&g_mutex);
+  }
+  return true;
+}
+
+// Writes a message consisting of the concatenation of the given segments (whose
+// total size, |num_bytes|, has already been checked).
+static MojoResult WriteMessage(MojoHandle message_pipe_handle,
+                               const struct MojoMessageSegment* segments,
+                               uint32_t num_segments,
+                               uint32_t num_bytes,
+                               const MojoHandle* handles,
+                               uint32_t num_handles) {
+  if (num_handles && !handles)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  if (num_bytes > MAX_MESSAGE_NUM_BYTES)
+    return MOJO_RESULT_OUT_OF_RANGE;
+  if (num_handles > MAX_MESSAGE_NUM_HANDLES)
+    return MOJO_RESULT_RESOURCE_EXHAUSTED;
+
+  // Allocate (and fill in the bytes of) the message before taking the lock.
+  struct Message* message = (struct Message*)malloc(
+      sizeof(struct Message) + num_handles * sizeof(struct TransferredHandle) +
+      num_bytes);
+  if (!message)
+    return MOJO_RESULT_RESOURCE_EXHAUSTED;
+  message->num_bytes = num_bytes;
+  message->num_handles = num_handles;
+  char* cursor = MessageBytes(message);
+  for (uint32_t i = 0u; i < num_segments; i++) {
+    if (segments[i].num_bytes) {
+      memcpy(cursor, segments[i].bytes, segments[i].num_bytes);
+      cursor += segments[i].num_bytes;
+    }
+  }
+
+  MojoResult result;
+  if (!num_handles &&
+      WriteMessageWithoutLock(message_pipe_handle, message, &result))
+    return result;
+
+  pthread_mutex_lock(&g_mutex);
+  struct Object* object;
+  result = LookupObject(message_pipe_handle, OBJECT_TYPE_MESSAGE_PIPE_ENDPOINT,
+                        MOJO_HANDLE_RIGHT_WRITE, &object);
+  struct MessagePipeEndpoint* endpoint =
+      result == MOJO_RESULT_OK
+          ? CONTAINER_OF(object, struct MessagePipeEndpoint, object)
+          : NULL;
+
+  // Check the handles to be sent.
+  uint32_t num_checked_handles = 0u;
+  for (; result == MOJO_RESULT_OK && num_checked_handles < num_handles;
+       num_checked_handles++) {
+    MojoHandle handle = handles[num_checked_handles];
+    struct HandleEntry* entry = LookupHandle(handle);
+    if (!entry) {
+      result = MOJO_RESULT_INVALID_ARGUMENT;
+    } else if (handle == message_pipe_handle || entry->being_sent) {
+      result = MOJO_RESULT_BUSY;
+    } else if (!(entry->rights & MOJO_HANDLE_RIGHT_TRANSFER)) {
+      result = MOJO_RESULT_PERMISSION_DENIED;
+    } else {
+      entry->being_sent = true;
+      continue;
+    }
+    break;
+  }
+  for (uint32_t i = 0u; i < num_checked_handles; i++)
+    LookupHandle(handles[i])->being_sent = false;
+  if (result == MOJO_RESULT_OK && !endpoint->peer->is_open)
+    result = MOJO_RESULT_FAILED_PRECONDITION;
+
+  struct MessagePipeEndpoint* peer = result == MOJO_RESULT_OK ? endpoint->peer
+                                                              : NULL;
+  struct MessageQueueNode* node = NULL;
+  if (peer) {
+    AcquireRole(&peer->producer_busy);
+    node = AllocMessageQueueNode(&peer->queue);
+    if (!node) {
+      ReleaseRole(&peer->producer_busy);
+      result = MOJO_RESULT_RESOURCE_EXHAUSTED;
+    }
+  }
+  if (result != MOJO_RESULT_OK) {
+    pthread_mutex_unlock(&g_mutex);
+    free(message);
+    return result;
+  }
+
+  // Move the handles into the message.
+  struct TransferredHandle* transferred_handles = MessageHandles(message);
+  for (uint32_t i = 0u; i < num_handles; i++) {
+    transferred_handles[i].rights = LookupHandle(handles[i])->rights;
+    transferred_handles[i].object = InvalidateHandle(handles[i]);
+  }
+
+  PushMessage(&peer->queue, node, message);
+  ReleaseRole(&peer->producer_busy);
+  NotifyWatches(&peer->object);
+  pthread_mutex_unlock(&g_mutex);
+  return MOJO_RESULT_OK;
+}
+
+MojoResult MojoWriteMessage(MojoHandle message_pipe_handle,
+                            const void* bytes,
+                            uint32_t num_bytes,
+                            const MojoHandle* handles,
+                            uint32_t num_handles,
+                            MojoWriteMessageFlags flags) {
+  if (num_bytes && !bytes)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  struct MojoMessageSegment segment = {bytes, num_bytes};
+  return WriteMessage(message_pipe_handle, &segment, 1u, num_bytes, handles,
+                      num_handles);
+}
+
+MojoResult MojoWriteMessageV(MojoHandle message_pipe_handle,
+                             const struct MojoMessageSegment* segments,
+                             uint32_t num_segments,
+                             const MojoHandle* handles,
+                             uint32_t num_handles,
+                             MojoWriteMessageFlags flags) {
+  if (num_segments && !segments)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+
+  uint32_t num_bytes = 0u;
+  for (uint32_t i = 0u; i < num_segments; i++) {
+    if (segments[i].num_bytes && !segments[i].bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    if (segments[i].num_bytes > UINT32_MAX - num_bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    num_bytes += segments[i].num_bytes;
+  }
+
+  // Messages are always copied (once) into memory of their own, so the
+  // segments are gathered directly into it.
+  return WriteMessage(message_pipe_handle, segments, num_segments, num_bytes,
+                      handles, num_handles);
+}
+
+// Tries to read a message (which must not have handles) without taking
+// |g_mutex|. Returns false if it can't; otherwise |*result| is set.
+static bool ReadMessageWithoutLock(MojoHandle message_pipe_handle,
+                                   void* bytes,
+                                   uint32_t* num_bytes,
+                                   uint32_t bytes_capacity,
+                                   uint32_t* num_handles,
+                                   MojoReadMessageFlags flags,
+                                   MojoResult* result) {
+  struct HandleEntry* entry;
+  struct MessagePipeEndpoint* endpoint = LookupMessagePipeEndpointWithoutLock(
+      message_pipe_handle, MOJO_HANDLE_RIGHT_READ, &entry);
+  if (!endpoint)
+    return false;
+  if (!TryAcquireRole(&endpoint->consumer_busy))
+    return false;
+  if (!IsHandleStillValid(entry, message_pipe_handle)) {
+    ReleaseRole(&endpoint->consumer_busy);
+    return false;
+  }
+
+  struct Message* message = PeekMessage(&endpoint->queue);
+  bool peer_is_open = true;
+  if (!message) {
+    // A message may have been written just before the peer was closed.
+    peer_is_open = __atomic_load_n(&endpoint->peer->is_open, __ATOMIC_ACQUIRE);
+    if (!peer_is_open)
+      message = PeekMessage(&endpoint->queue);
+  }
+  if (message && message->num_handles) {
+    ReleaseRole(&endpoint->consumer_busy);
+    return false;
+  }
+
+  bool fits = false;
+  if (!message) {
+    *result = peer_is_open ? MOJO_RESULT_SHOULD_WAIT
+                           : MOJO_RESULT_FAILED_PRECONDITION;
+  } else {
+    if (num_bytes)
+      *num_bytes = message->num_bytes;
+    if (num_handles)
+      *num_handles = 0u;
+    fits = message->num_bytes <= bytes_capacity;
+    if (fits || (flags & MOJO_READ_MESSAGE_FLAG_MAY_DISCARD))
+      PopMessage(&endpoint->queue);
+    else
+      message = NULL;
+    *result = fits ? MOJO_RESULT_OK : MOJO_RESULT_RESOURCE_EXHAUSTED;
+  }
+  ReleaseRole(&endpoint->consumer_busy);
+
+  if (message) {
+    if (fits && message->num_bytes)
+      memcpy(bytes, MessageBytes(message), message->num_bytes);
+    free(message);
+  }
+  return true;
+}
+
+MojoResult MojoReadMessage(MojoHandle message_pipe_handle,
+                           void* bytes,
+                           uint32_t* num_bytes,
+                           MojoHandle* handles,
+                           uint32_t* num_handles,
+                           MojoReadMessageFlags flags) {
+  uint32_t bytes_capacity = bytes && num_bytes ? *num_bytes : 0u;
+  uint32_t handles_capacity = handles && num_handles ? *num_handles : 0u;
+
+  MojoResult result;
+  if (ReadMessageWithoutLock(message_pipe_handle, bytes, num_bytes,
+                             bytes_capacity, num_handles, flags, &result))
+    return result;
+
+  pthread_mutex_lock(&g_mutex);
+  struct Object* object;
+  result = LookupObject(message_pipe_handle, OBJECT_TYPE_MESSAGE_PIPE_ENDPOINT,
+                        MOJO_HANDLE_RIGHT_READ, &object);
+  if (result != MOJO_RESULT_OK) {
+    pthread_mutex_unlock(&g_mutex);
+    return result;
+  }
+  struct MessagePipeEndpoint* endpoint =
+      CONTAINER_OF(object, struct MessagePipeEndpoint, object);
+
+  AcquireRole(&endpoint->consumer_busy);
+  struct Message* message = PeekMessage(&endpoint->queue);
+  if (!message) {
+    ReleaseRole(&endpoint->consumer_busy);
+    pthread_mutex_unlock(&g_mutex);
+    return endpoint->peer->is_open ? MOJO_RESULT_SHOULD_WAIT
+                                   : MOJO_RESULT_FAILED_PRECONDITION;
+  }
+  if (num_bytes)
+    *num_bytes = message->num_bytes;
+  if (num_handles)
+    *num_handles = message->num_handles;
+
+  bool fits = message->num_bytes <= bytes_capacity &&
+              message->num_handles <= handles_capacity;
+  if (fits) {
+    // Add all the handles (or none, leaving the message in place).
+    struct TransferredHandle* transferred_handles = MessageHandles(message);
+    for (uint32_t i = 0u; i < message->num_handles; i++) {
+      handles[i] = AllocHandle(transferred_handles[i].object,
+                               transferred_handles[i].rights);
+      if (handles[i] == MOJO_HANDLE_INVALID) {
+        ReleaseRole(&endpoint->consumer_busy);
+        while (i--)
+          InvalidateHandle(handles[i]);
+        pthread_mutex_unlock(&g_mutex);
+        return MOJO_RESULT_RESOURCE_EXHAUSTED;
+      }
+    }
+  } else if (!(flags & MOJO_READ_MESSAGE_FLAG_MAY_DISCARD)) {
+    ReleaseRole(&endpoint->consumer_busy);
+    pthread_mutex_unlock(&g_mutex);
+    return MOJO_RESULT_RESOURCE_EXHAUSTED;
+  }
+
+  PopMessage(&endpoint->queue);
+  ReleaseRole(&endpoint->consumer_busy);
+  if (!fits) {
+    DestroyMessage(message);
+    pthread_mutex_unlock(&g_mutex);
+    return MOJO_RESULT_RESOURCE_EXHAUSTED;
+  }
+  pthread_mutex_unlock(&g_mutex);
+
+  if (message->num_bytes)
+    memcpy(bytes, MessageBytes(message), message->num_bytes);
+  free(message);
+  return MOJO_RESULT_OK;
+}
+
+// data_pipe.h -----------------------------------------------------------------
+
+MojoResult MojoCreateDataPipe(const struct MojoCreateDataPipeOptions* options,
+                              MojoHandle* data_pipe_producer_handle,
+                              MojoHandle* data_pipe_consumer_handle) {
+  uint32_t element_num_bytes = 1u;
+  uint32_t capacity_num_bytes = 0u;
+  if (options) {
+    if (options->struct_size <
+        EXTENT_OF(struct MojoCreateDataPipeOptions, struct_size))
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    if (options->struct_size >=
+            EXTENT_OF(struct MojoCreateDataPipeOptions, flags) &&
+        options->flags != MOJO_CREATE_DATA_PIPE_OPTIONS_FLAG_NONE)
+      return MOJO_RESULT_UNIMPLEMENTED;
+    if (options->struct_size >=
+        EXTENT_OF(struct MojoCreateDataPipeOptions, element_num_bytes)) {
+      element_num_bytes = options->element_num_bytes;
+      if (!element_num_bytes)
+        return MOJO_RESULT_INVALID_ARGUMENT;
+    }
+    if (options->struct_size >=
+        EXTENT_OF(struct MojoCreateDataPipeOptions, capacity_num_bytes)) {
+      capacity_num_bytes = options->capacity_num_bytes;
+      if (capacity_num_bytes % element_num_bytes)
+        return MOJO_RESULT_INVALID_ARGUMENT;
+    }
+  }
+  if (!capacity_num_bytes) {
+    capacity_num_bytes = DEFAULT_DATA_PIPE_CAPACITY_NUM_BYTES -
+                         DEFAULT_DATA_PIPE_CAPACITY_NUM_BYTES %
+                             element_num_bytes;
+    if (!capacity_num_bytes)
+      capacity_num_bytes = element_num_bytes;
+  }
+  if (capacity_num_bytes > MAX_DATA_PIPE_CAPACITY_NUM_BYTES)
+    return MOJO_RESULT_RESOURCE_EXHAUSTED;
+
+  struct DataPipe* data_pipe =
+      (struct DataPipe*)malloc(sizeof(struct DataPipe));
+  char* buffer = (char*)malloc(capacity_num_bytes);
+  if (!data_pipe || !buffer) {
+    free(data_pipe);
+    free(buffer);
+    return MOJO_RESULT_RESOURCE_EXHAUSTED;
+  }
+  InitObject(&data_pipe->producer, OBJECT_TYPE_DATA_PIPE_PRODUCER);
+  InitObject(&data_pipe->consumer, OBJECT_TYPE_DATA_PIPE_CONSUMER);
+  data_pipe->producer_open = true;
+  data_pipe->consumer_open = true;
+  data_pipe->element_num_bytes = element_num_bytes;
+  data_pipe->capacity_num_bytes = capacity_num_bytes;
+  data_pipe->write_threshold_num_bytes = 0u;
+  data_pipe->read_threshold_num_bytes = 0u;
+  data_pipe->buffer = buffer;
+  data_pipe->read_offset = 0u;
+  data_pipe->num_bytes = 0u;
+  data_pipe->two_phase_write_num_bytes = 0u;
+  data_pipe->two_phase_read_num_bytes = 0u;
+
+  pthread_mutex_lock(&g_mutex);
+  MojoResult result = AllocHandlePair(
+      &data_pipe->producer, DEFAULT_DATA_PIPE_PRODUCER_HANDLE_RIGHTS,
+      &data_pipe->consumer, DEFAULT_DATA_PIPE_CONSUMER_HANDLE_RIGHTS,
+      data_pipe_producer_handle, data_pipe_consumer_handle);
+  pthread_mutex_unlock(&g_mutex);
+  return result;
+}
+
+MojoResult MojoSetDataPipeProducerOptions(
+    MojoHandle data_pipe_producer_handle,
+    const struct MojoDataPipeProducerOptions* options) {
+  uint32_t write_threshold_num_bytes = 0u;
+  if (options) {
+    if (options->struct_size <
+        EXTENT_OF(struct MojoDataPipeProducerOptions, struct_size))
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    if (options->struct_size >=
+        EXTENT_OF(struct MojoDataPipeProducerOptions,
+                  write_threshold_num_bytes))
+      write_threshold_num_bytes = options->write_threshold_num_bytes;
+  }
+
+  pthread_mutex_lock(&g_mutex);
+  struct Object* object;
+  MojoResult result =
+      LookupObject(data_pipe_producer_handle, OBJECT_TYPE_DATA_PIPE_PRODUCER,
+                   MOJO_HANDLE_RIGHT_SET_OPTIONS, &object);
+  if (result == MOJO_RESULT_OK) {
+    struct DataPipe* data_pipe =
+        CONTAINER_OF(object, struct DataPipe, producer);
+    if (write_threshold_num_bytes % data_pipe->element_num_bytes) {
+      result = MOJO_RESULT_INVALID_ARGUMENT;
+    } else {
+      data_pipe->write_threshold_num_bytes = write_threshold_num_bytes;
+      NotifyWatches(object);
+    }
+  }
+  pthread_mutex_unlock(&g_mutex);
+  return result;
+}
+
+MojoResult MojoGetDataPipeProducerOptions(
+    MojoHandle data_pipe_producer_handle,
+    struct MojoDataPipeProducerOptions* options,
+    uint32_t options_num_bytes) {
+  if (!options ||
+      options_num_bytes < sizeof(struct MojoDataPipeProducerOptions))
+    return MOJO_RESULT_INVALID_ARGUMENT;
+
+  pthread_mutex_lock(&g_mutex);
+  struct Object* object;
+  MojoResult result =
+      LookupObject(data_pipe_producer_handle, OBJECT_TYPE_DATA_PIPE_PRODUCER,
+                   MOJO_HANDLE_RIGHT_GET_OPTIONS, &object);
+  if (result == MOJO_RESULT_OK) {
+    options->struct_size = sizeof(struct MojoDataPipeProducerOptions);
+    options->write_threshold_num_bytes =
+        CONTAINER_OF(object, struct DataPipe, producer)
+            ->write_threshold_num_bytes;
+  }
+  pthread_mutex_unlock(&g_mutex);
+  return result;
+}
+
+// Looks up a data pipe producer or consumer, with the given right.
+static MojoResult LookupDataPipe(MojoHandle handle,
+                                 enum ObjectType type,
+                                 MojoHandleRights required_right,
+                                 struct DataPipe** data_pipe) {
+  struct Object* object;
+  MojoResult result = LookupObject(handle, type, required_right, &object);
+  if (result != MOJO_RESULT_OK)
+    return result;
+  *data_pipe = type == OBJECT_TYPE_DATA_PIPE_PRODUCER
+                   ? CONTAINER_OF(object, struct DataPipe, producer)
+                   : CONTAINER_OF(object, struct DataPipe, consumer);
+  return MOJO_RESULT_OK;
+}
+
+// Checks the flags given to |MojoWriteData()| or |MojoWriteDataV()|.
+static MojoResult CheckWriteDataFlags(MojoWriteDataFlags flags) {
+  if (flags &
+      ~(MOJO_WRITE_DATA_FLAG_ALL_OR_NONE | MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES))
+    return MOJO_RESULT_UNIMPLEMENTED;
+  // This only applies to two-phase writes.
+  if (flags & MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  return MOJO_RESULT_OK;
+}
+
+// Writes (up to) |*num_bytes| bytes, the total size of the given segments
+// (which, like |flags|, have already been checked), setting |*num_bytes| to the
+// amount written.
+static MojoResult WriteData(MojoHandle data_pipe_producer_handle,
+                            const struct MojoWriteDataSegment* segments,
+                            uint32_t num_segments,
+                            uint32_t* num_bytes,
+                            MojoWriteDataFlags flags) {
+  pthread_mutex_lock(&g_mutex);
+  struct DataPipe* data_pipe;
+  MojoResult result =
+      LookupDataPipe(data_pipe_producer_handle, OBJECT_TYPE_DATA_PIPE_PRODUCER,
+                     MOJO_HANDLE_RIGHT_WRITE, &data_pipe);
+  if (result != MOJO_RESULT_OK)
+    goto out;
+  if (data_pipe->two_phase_write_num_bytes) {
+    result = MOJO_RESULT_BUSY;
+    goto out;
+  }
+  if (*num_bytes % data_pipe->element_num_bytes) {
+    result = MOJO_RESULT_INVALID_ARGUMENT;
+    goto out;
+  }
+  if (!data_pipe->consumer_open) {
+    result = MOJO_RESULT_FAILED_PRECONDITION;
+    goto out;
+  }
+
+  uint32_t available = data_pipe->capacity_num_bytes - data_pipe->num_bytes;
+  if ((flags & MOJO_WRITE_DATA_FLAG_ALL_OR_NONE) && *num_bytes > available) {
+    result = MOJO_RESULT_OUT_OF_RANGE;
+    goto out;
+  }
+  if (!*num_bytes)
+    goto out;
+  if (!available) {
+    result = MOJO_RESULT_SHOULD_WAIT;
+    goto out;
+  }
+
+  if (*num_bytes > available)
+    *num_bytes = available;
+  if (!data_pipe->num_bytes)
+    data_pipe->read_offset = 0u;
+  uint32_t offset = DataPipeWriteOffset(data_pipe);
+  uint32_t num_bytes_left = *num_bytes;
+  for (uint32_t i = 0u; num_bytes_left; i++) {
+    uint32_t segment_num_bytes = segments[i].num_bytes < num_bytes_left
+                                     ? segments[i].num_bytes
+                                     : num_bytes_left;
+    if (!segment_num_bytes)
+      continue;
+    CopyToDataPipe(data_pipe, offset, (const char*)segments[i].bytes,
+                   segment_num_bytes);
+    offset = (offset + segment_num_bytes) % data_pipe->capacity_num_bytes;
+    num_bytes_left -= segment_num_bytes;
+  }
+  data_pipe->num_bytes += *num_bytes;
+  NotifyWatches(&data_pipe->consumer);
+
+out:
+  pthread_mutex_unlock(&g_mutex);
+  return result;
+}
+
+MojoResult MojoWriteData(MojoHandle data_pipe_producer_handle,
+                         const void* elements,
+                         uint32_t* num_bytes,
+                         MojoWriteDataFlags flags) {
+  if (!num_bytes)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  MojoResult result = CheckWriteDataFlags(flags);
+  if (result != MOJO_RESULT_OK)
+    return result;
+  struct MojoWriteDataSegment segment = {elements, *num_bytes};
+  return WriteData(data_pipe_producer_handle, &segment, 1u, num_bytes, flags);
+}
+
+MojoResult MojoWriteDataV(MojoHandle data_pipe_producer_handle,
+                          const struct MojoWriteDataSegment* segments,
+                          uint32_t num_segments,
+                          uint32_t* num_bytes,
+                          MojoWriteDataFlags flags) {
+  if (!num_bytes)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  MojoResult result = CheckWriteDataFlags(flags);
+  if (result != MOJO_RESULT_OK)
+    return result;
+  if (num_segments && !segments)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+
+  uint32_t total_num_bytes = 0u;
+  for (uint32_t i = 0u; i < num_segments; i++) {
+    if (segments[i].num_bytes && !segments[i].bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    if (segments[i].num_bytes > UINT32_MAX - total_num_bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    total_num_bytes += segments[i].num_bytes;
+  }
+
+  // The segments are copied directly into the data pipe's buffer.
+  *num_bytes = total_num_bytes;
+  return WriteData(data_pipe_producer_handle, segments, num_segments,
+                   num_bytes, flags);
+}
+
+MojoResult MojoBeginWriteData(MojoHandle data_pipe_producer_handle,
+                              void** buffer,
+                              uint32_t* buffer_num_bytes,
+                              MojoWriteDataFlags flags) {
+  pthread_mutex_lock(&g_mutex);
+  struct DataPipe* data_pipe;
+  MojoResult result =
+      LookupDataPipe(data_pipe_producer_handle, OBJECT_TYPE_DATA_PIPE_PRODUCER,
+                     MOJO_HANDLE_RIGHT_WRITE, &data_pipe);
+  if (result != MOJO_RESULT_OK)
+    goto out;
+  if ((flags & ~MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES) ||
+      ((flags & MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES) &&
+       (!*buffer_num_bytes ||
+        *buffer_num_bytes % data_pipe->element_num_bytes))) {
+    result = MOJO_RESULT_INVALID_ARGUMENT;
+    goto out;
+  }
+  if (data_pipe->two_phase_write_num_bytes) {
+    result = MOJO_RESULT_BUSY;
+    goto out;
+  }
+  if (!data_pipe->consumer_open) {
+    result = MOJO_RESULT_FAILED_PRECONDITION;
+    goto out;
+  }
+
+  uint32_t available = data_pipe->capacity_num_bytes - data_pipe->num_bytes;
+  if (!available) {
+    result = MOJO_RESULT_SHOULD_WAIT;
+    goto out;
+  }
+
+  // Offer as much contiguous space as possible (up to the maximum, if any).
+  if (!data_pipe->num_bytes)
+    data_pipe->read_offset = 0u;
+  uint32_t write_offset = DataPipeWriteOffset(data_pipe);
+  if (available > data_pipe->capacity_num_bytes - write_offset)
+    available = data_pipe->capacity_num_bytes - write_offset;
+  if ((flags & MOJO_WRITE_DATA_FLAG_MAX_NUM_BYTES) &&
+      available > *buffer_num_bytes)
+    available = *buffer_num_bytes;
+  data_pipe->two_phase_write_num_bytes = available;
+  *buffer = data_pipe->buffer + write_offset;
+  *buffer_num_bytes = available;
+
+out:
+  pthread_mutex_unlock(&g_mutex);
+  return result;
+}
+
+MojoResult MojoEndWriteData(MojoHandle data_pipe_producer_handle,
+                            uint32_t num_bytes_written) {
+  pthread_mutex_lock(&g_mutex);
+  struct DataPipe* data_pipe;
+  MojoResult result =
+      LookupDataPipe(data_pipe_producer_handle, OBJECT_TYPE_DATA_PIPE_PRODUCER,
+                     MOJO_HANDLE_RIGHT_WRITE, &data_pipe);
+  if (result != MOJO_RESULT_OK)
+    goto out;
+  if (!data_pipe->two_phase_write_num_bytes) {
+    result = MOJO_RESULT_FAILED_PRECONDITION;
+    goto out;
+  }
+
+  if (num_bytes_written > data_pipe->two_phase_write_num_bytes ||
+      num_bytes_written % data_pipe->element_num_bytes) {
+    result = MOJO_RESULT_INVALID_ARGUMENT;
+  } else if (num_bytes_written) {
+    data_pipe->num_bytes += num_bytes_written;
+    NotifyWatches(&data_pipe->consumer);
+  }
+  data_pipe->two_phase_write_num_bytes = 0u;
+  NotifyWatches(&data_pipe->producer);
+
+out:
+  pthread_mutex_unlock(&g_mutex);
+  return result;
+}
+
+MojoResult MojoSetDataPipeConsumerOptions(
+    MojoHandle data_pipe_consumer_handle,
+    const struct MojoDataPipeConsumerOptions* options) {
+  uint32_t read_threshold_num_bytes = 0u;
+  if (options) {
+    if (options->struct_size <
+        EXTENT_OF(struct MojoDataPipeConsumerOptions, struct_size))
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    if (options->struct_size >=
+        EXTENT_OF(struct MojoDataPipeConsumerOptions, read_threshold_num_bytes))
+      read_threshold_num_bytes = options->read_threshold_num_bytes;
+  }
+
+  pthread_mutex_lock(&g_mutex);
+  struct Object* object;
+  MojoResult result =
+      LookupObject(data_pipe_consumer_handle, OBJECT_TYPE_DATA_PIPE_CONSUMER,
+                   MOJO_HANDLE_RIGHT_SET_OPTIONS, &object);
+  if (result == MOJO_RESULT_OK) {
+    struct DataPipe* data_pipe =
+        CONTAINER_OF(object, struct DataPipe, consumer);
+    if (read_threshold_num_bytes % data_pipe->element_num_bytes) {
+      result = MOJO_RESULT_INVALID_ARGUMENT;
+    } else {
+      data_pipe->read_threshold_num_bytes = read_threshold_num_bytes;
+      NotifyWatches(object);
+    }
+  }
+  pthread_mutex_unlock(&g_mutex);
+  return result;
+}
+
+MojoResult MojoGetDataPipeConsumerOptions(
+    MojoHandle data_pipe_consumer_handle,
+    struct MojoDataPipeConsumerOptions* options,
+    uint32_t options_num_bytes) {
+  if (!options ||
+      options_num_bytes < sizeof(struct MojoDataPipeConsumerOptions))
+    return MOJO_RESULT_INVALID_ARGUMENT;
+
+  pthread_mutex_lock(&g_mutex);
+  struct Object* object;
+  MojoResult result =
+      LookupObject(data_pipe_consumer_handle, OBJECT_TYPE_DATA_PIPE_CONSUMER,
+                   MOJO_HANDLE_RIGHT_GET_OPTIONS, &object);
+  if (result == MOJO_RESULT_OK) {
+    options->struct_size = sizeof(struct MojoDataPipeConsumerOptions);
+    options->read_threshold_num_bytes =
+        CONTAINER_OF(object, struct DataPipe, consumer)
+            ->read_threshold_num_bytes;
+  }
+  pthread_mutex_unlock(&g_mutex);
+  return result;
+}
+
+// Checks the flags given to |MojoReadData()| or |MojoReadDataV()|.
+static MojoResult CheckReadDataFlags(MojoReadDataFlags flags) {
+  if (flags & ~(MOJO_READ_DATA_FLAG_ALL_OR_NONE | MOJO_READ_DATA_FLAG_DISCARD |
+                MOJO_READ_DATA_FLAG_QUERY | MOJO_READ_DATA_FLAG_PEEK |
+                MOJO_READ_DATA_FLAG_MAX_NUM_BYTES))
+    return MOJO_RESULT_UNIMPLEMENTED;
+  // This only applies to two-phase reads.
+  if (flags & MOJO_READ_DATA_FLAG_MAX_NUM_BYTES)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  if ((flags & MOJO_READ_DATA_FLAG_DISCARD) &&
+      (flags & (MOJO_READ_DATA_FLAG_QUERY | MOJO_READ_DATA_FLAG_PEEK)))
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  if ((flags & MOJO_READ_DATA_FLAG_QUERY) && (flags & MOJO_READ_DATA_FLAG_PEEK))
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  return MOJO_RESULT_OK;
+}
+
+// Reads, discards or queries, as |MojoReadData()|, reading into the given
+// segments (whose total size, |*num_bytes|, and |flags| have already been
+// checked).
+static MojoResult ReadData(MojoHandle data_pipe_consumer_handle,
+                           const struct MojoReadDataSegment* segments,
+                           uint32_t num_segments,
+                           uint32_t* num_bytes,
+                           MojoReadDataFlags flags) {
+  pthread_mutex_lock(&g_mutex);
+  struct DataPipe* data_pipe;
+  MojoResult result =
+      LookupDataPipe(data_pipe_consumer_handle, OBJECT_TYPE_DATA_PIPE_CONSUMER,
+                     MOJO_HANDLE_RIGHT_READ, &data_pipe);
+  if (result != MOJO_RESULT_OK)
+    goto out;
+  if (data_pipe->two_phase_read_num_bytes) {
+    result = MOJO_RESULT_BUSY;
+    goto out;
+  }
+  if (flags & MOJO_READ_DATA_FLAG_QUERY) {
+    *num_bytes = data_pipe->num_bytes;
+    goto out;
+  }
+  if (*num_bytes % data_pipe->element_num_bytes) {
+    result = MOJO_RESULT_INVALID_ARGUMENT;
+    goto out;
+  }
+
+  if ((flags & MOJO_READ_DATA_FLAG_ALL_OR_NONE) &&
+      *num_bytes > data_pipe->num_bytes) {
+    result = data_pipe->producer_open ? MOJO_RESULT_OUT_OF_RANGE
+                                      : MOJO_RESULT_FAILED_PRECONDITION;
+    goto out;
+  }
+  if (!*num_bytes)
+    goto out;
+  if (!data_pipe->num_bytes) {
+    result = data_pipe->producer_open ? MOJO_RESULT_SHOULD_WAIT
+                                      : MOJO_RESULT_FAILED_PRECONDITION;
+    goto out;
+  }
+
+  if (*num_bytes > data_pipe->num_bytes)
+    *num_bytes = data_pipe->num_bytes;
+  if (!(flags & MOJO_READ_DATA_FLAG_DISCARD)) {
+    uint32_t offset = data_pipe->read_offset;
+    uint32_t num_bytes_left = *num_bytes;
+    for (uint32_t i = 0u; num_bytes_left; i++) {
+      uint32_t segment_num_bytes = segments[i].num_bytes < num_bytes_left
+                                       ? segments[i].num_bytes
+                                       : num_bytes_left;
+      if (!segment_num_bytes)
+        continue;
+      CopyFromDataPipe(data_pipe, offset, (char*)segments[i].bytes,
+                       segment_num_bytes);
+      offset = (offset + segment_num_bytes) % data_pipe->capacity_num_bytes;
+      num_bytes_left -= segment_num_bytes;
+    }
+  }
+  if (!(flags & MOJO_READ_DATA_FLAG_PEEK))
+    ConsumeFromDataPipe(data_pipe, *num_bytes);
+
+out:
+  pthread_mutex_unlock(&g_mutex);
+  return result;
+}
+
+MojoResult MojoReadData(MojoHandle data_pipe_consumer_handle,
+                        void* elements,
+                        uint32_t* num_bytes,
+                        MojoReadDataFlags flags) {
+  if (!num_bytes)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  MojoResult result = CheckReadDataFlags(flags);
+  if (result != MOJO_RESULT_OK)
+    return result;
+  struct MojoReadDataSegment segment = {elements, *num_bytes};
+  return ReadData(data_pipe_consumer_handle, &segment, 1u, num_bytes, flags);
+}
+
+MojoResult MojoReadDataV(MojoHandle data_pipe_consumer_handle,
+                         const struct MojoReadDataSegment* segments,
+                         uint32_t num_segments,
+                         uint32_t* num_bytes,
+                         MojoReadDataFlags flags) {
+  if (!num_bytes)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  MojoResult result = CheckReadDataFlags(flags);
+  if (result != MOJO_RESULT_OK)
+    return result;
+  if (flags & (MOJO_READ_DATA_FLAG_DISCARD | MOJO_READ_DATA_FLAG_QUERY))
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  if (num_segments && !segments)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+
+  uint32_t total_num_bytes = 0u;
+  for (uint32_t i = 0u; i < num_segments; i++) {
+    if (segments[i].num_bytes && !segments[i].bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    if (segments[i].num_bytes > UINT32_MAX - total_num_bytes)
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    total_num_bytes += segments[i].num_bytes;
+  }
+
+  // The data is copied directly from the data pipe's buffer into the segments.
+  *num_bytes = total_num_bytes;
+  return ReadData(data_pipe_consumer_handle, segments, num_segments, num_bytes,
+                  flags);
+}
+
+MojoResult MojoBeginReadData(MojoHandle data_pipe_consumer_handle,
+                             const void** buffer,
+                             uint32_t* buffer_num_bytes,
+                             MojoReadDataFlags flags) {
+  pthread_mutex_lock(&g_mutex);
+  struct DataPipe* data_pipe;
+  MojoResult result =
+      LookupDataPipe(data_pipe_consumer_handle, OBJECT_TYPE_DATA_PIPE_CONSUMER,
+                     MOJO_HANDLE_RIGHT_READ, &data_pipe);
+  if (result != MOJO_RESULT_OK)
+    goto out;
+  if ((flags & ~MOJO_READ_DATA_FLAG_MAX_NUM_BYTES) ||
+      ((flags & MOJO_READ_DATA_FLAG_MAX_NUM_BYTES) &&
+       (!*buffer_num_bytes ||
+        *buffer_num_bytes % data_pipe->element_num_bytes))) {
+    result = MOJO_RESULT_INVALID_ARGUMENT;
+    goto out;
+  }
+  if (data_pipe->two_phase_read_num_bytes) {
+    result = MOJO_RESULT_BUSY;
+    goto out;
+  }
+  if (!data_pipe->num_bytes) {
+    result = data_pipe->producer_open ? MOJO_RESULT_SHOULD_WAIT
+                                      : MOJO_RESULT_FAILED_PRECONDITION;
+    goto out;
+  }
+
+  // Offer all the contiguous data (up to the maximum, if any).
+  uint32_t available = data_pipe->num_bytes;
+  if (available > data_pipe->capacity_num_bytes - data_pipe->read_offset)
+    available = data_pipe->capacity_num_bytes - data_pipe->read_offset;
+  if ((flags & MOJO_READ_DATA_FLAG_MAX_NUM_BYTES) &&
+      available > *buffer_num_bytes)
+    available = *buffer_num_bytes;
+  data_pipe->two_phase_read_num_bytes = available;
+  *buffer = data_pipe->buffer + data_pipe->read_offset;
+  *buffer_num_bytes = available;
+
+out:
+  pthread_mutex_unlock(&g_mutex);
+  return result;
+}
+
+MojoResult MojoEndReadData(MojoHandle data_pipe_consumer_handle,
+                           uint32_t num_bytes_read) {
+  pthread_mutex_lock(&g_mutex);
+  struct DataPipe* data_pipe;
+  MojoResult result =
+      LookupDataPipe(data_pipe_consumer_handle, OBJECT_TYPE_DATA_PIPE_CONSUMER,
+                     MOJO_HANDLE_RIGHT_READ, &data_pipe);
+  if (result != MOJO_RESULT_OK)
+    goto out;
+  if (!data_pipe->two_phase_read_num_bytes) {
+    result = MOJO_RESULT_FAILED_PRECONDITION;
+    goto out;
+  }
+
+  if (num_bytes_read > data_pipe->two_phase_read_num_bytes ||
+      num_bytes_read % data_pipe->element_num_bytes) {
+    result = MOJO_RESULT_INVALID_ARGUMENT;
+  } else if (num_bytes_read) {
+    ConsumeFromDataPipe(data_pipe, num_bytes_read);
+  }
+  data_pipe->two_phase_read_num_bytes = 0u;
+  NotifyWatches(&data_pipe->consumer);
+
+out:
+  pthread_mutex_unlock(&g_mutex);
+  return result;
+}
+
+// buffer.h --------------------------------------------------------------------
+
+MojoResult MojoCreateSharedBuffer(
+    const struct MojoCreateSharedBufferOptions* options,
+    uint64_t num_bytes,
+    MojoHandle* shared_buffer_handle) {
+  if (options) {
+    if (options->struct_size <
+        EXTENT_OF(struct MojoCreateSharedBufferOptions, struct_size))
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    if (options->struct_size >=
+            EXTENT_OF(struct MojoCreateSharedBufferOptions, flags) &&
+        options->flags != MOJO_CREATE_SHARED_BUFFER_OPTIONS_FLAG_NONE)
+      return MOJO_RESULT_UNIMPLEMENTED;
+  }
+  if (!num_bytes)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+  if (num_bytes > MAX_SHARED_BUFFER_NUM_BYTES)
+    return MOJO_RESULT_RESOURCE_EXHAUSTED;
+
+  struct SharedBuffer* shared_buffer =
+      (struct SharedBuffer*)malloc(sizeof(struct SharedBuffer));
+  if (!shared_buffer)
+    return MOJO_RESULT_RESOURCE_EXHAUSTED;
+  // Not all C libraries have a wrapper for memfd_create() (1 is MFD_CLOEXEC).
+  int fd = (int)syscall(SYS_memfd_create, "mojo_shared_buffer", 1u);
+  if (fd < 0 || ftruncate(fd, (off_t)num_bytes) != 0) {
+    if (fd >= 0)
+      close(fd);
+    free(shared_buffer);
+    return MOJO_RESULT_RESOURCE_EXHAUSTED;
+  }
+  InitObject(&shared_buffer->object, OBJECT_TYPE_SHARED_BUFFER);
+  shared_buffer->fd = fd;
+  shared_buffer->num_bytes = num_bytes;
+
+  pthread_mutex_lock(&g_mutex);
+  MojoHandle handle = AllocHandle(&shared_buffer->object,
+                                  DEFAULT_SHARED_BUFFER_HANDLE_RIGHTS);
+  if (handle == MOJO_HANDLE_INVALID)
+    ReleaseObject(&shared_buffer->object);
+  pthread_mutex_unlock(&g_mutex);
+  if (handle == MOJO_HANDLE_INVALID)
+    return MOJO_RESULT_RESOURCE_EXHAUSTED;
+  *shared_buffer_handle = handle;
+  return MOJO_RESULT_OK;
+}
+
+MojoResult MojoDuplicateBufferHandle(
+    MojoHandle buffer_handle,
+    const struct MojoDuplicateBufferHandleOptions* options,
+    MojoHandle* new_buffer_handle) {
+  if (options) {
+    if (options->struct_size <
+        EXTENT_OF(struct MojoDuplicateBufferHandleOptions, struct_size))
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    if (options->struct_size >=
+            EXTENT_OF(struct MojoDuplicateBufferHandleOptions, flags) &&
+        options->flags != MOJO_DUPLICATE_BUFFER_HANDLE_OPTIONS_FLAG_NONE)
+      return MOJO_RESULT_UNIMPLEMENTED;
+  }
+  static const enum ObjectType kType = OBJECT_TYPE_SHARED_BUFFER;
+  return DuplicateHandle(buffer_handle, &kType, MOJO_HANDLE_RIGHT_NONE,
+                         new_buffer_handle);
+}
+
+MojoResult MojoGetBufferInformation(MojoHandle buffer_handle,
+                                    struct MojoBufferInformation* info,
+                                    uint32_t info_num_bytes) {
+  if (!info || info_num_bytes < sizeof(struct MojoBufferInformation))
+    return MOJO_RESULT_INVALID_ARGUMENT;
+
+  pthread_mutex_lock(&g_mutex);
+  struct Object* object;
+  MojoResult result = LookupObject(buffer_handle, OBJECT_TYPE_SHARED_BUFFER,
+                                   MOJO_HANDLE_RIGHT_GET_OPTIONS, &object);
+  if (result == MOJO_RESULT_OK) {
+    info->struct_size = sizeof(struct MojoBufferInformation);
+    info->flags = MOJO_BUFFER_INFORMATION_FLAG_NONE;
+    info->num_bytes =
+        CONTAINER_OF(object, struct SharedBuffer, object)->num_bytes;
+  }
+  pthread_mutex_unlock(&g_mutex);
+  return result;
+}
+
+MojoResult MojoMapBuffer(MojoHandle buffer_handle,
+                         uint64_t offset,
+                         uint64_t num_bytes,
+                         void** buffer,
+                         MojoMapBufferFlags flags) {
+  if (flags != MOJO_MAP_BUFFER_FLAG_NONE)
+    return MOJO_RESULT_INVALID_ARGUMENT;
+
+  pthread_mutex_lock(&g_mutex);
+  struct Object* object;
+  MojoResult result = LookupObject(
+      buffer_handle, OBJECT_TYPE_SHARED_BUFFER,
+      MOJO_HANDLE_RIGHT_MAP_READABLE | MOJO_HANDLE_RIGHT_MAP_WRITABLE, &object);
+  if (result != MOJO_RESULT_OK)
+    goto out;
+  struct SharedBuffer* shared_buffer =
+      CONTAINER_OF(object, struct SharedBuffer, object);
+  if (!num_bytes || offset > shared_buffer->num_bytes ||
+      num_bytes > shared_buffer->num_bytes - offset) {
+    result = MOJO_RESULT_INVALID_ARGUMENT;
+    goto out;
+  }
+
+  if (g_num_mappings == g_mappings_capacity) {
+    size_t new_capacity = g_mappings_capacity ? 2u * g_mappings_capacity : 16u;
+    struct Mapping* new_mappings = (struct Mapping*)realloc(
+        g_mappings, new_capacity * sizeof(struct Mapping));
+    if (!new_mappings) {
+      result = MOJO_RESULT_RESOURCE_EXHAUSTED;
+      goto out;
+    }
+    g_mappings = new_mappings;
+    g_mappings_capacity = new_capacity;
+  }
+
+  // mmap() needs a page-aligned offset.
+  uint64_t page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+  uint64_t map_offset = offset - offset % page_size;
+  size_t length = (size_t)(offset - map_offset + num_bytes);
+  void* base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    shared_buffer->fd, (off_t)map_offset);
+  if (base == MAP_FAILED) {
+    result = MOJO_RESULT_RESOURCE_EXHAUSTED;
+    goto out;
+  }
+  struct Mapping* mapping = &g_mappings[g_num_mappings++];
+  mapping->address = (char*)base + (offset - map_offset);
+  mapping->base = base;
+  mapping->length = length;
+  *buffer = mapping->address;
+
+out:
+  pthread_mutex_unlock(&g_mutex);
+  return result;
+}
+
+MojoResult MojoUnmapBuffer(void* buffer) {
+  pthread_mutex_lock(&g_mutex);
+  for (size_t i = 0u; i < g_num_mappings; i++) {
+    if (g_mappings[i].address == buffer) {
+      munmap(g_mappings[i].base, g_mappings[i].length);
+      g_mappings[i] = g_mappings[--g_num_mappings];
+      pthread_mutex_unlock(&g_mutex);
+      return MOJO_RESULT_OK;
+    }
+  }
+  pthread_mutex_unlock(&g_mutex);
+  return MOJO_RESULT_INVALID_ARGUMENT;
+}
+
+// wait_set.h ------------------------------------------------------------------
+
+MojoResult MojoCreateWaitSet(const struct MojoCreateWaitSetOptions* options,
+                             MojoHandle* handle) {
+  if (options) {
+    if (options->struct_size <
+        EXTENT_OF(struct MojoCreateWaitSetOptions, struct_size))
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    if (options->struct_size >=
+        EXTENT_OF(struct MojoCreateWaitSetOptions, flags)) {
+      // Currently no known flags.
+      if (options->flags)
+        return MOJO_RESULT_UNIMPLEMENTED;
+    }
+  }
+
+  struct WaitSet* wait_set = (struct WaitSet*)malloc(sizeof(struct WaitSet));
+  if (!wait_set)
+    return MOJO_RESULT_RESOURCE_EXHAUSTED;
+  InitObject(&wait_set->object, OBJECT_TYPE_WAIT_SET);
+  wait_set->first_entry = NULL;
+  wait_set->first_ready = NULL;
+  wait_set->last_ready = NULL;
+
+  pthread_mutex_lock(&g_mutex);
+  MojoHandle h =
+      AllocHandle(&wait_set->object, DEFAULT_WAIT_SET_HANDLE_RIGHTS);
+  if (h == MOJO_HANDLE_INVALID)
+    ReleaseObject(&wait_set->object);
+  pthread_mutex_unlock(&g_mutex);
+  if (h == MOJO_HANDLE_INVALID)
+    return MOJO_RESULT_RESOURCE_EXHAUSTED;
+  *handle = h;
+  return MOJO_RESULT_OK;
+}
+
+static struct WaitSetEntry* FindWaitSetEntry(struct WaitSet* wait_set,
+                                             uint64_t cookie) {
+  for (struct WaitSetEntry* entry = wait_set->first_entry; entry;
+       entry = entry->next) {
+    if (entry->cookie == cookie)
+      return entry;
+  }
+  return NULL;
+}
+
+MojoResult MojoWaitSetAdd(MojoHandle wait_set_handle,
+                          MojoHandle handle,
+                          MojoHandleSignals signals,
+                          uint64_t cookie,
+                          const struct MojoWaitSetAddOptions* options) {
+  if (options) {
+    if (options->struct_size <
+        EXTENT_OF(struct MojoWaitSetAddOptions, struct_size))
+      return MOJO_RESULT_INVALID_ARGUMENT;
+    if (options->struct_size >=
+        EXTENT_OF(struct MojoWaitSetAddOptions, flags)) {
+      // Currently no known flags.
+      if (options->flags)
+        return MOJO_RESULT_UNIMPLEMENTED;
+    }
+  }
+
+  struct WaitSetEntry* entry =
+      (struct WaitSetEntry*)malloc(sizeof(struct WaitSetEntry));
+  if (!entry)
+    return MOJO_RESULT_RESOURCE_EXHAUSTED;
+
+  pthread_mutex_lock(&g_mutex);
+  struct Object* object;
+  MojoResult result = LookupObject(wait_set_handle, OBJECT_TYPE_WAIT_SET,
+                                   MOJO_HANDLE_RIGHT_WRITE, &object);
+  struct HandleEntry* handle_entry = LookupHandle(handle);
+  if (result == MOJO_RESULT_OK &&
+      (!handle_entry || handle_entry->object->type == OBJECT_TYPE_WAIT_SET))
+    result = MOJO_RESULT_INVALID_ARGUMENT;
+  struct WaitSet* wait_set =
+      result == MOJO_RESULT_OK ? CONTAINER_OF(object, struct WaitSet, object)
+                               : NULL;
+  if (result == MOJO_RESULT_OK && FindWaitSetEntry(wait_set, cookie))
+    result = MOJO_RESULT_ALREADY_EXISTS;
+  if (result != MOJO_RESULT_OK) {
+    pthread_mutex_unlock(&g_mutex);
+    free(entry);
+    return result;
+  }
+
+  entry->wait_set = wait_set;
+  entry->signals = signals;
+  entry->cookie = cookie;
+  entry->previous = NULL;
+  entry->next = wait_set->first_entry;
+  if (wait_set->first_entry)
+    wait_set->first_entry->previous = entry;
+  wait_set->first_entry = entry;
+  entry->is_ready = false;
+  AddWatch(handle_entry->object, &entry->watch, handle, &NotifyWaitSetEntry);
+  // The handle may already be ready.
+  NotifyWaitSetEntry(&entry->watch, false);
+  pthread_mutex_unlock(&g_mutex);
+  return MOJO_RESULT_OK;
+}
+
+MojoResult MojoWaitSetRemove(MojoHandle wait_set_handle, uint64_t cookie) {
+  pthread_mutex_lock(&g_mutex);
+  struct Object* object;
+  MojoResult result = LookupObject(wait_set_handle, OBJECT_TYPE_WAIT_SET,
+                                   MOJO_HANDLE_RIGHT_WRITE, &object);
+  struct WaitSet* wait_set = NULL;
+  struct WaitSetEntry* entry = NULL;
+  if (result == MOJO_RESULT_OK) {
+    wait_set = CONTAINER_OF(object, struct WaitSet, object);
+    entry = FindWaitSetEntry(wait_set, cookie);
+    if (!entry)
+      result = MOJO_RESULT_NOT_FOUND;
+  }
+  if (entry) {
+    RemoveWatch(&entry->watch);
+    if (entry->is_ready)
+      RemoveReadyWaitSetEntry(entry);
+    if (entry->previous)
+      entry->previous->next = entry->next;
+    else
+      wait_set->first_entry = entry->next;
+    if (entry->next)
+      entry->next->previous = entry->previous;
+  }
+  pthread_mutex_unlock(&g_mutex);
+  free(entry);
+  return result;
+}
+
+MojoResult MojoWaitSetWait(MojoHandle wait_set_handle,
+                           MojoDeadline deadline,
+                           uint32_t* num_results,
+                           struct MojoWaitSetResult* results,
+                           uint32_t* max_results) {
+  if (!num_results || (*num_results && !results))
+    return MOJO_RESULT_INVALID_ARGUMENT;
+
+  MojoTimeTicks end_time = DeadlineToEndTime(deadline);
+  struct Waiter waiter;
+  InitWaiter(&waiter);
+  struct WaiterWatch waiter_watch;
+  waiter_watch.watch.object = NULL;
+  waiter_watch.waiter = &waiter;
+  waiter_watch.index = 0u;
+
+  pthread_mutex_lock(&g_mutex);
+  struct Object* object;
+  MojoResult result = LookupObject(wait_set_handle, OBJECT_TYPE_WAIT_SET,
+                                   MOJO_HANDLE_RIGHT_READ, &object);
+  if (result != MOJO_RESULT_OK) {
+    pthread_mutex_unlock(&g_mutex);
+    return result;
+  }
+  struct WaitSet* wait_set = CONTAINER_OF(object, struct WaitSet, object);
+  waiter_watch.object = object;
+
+  for (;;) {
+    __atomic_store_n(&waiter.state, WAITER_AWAKE, __ATOMIC_RELAXED);
+
+    // Report the entries that are (still) ready, pruning the others.
+    uint32_t num_ready = 0u;
+    struct WaitSetEntry* entry = wait_set->first_ready;
+    while (entry) {
+      struct WaitSetEntry* next = entry->next_ready;
+      MojoResult wait_result;
+      struct MojoHandleSignalsState signals_state;
+      if (IsWaitSetEntryReady(entry, &wait_result, &signals_state)) {
+        if (num_ready < *num_results) {
+          results[num_ready].cookie = entry->cookie;
+          results[num_ready].wait_result = wait_result;
+          results[num_ready].reserved = 0u;
+          results[num_ready].signals_state = signals_state;
+        }
+        num_ready++;
+      } else {
+        RemoveReadyWaitSetEntry(entry);
+      }
+      entry = next;
+    }
+    if (num_ready) {
+      if (num_ready < *num_results)
+        *num_results = num_ready;
+      if (max_results)
+        *max_results = num_ready;
+      result = MOJO_RESULT_OK;
+      break;
+    }
+
+    if (waiter.cancelled) {
+      result = MOJO_RESULT_CANCELLED;
+      break;
+    }
+    if (end_time != END_TIME_INFINITE && GetTimeTicksNow() >= end_time) {
+      result = MOJO_RESULT_DEADLINE_EXCEEDED;
+      break;
+    }
+    if (!waiter_watch.watch.object) {
+      AddRefObject(object);
+      AddWatch(object, &waiter_watch.watch, wait_set_handle, &NotifyWaiter);
+    }
+    Sleep(&waiter, end_time);
+  }
+
+  // (If the wait set's handle was closed, the watch was already removed.)
+  bool was_watching = waiter_watch.watch.object || waiter.cancelled;
+  RemoveWatch(&waiter_watch.watch);
+  if (was_watching)
+    ReleaseObject(object);
+  pthread_mutex_unlock(&g_mutex);
+  return result;
+}
@@ -4,10 +4,19 @@
 
 #include "mojo/public/cpp/test_support/test_support.h"
 
+#include <dirent.h>
 #include <stdio.h>
 
 namespace mojo {
 namespace test {
+namespace {
+
+// |MOJO_SOURCE_ROOT| is the absolute path of the source root (see BUILD.gn).
+std::string GetSourceRootPath(const std::string& relative_path) {
+  return std::string(MOJO_SOURCE_ROOT) + "/" + relative_path;
+}
+
+}  // namespace
 
 void LogPerfResult(const char* test_name,
                    const char* sub_test_name,
@@ -20,14 +29,21 @@ void LogPerfResult(const char* test_name,
 }
 
 FILE* OpenSourceRootRelativeFile(const std::string& relative_path) {
-  // TODO(jamesr): implement.
-  return nullptr;
+  return fopen(GetSourceRootPath(relative_path).c_str(), "r");
 }
 
 std::vector<std::string> EnumerateSourceRootRelativeDirectory(
     const std::string& relative_path) {
-  // TODO(jamesr): implement.
-  return std::vector<std::string>();
+  std::vector<std::string> names;
+  DIR* dir = opendir(GetSourceRootPath(relative_path).c_str());
+  if (!dir)
+    return names;
+  while (struct dirent* entry = readdir(dir)) {
+    if (entry->d_type == DT_REG)
+      names.push_back(entry->d_name);
+  }
+  closedir(dir);
+  return names;
 }
 
 }  // namespace test